@@ -3,223 +3,423 @@
 #include "devices.hpp"
 #include "Settings.hpp"
 #include "utilities/print/Print.hpp"
-#include "utilities/strings/Strings.hpp"
 #include "ProbeStrings.hpp"
+#include "config.hpp"
+#include "latencyStats/LatencyStats.hpp"
+#include "stackMonitor/StackMonitor.hpp"
 
-using namespace Cli;
-using namespace Strings;
+#include <util/atomic.h>
 
-const static char* ON_STR = "ON";
-const static char* OFF_STR = "OFF";
+using namespace Commands;
 
-const static char* WIFI_ENABLED_FORMAT_STR = "WIFI is %s";
+static void printWifiEnabled()
+{
+    PRINTLN_P("WIFI is %s", getString(settings.wifiEnabled ? ProbeStrings::ON : ProbeStrings::OFF));
+}
+
+static void lightCmd(const Args& args)
+{
+    uint8_t value = args.getInt(0);
+    settings.lightMode = LightMode::STATIC;
+    settings.staticLight = value;
+    pDisplay->setBrightness(value);
+    PRINTLN(getString(ProbeStrings::PASS));
+}
 
-static void setLcdBrightness(uint16_t argc, ArgV argv)
+static void setDynamicLight(LightMode lightMode, const Args& args)
 {
-    if ((argc > 4) ||
-        (argc < 1))
+    // Both are percentages already, max must not be under min
+    int32_t minLight = args.getInt(0);
+    int32_t maxLight = args.getInt(1);
+    if (minLight > maxLight)
     {
-        if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_NUM_PARAMS));
-        PRINTLN(getString(ProbeStrings::PASS));
+        if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
+        PRINTLN(getString(ProbeStrings::FAIL));
         return;
     }
 
-    // Discover the light mode to set to from the first parameter
-    LightMode newLightMode = LightMode::STATIC;
-    if (strcompare(argv[1], "D"))
-    {
-        newLightMode = LightMode::DECREASE;
-    }
-    else if (strcompare(argv[1], "I"))
-    {
-        newLightMode = LightMode::INCREASE;
-    }
+    settings.lightMode = lightMode;
+    settings.minLight = minLight;
+    settings.maxLight = maxLight;
+    pDisplay->refreshBrightness();
+    PRINTLN(getString(ProbeStrings::PASS));
+}
 
-    if ((newLightMode == LightMode::INCREASE) ||
-        (newLightMode == LightMode::DECREASE))
-    {
-        // A dynamic light mode was selected, get the dynamic ranges
-        int32_t minLight = str2int(argv[2]);
-        int32_t maxLight = str2int(argv[3]);
-
-        // Ensure both values are valid percentages, and max is greater than min
-        if ((minLight < 0) || (minLight > 100) ||
-            (maxLight < 0) || (maxLight > 100) ||
-            (minLight > maxLight))
-        {
-            if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
-            PRINTLN(getString(ProbeStrings::FAIL));
-        }
-        else
-        {
-            // Valid values, lets update
-            settings.lightMode = newLightMode;
-            settings.minLight = minLight;
-            settings.maxLight = maxLight;
-            PRINTLN(getString(ProbeStrings::PASS));
-        }
-        
-    }
-    else
-    {
-        // Static light mode was selected
-        int32_t value = str2int(argv[1]);
-        if ((value < 0) || (value > 100))
-        {
-            if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
-            PRINTLN(getString(ProbeStrings::FAIL));
-            return;
-        }
+static void lightIncreaseCmd(const Args& args)
+{
+    setDynamicLight(LightMode::INCREASE, args);
+}
 
-        settings.lightMode = LightMode::STATIC;
-        settings.staticLight = value;
-        pDisplay->setBrightness(value);
-        PRINTLN(getString(ProbeStrings::PASS));
-    }
+static void lightDecreaseCmd(const Args& args)
+{
+    setDynamicLight(LightMode::DECREASE, args);
 }
 
-static void wifiCommand(uint16_t argc, ArgV argv)
+static void onWifiGetConfig(bool success, const char* ssid)
 {
-    if (argc == 1)
-    {
-        PRINTLN(WIFI_ENABLED_FORMAT_STR, settings.wifiEnabled ? ON_STR : OFF_STR);
-    }
-    else if (strcompare(argv[1], "GET") && (argc == 2))
-    {
-        char ssid[MAX_SSID_LEN+1];
-        if (pWifiInterface->getConfig(ssid, MAX_SSID_LEN+1))
-        {
-            PRINTLN("Config: %s");
-            PRINTLN(getString(ProbeStrings::PASS));
-        }
-        else
-        {
-            PRINTLN(getString(ProbeStrings::FAIL));
-        }
-    }
-    else if (strcompare(argv[1], OFF_STR))
+    if (success)
     {
-        settings.wifiEnabled = false;
-        PRINTLN(WIFI_ENABLED_FORMAT_STR, settings.wifiEnabled ? ON_STR : OFF_STR);
-    }
-    else if (strcompare(argv[1], ON_STR))
-    {
-        settings.wifiEnabled = true;
-        PRINTLN(WIFI_ENABLED_FORMAT_STR, settings.wifiEnabled ? ON_STR : OFF_STR);
-    }
-    else if (strcompare(argv[1], "SET") && (argc == 4))
-    {
-        PRINTLN("Config to: %s - %s", argv[2], argv[3]);
-        PRINTLN(pWifiInterface->setConfig(argv[2], argv[3]) ? getString(ProbeStrings::PASS) : getString(ProbeStrings::FAIL));
+        PRINTLN_P("Config: %s", ssid);
+        PRINTLN(getString(ProbeStrings::PASS));
     }
     else
     {
-        if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_NUM_PARAMS));
         PRINTLN(getString(ProbeStrings::FAIL));
     }
 }
 
-static void setTempUnit(uint16_t argc, ArgV argv)
+static void onWifiSetConfig(bool success, const char* response)
 {
-    if (argc == 1)
+    PRINTLN(success ? getString(ProbeStrings::PASS) : getString(ProbeStrings::FAIL));
+}
+
+static void wifiCmd(const Args& args)
+{
+    printWifiEnabled();
+}
+
+static void wifiGetCmd(const Args& args)
+{
+    // Result is printed once the wifi module answers
+    if (!pWifiInterface->getConfig(&onWifiGetConfig))
     {
-        PRINTLN(pDisplay->isCelsius() ? "C" : "F");
+        PRINTLN(getString(ProbeStrings::FAIL));
     }
-    else if (argc == 2)
+}
+
+static void wifiOnCmd(const Args& args)
+{
+    settings.wifiEnabled = true;
+    printWifiEnabled();
+}
+
+static void wifiOffCmd(const Args& args)
+{
+    settings.wifiEnabled = false;
+    printWifiEnabled();
+}
+
+static void wifiSetCmd(const Args& args)
+{
+    PRINTLN_P("Config to: %s - %s", args.getWord(0), args.getWord(1));
+    if (!pWifiInterface->setConfig(args.getWord(0), args.getWord(1), &onWifiSetConfig))
     {
-        if (strcompare(argv[1], "C"))
-        {
-            pDisplay->setTempUnit(true);
-        }
-        else if (strcompare(argv[1], "F"))
-        {
-            pDisplay->setTempUnit(false);
-        }
-        else
-        {
-            if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
-            PRINTLN(getString(ProbeStrings::FAIL));
-            return;
-        }
-        PRINTLN(getString(ProbeStrings::PASS));
+        PRINTLN(getString(ProbeStrings::FAIL));
     }
-    else
+}
+
+static void unitCmd(const Args& args)
+{
+    PRINTLN(getString(pDisplay->isCelsius() ? ProbeStrings::UNIT_C : ProbeStrings::UNIT_F));
+}
+
+static void unitCelsiusCmd(const Args& args)
+{
+    pDisplay->setTempUnit(true);
+    PRINTLN(getString(ProbeStrings::PASS));
+}
+
+static void unitFahrenheitCmd(const Args& args)
+{
+    pDisplay->setTempUnit(false);
+    PRINTLN(getString(ProbeStrings::PASS));
+}
+
+static void debugCmd(const Args& args)
+{
+    PRINTLN_P("DEBUG is %s", getString(settings.debug ? ProbeStrings::ON : ProbeStrings::OFF));
+}
+
+static void debugOnCmd(const Args& args)
+{
+    settings.debug = true;
+    debugCmd(args);
+}
+
+static void debugOffCmd(const Args& args)
+{
+    settings.debug = false;
+    debugCmd(args);
+}
+
+static void echoCmd(const Args& args)
+{
+    PRINTLN_P("T: %f, H: %f, L: %f",
+        Protocol::fromFixedTemperature(latestData.temperature),
+        Protocol::fromFixedPercent(latestData.humidity),
+        Protocol::fromFixedPercent(latestData.light));
+}
+
+static void bufferCmd(const Args& args)
+{
+    PRINTLN_P("Backlog: %u/%u, dropped: %u",
+        pReadingBuffer->getCount(),
+        pReadingBuffer->getCapacity(),
+        pReadingBuffer->getDropped());
+
+    // Drain rate while actually sending, in readings per minute
+    uint32_t sendTics = pWifiInterface->getSendTics();
+    uint32_t readingsSent = pWifiInterface->getReadingsSent();
+    uint16_t perMinute = (sendTics > 0) ?
+                            (readingsSent * 60 * TICS_PER_SECOND) / sendTics :
+                            0;
+    PRINTLN_P("Sent: %u, %u/min, %s",
+        (uint16_t)readingsSent,
+        perMinute,
+        getString(pWifiInterface->isBinaryMode() ? ProbeStrings::BINARY_MODE : ProbeStrings::TEXT_MODE));
+}
+
+static void sleepCmd(const Args& args)
+{
+    uint32_t windowTics;
+    uint8_t residency = takeSleepResidency(windowTics);
+    PRINTLN_P("Asleep %u percent of the last %u min",
+        residency,
+        (uint16_t)(windowTics / (60 * TICS_PER_SECOND)));
+}
+
+static void stackCmd(const Args& args)
+{
+    // The minimum is the most the stack has ever grown since boot, including interrupts
+    PRINTLN_P("RAM: static %u, stack free %u, min free %u",
+        StackMonitor::getStaticSize(),
+        StackMonitor::getFree(),
+        StackMonitor::getMinFree());
+}
+
+static void eepromCmd(const Args& args)
+{
+    PRINTLN_P("Slot %u, seq %u, saved %u, bytes written %u, %s",
+        pSettingsJournal->getSlot(),
+        pSettingsJournal->getSequence(),
+        pSettingsJournal->getRecordsSaved(),
+        (uint16_t)pSettingsJournal->getBytesWritten(),
+        getString(pSettingsJournal->isSaving() ? ProbeStrings::SAVING : ProbeStrings::IDLE));
+}
+
+static void histCmd(const Args& args)
+{
+    // The log is sent in binary, a little at a time, see HistoryLog.hpp for the format
+    if (!pHistoryLog->dump(getUptimeSeconds())) PRINTLN(getString(ProbeStrings::FAIL));
+}
+
+static void histCountCmd(const Args& args)
+{
+    PRINTLN_P("Samples: %u, dropped: %u", pHistoryLog->getSamples(), pHistoryLog->getDropped());
+}
+
+// Timer counts to microseconds, saturating at what fits in a print
+static uint16_t countsToMicros(uint32_t counts)
+{
+    const static uint32_t MICROS_PER_COUNT = 1000000 / COUNTS_PER_SECOND;
+    uint32_t micros = counts * MICROS_PER_COUNT;
+    return (micros > UINT16_MAX) ? UINT16_MAX : micros;
+}
+
+static void tasksCmd(const Args& args)
+{
+    // Runtimes and lateness in microseconds
+    PRINTLN_P("Task: runs, mean, max, late, overruns");
+    for (uint8_t i=0; i<pScheduler->getNumTasks(); i++)
     {
-        PRINTLN(getString(ProbeStrings::INVALID_NUM_PARAMS));
+        const Scheduler::TaskStats& stats = pScheduler->getStats(i);
+        uint32_t mean = (stats.runs > 0) ? (stats.totalRuntime / stats.runs) : 0;
+        PRINTLN_P("%s: %u, %u, %u, %u, %u",
+            loadString(pScheduler->getTask(i).name),
+            stats.runs,
+            countsToMicros(mean),
+            countsToMicros(stats.maxRuntime),
+            countsToMicros(stats.maxLateness),
+            stats.overruns);
     }
 }
 
-static void setDebug(uint16_t argc, ArgV argv)
+static void tasksClearCmd(const Args& args)
+{
+    pScheduler->clearStats();
+    PRINTLN(getString(ProbeStrings::PASS));
+}
+
+#ifdef LATENCY_STATS
+static void statsCmd(const Args& args)
 {
-    if (argc == 2)
+    // Times are in timer counts of 64us, histogram bin n holds times under 2^n counts
+    PRINTLN_P("Stage: count, min, mean, max | histogram");
+    for (uint8_t i=0; i<NUM_STAGES; i++)
     {
-        if (strcompare(argv[1], ON_STR))
+        LatencyStage stage = (LatencyStage)i;
+        StageStats stats;
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
         {
-            settings.debug = true;
+            stats = LatencyStats::getStats(stage);
         }
-        else if (strcompare(argv[1], OFF_STR))
+        uint32_t mean = (stats.count > 0) ? (stats.totalTime / stats.count) : 0;
+        PRINT_P("%s: %lu, %u, %u, %u |",
+            loadString(LatencyStats::getName(stage)),
+            (unsigned long)stats.count,
+            stats.minTime,
+            (uint16_t)mean,
+            stats.maxTime);
+        for (uint8_t bin=0; bin<LATENCY_BINS; bin++)
         {
-            settings.debug = false;
+            PRINT_P(" %u", stats.histogram[bin]);
         }
-        else
-        {
-            PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
-            return;
-        }
-    }
-    
-    if (argc <= 2)
-    {
-        PRINTLN("DEBUG is %s", settings.debug ? ON_STR : OFF_STR);
-    }
-    else
-    {
-        PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
+        PRINTLN_P("");
     }
+
+    // Dumping starts a new measurement window
+    LatencyStats::reset();
+}
+#endif
+
+static void reportCmd(const Args& args)
+{
+    PRINTLN_P("Deadband T %u H %u (tenths), heartbeat %u min",
+        settings.tempDeadband,
+        settings.humidityDeadband,
+        settings.heartbeatMinutes);
+    // The policy's period, the task runs every tic while a reading is in progress
+    PRINTLN_P("Sample %u-%u s, now %u s",
+        settings.fastSampleSeconds,
+        settings.slowSampleSeconds,
+        pReportPolicy->getSamplePeriod());
+}
+
+static void reportDeadbandCmd(const Args& args)
+{
+    // Deadbands in tenths of a degree and tenths of a percent
+    settings.tempDeadband = args.getInt(0);
+    settings.humidityDeadband = args.getInt(1);
+    reportCmd(args);
+    PRINTLN(getString(ProbeStrings::PASS));
 }
 
-static void getLastReading(uint16_t argc, ArgV argv)
+static void reportHeartbeatCmd(const Args& args)
 {
-    if (argc == 1)
+    settings.heartbeatMinutes = args.getInt(0);
+    reportCmd(args);
+    PRINTLN(getString(ProbeStrings::PASS));
+}
+
+static void reportRateCmd(const Args& args)
+{
+    int32_t fast = args.getInt(0);
+    int32_t slow = args.getInt(1);
+    if (slow < fast)
     {
-        PRINTLN("T: %f, H: %f, L: %f", latestData.tempF, latestData.humidity, latestData.light);
-    }
-    else {
-        PRINTLN(getString(ProbeStrings::INVALID_NUM_PARAMS));
+        if (settings.debug) PRINTLN(getString(ProbeStrings::INVALID_PARAM_VALUE));
+        PRINTLN(getString(ProbeStrings::FAIL));
+        return;
     }
+
+    settings.fastSampleSeconds = fast;
+    settings.slowSampleSeconds = slow;
+
+    // Take the next reading soon, rather than after the old period
+    pScheduler->setPeriod(pScheduler->findTask(updateClimateSensor), fast * COUNTS_PER_SECOND);
+    reportCmd(args);
+    PRINTLN(getString(ProbeStrings::PASS));
 }
 
-static void idCmd(uint16_t argc, ArgV argv)
+static void idCmd(const Args& args)
 {
-    if (argc < 3)
-    {
-        if (argc == 2)
-        {
-            int32_t value = str2int(argv[1]);
-            settings.id = value;
-        }
+    if (args.count == 1) settings.id = args.getInt(0);
 
-        PRINTLN("ID: %u", settings.id);
-        PRINTLN(getString(ProbeStrings::PASS));
-    }
-    else {
-        PRINTLN(getString(ProbeStrings::INVALID_NUM_PARAMS));
-        getString(ProbeStrings::FAIL);
-    }
+    PRINTLN_P("ID: %u", settings.id);
+    PRINTLN(getString(ProbeStrings::PASS));
 }
 
-const static Command commands[] =
+static void helpCmd(const Args& args);
+
+// Longest command line, enough for WIFI SET with a full length SSID and password
+const static uint8_t LINE_LEN = 80;
+
+constexpr static Command commands[] PROGMEM =
 {
-    {.name = "LIGHT", .function = setLcdBrightness},
-    {.name = "WIFI", .function = wifiCommand},
-    {.name = "DEBUG", .function = setDebug},
-    {.name = "UNIT", .function = setTempUnit},
-    {.name = "ECHO", .function = getLastReading},
-    {.name = "ID", .function = idCmd}
+    {"LIGHT",       lightCmd,           1, 1, {CLI_INT("pct", 0, 100)}},
+    {"LIGHT I",     lightIncreaseCmd,   2, 2, {CLI_INT("min", 0, 100), CLI_INT("max", 0, 100)}},
+    {"LIGHT D",     lightDecreaseCmd,   2, 2, {CLI_INT("min", 0, 100), CLI_INT("max", 0, 100)}},
+    {"WIFI",        wifiCmd,            0, 0, {}},
+    {"WIFI GET",    wifiGetCmd,         0, 0, {}},
+    {"WIFI ON",     wifiOnCmd,          0, 0, {}},
+    {"WIFI OFF",    wifiOffCmd,         0, 0, {}},
+    {"WIFI SET",    wifiSetCmd,         2, 2, {CLI_WORD("ssid"), CLI_WORD("pass")}},
+    {"DEBUG",       debugCmd,           0, 0, {}},
+    {"DEBUG ON",    debugOnCmd,         0, 0, {}},
+    {"DEBUG OFF",   debugOffCmd,        0, 0, {}},
+    {"UNIT",        unitCmd,            0, 0, {}},
+    {"UNIT C",      unitCelsiusCmd,     0, 0, {}},
+    {"UNIT F",      unitFahrenheitCmd,  0, 0, {}},
+    {"ECHO",        echoCmd,            0, 0, {}},
+    {"ID",          idCmd,              0, 1, {CLI_INT("id", 0, UINT16_MAX)}},
+    {"BUF",         bufferCmd,          0, 0, {}},
+    {"SLEEP",       sleepCmd,           0, 0, {}},
+    {"STACK",       stackCmd,           0, 0, {}},
+    {"EEPROM",      eepromCmd,          0, 0, {}},
+    {"HIST",        histCmd,            0, 0, {}},
+    {"HIST N",      histCountCmd,       0, 0, {}},
+    {"REPORT",      reportCmd,          0, 0, {}},
+    {"REPORT DB",   reportDeadbandCmd,  2, 2, {CLI_INT("temp", 0, UINT8_MAX), CLI_INT("hum", 0, UINT8_MAX)}},
+    {"REPORT HB",   reportHeartbeatCmd, 1, 1, {CLI_INT("min", 1, UINT8_MAX)}},
+    {"REPORT RATE", reportRateCmd,      2, 2, {CLI_INT("fast", 1, UINT16_MAX), CLI_INT("slow", 1, UINT16_MAX)}},
+#ifdef LATENCY_STATS
+    {"STATS",       statsCmd,           0, 0, {}},
+#endif
+    {"TASKS",       tasksCmd,           0, 0, {}},
+    {"TASKS CLR",   tasksClearCmd,      0, 0, {}},
+    {"HELP",        helpCmd,            0, 0, {}}
 };
-const static uint16_t numCommands = sizeof(commands) / sizeof(commands[0]);
+const static uint8_t numCommands = sizeof(commands) / sizeof(commands[0]);
+typedef HashTable<commands, numCommands> CommandHash;
 
-static CommandInterface probeCli(pSerial, commands, numCommands);
-CommandInterface* pProbeCli = &probeCli;
+static bool readChar(char& c)
+{
+    return pSerial->read(&c, 1) == 1;
+}
+
+static void onError(Result result)
+{
+    switch (result)
+    {
+        case Result::UNKNOWN:
+            PRINTLN_P("Unknown command, try HELP");
+            break;
+        case Result::TOO_LONG:
+            PRINTLN_P("Line too long");
+            break;
+        default:
+            if (settings.debug)
+            {
+                PRINTLN(getString((result == Result::BAD_ARG) ?
+                                    ProbeStrings::INVALID_PARAM_VALUE :
+                                    ProbeStrings::INVALID_NUM_PARAMS));
+            }
+            break;
+    }
+    PRINTLN(getString(ProbeStrings::FAIL));
+}
+
+static char lineBuffer[LINE_LEN];
+static CommandTable probeCli(commands,
+                             numCommands,
+                             CommandHash::slots,
+                             CommandHash::MASK,
+                             CommandHash::SEED,
+                             lineBuffer,
+                             LINE_LEN,
+                             &readChar,
+                             &onError);
+CommandTable* pProbeCli = &probeCli;
+
+static void helpCmd(const Args& args)
+{
+    // Generated from the table, so it always matches what is accepted
+    char usage[MAX_FORMAT_LEN];
+    for (uint8_t i=0; i<numCommands; i++)
+    {
+        pProbeCli->getUsage(i, usage, sizeof(usage));
+        PRINTLN(usage);
+    }
+}
 
-#endif
\ No newline at end of file
+#endif
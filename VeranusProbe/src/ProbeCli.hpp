@@ -2,9 +2,9 @@
 #define PROBE_CLI_HPP
 
 #ifndef DISABLE_CLI
-#include "utilities/cli/CommandInterface.hpp"
+#include "CommandTable.hpp"
 
-extern Cli::CommandInterface* pProbeCli;
+extern Commands::CommandTable* pProbeCli;
 #endif
 
 #endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#include "ProbeStrings.hpp"
+
+static char stringBuffer[MAX_STRING_LEN];
+static char formatBuffer[MAX_FORMAT_LEN];
+
+const PROGMEM char invalidParamValueStr[] = "Invalid parameter value.";
+const PROGMEM char invalidNumParamsStr[] = "Invalid number of parameters.";
+const PROGMEM char climateSensorFailure[] = "Failed to read from climate sensor.";
+const PROGMEM char pass[] = "PASS";
+const PROGMEM char fail[] = "FAIL";
+const PROGMEM char on[] = "ON";
+const PROGMEM char off[] = "OFF";
+const PROGMEM char watchdog[] = "watchdog";
+const PROGMEM char brownOut[] = "brown-out";
+const PROGMEM char tempLabel[] = "T:";
+const PROGMEM char humidLabel[] = "H:";
+const PROGMEM char unitF[] = "F";
+const PROGMEM char unitC[] = "C";
+const PROGMEM char unitPercent[] = "%";
+const PROGMEM char binaryMode[] = "BIN";
+const PROGMEM char textMode[] = "TXT";
+const PROGMEM char saving[] = "saving";
+const PROGMEM char idle[] = "idle";
+
+const char* const stringTable[] PROGMEM =
+{
+    invalidParamValueStr,
+    invalidNumParamsStr,
+    climateSensorFailure,
+    pass,
+    fail,
+    on,
+    off,
+    watchdog,
+    brownOut,
+    tempLabel,
+    humidLabel,
+    unitF,
+    unitC,
+    unitPercent,
+    binaryMode,
+    textMode,
+    saving,
+    idle
+};
+
+static_assert(sizeof(climateSensorFailure) <= MAX_STRING_LEN, "String too long for the string buffer");
+
+const char* getString(ProbeStrings probeString)
+{
+    return loadString((PGM_P)pgm_read_word(&(stringTable[(uint8_t)probeString])));
+}
+
+const char* loadString(PGM_P string)
+{
+    strlcpy_P(stringBuffer, string, MAX_STRING_LEN);
+    return stringBuffer;
+}
+
+const char* loadFormat(PGM_P format)
+{
+    strlcpy_P(formatBuffer, format, MAX_FORMAT_LEN);
+    return formatBuffer;
+}
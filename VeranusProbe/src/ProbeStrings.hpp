@@ -3,30 +3,71 @@
 
 #include <stdint.h>
 #include <avr/pgmspace.h>
+#include "utilities/print/Print.hpp"
 
+/**
+ * Pool of the probe's strings, kept in flash and copied into RAM only while in use
+ */
 enum class ProbeStrings : uint8_t
 {
     INVALID_PARAM_VALUE = 0,
     INVALID_NUM_PARAMS,
     CLIMATE_SENSOR_FAILURE,
     PASS,
-    FAIL
+    FAIL,
+    ON,
+    OFF,
+    WATCHDOG,
+    BROWN_OUT,
+    TEMP_LABEL,
+    HUMID_LABEL,
+    UNIT_F,
+    UNIT_C,
+    UNIT_PERCENT,
+    BINARY_MODE,
+    TEXT_MODE,
+    SAVING,
+    IDLE
 };
 
-const static uint8_t MAX_STRING_LEN = 64;
-static char stringBuffer[MAX_STRING_LEN];
+// Longest pooled string, and longest print format, including the terminator
+const static uint8_t MAX_STRING_LEN = 40;
+const static uint8_t MAX_FORMAT_LEN = 48;
 
-const PROGMEM char invalidParamValueStr[] = "Invalid parameter value.";
-const PROGMEM char invalidNumParamsStr[] = "Invalid number of parameters.";
-const PROGMEM char climateSensorFailure[] = "Failed to read from climate sensor.";
-const PROGMEM char pass[] = "PASS";
-const PROGMEM char fail[] = "FAIL";
-const char* const stringTable[] PROGMEM = {invalidParamValueStr, invalidNumParamsStr, climateSensorFailure, pass, fail};
+/**
+ * Get a string from the pool. All strings share one buffer, so it is only valid until the next call
+ * @param   probeString     String to get
+ * @return  The string, copied into RAM
+ */
+const char* getString(ProbeStrings probeString);
 
-static const char* getString(ProbeStrings probeString)
-{
-    strcpy_P(stringBuffer, (char *)pgm_read_word(&(stringTable[(uint8_t)probeString])));
-    return stringBuffer;
-}
+/**
+ * Copy a string out of flash, into the buffer getString() uses, so it is only valid until the next call
+ * @param   string  String in flash
+ * @return  The string, copied into RAM
+ */
+const char* loadString(PGM_P string);
+
+/**
+ * Copy a print format out of flash, into its own buffer so that it can be used with getString()
+ * @param   format  Format string in flash
+ * @return  The format, copied into RAM
+ */
+const char* loadFormat(PGM_P format);
+
+/**
+ * Print with the format kept in flash instead of RAM
+ */
+#define PRINTLN_P(format, ...)                                                                  \
+    do {                                                                                        \
+        static_assert(sizeof(format) <= MAX_FORMAT_LEN, "Print format too long");              \
+        PRINTLN(loadFormat(PSTR(format)), ##__VA_ARGS__);                                       \
+    } while (0)
+
+#define PRINT_P(format, ...)                                                                    \
+    do {                                                                                        \
+        static_assert(sizeof(format) <= MAX_FORMAT_LEN, "Print format too long");              \
+        PRINT(loadFormat(PSTR(format)), ##__VA_ARGS__);                                         \
+    } while (0)
 
-#endif
\ No newline at end of file
+#endif
@@ -9,7 +9,12 @@ Settings settings =
     .minLight = 10,
     .maxLight = 10,
     .debug = true,
-    .wifiEnabled = true
+    .wifiEnabled = true,
+    .tempDeadband = 5,
+    .humidityDeadband = 20,
+    .heartbeatMinutes = 60,
+    .fastSampleSeconds = 60,
+    .slowSampleSeconds = 5 * 60
 };
 
 // Ensure this whole struct fits in EEPROM
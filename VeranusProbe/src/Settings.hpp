@@ -3,7 +3,7 @@
 
 #include <stdint.h>
 
-const static uint8_t EEPROM_REV = 2;
+const static uint8_t EEPROM_REV = 3;
 
 enum LightMode : uint8_t
 {
@@ -22,6 +22,16 @@ struct Settings
     uint8_t maxLight;
     bool debug;
     bool wifiEnabled;
+
+    // Readings are only sent when they have changed by more than the deadband since the last one
+    // sent, or when nothing has been sent for the heartbeat time
+    uint8_t tempDeadband;       // Tenths of a degree Fahrenheit
+    uint8_t humidityDeadband;   // Tenths of a percent
+    uint8_t heartbeatMinutes;
+
+    // Climate readings are taken every fast period while changing, backing off to the slow period
+    uint16_t fastSampleSeconds;
+    uint16_t slowSampleSeconds;
 };
 
 extern Settings settings;
@@ -0,0 +1,138 @@
+#include "asyncHdc1080/AsyncHdc1080.hpp"
+
+using namespace Twi;
+
+const static uint8_t HDC1080_ADDRESS = 0x40;
+
+const static uint8_t TEMPERATURE_REGISTER = 0x00;
+const static uint8_t CONFIG_REGISTER = 0x02;
+
+// Acquire temperature then humidity on one trigger, both at 14 bits, heater off
+const static uint16_t CONFIG_MODE_BOTH = 0x1000;
+
+/*
+ * Raw readings are fractions of full scale, as 16 bits.
+ * Temperature is -40C to 125C, which is -40F to 257F, so 297F of range.
+ * Humidity is 0% to 100%
+ */
+const static uint8_t RAW_SHIFT = 16;
+const static int32_t TEMPERATURE_RANGE = 29700;
+const static int32_t TEMPERATURE_MIN = -4000;
+const static uint32_t HUMIDITY_RANGE = 10000;
+
+static void setTransaction(Transaction& transaction,
+                           const uint8_t* pWrite,
+                           uint8_t writeLength,
+                           uint8_t* pRead,
+                           uint8_t readLength)
+{
+    transaction.address = HDC1080_ADDRESS;
+    transaction.pWrite = pWrite;
+    transaction.writeLength = writeLength;
+    transaction.pRead = pRead;
+    transaction.readLength = readLength;
+    transaction.status = Status::IDLE;
+    transaction.count = 0;
+}
+
+AsyncHdc1080::AsyncHdc1080(TwiQueue* pTwi, TimeSource getTime, uint32_t conversionTime):
+    pTwi_(pTwi),
+    getTime_(getTime),
+    conversionTime_(conversionTime),
+    state_(State::IDLE),
+    configured_(false),
+    triggerTime_(0)
+{
+    configBytes_[0] = CONFIG_REGISTER;
+    configBytes_[1] = CONFIG_MODE_BOTH >> 8;
+    configBytes_[2] = CONFIG_MODE_BOTH & 0xff;
+    triggerBytes_[0] = TEMPERATURE_REGISTER;
+
+    setTransaction(config_, configBytes_, sizeof(configBytes_), nullptr, 0);
+
+    // Pointing at the temperature register starts a conversion. The results are read back
+    // without a register write, since that would start another
+    setTransaction(trigger_, triggerBytes_, sizeof(triggerBytes_), nullptr, 0);
+    setTransaction(read_, nullptr, 0, readBytes_, sizeof(readBytes_));
+}
+
+bool AsyncHdc1080::initialize()
+{
+    if (!pTwi_->submit(&config_)) return false;
+
+    // The queue times the transaction out if the bus is stuck, so this cannot wait forever
+    Status status;
+    do
+    {
+        status = pTwi_->getStatus(&config_);
+    } while ((status == Status::QUEUED) || (status == Status::ACTIVE));
+
+    configured_ = (status == Status::DONE);
+    return configured_;
+}
+
+AsyncHdc1080::Result AsyncHdc1080::update(int16_t& temperatureF, uint16_t& humidity)
+{
+    switch (state_)
+    {
+        case State::IDLE:
+        {
+            // Configure first if that has not worked yet, the queue keeps them in order
+            if (!configured_ && !pTwi_->submit(&config_)) return Result::FAILED;
+            if (!pTwi_->submit(&trigger_)) return fail();
+
+            state_ = State::TRIGGERING;
+            return Result::BUSY;
+        }
+
+        case State::TRIGGERING:
+        {
+            Status status = pTwi_->getStatus(&trigger_);
+            if ((status == Status::QUEUED) || (status == Status::ACTIVE)) return Result::BUSY;
+            if (!configured_)
+            {
+                configured_ = (pTwi_->getStatus(&config_) == Status::DONE);
+            }
+            if ((status != Status::DONE) || !configured_) return fail();
+
+            triggerTime_ = getTime_();
+            state_ = State::CONVERTING;
+            return Result::BUSY;
+        }
+
+        case State::CONVERTING:
+        {
+            if ((getTime_() - triggerTime_) < conversionTime_) return Result::BUSY;
+            if (!pTwi_->submit(&read_)) return fail();
+
+            state_ = State::READING;
+            return Result::BUSY;
+        }
+
+        case State::READING:
+        {
+            Status status = pTwi_->getStatus(&read_);
+            if ((status == Status::QUEUED) || (status == Status::ACTIVE)) return Result::BUSY;
+            if (status != Status::DONE) return fail();
+
+            uint16_t rawTemperature = ((uint16_t)readBytes_[0] << 8) | readBytes_[1];
+            uint16_t rawHumidity = ((uint16_t)readBytes_[2] << 8) | readBytes_[3];
+
+            temperatureF = (((int32_t)rawTemperature * TEMPERATURE_RANGE) >> RAW_SHIFT) + TEMPERATURE_MIN;
+            humidity = ((uint32_t)rawHumidity * HUMIDITY_RANGE) >> RAW_SHIFT;
+
+            state_ = State::IDLE;
+            return Result::READY;
+        }
+    }
+
+    return fail();
+}
+
+AsyncHdc1080::Result AsyncHdc1080::fail()
+{
+    // The sensor may have been reset, so configure it again with the next reading
+    configured_ = false;
+    state_ = State::IDLE;
+    return Result::FAILED;
+}
@@ -0,0 +1,76 @@
+#ifndef ASYNC_HDC1080_HPP
+#define ASYNC_HDC1080_HPP
+
+#include "twiQueue/TwiQueue.hpp"
+
+#include <stdint.h>
+
+/**
+ * HDC1080 temperature and humidity sensor, read in steps over the TWI queue so nothing waits on it.
+ *
+ * A reading triggers a conversion of both values, waits out the conversion time, then collects
+ * the result. Each call to update() moves the reading on as far as it can without waiting, and
+ * says whether it is done. Readings are in the same fixed point hundredths as the wire format
+ */
+class AsyncHdc1080
+{
+    public:
+        enum class Result: uint8_t
+        {
+            BUSY = 0,   // Call again later
+            READY,      // A new reading is out
+            FAILED      // The sensor did not answer, the next call starts again
+        };
+
+        /**
+         * @param   pTwi            Bus the sensor is on
+         * @param   getTime         Time source for the conversion time
+         * @param   conversionTime  Time to wait between triggering and collecting a reading
+         */
+        AsyncHdc1080(Twi::TwiQueue* pTwi, Twi::TimeSource getTime, uint32_t conversionTime);
+        ~AsyncHdc1080(){}
+
+        /**
+         * Configure the sensor, waiting at most the bus timeout. Only for startup
+         * @return  False if the sensor did not answer, it is configured again before the next reading
+         */
+        bool initialize();
+
+        /**
+         * Move the reading on, starting a new one if none is in progress
+         * @param   temperatureF    Set when ready, hundredths of a degree Fahrenheit
+         * @param   humidity        Set when ready, relative humidity in hundredths of a percent
+         */
+        Result update(int16_t& temperatureF, uint16_t& humidity);
+
+    private:
+        enum class State: uint8_t
+        {
+            IDLE = 0,
+            TRIGGERING,
+            CONVERTING,
+            READING
+        };
+
+        Twi::TwiQueue* pTwi_;
+        Twi::TimeSource getTime_;
+        uint32_t conversionTime_;
+
+        State state_;
+        bool configured_;
+        uint32_t triggerTime_;
+
+        uint8_t configBytes_[3];
+        uint8_t triggerBytes_[1];
+        uint8_t readBytes_[4];
+        Twi::Transaction config_;
+        Twi::Transaction trigger_;
+        Twi::Transaction read_;
+
+        /**
+         * Give up on the reading in progress
+         */
+        Result fail();
+};
+
+#endif
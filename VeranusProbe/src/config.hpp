@@ -3,11 +3,43 @@
 
 const static uint32_t TICS_PER_SECOND = 61u;
 
+// Timer counts in one tic, each count is 64us. Task periods and runtimes are in counts
+const static uint32_t COUNTS_PER_TIC = 256u;
+const static uint32_t COUNTS_PER_SECOND = COUNTS_PER_TIC * TICS_PER_SECOND;
+
+// Climate readings start at this period, then follow the sample periods in the settings
 const static uint32_t CLIMATE_UPDATE_TIME_SECONDS = 5 * 60;
 const static uint32_t LIGHT_UPDATE_TIME_SECONDS = 15;
-const static uint32_t WIFI_SUCCESS_UPDATE_READINGS = 3;
-const static uint32_t WIFI_FAIL_UPDATE_TIME_SECONDS = 1;
+
+// The HDC1080 is the only device on the I2C bus, and supports fast mode.
+// Conversions of both values take 13ms at 14 bits, and no transaction should take near a tic
+const static uint32_t I2C_BIT_RATE = 400000;
+const static uint32_t I2C_TIMEOUT_COUNTS = COUNTS_PER_TIC;
+const static uint32_t CLIMATE_CONVERSION_COUNTS = 15000 / 64;
 const static uint32_t WIFI_TIMEOUT_TIME_SECONDS = 1 * 60;
+const static uint32_t WIFI_BAUD_RATE = 9600;
+
+/*
+ * SRAM set aside for readings waiting to be uploaded, kept while the wifi link is down.
+ * The ReadingBuffer ram budget in memory_budget.json is this plus 16 bytes for the buffer itself,
+ * so raising it fails the build's budget check until the budget is raised to match. The total
+ * ram budget leaves 512 of the 2048 bytes of SRAM to the stack. Only raise both if the STACK
+ * command still shows the min free well above STACK_WARNING_BYTES after a day of use
+ */
+const static uint16_t READING_BUFFER_BYTES = 160;
+
+// Settings are kept in a journal at the start of EEPROM, and saved once they have not changed for a while
+const static uint16_t SETTINGS_JOURNAL_ADDRESS = 0;
+const static uint16_t SETTINGS_JOURNAL_BYTES = 256;
+const static uint32_t SETTINGS_QUIET_SECONDS = 5;
+
+// The rest of EEPROM keeps a history of readings, 12 pages of 64 bytes hold up to about 4 days
+const static uint16_t HISTORY_ADDRESS = SETTINGS_JOURNAL_ADDRESS + SETTINGS_JOURNAL_BYTES;
+const static uint16_t HISTORY_BYTES = 1024 - HISTORY_ADDRESS;
+const static uint16_t HISTORY_INTERVAL_SECONDS = 10 * 60;
+
+// With the STACK_WARNING build flag, warn once the stack comes this close to the static data
+const static uint16_t STACK_WARNING_BYTES = 64;
 
 // Max and minimum values for scaling brightness based on light level
 const static uint8_t MAX_LIGHT_SCALE = 90;
@@ -1,6 +1,15 @@
 #include "devices.hpp"
 #include "config.hpp"
 #include "Settings.hpp"
+#include "ProbeStrings.hpp"
+#include "stackMonitor/StackMonitor.hpp"
+#include "lightSampler/LightSampler.hpp"
+#include "twiQueue/TwiQueue.hpp"
+#include "asyncHdc1080/AsyncHdc1080.hpp"
+#include "timerSerial/TimerSerial.hpp"
+#include "wifiInterface/WifiFrame.hpp"
+#include "latencyStats/LatencyStats.hpp"
+#include "ticClock/TicClock.hpp"
 #include "drivers/timer/TicCounter.hpp"
 #include "drivers/timer/ATmega328/ATmega328Timer.hpp"
 #include "drivers/dio/atmega328/Atmega328Dio.hpp"
@@ -9,17 +18,13 @@
 #include "utilities/print/Print.hpp"
 #include "drivers/timer/Delay.hpp"
 #include "drivers/lcd/dips082/Dips082Lcd.hpp"
-#include "drivers/i2c/atmega328/Atmega328I2c.hpp"
-#include "drivers/climateSensor/hdc1080/Hdc1080.hpp"
 #include "drivers/assert/Assert.hpp"
-#include "drivers/adc/atmega328/Atmega328Adc.hpp"
-#include "drivers/phototransistor/PhotoTransistor.hpp"
-#include "utilities/filter/lowPassFilter/LowPassFilter.hpp"
 #include "drivers/spi/atmega328/Atmega328Spi.hpp"
 #include "drivers/pwm/atmega328/Atmega328Pwm.hpp"
-#include "drivers/serial/atmega328/Atmega328SoftwareSerial.hpp"
 #include "drivers/watchdog/atmega328/Atmega328Watchdog.hpp"
-#include "drivers/eeprom/atmega328/Atmega328Eeprom.hpp"
+
+#include <avr/sleep.h>
+#include <avr/eeprom.h>
 
 using namespace Tic;
 using namespace Timer;
@@ -27,14 +32,10 @@ using namespace Dio;
 using namespace SerialComm;
 using namespace Interrupt;
 using namespace Lcd;
-using namespace I2c;
-using namespace ClimateSensor;
-using namespace Adc;
-using namespace Filter;
+using namespace Twi;
 using namespace Spi;
 using namespace Pwm;
 using namespace Watchdog;
-using namespace Eeprom;
 
 const static uint16_t WDT_TIMEOUT = 2000;
 static Atmega328Watchdog wdt;
@@ -42,24 +43,60 @@ IWatchdog* pWdt = &wdt;
 
 // Set up tic handler
 static TicCounter ticHandler(TICS_PER_SECOND);
+
+// Light sensor, sampled in the background every tic
+static LightSampler lightSampler(0);
+
 void HandleTicInterrupt()
 {
+#ifdef LATENCY_STATS
+    // Timer 2 clears on the compare match, so its count is how late this interrupt is
+    LatencyStats::record(STAGE_TIC, TCNT2);
+#endif
+
     ticHandler.incrementTicCount();
+    TicClock::onTic();
+    pDisplay->onTic();
+    lightSampler.onTic();
+}
+
+uint32_t getTicCount()
+{
+    return TicClock::getTicCount();
+}
+
+uint32_t getUptimeSeconds()
+{
+    return getTicCount() / TICS_PER_SECOND;
 }
 
 // Set up timer that triggers the tic counter to count
 const static TimerPrescaler PRESCALE = PRESCALE_1024;
-const static uint16_t TOP = 255;
+const static uint16_t TOP = COUNTS_PER_TIC - 1;
 static Atmega328Timer tmr(Timer::TIMER_2, CTC, PRESCALE, TOP, &HandleTicInterrupt);
 
-// Set up a software timers
-static SoftwareTimer updateTimer(1, &ticHandler, pWdt);
-static SoftwareTimer climateTimer(ticHandler.secondsToTics(CLIMATE_UPDATE_TIME_SECONDS), &ticHandler);
-static SoftwareTimer lightTimer(ticHandler.secondsToTics(LIGHT_UPDATE_TIME_SECONDS), &ticHandler);
+uint32_t getTimerCounts()
+{
+    return TicClock::getTimerCounts();
+}
+
+void sleepUntilInterrupt(uint32_t lastTic, uint32_t wakeAt)
+{
+    // Idle keeps Timer 2, the UART, and the software serial's pin change interrupt running to wake us
+    uint8_t sleepMode = SLEEP_MODE_IDLE;
+#ifdef ADC_NOISE_REDUCTION
+    // Take the light sample with the CPU and IO clocks stopped, it starts once we are asleep.
+    // Only the ADC finishing wakes us, Timer 2 stands still until then
+    if (lightSampler.takeConversionRequest()) sleepMode = SLEEP_MODE_ADC;
+#endif
+    TicClock::sleepUntilInterrupt(lastTic, wakeAt, sleepMode);
+}
+
+uint8_t takeSleepResidency(uint32_t& windowTics)
+{
+    return TicClock::takeSleepResidency(windowTics);
+}
 
-SoftwareTimer* pUpdateTimer = &updateTimer;
-SoftwareTimer* pClimateTimer = &climateTimer;
-SoftwareTimer* pLightTimer = &lightTimer;
 
 // Interrupt control object, must be enabled on start
 static Atmega328Interrupt interruptControl;
@@ -82,19 +119,10 @@ static Atmega328Dio rsPin(Port::C, 3, Mode::OUTPUT, Level::L_LOW, false, false);
 static Atmega328Dio rwPin(Port::C, 2, Mode::OUTPUT, Level::L_LOW, false, false);
 static Atmega328Dio oePin(Port::C, 1, Mode::OUTPUT, Level::L_LOW, false, false);
 
-#ifdef WIFI_PROG
-static Atmega328Dio wifiTxPin(Port::D, 6, Mode::INPUT, Level::L_LOW, false, false);
-#else
-static Atmega328Dio wifiTxPin(Port::D, 6, Mode::OUTPUT, Level::L_LOW, false, false);
-#endif
-static Atmega328Dio wifiRxPin(Port::D, 7, Mode::INPUT, Level::L_LOW, false, true);
-
 // static Atmega328Dio lcdBacklightPin(Port::B, 1, Mode::OUTPUT, Level::L_HIGH, false, false);
 const static uint16_t DEFAULT_LCD_BRIGHTNESS = 100;
 static Atmega328Pwm lcdBacklightPwm(Port::B, 1, DEFAULT_LCD_BRIGHTNESS, PwmMode::FAST, PwmResolution::RES_8_BIT);
 
-static Atmega328Adc lightSensorAdc(Atmega328Channel::ADC_0, Prescaler::DIV_128, Reference::AREF);
-
 IDio* pRsPin = &rsPin;
 IDio* pRwPin = &rwPin;
 IDio* pOePin = &oePin;
@@ -111,9 +139,18 @@ IDio** pDataPins = dataPinArray;
 uint8_t numPins = sizeof(dataPinArray) / sizeof(dataPinArray[0]);
 
 
-const static uint16_t WIFI_SERIAL_RX_BUFFER_LEN = 64;
+// Wifi module on PD6 (TX) and PD7 (RX), sent and received in the background by Timer 0.
+// With WIFI_PROG it is never initialized, so both pins stay inputs for the module to be programmed
+const static uint8_t WIFI_SERIAL_RX_BUFFER_LEN = 64;
+const static uint8_t WIFI_SERIAL_TX_BUFFER_LEN = 96;
+static_assert(WIFI_SERIAL_TX_BUFFER_LEN >= WIFI_FRAME_MAX_LEN, "A wifi frame must fit in the TX buffer to send without waiting");
 static uint8_t wifiSerialRxBuffer[WIFI_SERIAL_RX_BUFFER_LEN];
-static Atmega328SoftwareSerial wifiSerial(&wifiRxPin, &wifiTxPin, &interruptControl, 9600, F_CPU, wifiSerialRxBuffer, WIFI_SERIAL_RX_BUFFER_LEN);
+static uint8_t wifiSerialTxBuffer[WIFI_SERIAL_TX_BUFFER_LEN];
+static TimerSerial wifiSerial(WIFI_BAUD_RATE,
+                              wifiSerialTxBuffer,
+                              WIFI_SERIAL_TX_BUFFER_LEN,
+                              wifiSerialRxBuffer,
+                              WIFI_SERIAL_RX_BUFFER_LEN);
 ISerial* pTest = &wifiSerial;
 
 static Dips082Lcd lcd(pRsPin, pRwPin, pOePin, dataPinArray, 4);
@@ -121,30 +158,36 @@ static Dips082Lcd lcd(pRsPin, pRwPin, pOePin, dataPinArray, 4);
 static VeranusDisplay display(&lcd, &lcdBacklightPwm);
 VeranusDisplay* pDisplay = &display;
 
-static SoftwareTimer i2cTimeoutTimer(ticHandler.secondsToTics(2), &ticHandler, pWdt);
-static Atmega328I2c i2c(I2cBitRate::BR_100_KBPS, &i2cTimeoutTimer);
-
-static Hdc1080ClimateSensor climateSensor(&i2c, &ticHandler);
+static TwiQueue twi(I2C_BIT_RATE, &getTimerCounts, I2C_TIMEOUT_COUNTS);
+static AsyncHdc1080 climateSensor(&twi, &getTimerCounts, CLIMATE_CONVERSION_COUNTS);
 
-static LowPassFilter lightSensorFilter(4, 100);
-static PhotoTransistor lightSensor(&lightSensorAdc, &lightSensorFilter);
-
-static VeranusProbe probe(&climateSensor, &lightSensor);
+static VeranusProbe probe(&climateSensor, &lightSampler, &getTicCount);
 VeranusProbe* pProbe = &probe;
 
+const static uint8_t READING_BUFFER_LEN = READING_BUFFER_BYTES / sizeof(StoredReading);
+static StoredReading readingStorage[READING_BUFFER_LEN];
+static ReadingBuffer readingBuffer(readingStorage, READING_BUFFER_LEN);
+ReadingBuffer* pReadingBuffer = &readingBuffer;
+
 static SoftwareTimer wifiTimeoutTimer(ticHandler.secondsToTics(WIFI_TIMEOUT_TIME_SECONDS), &ticHandler, &wdt);
-static WifiInterface wifiInterface(&wifiSerial, &wifiTimeoutTimer);
+static WifiInterface wifiInterface(&wifiSerial, &wifiTimeoutTimer, &readingBuffer, &getTicCount);
 WifiInterface* pWifiInterface = &wifiInterface;
 
-static Atmega328Eeprom eepromDriver(&interruptControl);
+static SettingsJournal settingsJournal(&settings,
+                                       SETTINGS_JOURNAL_ADDRESS,
+                                       SETTINGS_JOURNAL_BYTES,
+                                       SETTINGS_QUIET_SECONDS * TICS_PER_SECOND,
+                                       &getTicCount);
+SettingsJournal* pSettingsJournal = &settingsJournal;
 
-const static uint16_t numEepromEntries = sizeof(Settings);
-static EepromManager eepromManager(&eepromDriver, &settings, numEepromEntries);
-EepromManager* pEepromManager = &eepromManager;
+static HistoryLog historyLog(&serialUart, HISTORY_ADDRESS, HISTORY_BYTES, HISTORY_INTERVAL_SECONDS);
+HistoryLog* pHistoryLog = &historyLog;
 
-VeranusData latestData = 
+Protocol::Reading latestData =
 {
-  .tempF = 0,
+  .version = Protocol::VERSION,
+  .probeId = 0,
+  .temperature = 0,
   .humidity = 0,
   .light = 0
 };
@@ -166,35 +209,53 @@ void initializeDevices()
     ResetCause resetCause = pWdt->getResetCause();
     if (resetCause != ResetCause::POWER_ON)
     {
-        PRINTLN("Reset due to %s", (resetCause == ResetCause::WATCHDOG) ?
-                                    "watchdog" :
-                                    "brown-out");
+        PRINTLN_P("Reset due to %s", getString((resetCause == ResetCause::WATCHDOG) ?
+                                               ProbeStrings::WATCHDOG :
+                                               ProbeStrings::BROWN_OUT));
+#ifdef STACK_WARNING
+        StackMonitor::reportReset();
+#endif
     }
 
     // This may take a little while, so nourish the watchdog
     pWdt->reset();
 
-    // Load values from eeprom
-    eepromManager.initialize();
+    // Load values from eeprom. Before the journal, EepromManager kept the settings exactly as
+    // they are in RAM from the start of eeprom, so try those before falling back to defaults
+    if (!settingsJournal.initialize())
+    {
+        eeprom_read_block(&settings, (const void*)0, sizeof(Settings));
+    }
+    historyLog.initialize();
 
-    // Initialize settings to defaults if eeprom has changed revision
+    // Initialize settings to defaults if eeprom has changed revision. Revision 2 is the same up
+    // to wifiEnabled, so those are kept and only the reporting settings are defaulted
     if (settings.revision != EEPROM_REV)
     {
-        settings.debug = false;
-        settings.id = 0xffff;
-        settings.lightMode = LightMode::STATIC;
-        settings.staticLight = 100;
-        settings.minLight = 10;
-        settings.maxLight = 100;
-        settings.wifiEnabled = true;
+        if (settings.revision != 2)
+        {
+            settings.debug = false;
+            settings.id = 0xffff;
+            settings.lightMode = LightMode::STATIC;
+            settings.staticLight = 100;
+            settings.minLight = 10;
+            settings.maxLight = 100;
+            settings.wifiEnabled = true;
+        }
+        settings.tempDeadband = 5;
+        settings.humidityDeadband = 20;
+        settings.heartbeatMinutes = 60;
+        settings.fastSampleSeconds = 60;
+        settings.slowSampleSeconds = CLIMATE_UPDATE_TIME_SECONDS;
         settings.revision = EEPROM_REV;
     }
 
     // Initialize display and sensors
     pDisplay->setup();
+    twi.initialize();
 
     if (!probe.init())
     {
-        PRINTLN("Unable to start probes.");
+        PRINTLN_P("Unable to start probes.");
     }
 }
\ No newline at end of file
@@ -7,27 +7,53 @@
 #include "drivers/serial/ISerial.hpp"
 #include "wifiInterface/WifiInterface.hpp"
 #include "drivers/watchdog/Watchdog.hpp"
-#include "drivers/eeprom/EepromManager.hpp"
+#include "settingsJournal/SettingsJournal.hpp"
+#include "historyLog/HistoryLog.hpp"
+#include "readingBuffer/ReadingBuffer.hpp"
+#include "VeranusProtocol.hpp"
+#include "TaskScheduler.hpp"
+#include "reportPolicy/ReportPolicy.hpp"
 
 extern VeranusProbe* pProbe;
 extern VeranusDisplay* pDisplay;
-extern Timer::SoftwareTimer* pUpdateTimer;
-extern Timer::SoftwareTimer* pClimateTimer;
-extern Timer::SoftwareTimer* pLightTimer;
 extern SerialComm::ISerial* pSerial;
 extern WifiInterface* pWifiInterface;
 extern Watchdog::IWatchdog* pWdt;
-extern Eeprom::EepromManager* pEepromManager;
+extern SettingsJournal* pSettingsJournal;
+extern HistoryLog* pHistoryLog;
+extern ReadingBuffer* pReadingBuffer;
+extern Scheduler::TaskScheduler* pScheduler;    // Defined with the task table in main.cpp
+void updateClimateSensor();                     // Climate task in that table, see findTask()
+extern ReportPolicy* pReportPolicy;
 void initializeDevices();
 
-struct VeranusData
-{
-  float tempF;
-  float humidity;
-  float light;
-};
-const static uint8_t V_DATA_SIZE = sizeof(VeranusData);
+/**
+ * Tics counted since boot, and the same in whole seconds
+ */
+uint32_t getTicCount();
+uint32_t getUptimeSeconds();
 
-extern VeranusData latestData;
+/**
+ * Time since boot in timer counts (COUNTS_PER_TIC per tic), wraps after about 76 hours
+ */
+uint32_t getTimerCounts();
+
+/**
+ * Put the CPU to sleep until the next interrupt (at the latest, the next tic or wakeAt)
+ * @param   lastTic     Tic count when the caller last checked for work. If a tic has
+ *                      happened since, returns straight away instead of sleeping
+ * @param   wakeAt      Timer counts when the next task is due
+ */
+void sleepUntilInterrupt(uint32_t lastTic, uint32_t wakeAt);
+
+/**
+ * Get the percentage of time spent asleep, since the last call
+ * @param   windowTics  Set to the tics since the last call
+ * @return  Percent of that time spent asleep
+ */
+uint8_t takeSleepResidency(uint32_t& windowTics);
+
+// Most recent readings, in wire format
+extern Protocol::Reading latestData;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,320 @@
+#include "HistoryLog.hpp"
+
+#include <stddef.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+#include <avr/pgmspace.h>
+
+using namespace SerialComm;
+
+// Sample encodings, see HistoryLog.hpp
+const static uint8_t LONG_CHANGE = 0x80;
+const static uint8_t GAP = 0xc0;
+const static uint8_t ERASED = 0xff;
+const static uint8_t MAX_GAP = 62;
+
+const static int8_t SMALL_T_MIN = -4;
+const static int8_t SMALL_T_MAX = 3;
+const static int8_t SMALL_HL_MIN = -2;
+const static int8_t SMALL_HL_MAX = 1;
+const static int8_t LONG_T_MIN = -32;
+const static int8_t LONG_T_MAX = 31;
+
+// Sent ahead of a dump, followed by the number of pages, the page size and the uptime
+const static char DUMP_MAGIC[] PROGMEM = "HIST";
+
+// Bytes of a dump to send per update, the UART sends about 16 bytes a tic at 9600 baud
+const static uint8_t DUMP_CHUNK = 12;
+
+// Samples this much early still count as being on the interval
+const static uint8_t EARLY_FRACTION = 8;
+
+HistoryLog::HistoryLog(ISerial* pSerial, uint16_t address, uint16_t length, uint16_t interval):
+    pSerial_(pSerial),
+    address_(address),
+    numPages_(length / PAGE_SIZE),
+    interval_(interval),
+    page_(0),
+    sequence_(0),
+    pageUsed_(PAGE_SIZE),
+    lastUptime_(0),
+    lastTemperature_(0),
+    lastHumidity_(0),
+    lastLight_(0),
+    prepareIndex_(PAGE_SIZE),
+    queueHead_(0),
+    queueCount_(0),
+    writeOffset_(PAGE_SIZE),
+    gateOffset_(NO_GATE),
+    gateValue_(0),
+    dumpPage_(0),
+    dumpPagesLeft_(0),
+    dumpOffset_(0),
+    samples_(0),
+    dropped_(0)
+{
+}
+
+void HistoryLog::initialize()
+{
+    // Carry on after the newest page, or start at the first page if there are none
+    bool found = false;
+    page_ = numPages_ - 1;
+    for (uint8_t page=0; page<numPages_; page++)
+    {
+        PageHeader header;
+        if (!readHeader(page, header)) continue;
+
+        if (!found || ((int16_t)(header.sequence - sequence_) > 0))
+        {
+            found = true;
+            page_ = page;
+            sequence_ = header.sequence;
+        }
+    }
+
+    // Uptime starts over, so the first sample after boot always starts a new page
+    pageUsed_ = PAGE_SIZE;
+}
+
+void HistoryLog::add(uint32_t uptime, int16_t temperatureF, uint16_t humidity, uint16_t light)
+{
+    // Round to the resolution stored
+    int16_t temperature = (temperatureF + ((temperatureF < 0) ? -5 : 5)) / 10;
+    uint16_t halfPercents = (humidity + 25) / 50;
+    uint8_t humidityStored = (halfPercents > UINT8_MAX) ? UINT8_MAX : halfPercents;
+    uint8_t lightStored = (light + 50) / 100;
+
+    if (pageUsed_ >= PAGE_SIZE)
+    {
+        if (!startPage(uptime, temperature, humidityStored, lightStored)) dropped_++;
+        return;
+    }
+
+    uint32_t elapsed = uptime - lastUptime_;
+    if (elapsed < (uint32_t)(interval_ - (interval_ / EARLY_FRACTION))) return;
+
+    uint32_t intervals = (elapsed + (interval_ / 2)) / interval_;
+    int16_t dT = temperature - lastTemperature_;
+    int16_t dH = (int16_t)humidityStored - lastHumidity_;
+    int16_t dL = (int16_t)lightStored - lastLight_;
+
+    uint8_t entry[4];
+    uint8_t length = 0;
+    bool fits = true;
+
+    // Mark any intervals that were missed, so the samples after them keep their times
+    if (intervals > 1)
+    {
+        if ((intervals - 1) > MAX_GAP) fits = false;
+        entry[length++] = GAP | (intervals - 1);
+    }
+
+    if ((dT >= SMALL_T_MIN) && (dT <= SMALL_T_MAX) &&
+        (dH >= SMALL_HL_MIN) && (dH <= SMALL_HL_MAX) &&
+        (dL >= SMALL_HL_MIN) && (dL <= SMALL_HL_MAX))
+    {
+        entry[length++] = ((dT - SMALL_T_MIN) << 4) | ((dH - SMALL_HL_MIN) << 2) | (dL - SMALL_HL_MIN);
+    }
+    else if ((dT >= LONG_T_MIN) && (dT <= LONG_T_MAX) &&
+             (dH >= INT8_MIN) && (dH <= INT8_MAX) &&
+             (dL >= INT8_MIN) && (dL <= INT8_MAX))
+    {
+        entry[length++] = LONG_CHANGE | (dT & 0x3f);
+        entry[length++] = (uint8_t)dH;
+        entry[length++] = (uint8_t)dL;
+    }
+    else
+    {
+        fits = false;
+    }
+
+    // Anything that cannot be stored as a change, or does not fit, starts a new page
+    if (!fits || ((pageUsed_ + length) > PAGE_SIZE))
+    {
+        if (!startPage(uptime, temperature, humidityStored, lightStored)) dropped_++;
+        return;
+    }
+
+    if (!queueBytes(entry, length))
+    {
+        dropped_++;
+        return;
+    }
+
+    pageUsed_ += length;
+    lastUptime_ += intervals * interval_;
+    lastTemperature_ = temperature;
+    lastHumidity_ = humidityStored;
+    lastLight_ = lightStored;
+    samples_++;
+}
+
+void HistoryLog::update()
+{
+    // Only one byte is written at a time, and reads would wait for it to finish
+    if (!eeprom_is_ready()) return;
+
+    if (isWriting())
+    {
+        writeNext();
+    }
+    else if (dumpPagesLeft_ > 0)
+    {
+        dumpNext();
+    }
+}
+
+bool HistoryLog::dump(uint32_t uptime)
+{
+    if (dumpPagesLeft_ > 0) return false;
+
+    char magic[sizeof(DUMP_MAGIC) - 1];
+    memcpy_P(magic, DUMP_MAGIC, sizeof(magic));
+    pSerial_->write(magic, sizeof(magic));
+    uint8_t sizes[] = {numPages_, PAGE_SIZE};
+    pSerial_->write((const char*)sizes, sizeof(sizes));
+    pSerial_->write((const char*)&uptime, sizeof(uptime));
+
+    // Every page is sent, the reader checks which are valid. The page being filled goes last
+    dumpPage_ = (page_ + 1) % numPages_;
+    dumpPagesLeft_ = numPages_;
+    dumpOffset_ = 0;
+    return true;
+}
+
+bool HistoryLog::readHeader(uint8_t page, PageHeader& header)
+{
+    eeprom_read_block(&header, (const void*)(uintptr_t)getPageAddress(page), HEADER_SIZE);
+    return (header.sequence != UINT16_MAX) && (header.crc == getCrc(header));
+}
+
+uint8_t HistoryLog::getCrc(const PageHeader& header)
+{
+    const uint8_t* pBytes = (const uint8_t*)&header;
+    uint8_t crc = 0;
+    for (uint8_t i=0; i<offsetof(PageHeader, crc); i++)
+    {
+        crc = _crc8_ccitt_update(crc, pBytes[i]);
+    }
+
+    return crc;
+}
+
+bool HistoryLog::startPage(uint32_t uptime, int16_t temperature, uint8_t humidity, uint8_t light)
+{
+    // Wait for the last page to be finished, which only takes a few tics
+    if (isWriting()) return false;
+
+    sequence_++;
+    if (sequence_ == UINT16_MAX) sequence_++;
+
+    header_.sequence = sequence_;
+    header_.uptime = uptime;
+    header_.interval = interval_;
+    header_.temperature = temperature;
+    header_.humidity = humidity;
+    header_.light = light;
+    header_.crc = getCrc(header_);
+
+    page_ = (page_ + 1) % numPages_;
+    prepareIndex_ = 0;
+    writeOffset_ = HEADER_SIZE;
+    pageUsed_ = HEADER_SIZE;
+
+    lastUptime_ = uptime;
+    lastTemperature_ = temperature;
+    lastHumidity_ = humidity;
+    lastLight_ = light;
+    samples_++;
+    return true;
+}
+
+bool HistoryLog::queueBytes(const uint8_t* pBytes, uint8_t length)
+{
+    if ((queueCount_ + length) > QUEUE_LEN) return false;
+
+    for (uint8_t i=0; i<length; i++)
+    {
+        queue_[(queueHead_ + queueCount_) % QUEUE_LEN] = pBytes[i];
+        queueCount_++;
+    }
+
+    return true;
+}
+
+void HistoryLog::writeNext()
+{
+    uint16_t pageAddress = getPageAddress(page_);
+
+    // Writes at most one byte, bytes already holding the right value are skipped
+    while (isWriting())
+    {
+        uint8_t offset;
+        uint8_t value;
+
+        if (prepareIndex_ < (PAGE_SIZE - HEADER_SIZE))
+        {
+            // Erase the old samples first, then write the header, so a page is only valid once ready
+            offset = HEADER_SIZE + prepareIndex_;
+            value = ERASED;
+            prepareIndex_++;
+        }
+        else if (prepareIndex_ < PAGE_SIZE)
+        {
+            offset = prepareIndex_ - (PAGE_SIZE - HEADER_SIZE);
+            value = ((const uint8_t*)&header_)[offset];
+            prepareIndex_++;
+        }
+        else if (queueCount_ > 0)
+        {
+            offset = writeOffset_++;
+            value = queue_[queueHead_];
+            queueHead_ = (queueHead_ + 1) % QUEUE_LEN;
+            queueCount_--;
+
+            // Readers stop at the erased byte, so until the first is written the rest are not seen
+            if (gateOffset_ == NO_GATE)
+            {
+                gateOffset_ = offset;
+                gateValue_ = value;
+                continue;
+            }
+        }
+        else
+        {
+            offset = gateOffset_;
+            value = gateValue_;
+            gateOffset_ = NO_GATE;
+        }
+
+        uint8_t* pEeprom = (uint8_t*)(uintptr_t)(pageAddress + offset);
+        if (eeprom_read_byte(pEeprom) != value)
+        {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                eeprom_write_byte(pEeprom, value);
+            }
+            return;
+        }
+    }
+}
+
+void HistoryLog::dumpNext()
+{
+    uint8_t buffer[DUMP_CHUNK];
+    uint8_t length = PAGE_SIZE - dumpOffset_;
+    if (length > DUMP_CHUNK) length = DUMP_CHUNK;
+
+    eeprom_read_block(buffer, (const void*)(uintptr_t)(getPageAddress(dumpPage_) + dumpOffset_), length);
+    pSerial_->write((const char*)buffer, length);
+
+    dumpOffset_ += length;
+    if (dumpOffset_ >= PAGE_SIZE)
+    {
+        dumpOffset_ = 0;
+        dumpPage_ = (dumpPage_ + 1) % numPages_;
+        dumpPagesLeft_--;
+    }
+}
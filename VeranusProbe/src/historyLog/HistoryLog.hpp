@@ -0,0 +1,139 @@
+#ifndef HISTORY_LOG_HPP
+#define HISTORY_LOG_HPP
+
+#include <stdint.h>
+#include "drivers/serial/ISerial.hpp"
+
+/**
+ * Long term history of readings, kept in EEPROM so it survives resets and uplink outages.
+ *
+ * The log is a ring of fixed size pages, a new page replacing the oldest. Each page starts with
+ * a header holding a full sample, and every sample after it is stored as a change from the one
+ * before, at a fixed interval. Samples are stored at 0.1F, 0.5% humidity and 1% light.
+ *
+ * Page header (little endian):
+ *      uint16_t sequence       Increases by one each page, wraps
+ *      uint32_t uptime         Seconds since boot of the first sample, each boot starts a page
+ *      uint16_t interval       Seconds between samples
+ *      int16_t  temperature    First sample, tenths of a degree Fahrenheit
+ *      uint8_t  humidity       Half percents
+ *      uint8_t  light          Percent
+ *      uint8_t  crc            CRC-8 (CCITT) of the header before it
+ *
+ * Then, for each following interval:
+ *      0TTTHHLL                Small change, T - 4, H - 2 and L - 2
+ *      10TTTTTT H L            Larger change, T is 6 bit signed, H and L are int8_t
+ *      11NNNNNN                N intervals without a sample (1 to 62)
+ *      0xFF                    End of the page
+ *
+ * Appends are written out one byte per call to update(), so they never wait on the EEPROM. The
+ * first byte queued is written last, so a reset part way through an append leaves the page
+ * ending before it rather than holding half a change
+ */
+class HistoryLog
+{
+    public:
+        /**
+         * @param   pSerial     Serial to dump the log to
+         * @param   address     First EEPROM byte of the log
+         * @param   length      Bytes of EEPROM for the log, a multiple of PAGE_SIZE
+         * @param   interval    Seconds between samples
+         */
+        HistoryLog(SerialComm::ISerial* pSerial, uint16_t address, uint16_t length, uint16_t interval);
+        ~HistoryLog(){}
+
+        /**
+         * Find the newest page, the next sample starts a page after it
+         */
+        void initialize();
+
+        /**
+         * Add a reading, ignored if it is too soon after the last sample
+         * @param   uptime          Seconds since boot
+         * @param   temperatureF    Hundredths of a degree Fahrenheit
+         * @param   humidity        Hundredths of a percent
+         * @param   light           Hundredths of a percent
+         */
+        void add(uint32_t uptime, int16_t temperatureF, uint16_t humidity, uint16_t light);
+
+        /**
+         * Write the next byte of the log, or send the next part of a dump. Call often
+         */
+        void update();
+
+        /**
+         * Start sending the log. Sends a line with the page count, page size and current uptime,
+         * then that many pages exactly as they are in EEPROM, oldest first
+         * @param   uptime  Seconds since boot
+         * @return  False if a dump is already in progress
+         */
+        bool dump(uint32_t uptime);
+
+        uint16_t getSamples(){ return samples_; }
+        uint16_t getDropped(){ return dropped_; }
+
+        const static uint8_t PAGE_SIZE = 64;
+
+    private:
+        struct PageHeader
+        {
+            uint16_t sequence;
+            uint32_t uptime;
+            uint16_t interval;
+            int16_t temperature;
+            uint8_t humidity;
+            uint8_t light;
+            uint8_t crc;
+        } __attribute__((packed));
+
+        const static uint8_t HEADER_SIZE = sizeof(PageHeader);
+        static_assert(HEADER_SIZE == 13, "Page header layout changed, update the format above");
+        const static uint8_t QUEUE_LEN = 8;
+        const static uint8_t NO_PAGE = 0xff;
+        const static uint8_t NO_GATE = 0;
+
+        SerialComm::ISerial* pSerial_;
+        uint16_t address_;
+        uint8_t numPages_;
+        uint16_t interval_;
+
+        // Page being filled, and the last sample written to it
+        uint8_t page_;
+        uint16_t sequence_;
+        uint8_t pageUsed_;      // Bytes of the page used, including those still queued
+        uint32_t lastUptime_;
+        int16_t lastTemperature_;
+        uint8_t lastHumidity_;
+        uint8_t lastLight_;
+
+        // Header for a new page, and how much of the page has been prepared
+        PageHeader header_;
+        uint8_t prepareIndex_;
+
+        // Bytes waiting to be written after the header
+        uint8_t queue_[QUEUE_LEN];
+        uint8_t queueHead_;
+        uint8_t queueCount_;
+        uint8_t writeOffset_;   // Where in the page the next queued byte goes
+        uint8_t gateOffset_;    // First byte queued, held back until the rest are written
+        uint8_t gateValue_;
+
+        // Dump in progress
+        uint8_t dumpPage_;
+        uint8_t dumpPagesLeft_;
+        uint8_t dumpOffset_;
+
+        uint16_t samples_;
+        uint16_t dropped_;
+
+        uint16_t getPageAddress(uint8_t page){ return address_ + ((uint16_t)page * PAGE_SIZE); }
+        bool isWriting(){ return (prepareIndex_ < PAGE_SIZE) || (queueCount_ > 0) || (gateOffset_ != NO_GATE); }
+        bool readHeader(uint8_t page, PageHeader& header);
+        static uint8_t getCrc(const PageHeader& header);
+        bool startPage(uint32_t uptime, int16_t temperature, uint8_t humidity, uint8_t light);
+        bool queueBytes(const uint8_t* pBytes, uint8_t length);
+        void writeNext();
+        void dumpNext();
+};
+
+#endif
@@ -0,0 +1,76 @@
+#ifdef LATENCY_STATS
+#include "LatencyStats.hpp"
+
+#include <util/atomic.h>
+
+static StageStats stageStats[NUM_STAGES];
+
+const static char cliName[] PROGMEM = "CLI";
+const static char climateName[] PROGMEM = "CLIMATE";
+const static char lightName[] PROGMEM = "LIGHT";
+const static char wifiName[] PROGMEM = "WIFI";
+const static char sendName[] PROGMEM = "SEND";
+const static char eepromName[] PROGMEM = "EEPROM";
+const static char ticName[] PROGMEM = "TIC";
+
+const static char* const STAGE_NAMES[NUM_STAGES] PROGMEM =
+{
+    cliName,
+    climateName,
+    lightName,
+    wifiName,
+    sendName,
+    eepromName,
+    ticName
+};
+
+void LatencyStats::record(LatencyStage stage, uint32_t time)
+{
+    StageStats& stats = stageStats[stage];
+    uint16_t time16 = (time > UINT16_MAX) ? UINT16_MAX : time;
+
+    if ((stats.count == 0) || (time16 < stats.minTime)) stats.minTime = time16;
+    if (time16 > stats.maxTime) stats.maxTime = time16;
+    stats.totalTime += time;
+    stats.count++;
+
+    // Bin by the position of the highest set bit
+    uint8_t bin = 0;
+    while ((time16 > 0) && (bin < (LATENCY_BINS - 1)))
+    {
+        time16 >>= 1;
+        bin++;
+    }
+    if (stats.histogram[bin] < UINT8_MAX) stats.histogram[bin]++;
+}
+
+void LatencyStats::reset()
+{
+    // The tic interrupt records into its own stage
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        for (uint8_t i=0; i<NUM_STAGES; i++)
+        {
+            stageStats[i].minTime = 0;
+            stageStats[i].maxTime = 0;
+            stageStats[i].totalTime = 0;
+            stageStats[i].count = 0;
+            for (uint8_t j=0; j<LATENCY_BINS; j++)
+            {
+                stageStats[i].histogram[j] = 0;
+            }
+        }
+    }
+}
+
+const StageStats& LatencyStats::getStats(LatencyStage stage)
+{
+    return stageStats[stage];
+}
+
+PGM_P LatencyStats::getName(LatencyStage stage)
+{
+    return (PGM_P)pgm_read_word(&(STAGE_NAMES[stage]));
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef LATENCY_STATS_HPP
+#define LATENCY_STATS_HPP
+
+#include <stdint.h>
+
+/**
+ * Timing of each stage of the main loop, enabled with the LATENCY_STATS build flag.
+ * When disabled, LATENCY_SCOPE compiles to nothing.
+ *
+ * Times are in timer counts (64us), from getTimerCounts()
+ */
+enum LatencyStage : uint8_t
+{
+    STAGE_CLI,
+    STAGE_CLIMATE,
+    STAGE_LIGHT,
+    STAGE_WIFI,
+    STAGE_WIFI_SEND,
+    STAGE_EEPROM,
+    STAGE_TIC,          // How late the tic interrupt ran, recorded by the interrupt itself
+    NUM_STAGES
+};
+
+#ifdef LATENCY_STATS
+
+#include "devices.hpp"
+#include <avr/pgmspace.h>
+
+// Histogram bin n counts stage times of 2^(n-1) up to 2^n - 1 counts, the last bin holds everything longer
+const static uint8_t LATENCY_BINS = 16;
+
+struct StageStats
+{
+    uint16_t minTime;
+    uint16_t maxTime;
+    uint32_t totalTime;
+    uint32_t count;
+    uint8_t histogram[LATENCY_BINS];    // Saturates at 255
+};
+
+namespace LatencyStats
+{
+    /**
+     * Add a time to a stage's stats
+     * @param   stage   Stage that was timed
+     * @param   time    Time taken, in timer counts
+     */
+    void record(LatencyStage stage, uint32_t time);
+
+    /**
+     * Clear the stats of every stage
+     */
+    void reset();
+
+    /**
+     * @param   stage   Stage to get
+     * @return  The stage's stats. The tic interrupt writes STAGE_TIC, copy them with interrupts off
+     */
+    const StageStats& getStats(LatencyStage stage);
+
+    /**
+     * @param   stage   Stage to name
+     * @return  The stage's name, in flash
+     */
+    PGM_P getName(LatencyStage stage);
+}
+
+/**
+ * Times from construction until it goes out of scope
+ */
+class LatencyScope
+{
+    public:
+        LatencyScope(LatencyStage stage):
+            stage_(stage),
+            start_(getTimerCounts())
+        {}
+
+        ~LatencyScope(){ LatencyStats::record(stage_, getTimerCounts() - start_); }
+
+    private:
+        LatencyStage stage_;
+        uint32_t start_;
+};
+
+#define LATENCY_SCOPE(stage) LatencyScope latencyScope(stage)
+
+#else
+
+#define LATENCY_SCOPE(stage)
+
+#endif
+
+#endif
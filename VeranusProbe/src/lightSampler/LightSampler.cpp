@@ -0,0 +1,110 @@
+#include "lightSampler/LightSampler.hpp"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+const static uint16_t SAMPLE_MAX = 1023 << 2;     // Full scale after decimating to 12 bits
+const static uint16_t FULL_SCALE = 10000;   // Hundredths of a percent
+
+// Sampler the ADC interrupt hands conversions to, there is only one ADC
+static LightSampler* pActiveSampler = nullptr;
+
+ISR(ADC_vect)
+{
+    if (pActiveSampler != nullptr) pActiveSampler->onConversion(ADC);
+}
+
+LightSampler::LightSampler(uint8_t channel):
+    channel_(channel),
+    sum_(0),
+    count_(0),
+    filtered_(0),
+    primed_(false)
+#ifdef ADC_NOISE_REDUCTION
+    ,conversionRequested_(false)
+#endif
+{
+}
+
+void LightSampler::initialize()
+{
+    // External reference, single conversions at 16MHz / 128 = 125kHz, about 104us each
+    ADMUX = channel_ & 0x0f;
+    DIDR0 |= (1 << channel_);
+    ADCSRA = (1 << ADEN) | (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+
+    // Take the first sample straight away, so there is a reading before the first tic
+    for (uint8_t i=0; i<OVERSAMPLE; i++)
+    {
+        ADCSRA |= (1 << ADSC);
+        while (ADCSRA & (1 << ADSC));
+        onConversion(ADC);
+    }
+
+    pActiveSampler = this;
+    ADCSRA |= (1 << ADIF) | (1 << ADIE);
+}
+
+void LightSampler::onTic()
+{
+#ifdef ADC_NOISE_REDUCTION
+    conversionRequested_ = true;
+#else
+    // Idle sleep with the ADC enabled can also start a conversion, all of them count.
+    // Writing ADIF back would clear a conversion the ADC interrupt has not collected yet
+    uint8_t control = ADCSRA;
+    if ((control & ((1 << ADIE) | (1 << ADSC))) == (1 << ADIE))
+    {
+        ADCSRA = (control & ~(1 << ADIF)) | (1 << ADSC);
+    }
+#endif
+}
+
+#ifdef ADC_NOISE_REDUCTION
+bool LightSampler::takeConversionRequest()
+{
+    bool requested;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        requested = conversionRequested_ && (pActiveSampler == this) && !(ADCSRA & (1 << ADSC));
+        conversionRequested_ = false;
+    }
+    return requested;
+}
+#endif
+
+void LightSampler::onConversion(uint16_t value)
+{
+    sum_ += value;
+    count_++;
+    if (count_ < OVERSAMPLE) return;
+
+    uint16_t sample = sum_ >> DECIMATE_SHIFT;
+    sum_ = 0;
+    count_ = 0;
+
+    // Start the filter from the first sample rather than ramping up from 0
+    if (!primed_)
+    {
+        filtered_ = sample << FILTER_SHIFT;
+        primed_ = true;
+    }
+    else
+    {
+        filtered_ = filtered_ - (filtered_ >> FILTER_SHIFT) + sample;
+    }
+}
+
+uint16_t LightSampler::getLight()
+{
+    uint16_t filtered;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        filtered = filtered_;
+    }
+
+    uint16_t sample = (filtered + (1 << (FILTER_SHIFT - 1))) >> FILTER_SHIFT;
+    if (sample > SAMPLE_MAX) sample = SAMPLE_MAX;
+    return (((uint32_t)sample * FULL_SCALE) + (SAMPLE_MAX / 2)) / SAMPLE_MAX;
+}
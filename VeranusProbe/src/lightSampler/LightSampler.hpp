@@ -0,0 +1,72 @@
+#ifndef LIGHT_SAMPLER_HPP
+#define LIGHT_SAMPLER_HPP
+
+#include <stdint.h>
+
+/**
+ * Samples the light sensor in the background, so reading it never waits on the ADC.
+ *
+ * A conversion is started every tic and collected by the ADC interrupt. Every OVERSAMPLE
+ * conversions are summed and decimated to one 12 bit sample, which feeds a low pass filter
+ * with a time constant of a few seconds. That smooths out flicker from mains lighting, which
+ * the old filter never saw enough samples of to do at one reading every 15 seconds.
+ *
+ * With the ADC_NOISE_REDUCTION build flag, conversions are taken in ADC noise reduction sleep
+ * instead, with the CPU and IO clocks halted. Timer 2 and the UART stop for the ~100us each one
+ * takes, which makes the tic count run about 0.6% slow, so this is off by default
+ */
+class LightSampler
+{
+    public:
+        /**
+         * @param   channel     ADC channel the sensor is on, measured against AREF
+         */
+        LightSampler(uint8_t channel);
+        ~LightSampler(){}
+
+        /**
+         * Set up the ADC, and fill the filter with a first reading. Blocks for about 2ms
+         */
+        void initialize();
+
+        /**
+         * Start the next conversion, called from the tic interrupt. Does nothing until initialized
+         */
+        void onTic();
+
+        /**
+         * Get the filtered light level, does not block
+         * @return  Hundredths of a percent of full scale
+         */
+        uint16_t getLight();
+
+#ifdef ADC_NOISE_REDUCTION
+        /**
+         * Check whether a conversion is wanted, for the main loop to sleep in ADC noise reduction
+         * mode. Clears the request
+         */
+        bool takeConversionRequest();
+#endif
+
+        /**
+         * Add a finished conversion, called from the ADC interrupt
+         */
+        void onConversion(uint16_t value);
+
+    private:
+        const static uint8_t OVERSAMPLE = 16;   // Conversions per sample, 4^2 for 2 extra bits
+        const static uint8_t DECIMATE_SHIFT = 2;
+        const static uint8_t FILTER_SHIFT = 4;  // Filter weight of 1/16 per sample
+
+        uint8_t channel_;
+
+        volatile uint16_t sum_;
+        volatile uint8_t count_;
+        volatile uint16_t filtered_;    // Filtered 12 bit sample, shifted up by FILTER_SHIFT
+        volatile bool primed_;
+#ifdef ADC_NOISE_REDUCTION
+        volatile bool conversionRequested_;
+#endif
+};
+
+#endif
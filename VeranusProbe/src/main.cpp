@@ -6,6 +6,10 @@
 #include "Settings.hpp"
 #include "config.hpp"
 #include "ProbeStrings.hpp"
+#include "TaskScheduler.hpp"
+#include "latencyStats/LatencyStats.hpp"
+#include "stackMonitor/StackMonitor.hpp"
+#include "reportPolicy/ReportPolicy.hpp"
 
 #ifndef DISABLE_CLI
 #include "ProbeCli.hpp"
@@ -13,31 +17,61 @@
 
 extern "C" void __cxa_pure_virtual() { while (1); }
 
-// Count used to sync wifi updates to be directly after climate readings
-static int8_t readingsUntilUpdate = 1;
+// Set when there are readings to upload, cleared once they are sent or an upload fails.
+// A failed upload is tried again after the next climate reading
+static bool sendDue = false;
+
+// True while a reading is queued on, or being sent by, the wifi interface
+static bool sendInProgress = false;
 
-void updateReceiver();
 void updateLightSensor();
-void updateClimateSensor();
 void updateWifi();
-void loop();
+static void updateCli();
+static void updateWifiTask();
+static void updateEeprom();
+static void feedWatchdog();
+
+/**
+ * Everything the probe does, most urgent first. Periods and deadlines are in timer counts.
+ * Draining the UARTs comes first, slow sensor reads next, and writes to eeprom wait for
+ * everything else. The watchdog is fed last, so it resets us if lower priority work is starved
+ */
+const static char cliName[] PROGMEM = "CLI";
+const static char wifiName[] PROGMEM = "WIFI";
+const static char climateName[] PROGMEM = "CLIMATE";
+const static char lightName[] PROGMEM = "LIGHT";
+const static char eepromName[] PROGMEM = "EEPROM";
+const static char watchdogName[] PROGMEM = "WDT";
+
+const static Scheduler::Task tasks[] PROGMEM =
+{
+    {.name = cliName,      .function = updateCli,           .period = COUNTS_PER_TIC,                                   .priority = 0, .deadline = COUNTS_PER_TIC},
+    {.name = wifiName,     .function = updateWifiTask,      .period = COUNTS_PER_TIC,                                   .priority = 0, .deadline = COUNTS_PER_TIC},
+    {.name = climateName,  .function = updateClimateSensor, .period = CLIMATE_UPDATE_TIME_SECONDS * COUNTS_PER_SECOND,  .priority = 1, .deadline = COUNTS_PER_SECOND},
+    {.name = lightName,    .function = updateLightSensor,   .period = LIGHT_UPDATE_TIME_SECONDS * COUNTS_PER_SECOND,    .priority = 1, .deadline = COUNTS_PER_SECOND},
+    {.name = eepromName,   .function = updateEeprom,        .period = COUNTS_PER_TIC,                                   .priority = 2, .deadline = 5 * COUNTS_PER_SECOND},
+    {.name = watchdogName, .function = feedWatchdog,        .period = COUNTS_PER_SECOND / 4,                            .priority = 3, .deadline = COUNTS_PER_SECOND}
+};
+const static uint8_t numTasks = sizeof(tasks) / sizeof(tasks[0]);
+
+static Scheduler::TaskStats taskStats[numTasks];
+static Scheduler::TaskScheduler scheduler(tasks, taskStats, numTasks, &getTimerCounts);
+Scheduler::TaskScheduler* pScheduler = &scheduler;
+
+// Decides which climate readings to upload, and when to take the next
+static ReportPolicy reportPolicy(&settings);
+ReportPolicy* pReportPolicy = &reportPolicy;
 
 int main(void)
 {
     initializeDevices();
 
-    PRINTLN("Build %d.%d", V_MAJOR, V_MINOR);
-    PRINTLN("ID: %d", settings.id);
+    PRINTLN_P("Build %d.%d", V_MAJOR, V_MINOR);
+    PRINTLN_P("ID: %d", settings.id);
 
-    // Get initial readings for each sensor
-    updateClimateSensor();
+    // Get an initial light reading, the climate takes a few tics so is read once tasks start
     updateLightSensor();
 
-    // Start the update timers
-    pUpdateTimer->enable();
-    pClimateTimer->enable();
-    pLightTimer->enable();
-
 #ifndef DISABLE_CLI
     // Enable our CLI
     pProbeCli->enable();
@@ -50,169 +84,170 @@ int main(void)
     settings.wifiEnabled = false;
 #endif
 
+    // Start running tasks
+    scheduler.start();
+
+    // Start the first climate reading on the next tic, it sets its own period from then on
+    scheduler.setPeriod(scheduler.findTask(updateClimateSensor), COUNTS_PER_TIC);
+
     for (;;) {
 
-        if (pUpdateTimer->hasPeriodPassed())
+        // Sleep until the next task is due, or an interrupt has something for us
+        uint32_t tic = getTicCount();
+        if (!scheduler.runNext())
         {
-            loop();
+            sleepUntilInterrupt(tic, scheduler.getNextRun());
         }
     }
 
   return 0;
 }
 
-void loop()
+static void updateCli()
 {
+    LATENCY_SCOPE(STAGE_CLI);
 #ifndef DISABLE_CLI
-    // Update the cli
     pProbeCli->update();
 #endif
+}
 
-    // If enough time has elapsed, update the climate sensor data
-    if (pClimateTimer->hasPeriodPassed())
-    {
-        updateClimateSensor();
-
-        // Reset timer to ensure we do not try and read the sensor
-        // again before it is ready
-        pClimateTimer->reset();
-    }
-
-    // If enough time has passed, update the light sensor
-    if (pLightTimer->hasPeriodPassed())
+static void updateWifiTask()
+{
     {
-        updateLightSensor();
+        // Update wifi driver, always so that CLI wifi commands complete
+        LATENCY_SCOPE(STAGE_WIFI);
+        pWifiInterface->update();
     }
 
-    // Update wifi driver
     if (settings.wifiEnabled)
     {
+        LATENCY_SCOPE(STAGE_WIFI_SEND);
         updateWifi();
     }
+}
 
-    // Save any changes to eeprom
-    pEepromManager->update();
+static void updateEeprom()
+{
+    // Save any changes to eeprom, a byte at a time
+    LATENCY_SCOPE(STAGE_EEPROM);
+    pSettingsJournal->update();
+    pHistoryLog->update();
+}
+
+static void feedWatchdog()
+{
+#ifdef STACK_WARNING
+    // Speak up while the stack is getting low, rather than leaving an overflow to the watchdog
+    StackMonitor::check();
+#endif
+
+    pWdt->reset();
 }
 
 void updateClimateSensor()
 {
-    // Try and get a new climate reading
-    if (pProbe->readClimate(latestData.tempF, latestData.humidity))
+    LATENCY_SCOPE(STAGE_CLIMATE);
+
+    // Move the climate reading on, coming back each tic until the sensor is done with it
+    int16_t temperatureF;
+    uint16_t humidity;
+    AsyncHdc1080::Result result = pProbe->readClimate(temperatureF, humidity);
+    if (result == AsyncHdc1080::Result::BUSY)
+    {
+        pScheduler->setPeriod(pScheduler->findTask(updateClimateSensor), COUNTS_PER_TIC);
+        return;
+    }
+
+    if (result == AsyncHdc1080::Result::READY)
     {
 
 #ifdef CLIMATE_DEBUG
-        PRINTLN("T,%f,H,%f", latestData.tempF, latestData.humidity);
+        PRINTLN_P("T,%f,H,%f",
+                Protocol::fromFixedTemperature(temperatureF),
+                Protocol::fromFixedPercent(humidity));
 #else
         if (settings.debug)
         {
-            PRINTLN("T,%f,H,%f", latestData.tempF, latestData.humidity);
+            PRINTLN_P("T,%f,H,%f",
+                    Protocol::fromFixedTemperature(temperatureF),
+                    Protocol::fromFixedPercent(humidity));
         }
 #endif
 
+        // Keep the reading in wire format
+        Protocol::encode((uint8_t*)&latestData,
+                         settings.id,
+                         temperatureF,
+                         humidity,
+                         latestData.light);
+
         // Update display
-        pDisplay->update(latestData.tempF, latestData.humidity);
+        pDisplay->update(temperatureF, humidity);
+
+        // Keep the long term history
+        pHistoryLog->add(getUptimeSeconds(), temperatureF, humidity, latestData.light);
 
-        // Decrease the number of climate readings required to update the wifi module
-        readingsUntilUpdate--;
+        // Keep this reading until it is uploaded if it is worth sending
+        if (reportPolicy.onReading(getUptimeSeconds(), temperatureF, humidity))
+        {
+            StoredReading reading;
+            reading.timestamp = getUptimeSeconds();
+            reading.temperature = latestData.temperature;
+            reading.humidity = latestData.humidity;
+            reading.light = latestData.light;
+            pReadingBuffer->push(reading);
+        }
+        sendDue = !pReadingBuffer->isEmpty();
 
         // Let the probe know what the brightness of the LCD is so that we can adjust accordingly
-        pProbe->setLcdBrightness(static_cast<float>(pDisplay->getBrightness()));
+        pProbe->setLcdBrightness(pDisplay->getBrightness());
     }
     else
     {
-        if (settings.debug) PRINTLN(getString(ProbeStrings::CLIMATE_SENSOR_FAILURE));
+        if (settings.debug) PRINTLN_P("%s", getString(ProbeStrings::CLIMATE_SENSOR_FAILURE));
     }
+
+    // Sample faster while the climate is changing
+    pScheduler->setPeriod(pScheduler->findTask(updateClimateSensor),
+                          reportPolicy.getSamplePeriod() * COUNTS_PER_SECOND);
 }
 
 void updateLightSensor()
 {
-    pProbe->readLight(latestData.light);
+    LATENCY_SCOPE(STAGE_LIGHT);
+
+    uint16_t light;
+    pProbe->readLight(light);
+    latestData.light = light;
 #ifndef CLIMATE_DEBUG
-    if (settings.debug) PRINTLN("L,%d", (uint16_t)latestData.light);
+    if (settings.debug) PRINTLN_P("L,%u", light / 100);
 #endif
 
-    if (settings.lightMode == LightMode::INCREASE)
-    {
-        if (settings.maxLight > settings.minLight)
-        {
-            // Calculate the desired brightness for the increase mode
-            float brightness = 0;
-            if (latestData.light <= MIN_LIGHT_SCALE)
-            {
-                brightness = settings.minLight;
-            }
-            else if (latestData.light >= MAX_LIGHT_SCALE)
-            {
-                brightness = settings.maxLight;
-            }
-            else 
-            {
-                float brightnessPercent = (latestData.light - MIN_LIGHT_SCALE) / (MAX_LIGHT_SCALE - MIN_LIGHT_SCALE);
-                brightness = (brightnessPercent * (settings.maxLight - settings.minLight)) + settings.minLight;
-            }
-            pDisplay->setBrightness(static_cast<uint8_t>(brightness));
-        }
-    }
-    else if (settings.lightMode == LightMode::DECREASE)
+    // The display picks a backlight level for the light mode, and fades to it
+    pDisplay->setLightLevel(latestData.light);
+}
+
+static void onSendComplete(bool success, const char* response)
+{
+    sendInProgress = false;
+
+    // Keep going straight away while there is a backlog to drain, otherwise wait for the
+    // next reading to be worth sending, or to try again after a failure
+    if (!success || pReadingBuffer->isEmpty())
     {
-        if (settings.maxLight > settings.minLight)
-        {
-            float brightness = 0;
-            if (latestData.light <= MIN_LIGHT_SCALE)
-            {
-                brightness = settings.maxLight;
-            }
-            else if (latestData.light >= MAX_LIGHT_SCALE)
-            {
-                brightness = settings.minLight;
-            }
-            else 
-            {
-                float brightnessPercent = (MAX_LIGHT_SCALE - latestData.light) / (MAX_LIGHT_SCALE - MIN_LIGHT_SCALE);
-                brightness = (brightnessPercent * (settings.maxLight - settings.minLight)) + settings.minLight;
-            }
-            pDisplay->setBrightness(static_cast<uint8_t>(brightness));
-        }
+        sendDue = false;
     }
+
+    if (settings.debug) PRINTLN_P("Send %s", success ? getString(ProbeStrings::PASS) : getString(ProbeStrings::FAIL));
 }
 
 void updateWifi()
 {
-    switch (pWifiInterface->getState())
+    if (!sendInProgress &&
+        sendDue &&
+        !pReadingBuffer->isEmpty())
     {
-        case WifiState::IDLE:
-        {
-            if (readingsUntilUpdate <= 0)
-            {
-                pWifiInterface->send(settings.id, latestData.tempF, latestData.humidity, latestData.light);
-            }
-            break;
-        }
-
-        case WifiState::PENDING:
-        {
-            // Transaction pending, let the wifi interface do its thing
-            pWifiInterface->update();
-            break;
-        }
-
-        case WifiState::COMPLETED:
-        {
-            // Set the number of climates readings to wait for before sending to wifi again
-            // based on whether or not this transmission succeeded
-            bool success = pWifiInterface->getSuccess();
-            readingsUntilUpdate = success ?
-                                    WIFI_SUCCESS_UPDATE_READINGS :
-                                    WIFI_FAIL_UPDATE_TIME_SECONDS;
-
-            if (settings.debug) PRINTLN("Send %s", success ? getString(ProbeStrings::PASS) : getString(ProbeStrings::FAIL));
-            break;
-        }
-
-        default:
-        {
-            // Still active, do nothing
-            break;
-        }
+        // Sends the oldest buffered readings, the result comes back through onSendComplete
+        sendInProgress = pWifiInterface->send(settings.id, &onSendComplete);
     }
 }
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "ReadingBuffer.hpp"
+#include "drivers/assert/Assert.hpp"
+
+ReadingBuffer::ReadingBuffer(StoredReading* pStorage, uint8_t capacity):
+    pStorage_(pStorage),
+    capacity_(capacity),
+    head_(0),
+    count_(0),
+    dropped_(0)
+{
+    assert(pStorage_ != nullptr);
+    assert(capacity_ > 0);
+}
+
+void ReadingBuffer::push(const StoredReading& reading)
+{
+    if (count_ >= capacity_)
+    {
+        // Full, make room by dropping the oldest
+        head_ = (head_ + 1) % capacity_;
+        count_--;
+        dropped_++;
+    }
+
+    pStorage_[(head_ + count_) % capacity_] = reading;
+    count_++;
+}
+
+const StoredReading* ReadingBuffer::peek(uint8_t index)
+{
+    if (index >= count_) return nullptr;
+
+    return &(pStorage_[(head_ + index) % capacity_]);
+}
+
+void ReadingBuffer::popThrough(uint32_t timestamp)
+{
+    // Readings are in time order, so stop at the first one newer than the timestamp.
+    // Readings already dropped to make room are simply no longer here
+    while ((count_ > 0) &&
+           (pStorage_[head_].timestamp <= timestamp))
+    {
+        head_ = (head_ + 1) % capacity_;
+        count_--;
+    }
+}
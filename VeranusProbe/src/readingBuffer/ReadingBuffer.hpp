@@ -0,0 +1,54 @@
+#ifndef READING_BUFFER_HPP
+#define READING_BUFFER_HPP
+
+#include <stdint.h>
+
+struct StoredReading
+{
+    uint32_t timestamp;     // Seconds since boot
+    int16_t temperature;    // Hundredths of a degree Fahrenheit
+    uint16_t humidity;      // Hundredths of a percent
+    uint16_t light;         // Hundredths of a percent
+};
+
+/**
+ * Ring buffer of readings waiting to be uploaded. When full, the oldest reading is dropped
+ */
+class ReadingBuffer
+{
+    public:
+        ReadingBuffer(StoredReading* pStorage, uint8_t capacity);
+        ~ReadingBuffer(){}
+
+        /**
+         * Add a reading to the end of the buffer, dropping the oldest reading if full
+         */
+        void push(const StoredReading& reading);
+
+        /**
+         * Get a reading without removing it
+         * @param   index   Position from the oldest reading
+         * @return  Pointer to the reading, or nullptr if there are not that many readings
+         */
+        const StoredReading* peek(uint8_t index);
+
+        /**
+         * Remove the oldest readings up to and including the given timestamp
+         * @param   timestamp   Timestamp of the newest reading to remove
+         */
+        void popThrough(uint32_t timestamp);
+
+        uint8_t getCount(){ return count_; }
+        uint8_t getCapacity(){ return capacity_; }
+        uint16_t getDropped(){ return dropped_; }
+        bool isEmpty(){ return count_ == 0; }
+
+    private:
+        StoredReading* pStorage_;
+        uint8_t capacity_;
+        uint8_t head_;
+        uint8_t count_;
+        uint16_t dropped_;
+};
+
+#endif
@@ -0,0 +1,84 @@
+#include "ReportPolicy.hpp"
+
+// Deadbands are in tenths, readings in hundredths
+const static uint8_t DEADBAND_SCALE = 10;
+
+static uint16_t difference(int32_t a, int32_t b)
+{
+    return (a > b) ? (a - b) : (b - a);
+}
+
+ReportPolicy::ReportPolicy(const Settings* pSettings):
+    pSettings_(pSettings),
+    hasReading_(false),
+    lastUptime_(0),
+    lastTemperature_(0),
+    lastHumidity_(0),
+    hasSent_(false),
+    sentUptime_(0),
+    sentTemperature_(0),
+    sentHumidity_(0),
+    samplePeriod_(0)
+{
+}
+
+bool ReportPolicy::onReading(uint32_t uptime, int16_t temperatureF, uint16_t humidity)
+{
+    uint32_t tempDeadband = (uint32_t)pSettings_->tempDeadband * DEADBAND_SCALE;
+    uint32_t humidityDeadband = (uint32_t)pSettings_->humidityDeadband * DEADBAND_SCALE;
+
+    // Work out how far the readings would move over a slow period at the rate they are changing
+    uint32_t elapsed = uptime - lastUptime_;
+    if (hasReading_ && (elapsed > 0))
+    {
+        uint32_t slowPeriod = pSettings_->slowSampleSeconds;
+        uint32_t tempChange = ((uint32_t)difference(temperatureF, lastTemperature_) * slowPeriod) / elapsed;
+        uint32_t humidityChange = ((uint32_t)difference(humidity, lastHumidity_) * slowPeriod) / elapsed;
+
+        if ((tempChange >= tempDeadband) || (humidityChange >= humidityDeadband))
+        {
+            samplePeriod_ = pSettings_->fastSampleSeconds;
+        }
+        else
+        {
+            uint32_t backedOff = (uint32_t)getSamplePeriod() * 2;
+            samplePeriod_ = (backedOff > UINT16_MAX) ? UINT16_MAX : backedOff;
+        }
+    }
+    else
+    {
+        samplePeriod_ = pSettings_->slowSampleSeconds;
+    }
+
+    hasReading_ = true;
+    lastUptime_ = uptime;
+    lastTemperature_ = temperatureF;
+    lastHumidity_ = humidity;
+
+    // Send on change, or when it has been quiet for too long
+    bool send = !hasSent_ ||
+                (difference(temperatureF, sentTemperature_) >= tempDeadband) ||
+                (difference(humidity, sentHumidity_) >= humidityDeadband) ||
+                ((uptime - sentUptime_) >= ((uint32_t)pSettings_->heartbeatMinutes * 60));
+
+    if (send)
+    {
+        hasSent_ = true;
+        sentUptime_ = uptime;
+        sentTemperature_ = temperatureF;
+        sentHumidity_ = humidity;
+    }
+
+    return send;
+}
+
+uint16_t ReportPolicy::getSamplePeriod()
+{
+    // The settings may have changed since the period was worked out
+    uint16_t period = samplePeriod_;
+    if (period > pSettings_->slowSampleSeconds) period = pSettings_->slowSampleSeconds;
+    if (period < pSettings_->fastSampleSeconds) period = pSettings_->fastSampleSeconds;
+    if (period == 0) period = 1;
+
+    return period;
+}
@@ -0,0 +1,56 @@
+#ifndef REPORT_POLICY_HPP
+#define REPORT_POLICY_HPP
+
+#include <stdint.h>
+#include "Settings.hpp"
+
+/**
+ * Decides which climate readings are worth sending, and how soon to take the next one.
+ *
+ * A reading is sent when temperature or humidity has moved past its deadband since the last
+ * reading sent, or once the heartbeat time has passed without sending anything.
+ *
+ * Sampling speeds up to the fast period as soon as the readings are changing quickly enough to
+ * cross a deadband within one slow period, and otherwise doubles each reading back to the slow
+ * period. Everything is tuned from the settings, so changes apply from the next reading
+ */
+class ReportPolicy
+{
+    public:
+        ReportPolicy(const Settings* pSettings);
+        ~ReportPolicy(){}
+
+        /**
+         * Take in a new reading
+         * @param   uptime          Seconds since boot
+         * @param   temperatureF    Hundredths of a degree Fahrenheit
+         * @param   humidity        Hundredths of a percent
+         * @return  True if the reading should be sent
+         */
+        bool onReading(uint32_t uptime, int16_t temperatureF, uint16_t humidity);
+
+        /**
+         * Get how long to wait before the next reading
+         * @return  Seconds, between the fast and slow sample periods
+         */
+        uint16_t getSamplePeriod();
+
+    private:
+        const Settings* pSettings_;
+
+        // Last reading taken
+        bool hasReading_;
+        uint32_t lastUptime_;
+        int16_t lastTemperature_;
+        uint16_t lastHumidity_;
+
+        // Last reading sent
+        bool hasSent_;
+        uint32_t sentUptime_;
+        int16_t sentTemperature_;
+        uint16_t sentHumidity_;
+
+        uint16_t samplePeriod_;
+};
+
+#endif
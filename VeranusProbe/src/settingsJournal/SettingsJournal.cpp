@@ -0,0 +1,189 @@
+#include "SettingsJournal.hpp"
+
+#include <stddef.h>
+#include <string.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <util/atomic.h>
+
+// Erased EEPROM reads as all ones, so this sequence number is never used
+const static uint16_t BLANK_SEQUENCE = 0xffff;
+
+SettingsJournal::SettingsJournal(Settings* pSettings,
+                                 uint16_t address,
+                                 uint16_t length,
+                                 uint32_t quietTics,
+                                 TicSource getTics):
+    pSettings_(pSettings),
+    address_(address),
+    numSlots_(length / SLOT_SIZE),
+    quietTics_(quietTics),
+    getTics_(getTics),
+    dirty_(false),
+    changeTic_(0),
+    writeIndex_(sizeof(Record)),
+    slot_(0),
+    sequence_(0),
+    recordsSaved_(0),
+    bytesWritten_(0)
+{
+}
+
+bool SettingsJournal::initialize()
+{
+    // Every slot is read once, keeping the valid record with the newest sequence number.
+    // Sequence numbers wrap, but all the records in the journal are within numSlots_ of each other
+    bool found = false;
+    for (uint8_t slot=0; slot<numSlots_; slot++)
+    {
+        Record record;
+        eeprom_read_block(&record, (const void*)(uintptr_t)getSlotAddress(slot), sizeof(Record));
+
+        if ((record.sequence == BLANK_SEQUENCE) ||
+            (record.crc != getCrc(&record, offsetof(Record, crc))))
+        {
+            continue;
+        }
+
+        if (!found || ((int16_t)(record.sequence - sequence_) > 0))
+        {
+            found = true;
+            slot_ = slot;
+            sequence_ = record.sequence;
+            saved_ = record.settings;
+        }
+    }
+
+    if (found)
+    {
+        *pSettings_ = saved_;
+        latest_ = saved_;
+        return true;
+    }
+
+    // Nothing saved yet, start at the first slot and save whatever settings we end up with
+    slot_ = numSlots_ - 1;
+    memset(&saved_, 0xff, sizeof(Settings));
+    latest_ = saved_;
+
+    return loadLegacy();
+}
+
+bool SettingsJournal::loadLegacy()
+{
+    bool found = false;
+    uint8_t newestSlot = 0;
+    LegacyRecord newest;
+    for (uint8_t slot=0; slot<(numSlots_ * (SLOT_SIZE / LEGACY_SLOT_SIZE)); slot++)
+    {
+        LegacyRecord record;
+        uint16_t address = address_ + ((uint16_t)slot * LEGACY_SLOT_SIZE);
+        eeprom_read_block(&record, (const void*)(uintptr_t)address, sizeof(LegacyRecord));
+
+        if ((record.sequence == BLANK_SEQUENCE) ||
+            (record.crc != getCrc(&record, offsetof(LegacyRecord, crc))))
+        {
+            continue;
+        }
+
+        if (!found || ((int16_t)(record.sequence - newest.sequence) > 0))
+        {
+            found = true;
+            newestSlot = slot;
+            newest = record;
+        }
+    }
+
+    if (!found) return false;
+
+    // Fields after wifiEnabled are left for the caller to default, as the revision is still 2
+    memcpy(pSettings_, newest.settings, LEGACY_SETTINGS_SIZE);
+    sequence_ = newest.sequence;
+
+    // Nothing is saved in the current size, so the next update() saves these. It goes in the slot
+    // after the one holding the legacy record, which is kept until the new record is complete
+    slot_ = (newestSlot * LEGACY_SLOT_SIZE) / SLOT_SIZE;
+    return true;
+}
+
+void SettingsJournal::update()
+{
+    if (isSaving())
+    {
+        writeNext();
+        return;
+    }
+
+    uint32_t tics = getTics_();
+    if (memcmp(pSettings_, &latest_, sizeof(Settings)) != 0)
+    {
+        // Wait for the settings to settle, changing them back to what is saved cancels the save
+        latest_ = *pSettings_;
+        changeTic_ = tics;
+        dirty_ = (memcmp(&latest_, &saved_, sizeof(Settings)) != 0);
+    }
+
+    if (dirty_ && ((tics - changeTic_) >= quietTics_))
+    {
+        startSave();
+    }
+}
+
+uint16_t SettingsJournal::getCrc(const void* pRecord, uint8_t length)
+{
+    const uint8_t* pData = (const uint8_t*)pRecord;
+    uint16_t crc = 0xffff;
+    for (uint8_t i=0; i<length; i++)
+    {
+        crc = _crc_ccitt_update(crc, pData[i]);
+    }
+
+    return crc;
+}
+
+void SettingsJournal::startSave()
+{
+    sequence_++;
+    if (sequence_ == BLANK_SEQUENCE) sequence_++;
+
+    pending_.sequence = sequence_;
+    pending_.settings = latest_;
+    pending_.crc = getCrc(&pending_, offsetof(Record, crc));
+
+    slot_ = (slot_ + 1) % numSlots_;
+    writeIndex_ = 0;
+    dirty_ = false;
+}
+
+void SettingsJournal::writeNext()
+{
+    // Only start a write once the last one has finished, rather than waiting for it
+    if (!eeprom_is_ready()) return;
+
+    const uint8_t* pData = (const uint8_t*)&pending_;
+    uint16_t address = getSlotAddress(slot_);
+
+    // Bytes that already hold the right value are skipped, they cost a read instead of a write
+    while (writeIndex_ < sizeof(Record))
+    {
+        uint8_t* pEeprom = (uint8_t*)(uintptr_t)(address + writeIndex_);
+        uint8_t value = pData[writeIndex_];
+        writeIndex_++;
+
+        if (eeprom_read_byte(pEeprom) != value)
+        {
+            ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+            {
+                eeprom_write_byte(pEeprom, value);
+            }
+            bytesWritten_++;
+            break;
+        }
+    }
+
+    if (!isSaving())
+    {
+        saved_ = pending_.settings;
+        recordsSaved_++;
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef SETTINGS_JOURNAL_HPP
+#define SETTINGS_JOURNAL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include "Settings.hpp"
+
+/**
+ * Returns the current tic count
+ */
+typedef uint32_t (*TicSource)();
+
+/**
+ * Keeps the settings in EEPROM as a journal of records, each with a sequence number and CRC.
+ *
+ * Every save goes to the slot after the last one, so wear is spread across the whole region,
+ * and a save cut short by a reset leaves the previous record as the newest valid one.
+ * Changes are only saved once the settings have stopped changing for a while, so a burst of
+ * CLI commands costs one record. Records are written a byte per call to update(), so nothing
+ * waits on the EEPROM's 3.3ms write time.
+ *
+ * Slots were LEGACY_SLOT_SIZE bytes while the settings were at revision 2. A journal of those is
+ * still read, and its newest record saved in the current slot size
+ */
+class SettingsJournal
+{
+    public:
+        /**
+         * @param   pSettings   Settings to keep in EEPROM
+         * @param   address     First EEPROM byte of the journal
+         * @param   length      Bytes of EEPROM for the journal, a multiple of SLOT_SIZE
+         * @param   quietTics   Tics the settings must stay the same for before they are saved
+         * @param   getTics     Returns the current tic count
+         */
+        SettingsJournal(Settings* pSettings,
+                        uint16_t address,
+                        uint16_t length,
+                        uint32_t quietTics,
+                        TicSource getTics);
+        ~SettingsJournal(){}
+
+        /**
+         * Load the newest valid record into the settings. If there is none, but there is a record
+         * in the legacy slot size, that is loaded instead and saved again on the next update()
+         * @return  True if there was one, otherwise the settings are left alone
+         */
+        bool initialize();
+
+        /**
+         * Look for changes to the settings, and write out the next byte of a record being saved.
+         * Call often, each call takes a few microseconds
+         */
+        void update();
+
+        bool isSaving(){ return writeIndex_ < sizeof(Record); }
+        uint8_t getSlot(){ return slot_; }
+        uint16_t getSequence(){ return sequence_; }
+        uint16_t getRecordsSaved(){ return recordsSaved_; }
+        uint32_t getBytesWritten(){ return bytesWritten_; }
+
+        const static uint8_t SLOT_SIZE = 32;
+        const static uint8_t LEGACY_SLOT_SIZE = 16;
+
+        // Revision 2 settings are the same as the current ones, up to wifiEnabled
+        const static uint8_t LEGACY_SETTINGS_SIZE = offsetof(Settings, tempDeadband);
+
+    private:
+        struct Record
+        {
+            uint16_t sequence;
+            Settings settings;
+            uint16_t crc;       // Of everything before it
+        };
+        static_assert(sizeof(Record) <= SLOT_SIZE, "Settings do not fit in a journal slot");
+
+        // As the ATmega328 wrote it, with no padding
+        struct LegacyRecord
+        {
+            uint16_t sequence;
+            uint8_t settings[LEGACY_SETTINGS_SIZE];
+            uint16_t crc;       // Of everything before it
+        } __attribute__((packed));
+        static_assert(sizeof(LegacyRecord) <= LEGACY_SLOT_SIZE, "Legacy record does not fit its slot");
+
+        Settings* pSettings_;
+        uint16_t address_;
+        uint8_t numSlots_;
+        uint32_t quietTics_;
+        TicSource getTics_;
+
+        Settings saved_;        // Settings in the newest record
+        Settings latest_;       // Settings when last checked
+        bool dirty_;            // Latest differs from saved
+        uint32_t changeTic_;    // When the settings last changed
+
+        Record pending_;        // Record being written
+        uint8_t writeIndex_;    // Next byte of the pending record to write
+
+        uint8_t slot_;          // Slot of the newest record
+        uint16_t sequence_;     // Sequence number of the newest record
+        uint16_t recordsSaved_;
+        uint32_t bytesWritten_;
+
+        uint16_t getSlotAddress(uint8_t slot){ return address_ + ((uint16_t)slot * SLOT_SIZE); }
+        static uint16_t getCrc(const void* pRecord, uint8_t length);
+
+        /**
+         * Load the newest valid record of a journal in the legacy slot size
+         * @return  True if there was one
+         */
+        bool loadLegacy();
+        void startSave();
+        void writeNext();
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "stackMonitor/StackMonitor.hpp"
+#include "utilities/print/Print.hpp"
+#include "ProbeStrings.hpp"
+#include "config.hpp"
+
+#include <avr/io.h>
+
+// From the linker, the first byte after the static data, and the top of the stack
+extern uint8_t _end;
+extern uint8_t __stack;
+
+const static uint8_t PAINT = 0xc5;
+
+/**
+ * Runs from the startup code after the stack pointer is set up, before the static data is
+ * initialized and before main. Nothing has been pushed yet, so the whole region can be painted
+ */
+extern "C" void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack()
+{
+    for (uint8_t* p = &_end; p <= &__stack; p++)
+    {
+        *p = PAINT;
+    }
+}
+
+/**
+ * Count the painted bytes above the static data, stopping at limit
+ */
+static uint16_t countPaint(uint16_t limit)
+{
+    const uint8_t* p = &_end;
+    while ((p <= &__stack) && (*p == PAINT) && ((uint16_t)(p - &_end) < limit))
+    {
+        p++;
+    }
+
+    return p - &_end;
+}
+
+uint16_t StackMonitor::getStaticSize()
+{
+    return (uint16_t)&_end - RAMSTART;
+}
+
+uint16_t StackMonitor::getFree()
+{
+    // The stack pointer points at the next byte to be pushed
+    return SP - (uint16_t)&_end + 1;
+}
+
+uint16_t StackMonitor::getMinFree()
+{
+    return countPaint(UINT16_MAX);
+}
+
+#ifdef STACK_WARNING
+
+// Kept through a watchdog reset, the check is the complement so garbage from power on is ignored
+static uint16_t lowWater __attribute__((section(".noinit")));
+static uint16_t lowWaterCheck __attribute__((section(".noinit")));
+
+static uint16_t warnedFree = UINT16_MAX;
+
+void StackMonitor::check()
+{
+    // Only the bytes under the threshold need looking at, so this stays quick
+    uint16_t minFree = countPaint(STACK_WARNING_BYTES);
+    if ((minFree >= STACK_WARNING_BYTES) || (minFree >= warnedFree))
+    {
+        return;
+    }
+
+    warnedFree = minFree;
+    lowWater = minFree;
+    lowWaterCheck = ~minFree;
+    PRINTLN_P("Stack low, %u bytes left", minFree);
+}
+
+void StackMonitor::reportReset()
+{
+    if (lowWaterCheck == (uint16_t)~lowWater)
+    {
+        PRINTLN_P("Stack was down to %u bytes", lowWater);
+    }
+
+    // Only report it once
+    lowWaterCheck = lowWater;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef STACK_MONITOR_HPP
+#define STACK_MONITOR_HPP
+
+#include <stdint.h>
+
+/**
+ * SRAM headroom, for sizing buffers from measurements instead of guesses.
+ *
+ * Everything between the static data (.data, .bss and .noinit) and the top of the stack is
+ * painted with a known pattern before main runs. Nothing uses the heap, so that space is only
+ * ever used by the stack, and the lowest point it has reached is where the paint stops
+ */
+namespace StackMonitor
+{
+    /**
+     * Get the SRAM taken by static data
+     * @return  Bytes of .data, .bss and .noinit
+     */
+    uint16_t getStaticSize();
+
+    /**
+     * Get the bytes between the static data and the stack pointer right now
+     */
+    uint16_t getFree();
+
+    /**
+     * Get the fewest bytes there have been between the static data and the stack, since boot
+     */
+    uint16_t getMinFree();
+
+#ifdef STACK_WARNING
+    /**
+     * Log a warning when the stack first comes within STACK_WARNING_BYTES of the static data,
+     * and each time it gets closer after that. Cheap enough to call alongside feeding the watchdog
+     */
+    void check();
+
+    /**
+     * Log how low the stack got before the last reset, if check() warned about it
+     */
+    void reportReset();
+#endif
+}
+
+#endif
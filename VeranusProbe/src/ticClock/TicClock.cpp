@@ -0,0 +1,117 @@
+#include "ticClock/TicClock.hpp"
+#include "config.hpp"
+
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+static volatile uint32_t ticCount = 0;
+
+// Only there to wake us, see sleepUntilInterrupt()
+EMPTY_INTERRUPT(TIMER2_COMPB_vect);
+
+// Time spent asleep, in whole tics plus the timer counts left over
+static uint32_t sleepTics = 0;
+static uint8_t sleepCounts = 0;
+
+// Start of the window sleep residency is reported over
+static uint32_t residencyStartTic = 0;
+static uint32_t residencyStartSleep = 0;
+
+void TicClock::onTic()
+{
+    ticCount++;
+}
+
+uint32_t TicClock::getTicCount()
+{
+    uint32_t tics;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tics = ticCount;
+    }
+    return tics;
+}
+
+uint32_t TicClock::getTimerCounts()
+{
+    uint32_t tics;
+    uint8_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tics = ticCount;
+        count = TCNT2;
+
+        // The timer may have just wrapped, before its interrupt had a chance to count the tic
+        if ((TIFR2 & _BV(OCF2A)) && (count < (COUNTS_PER_TIC / 2))) tics++;
+    }
+
+    return (tics * COUNTS_PER_TIC) + count;
+}
+
+void TicClock::sleepUntilInterrupt(uint32_t lastTic, uint32_t wakeAt, uint8_t sleepMode)
+{
+    cli();
+
+    // Do not sleep through a tic that has not been handled yet
+    // A pending tic interrupt would wake us straight away anyway
+    if ((ticCount != lastTic) || (TIFR2 & _BV(OCF2A)))
+    {
+        sei();
+        return;
+    }
+
+    uint8_t count = TCNT2;
+    uint32_t start = (lastTic * COUNTS_PER_TIC) + count;
+
+    // A count away or less, and the match could be missed while setting it up
+    int32_t untilWake = (int32_t)(wakeAt - start);
+    if (untilWake <= 1)
+    {
+        sei();
+        return;
+    }
+
+    // Due before the next tic, so have compare B wake us then
+    if (untilWake < (int32_t)(COUNTS_PER_TIC - count))
+    {
+        OCR2B = count + untilWake;
+        TIFR2 = _BV(OCF2B);
+        TIMSK2 |= _BV(OCIE2B);
+    }
+
+    set_sleep_mode(sleepMode);
+    sleep_enable();
+    sei();          // Takes effect after the next instruction, so the wake up cannot be missed
+    sleep_cpu();
+    sleep_disable();
+    TIMSK2 &= ~_BV(OCIE2B);
+
+    // The interrupt that woke us has been handled, add how long we slept
+    uint32_t elapsed = getTimerCounts() - start;
+    elapsed += sleepCounts;
+    sleepTics += elapsed / COUNTS_PER_TIC;
+    sleepCounts = elapsed % COUNTS_PER_TIC;
+}
+
+uint8_t TicClock::takeSleepResidency(uint32_t& windowTics)
+{
+    uint32_t now = getTicCount();
+    uint32_t slept = sleepTics - residencyStartSleep;
+    windowTics = now - residencyStartTic;
+
+    residencyStartTic = now;
+    residencyStartSleep = sleepTics;
+
+    // Scale down long windows so the percentage does not overflow
+    uint32_t elapsed = windowTics;
+    while (elapsed > (UINT32_MAX / 100))
+    {
+        elapsed >>= 1;
+        slept >>= 1;
+    }
+
+    if (elapsed == 0) return 0;
+    return (slept * 100) / elapsed;
+}
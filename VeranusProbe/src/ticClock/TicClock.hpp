@@ -0,0 +1,51 @@
+#ifndef TIC_CLOCK_HPP
+#define TIC_CLOCK_HPP
+
+#include <stdint.h>
+
+/**
+ * The probe's sense of time, from Timer 2 running in CTC mode with a period of one tic
+ * (COUNTS_PER_TIC counts of 64us), and sleeping until the next interrupt once nothing is due.
+ * Tasks fall due part way through a tic, so Timer 2's compare B wakes us for one that is due
+ * before the next tic.
+ *
+ * Kept apart from devices.cpp so the sleep can be checked against a simulated Timer 2,
+ * see tools/sleep_sim
+ */
+namespace TicClock
+{
+    /**
+     * Count a tic, called from the Timer 2 compare interrupt
+     */
+    void onTic();
+
+    /**
+     * Tics counted since boot
+     */
+    uint32_t getTicCount();
+
+    /**
+     * Time since boot in timer counts, wraps after about 76 hours
+     */
+    uint32_t getTimerCounts();
+
+    /**
+     * Put the CPU to sleep until the next interrupt, at the latest the next tic or wakeAt
+     * @param   lastTic     Tic count when the caller last checked for work. If a tic has
+     *                      happened since, returns straight away instead of sleeping
+     * @param   wakeAt      Timer counts when the next task is due. If that is too close to sleep
+     *                      for, returns straight away
+     * @param   sleepMode   SLEEP_MODE_ to sleep in, one that keeps Timer 2 running or that
+     *                      something else is sure to wake
+     */
+    void sleepUntilInterrupt(uint32_t lastTic, uint32_t wakeAt, uint8_t sleepMode);
+
+    /**
+     * Get the percentage of time spent asleep, since the last call
+     * @param   windowTics  Set to the tics since the last call
+     * @return  Percent of that time spent asleep
+     */
+    uint8_t takeSleepResidency(uint32_t& windowTics);
+}
+
+#endif
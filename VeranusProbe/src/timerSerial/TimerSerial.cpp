@@ -0,0 +1,250 @@
+#include "timerSerial/TimerSerial.hpp"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+// Timer 0 runs free at F_CPU / 8, so a bit at 9600 baud is about 208 counts
+const static uint32_t TIMER_CLOCK = F_CPU / 8;
+
+// How far ahead of now the first edge of a frame is put, enough to set up the compare unit
+const static uint8_t TX_START_LEAD = 16;
+
+// Compare A output modes, for the level the TX pin goes to at the next edge
+const static uint8_t TX_HIGH = (1 << COM0A1) | (1 << COM0A0);
+const static uint8_t TX_LOW = (1 << COM0A1);
+const static uint8_t TX_MODE_MASK = (1 << COM0A1) | (1 << COM0A0);
+
+// The start bit pulls AIN1 below the bandgap, which is a rising edge on the comparator output
+const static uint8_t RX_COMPARATOR = (1 << ACBG) | (1 << ACIS1) | (1 << ACIS0);
+
+// Hands the interrupts to the port, there is only one Timer 0
+static TimerSerial* pActiveSerial = nullptr;
+
+ISR(TIMER0_COMPA_vect)
+{
+    pActiveSerial->onTxEdge();
+}
+
+ISR(TIMER0_COMPB_vect)
+{
+    pActiveSerial->onRxSample();
+}
+
+ISR(ANALOG_COMP_vect)
+{
+    pActiveSerial->onRxStart();
+}
+
+TimerSerial::TimerSerial(uint32_t baudRate,
+                         uint8_t* txBuffer,
+                         uint8_t txBufferLen,
+                         uint8_t* rxBuffer,
+                         uint8_t rxBufferLen):
+    bitTime_(((TIMER_CLOCK << 8) + (baudRate / 2)) / baudRate),
+    txBuffer_(txBuffer),
+    txBufferLen_(txBufferLen),
+    txHead_(0),
+    txCount_(0),
+    txActive_(false),
+    txIdle_(false),
+    txFrame_(0),
+    txBits_(0),
+    txTime_(0),
+    rxBuffer_(rxBuffer),
+    rxBufferLen_(rxBufferLen),
+    rxHead_(0),
+    rxCount_(0),
+    rxByte_(0),
+    rxBits_(0),
+    rxTime_(0),
+    rxErrors_(0)
+{
+}
+
+void TimerSerial::initialize()
+{
+    pActiveSerial = this;
+
+    // TX idles high, RX is an input without a pull up
+    PORTD |= (1 << PORTD6);
+    DDRD |= (1 << DDD6);
+    DDRD &= ~(1 << DDD7);
+
+    // Normal mode with compare A driving TX, and the line forced high to start with.
+    // Compare B only interrupts, PD5 (OC0B) belongs to the LCD
+    TIMSK0 = 0;
+    TCCR0A = TX_HIGH;
+    TCCR0B = (1 << CS01);
+    TCCR0B |= (1 << FOC0A);
+
+    // The comparator compares against AIN1, not the ADC multiplexer
+    ADCSRB &= ~(1 << ACME);
+    armRxStart();
+}
+
+void TimerSerial::write(const char* data, uint16_t length)
+{
+    for (uint16_t i=0; i<length; i++)
+    {
+        // Only waits if more is written than the buffer holds
+        while (txCount_ >= txBufferLen_);
+
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+        {
+            txBuffer_[(txHead_ + txCount_) % txBufferLen_] = data[i];
+            txCount_++;
+            if (!txActive_) startTx();
+        }
+    }
+}
+
+uint16_t TimerSerial::read(char* buffer, uint16_t length)
+{
+    uint16_t numRead = 0;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        while ((numRead < length) && (rxCount_ > 0))
+        {
+            buffer[numRead++] = rxBuffer_[rxHead_];
+            rxHead_ = (rxHead_ + 1) % rxBufferLen_;
+            rxCount_--;
+        }
+    }
+    return numRead;
+}
+
+bool TimerSerial::isDataAvailable()
+{
+    return rxCount_ > 0;
+}
+
+void TimerSerial::flush()
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        rxHead_ = 0;
+        rxCount_ = 0;
+    }
+}
+
+bool TimerSerial::loadTxFrame()
+{
+    if (txCount_ == 0) return false;
+
+    // Start bit low, data LSB first, stop bit high
+    txFrame_ = ((uint16_t)txBuffer_[txHead_] << 1) | (1 << (FRAME_BITS - 1));
+    txBits_ = FRAME_BITS;
+    txHead_ = (txHead_ + 1) % txBufferLen_;
+    txCount_--;
+    return true;
+}
+
+void TimerSerial::scheduleTxLevel(bool high)
+{
+    TCCR0A = (TCCR0A & ~TX_MODE_MASK) | (high ? TX_HIGH : TX_LOW);
+    txTime_ += bitTime_;
+    OCR0A = txTime_ >> 8;
+}
+
+void TimerSerial::startTx()
+{
+    loadTxFrame();
+    txActive_ = true;
+    txIdle_ = false;
+
+    // The first edge is a little way off, the rest follow a bit apart
+    txTime_ = ((uint16_t)(uint8_t)(TCNT0 + TX_START_LEAD) << 8) - bitTime_;
+    scheduleTxLevel(false);
+    txFrame_ >>= 1;
+    txBits_--;
+
+    TIFR0 = (1 << OCF0A);
+    TIMSK0 |= (1 << OCIE0A);
+}
+
+void TimerSerial::onTxEdge()
+{
+    // An edge has just gone out, set up the one after it
+    if ((txBits_ == 0) && !loadTxFrame())
+    {
+        if (txIdle_)
+        {
+            // The last stop bit has had its full time
+            TIMSK0 &= ~(1 << OCIE0A);
+            txActive_ = false;
+            return;
+        }
+
+        // Hold the line high until the stop bit is over, before anything else can start
+        txIdle_ = true;
+        scheduleTxLevel(true);
+        return;
+    }
+
+    txIdle_ = false;
+    scheduleTxLevel(txFrame_ & 1);
+    txFrame_ >>= 1;
+    txBits_--;
+}
+
+void TimerSerial::armRxStart()
+{
+    // Writing ACI clears an edge left over from the last byte's data bits
+    ACSR = RX_COMPARATOR | (1 << ACI) | (1 << ACIE);
+}
+
+void TimerSerial::onRxStart()
+{
+    // Sample half a bit after the edge, to check it is a start bit and not a glitch
+    uint8_t now = TCNT0;
+    ACSR = RX_COMPARATOR;
+
+    rxTime_ = ((uint16_t)now << 8) + (bitTime_ >> 1);
+    OCR0B = rxTime_ >> 8;
+    rxBits_ = 0;
+
+    TIFR0 = (1 << OCF0B);
+    TIMSK0 |= (1 << OCIE0B);
+}
+
+void TimerSerial::onRxSample()
+{
+    bool high = PIND & (1 << PIND7);
+    rxTime_ += bitTime_;
+    OCR0B = rxTime_ >> 8;
+
+    if (rxBits_ == 0)
+    {
+        if (high)
+        {
+            // Too short for a start bit
+            TIMSK0 &= ~(1 << OCIE0B);
+            armRxStart();
+            return;
+        }
+    }
+    else if (rxBits_ < (FRAME_BITS - 1))
+    {
+        rxByte_ >>= 1;
+        if (high) rxByte_ |= 0x80;
+    }
+    else
+    {
+        // Middle of the stop bit, the next start bit cannot come before the end of it
+        TIMSK0 &= ~(1 << OCIE0B);
+        if (high && (rxCount_ < rxBufferLen_))
+        {
+            rxBuffer_[(rxHead_ + rxCount_) % rxBufferLen_] = rxByte_;
+            rxCount_++;
+        }
+        else
+        {
+            rxErrors_++;
+        }
+        armRxStart();
+        return;
+    }
+
+    rxBits_++;
+}
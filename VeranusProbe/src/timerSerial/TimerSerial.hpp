@@ -0,0 +1,102 @@
+#ifndef TIMER_SERIAL_HPP
+#define TIMER_SERIAL_HPP
+
+#include "drivers/serial/ISerial.hpp"
+
+#include <stdint.h>
+
+/**
+ * Full duplex software serial port for the wifi module, clocked by Timer 0 so it never waits.
+ *
+ * TX is on PD6 (OC0A). Timer 0 compare A sets or clears the pin in hardware at each bit edge,
+ * and its interrupt only has to pick the level for the next one, so interrupt latency does not
+ * move the edges. RX is on PD7 (AIN1). The falling edge of a start bit trips the analog
+ * comparator against the bandgap, then Timer 0 compare B samples the middle of each bit.
+ * The pin change interrupts are left to the Dio driver.
+ *
+ * Bytes are queued in ring buffers both ways. write() only waits if the TX buffer fills, so it
+ * should be sized for the longest message
+ */
+class TimerSerial: public SerialComm::ISerial
+{
+    public:
+        /**
+         * @param   baudRate    Bits per second, 7813 to 62500 at 16MHz
+         * @param   txBuffer    Bytes waiting to be sent
+         * @param   rxBuffer    Bytes received and not read yet
+         */
+        TimerSerial(uint32_t baudRate,
+                    uint8_t* txBuffer,
+                    uint8_t txBufferLen,
+                    uint8_t* rxBuffer,
+                    uint8_t rxBufferLen);
+        ~TimerSerial(){}
+
+        /**
+         * Take over the pins, Timer 0, and the analog comparator
+         */
+        void initialize();
+
+        void write(const char* data, uint16_t length);
+        uint16_t read(char* buffer, uint16_t length);
+        bool isDataAvailable();
+
+        /**
+         * Drop everything received and not read yet
+         */
+        void flush();
+
+        /**
+         * Get the bytes dropped because the RX buffer was full, or had no stop bit
+         */
+        uint16_t getRxErrors(){ return rxErrors_; }
+
+        // Called from the Timer 0 and analog comparator interrupts
+        void onTxEdge();
+        void onRxSample();
+        void onRxStart();
+
+    private:
+        const static uint8_t FRAME_BITS = 10;   // Start, 8 data, stop
+
+        uint16_t bitTime_;      // Timer counts per bit, as Q8
+
+        uint8_t* txBuffer_;
+        uint8_t txBufferLen_;
+        volatile uint8_t txHead_;
+        volatile uint8_t txCount_;
+        volatile bool txActive_;
+        bool txIdle_;           // Holding the line high to finish the last stop bit
+        uint16_t txFrame_;      // Levels still to go out, LSB first
+        uint8_t txBits_;
+        uint16_t txTime_;       // Time of the next edge, as Q8 timer counts
+
+        uint8_t* rxBuffer_;
+        uint8_t rxBufferLen_;
+        volatile uint8_t rxHead_;
+        volatile uint8_t rxCount_;
+        uint8_t rxByte_;
+        uint8_t rxBits_;
+        uint16_t rxTime_;       // Time of the next sample, as Q8 timer counts
+        volatile uint16_t rxErrors_;
+
+        /**
+         * Start sending if the TX buffer has something in it and nothing is going out
+         */
+        void startTx();
+
+        /**
+         * Take the next byte from the TX buffer
+         * @return  False if it was empty
+         */
+        bool loadTxFrame();
+
+        /**
+         * Set the compare unit up for the next TX edge, a bit after the last
+         */
+        void scheduleTxLevel(bool high);
+
+        void armRxStart();
+};
+
+#endif
@@ -0,0 +1,200 @@
+#include "twiQueue/TwiQueue.hpp"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+using namespace Twi;
+
+// Bus states in TWSR, with the prescaler bits masked off
+const static uint8_t TW_START = 0x08;
+const static uint8_t TW_REP_START = 0x10;
+const static uint8_t TW_MT_SLA_ACK = 0x18;
+const static uint8_t TW_MT_SLA_NACK = 0x20;
+const static uint8_t TW_MT_DATA_ACK = 0x28;
+const static uint8_t TW_MT_DATA_NACK = 0x30;
+const static uint8_t TW_ARB_LOST = 0x38;
+const static uint8_t TW_MR_SLA_ACK = 0x40;
+const static uint8_t TW_MR_SLA_NACK = 0x48;
+const static uint8_t TW_MR_DATA_ACK = 0x50;
+const static uint8_t TW_MR_DATA_NACK = 0x58;
+const static uint8_t TW_STATUS_MASK = 0xf8;
+
+const static uint8_t TW_READ = 1;
+
+// Hands the interrupt to the step function, there is only one TWI
+static TwiQueue* pActiveQueue = nullptr;
+
+ISR(TWI_vect)
+{
+    if (pActiveQueue != nullptr) pActiveQueue->onInterrupt();
+}
+
+// Clear the interrupt flag to let the TWI do its next step
+const static uint8_t TWI_NEXT = (1 << TWINT) | (1 << TWEN) | (1 << TWIE);
+
+TwiQueue::TwiQueue(uint32_t bitRate, TimeSource getTime, uint32_t timeout):
+    bitRate_(bitRate),
+    getTime_(getTime),
+    timeout_(timeout),
+    head_(0),
+    length_(0),
+    startTime_(0)
+{
+}
+
+void TwiQueue::initialize()
+{
+    // No prescaler, SCL = F_CPU / (16 + 2 * TWBR)
+    TWSR = 0;
+    TWBR = ((F_CPU / bitRate_) - 16) / 2;
+
+    pActiveQueue = this;
+    TWCR = (1 << TWEN);
+}
+
+bool TwiQueue::submit(Transaction* pTransaction)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        if ((length_ >= QUEUE_LENGTH) ||
+            (pTransaction->status == Status::QUEUED) ||
+            (pTransaction->status == Status::ACTIVE))
+        {
+            return false;
+        }
+
+        queue_[(head_ + length_) % QUEUE_LENGTH] = pTransaction;
+        pTransaction->status = Status::QUEUED;
+        length_++;
+
+        // The bus was idle, so start this one now
+        if (length_ == 1) startNext(0);
+    }
+
+    return true;
+}
+
+Status TwiQueue::getStatus(Transaction* pTransaction)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        // Whatever is on the bus holds up everything queued behind it, so that is what times out
+        if ((length_ > 0) && ((getTime_() - startTime_) > timeout_))
+        {
+            // Turning the TWI off lets go of the bus, whatever state it was left in
+            TWCR = 0;
+            TWCR = (1 << TWEN);
+
+            queue_[head_]->status = Status::FAILED;
+            head_ = (head_ + 1) % QUEUE_LENGTH;
+            length_--;
+            startNext(0);
+        }
+    }
+
+    return pTransaction->status;
+}
+
+void TwiQueue::startNext(uint8_t control)
+{
+    // A stop still going out is kept, the start follows it
+    control |= TWCR & (1 << TWSTO);
+
+    if (length_ == 0)
+    {
+        TWCR = (1 << TWINT) | (1 << TWEN) | control;
+        return;
+    }
+
+    Transaction* pTransaction = queue_[head_];
+    pTransaction->status = Status::ACTIVE;
+    pTransaction->count = 0;
+    startTime_ = getTime_();
+    TWCR = TWI_NEXT | (1 << TWSTA) | control;
+}
+
+void TwiQueue::finish(Status status)
+{
+    queue_[head_]->status = status;
+    head_ = (head_ + 1) % QUEUE_LENGTH;
+    length_--;
+    startNext(1 << TWSTO);
+}
+
+void TwiQueue::onInterrupt()
+{
+    uint8_t state = TWSR & TW_STATUS_MASK;
+    if (length_ == 0)
+    {
+        // Nothing on the bus, should not happen
+        TWCR = (1 << TWINT) | (1 << TWEN) | (1 << TWSTO);
+        return;
+    }
+
+    Transaction* pTransaction = queue_[head_];
+    switch (state)
+    {
+        case TW_START:
+            if (pTransaction->writeLength > 0)
+            {
+                TWDR = pTransaction->address << 1;
+                TWCR = TWI_NEXT;
+                break;
+            }
+            // Fall through - read only
+        case TW_REP_START:
+            pTransaction->count = 0;
+            TWDR = (pTransaction->address << 1) | TW_READ;
+            TWCR = TWI_NEXT;
+            break;
+
+        case TW_MT_DATA_ACK:
+            pTransaction->count++;
+            // Fall through
+        case TW_MT_SLA_ACK:
+            if (pTransaction->count < pTransaction->writeLength)
+            {
+                TWDR = pTransaction->pWrite[pTransaction->count];
+                TWCR = TWI_NEXT;
+            }
+            else if (pTransaction->readLength > 0)
+            {
+                TWCR = TWI_NEXT | (1 << TWSTA);
+            }
+            else
+            {
+                finish(Status::DONE);
+            }
+            break;
+
+        case TW_MR_DATA_ACK:
+            pTransaction->pRead[pTransaction->count++] = TWDR;
+            // Fall through
+        case TW_MR_SLA_ACK:
+            // Acknowledge every byte but the last, which tells the slave to stop sending
+            if ((pTransaction->count + 1) < pTransaction->readLength)
+            {
+                TWCR = TWI_NEXT | (1 << TWEA);
+            }
+            else
+            {
+                TWCR = TWI_NEXT;
+            }
+            break;
+
+        case TW_MR_DATA_NACK:
+            pTransaction->pRead[pTransaction->count++] = TWDR;
+            finish(Status::DONE);
+            break;
+
+        case TW_MT_SLA_NACK:
+        case TW_MT_DATA_NACK:
+        case TW_MR_SLA_NACK:
+        case TW_ARB_LOST:
+        default:
+            // Includes bus errors, which a stop recovers from
+            finish(Status::FAILED);
+            break;
+    }
+}
@@ -0,0 +1,99 @@
+#ifndef TWI_QUEUE_HPP
+#define TWI_QUEUE_HPP
+
+#include <stdint.h>
+
+/**
+ * I2C master that runs a queue of transactions from the TWI interrupt, so nothing waits on the bus.
+ *
+ * Each transaction writes some bytes, then reads some with a repeated start, either of which may
+ * be empty. Callers own their transactions, submit them, and check back on their status later.
+ * A transaction that takes longer than the timeout (a slave holding the bus, or no pull ups) is
+ * failed, and the TWI reset, the next time anything checks on it.
+ */
+namespace Twi
+{
+    /**
+     * Returns a free running time, wrapping at 32 bits
+     */
+    typedef uint32_t (*TimeSource)();
+
+    enum class Status: uint8_t
+    {
+        IDLE = 0,   // Not submitted yet
+        QUEUED,     // Waiting for the bus
+        ACTIVE,     // On the bus now
+        DONE,
+        FAILED      // Not acknowledged, lost the bus, or timed out
+    };
+
+    struct Transaction
+    {
+        uint8_t address;            // 7 bit slave address
+        const uint8_t* pWrite;
+        uint8_t writeLength;
+        uint8_t* pRead;
+        uint8_t readLength;
+
+        volatile Status status;
+        volatile uint8_t count;     // Bytes moved in the current direction
+    };
+
+    class TwiQueue
+    {
+        public:
+            /**
+             * @param   bitRate     SCL frequency in Hz, 400000 for fast mode if every device on
+             *                      the bus supports it
+             * @param   getTime     Time source the timeout is measured in
+             * @param   timeout     Longest a transaction may be on the bus, in time source units
+             */
+            TwiQueue(uint32_t bitRate, TimeSource getTime, uint32_t timeout);
+            ~TwiQueue(){}
+
+            void initialize();
+
+            /**
+             * Queue a transaction to run once the bus is free
+             * @return  False if the queue is full, or the transaction is already queued
+             */
+            bool submit(Transaction* pTransaction);
+
+            /**
+             * Get where a transaction is up to, first failing the active transaction if it
+             * has timed out, whichever transaction is asked about
+             */
+            Status getStatus(Transaction* pTransaction);
+
+            /**
+             * Step the transaction on the bus, called from the TWI interrupt
+             */
+            void onInterrupt();
+
+        private:
+            const static uint8_t QUEUE_LENGTH = 4;
+
+            uint32_t bitRate_;
+            TimeSource getTime_;
+            uint32_t timeout_;
+
+            Transaction* volatile queue_[QUEUE_LENGTH];
+            volatile uint8_t head_;         // Active transaction, or the next to start
+            volatile uint8_t length_;
+            volatile uint32_t startTime_;   // When the active transaction was started
+
+            /**
+             * Start the transaction at the head of the queue if there is one, must be called
+             * with interrupts disabled
+             * @param   control     Extra TWCR bits, for a stop to send first
+             */
+            void startNext(uint8_t control);
+
+            /**
+             * Finish the active transaction with a stop, and move on to the next
+             */
+            void finish(Status status);
+    };
+}
+
+#endif
@@ -1,24 +1,16 @@
 #include "VeranusDisplay.hpp"
 #include "drivers/assert/Assert.hpp"
 #include "utilities/strings/Strings.hpp"
-#include "utilities/Conversions.hpp"
 #include "Settings.hpp"
+#include "ProbeStrings.hpp"
+#include "VeranusProtocol.hpp"
+#include "config.hpp"
+
+#include <avr/pgmspace.h>
 
 using namespace Lcd;
 using namespace Strings;
 
-// Text for temperature and humidity labels
-const static char* TEMP_TEXT =  "T:";
-const static uint8_t TEMP_TEXT_LEN = strlen(TEMP_TEXT);
-
-const static char* HUMID_TEXT = "H:";
-const static uint8_t HUMID_TEXT_LEN = strlen(HUMID_TEXT);
-
-const static char* TEMP_UNIT_F = "F";
-const static char* TEMP_UNIT_C = "C";
-const static char* HUMID_UNIT = "%";
-const static uint8_t UNIT_LEN = 1;
-
 const static uint8_t DEGREE_CHAR_CODE = 0xDF;
 
 // Indexes for text location
@@ -35,15 +27,82 @@ const static uint8_t DEGREE_INDEX = 6;
 const static uint8_t TEMP_VALUE_LEN = 4;
 const static uint8_t HUMID_VALUE_LEN = 3;
 static char stringBuffer[TEMP_VALUE_LEN + 1];
-static char displayBuffer[TEMP_VALUE_LEN];
+
+// Moving the cursor costs as much as writing a character, so rewriting up to this many
+// unchanged characters is no worse than skipping over them
+const static uint8_t MAX_RUN_GAP = 1;
+
+/*
+ * Backlight curve, brightness as a fraction of 255 for each of 256 steps between the
+ * min and max light scales. Follows a gamma of 2.25 (x^2 * x^(1/4), close to the usual 2.2
+ * and cheap to build at compile time), so steps in dim light are small
+ */
+const static uint16_t CURVE_STEPS = 256;
+const static uint8_t CURVE_MAX = 255;
+
+constexpr float sqrtIterate(float x, float guess, uint8_t n)
+{
+    return (n == 0) ? guess : sqrtIterate(x, (guess + (x / guess)) / 2, n - 1);
+}
+
+constexpr float sqrtNewton(float x)
+{
+    return (x <= 0) ? 0 : sqrtIterate(x, (x + 1) / 2, 8);
+}
+
+constexpr uint8_t curveEntry(uint16_t step)
+{
+    return (uint8_t)((CURVE_MAX *
+                      ((float)step / CURVE_MAX) *
+                      ((float)step / CURVE_MAX) *
+                      sqrtNewton(sqrtNewton((float)step / CURVE_MAX))) + 0.5f);
+}
+
+#define CURVE_ENTRIES_4(n) curveEntry(n), curveEntry(n + 1), curveEntry(n + 2), curveEntry(n + 3)
+#define CURVE_ENTRIES_16(n) CURVE_ENTRIES_4(n), CURVE_ENTRIES_4(n + 4), CURVE_ENTRIES_4(n + 8), CURVE_ENTRIES_4(n + 12)
+#define CURVE_ENTRIES_64(n) CURVE_ENTRIES_16(n), CURVE_ENTRIES_16(n + 16), CURVE_ENTRIES_16(n + 32), CURVE_ENTRIES_16(n + 48)
+
+const static uint8_t BRIGHTNESS_CURVE[CURVE_STEPS] PROGMEM =
+{
+    CURVE_ENTRIES_64(0),
+    CURVE_ENTRIES_64(64),
+    CURVE_ENTRIES_64(128),
+    CURVE_ENTRIES_64(192)
+};
+
+static_assert(curveEntry(0) == 0, "Curve must start dark");
+static_assert(curveEntry(CURVE_MAX) == CURVE_MAX, "Curve must end at full brightness");
+
+// Light levels, in hundredths, mapped to the start and end of the curve
+const static int32_t LIGHT_SCALE_MIN = (int32_t)MIN_LIGHT_SCALE * Protocol::FIXED_SCALE;
+const static int32_t LIGHT_SCALE_MAX = (int32_t)MAX_LIGHT_SCALE * Protocol::FIXED_SCALE;
+
+// Light has to move this many steps along the curve (about 3%) before the backlight follows
+const static uint8_t LIGHT_HYSTERESIS = 8;
+const static uint16_t NO_LIGHT_INDEX = 0xffff;
+
+// Backlight changes by one percent each tic while fading
+const static uint8_t FADE_STEP = 1;
+
+// Rounds hundredths to the nearest whole value
+static int32_t roundFixed(int32_t value)
+{
+    int32_t half = (value < 0) ? -(Protocol::FIXED_SCALE / 2) : (Protocol::FIXED_SCALE / 2);
+    return (value + half) / Protocol::FIXED_SCALE;
+}
 
 VeranusDisplay::VeranusDisplay(Lcd::ILcd* pLcd, Pwm::IPwm* pBrigthnessPwm):
     pLcd_(pLcd),
     pBrigthnessPwm_(pBrigthnessPwm),
-    temperature_(0),
+    temperatureF_(0),
     humidity_(0),
+    isCelsius_(false),
     brightness_(100),
-    isCelsius_(false)
+    targetBrightness_(100),
+    light_(0),
+    lightIndex_(NO_LIGHT_INDEX),
+    cursorRow_(0),
+    cursorCol_(0)
 {
     assert(pLcd_ != nullptr);
     stringBuffer[TEMP_VALUE_LEN] = '\0';
@@ -56,88 +115,63 @@ VeranusDisplay::~VeranusDisplay()
 
 bool VeranusDisplay::setup()
 {
+    // Initializing leaves the LCD blank with the cursor at the start
     pLcd_->initialize();
+    for (uint8_t row=0; row<NUM_ROWS; row++)
+    {
+        for (uint8_t col=0; col<NUM_COLS; col++)
+        {
+            frame_[row][col] = ' ';
+            glass_[row][col] = ' ';
+        }
+    }
+    cursorRow_ = 0;
+    cursorCol_ = 0;
 
-    // Temperature label
-    pLcd_->display(TEMP_TEXT, TEMP_TEXT_LEN);
-
-    // Degree symbol
-    pLcd_->setCursor(TEMP_ROW, DEGREE_INDEX);
-    pLcd_->display(DEGREE_CHAR_CODE);
-
-    // Temperature unit
-    pLcd_->display(TEMP_UNIT_F, UNIT_LEN);
+    // Temperature label, degree symbol, and unit
+    drawString(TEMP_ROW, 0, ProbeStrings::TEMP_LABEL);
+    frame_[TEMP_ROW][DEGREE_INDEX] = (char)DEGREE_CHAR_CODE;
+    drawString(TEMP_ROW, TEMP_UNIT_INDEX, isCelsius_ ? ProbeStrings::UNIT_C : ProbeStrings::UNIT_F);
 
-    // Humidity label
-    pLcd_->setCursor(HUMID_ROW, 0);
-    pLcd_->display(HUMID_TEXT, HUMID_TEXT_LEN);
+    // Humidity label and unit
+    drawString(HUMID_ROW, 0, ProbeStrings::HUMID_LABEL);
+    drawString(HUMID_ROW, HUMID_UNIT_INDEX, ProbeStrings::UNIT_PERCENT);
 
-    // Humidity unit
-    pLcd_->setCursor(HUMID_ROW, HUMID_UNIT_INDEX);
-    pLcd_->display(HUMID_UNIT, UNIT_LEN);
+    flush();
 
     // Turn on the backlight
     if (pBrigthnessPwm_ != nullptr)
     {
+        targetBrightness_ = settings.staticLight;
         brightness_ = settings.staticLight;
         pBrigthnessPwm_->setDutyCycle(brightness_);
         pBrigthnessPwm_->enable();
     }
     else
     {
+        targetBrightness_ = 100;
         brightness_ = 100;
     }
 
     return true;
 }
 
-bool VeranusDisplay::update(float temperatureF, float humidity)
+bool VeranusDisplay::update(int16_t temperatureF, uint16_t humidity)
 {
-    float temperature = temperatureF;
+    temperatureF_ = temperatureF;
+    humidity_ = humidity;
+
+    int32_t temperature = temperatureF;
     if (isCelsius_)
     {
-        temperature = degreesFToC(temperatureF);
+        temperature = ((temperature - (32 * Protocol::FIXED_SCALE)) * 5) / 9;
     }
 
     // Round to nearest whole value
-    temperature = round(temperature);
-    humidity = round(humidity);
-
-    if (temperature_ != temperature)
-    {
-        temperature_ = temperature;
-        clearDisplayBuffer();
-
-        // Fill display buffer with string representation of temperature
-        // Right align
-        int2str(temperature, stringBuffer, TEMP_VALUE_LEN);
-        uint8_t tempStrLen = strlen(stringBuffer);
-        uint8_t offset = TEMP_VALUE_LEN - tempStrLen;
-        copy(&(displayBuffer[offset]), stringBuffer, tempStrLen);
-
-        // Display buffer contents in the temperature slot
-        pLcd_->setCursor(TEMP_ROW, TEMP_VALUE_INDEX);
-        pLcd_->display(displayBuffer, TEMP_VALUE_LEN);
-    }
-
-    if (humidity_ != humidity)
-    {
-        humidity_ = humidity;
-
-        clearDisplayBuffer();
-
-        // Fill display buffer with string representation of humidity
-        // Right align
-        int2str(humidity, stringBuffer, HUMID_VALUE_LEN);
-        uint8_t humidStrLen = strlen(stringBuffer);
-        uint8_t offset = HUMID_VALUE_LEN - humidStrLen;
-        copy(&(displayBuffer[offset]), stringBuffer, humidStrLen);
-
-        // Display buffer contents in humidity slot
-        pLcd_->setCursor(HUMID_ROW, HUMID_VALUE_INDEX);
-        pLcd_->display(displayBuffer, HUMID_VALUE_LEN);
-    }
+    drawValue(TEMP_ROW, TEMP_VALUE_INDEX, roundFixed(temperature), TEMP_VALUE_LEN);
+    drawValue(HUMID_ROW, HUMID_VALUE_INDEX, roundFixed(humidity), HUMID_VALUE_LEN);
 
+    flush();
     return true;
 }
 
@@ -148,42 +182,170 @@ void VeranusDisplay::setTempUnit(bool isCelsius)
 
     isCelsius_ = isCelsius;
 
-    // Update Unit
-    if (isCelsius_)
+    // Update unit, and redraw the last temperature in it
+    drawString(TEMP_ROW, TEMP_UNIT_INDEX, isCelsius_ ? ProbeStrings::UNIT_C : ProbeStrings::UNIT_F);
+    update(temperatureF_, humidity_);
+}
+
+void VeranusDisplay::drawText(uint8_t row, uint8_t col, const char* text, uint8_t length)
+{
+    for (uint8_t i=0; (i < length) && ((col + i) < NUM_COLS); i++)
     {
-        // Swap from F to C
-        pLcd_->setCursor(TEMP_ROW, TEMP_UNIT_INDEX);
-        pLcd_->display(TEMP_UNIT_C, UNIT_LEN);
-        update(temperature_, humidity_);
+        frame_[row][col + i] = text[i];
     }
-    else
+}
+
+void VeranusDisplay::drawString(uint8_t row, uint8_t col, ProbeStrings string)
+{
+    const char* text = getString(string);
+    drawText(row, col, text, strlen(text));
+}
+
+void VeranusDisplay::drawValue(uint8_t row, uint8_t col, int32_t value, uint8_t length)
+{
+    // Fill the field with the string representation of the value
+    // Right align
+    int2str(value, stringBuffer, length);
+    uint8_t strLen = strlen(stringBuffer);
+    uint8_t offset = length - strLen;
+
+    for (uint8_t i=0; i<offset; i++)
+    {
+        frame_[row][col + i] = ' ';
+    }
+    drawText(row, col + offset, stringBuffer, strLen);
+}
+
+void VeranusDisplay::flush()
+{
+    for (uint8_t row=0; row<NUM_ROWS; row++)
     {
-        // Swap from C to F
-        pLcd_->setCursor(TEMP_ROW, TEMP_UNIT_INDEX);
-        pLcd_->display(TEMP_UNIT_F, UNIT_LEN);
-        update(degreesCToF(temperature_), humidity_);
+        // Group the changed characters into runs, each written after a single cursor move
+        bool inRun = false;
+        uint8_t runStart = 0;
+        uint8_t runEnd = 0;
+        for (uint8_t col=0; col<NUM_COLS; col++)
+        {
+            if (frame_[row][col] == glass_[row][col]) continue;
+
+            if (!inRun)
+            {
+                inRun = true;
+                runStart = col;
+            }
+            else if ((col - runEnd) > MAX_RUN_GAP)
+            {
+                flushRun(row, runStart, runEnd);
+                runStart = col;
+            }
+            runEnd = col + 1;
+        }
+
+        if (inRun) flushRun(row, runStart, runEnd);
     }
 }
 
-void VeranusDisplay::clearDisplayBuffer()
+void VeranusDisplay::flushRun(uint8_t row, uint8_t start, uint8_t end)
 {
-    for (uint8_t i=0; i<TEMP_VALUE_LEN; i++)
+    // The cursor moves along by itself, so only move it when the run starts somewhere else
+    if ((cursorRow_ != row) || (cursorCol_ != start))
+    {
+        pLcd_->setCursor(row, start);
+        cursorRow_ = row;
+    }
+
+    pLcd_->display(&(frame_[row][start]), end - start);
+    for (uint8_t col=start; col<end; col++)
     {
-        displayBuffer[i] = ' ';
+        glass_[row][col] = frame_[row][col];
     }
+    cursorCol_ = end;
 }
 
 void VeranusDisplay::setBrightness(uint8_t brightness)
 {
-    if ((pBrigthnessPwm_ != nullptr) &&
-        (brightness_ != brightness))
+    // The fade towards it is done from the tic
+    if (pBrigthnessPwm_ != nullptr)
     {
-        brightness_ = brightness;
-        pBrigthnessPwm_->setDutyCycle(brightness);
+        targetBrightness_ = brightness;
     }
 }
 
 uint8_t VeranusDisplay::getBrightness()
 {
     return brightness_;
+}
+
+void VeranusDisplay::setLightLevel(uint16_t light)
+{
+    light_ = light;
+    applyLightLevel(false);
+}
+
+void VeranusDisplay::refreshBrightness()
+{
+    applyLightLevel(true);
+}
+
+void VeranusDisplay::applyLightLevel(bool force)
+{
+    if ((settings.lightMode != LightMode::INCREASE) &&
+        (settings.lightMode != LightMode::DECREASE))
+    {
+        return;
+    }
+
+    if (settings.maxLight <= settings.minLight) return;
+
+    // Find where the light level falls on the curve
+    uint8_t index = 0;
+    if (light_ >= LIGHT_SCALE_MAX)
+    {
+        index = CURVE_MAX;
+    }
+    else if (light_ > LIGHT_SCALE_MIN)
+    {
+        index = ((light_ - LIGHT_SCALE_MIN) * CURVE_MAX) / (LIGHT_SCALE_MAX - LIGHT_SCALE_MIN);
+    }
+
+    // Ignore small changes, unless the light reaches either end of the scale
+    uint16_t change = (index > lightIndex_) ? (index - lightIndex_) : (lightIndex_ - index);
+    if (!force &&
+        (lightIndex_ != NO_LIGHT_INDEX) &&
+        (change < LIGHT_HYSTERESIS) &&
+        (index != 0) &&
+        (index != CURVE_MAX))
+    {
+        return;
+    }
+    lightIndex_ = index;
+
+    // Decrease mode runs along the curve backwards
+    if (settings.lightMode == LightMode::DECREASE)
+    {
+        index = CURVE_MAX - index;
+    }
+
+    uint16_t range = settings.maxLight - settings.minLight;
+    uint8_t curve = pgm_read_byte(&(BRIGHTNESS_CURVE[index]));
+    setBrightness(settings.minLight + (((range * curve) + (CURVE_MAX / 2)) / CURVE_MAX));
+}
+
+void VeranusDisplay::onTic()
+{
+    uint8_t brightness = brightness_;
+    uint8_t target = targetBrightness_;
+    if (brightness == target) return;
+
+    if (brightness < target)
+    {
+        brightness = ((target - brightness) > FADE_STEP) ? (brightness + FADE_STEP) : target;
+    }
+    else
+    {
+        brightness = ((brightness - target) > FADE_STEP) ? (brightness - FADE_STEP) : target;
+    }
+
+    brightness_ = brightness;
+    pBrigthnessPwm_->setDutyCycle(brightness);
 }
\ No newline at end of file
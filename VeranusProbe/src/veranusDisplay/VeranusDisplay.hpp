@@ -3,6 +3,7 @@
 
 #include "drivers/lcd/ILcd.hpp"
 #include "drivers/pwm/IPwm.hpp"
+#include "ProbeStrings.hpp"
 
 
 class VeranusDisplay
@@ -17,12 +18,13 @@ class VeranusDisplay
         bool setup();
 
         /**
-         * Update the values to display on the display
-         * @param   temperatureF    Temperature to display in Fahrenheit
-         * @param   humidity        Relative humidity to display
+         * Update the values to display on the display. Only the characters that changed are
+         * sent to the LCD
+         * @param   temperatureF    Temperature to display, hundredths of a degree Fahrenheit
+         * @param   humidity        Relative humidity to display, hundredths of a percent
          * @return  True if update was successful
          */
-        bool update(float temperatureF, float humidity);
+        bool update(int16_t temperatureF, uint16_t humidity);
 
         /**
          * Set which unit the temperature should be displayed in
@@ -37,7 +39,7 @@ class VeranusDisplay
         bool isCelsius(){ return isCelsius_; }
 
         /**
-         * Set the brightness of the LCD backlight
+         * Set the brightness of the LCD backlight. The backlight fades to it from onTic()
          * @param   brightness  Brightness in percent
          */
         void setBrightness(uint8_t brightness);
@@ -48,15 +50,61 @@ class VeranusDisplay
          */
         uint8_t getBrightness();
 
+        /**
+         * Set the backlight from the ambient light level, following the light mode in the settings.
+         * Small changes in light are ignored so the backlight does not flap around a threshold
+         * @param   light   Ambient light level, hundredths of a percent
+         */
+        void setLightLevel(uint16_t light);
+
+        /**
+         * Apply the last light level again, regardless of how much it has changed.
+         * Used after the light mode or range changes
+         */
+        void refreshBrightness();
+
+        /**
+         * Steps the backlight fade, called from the tic interrupt
+         */
+        void onTic();
+
     private:
+        const static uint8_t NUM_ROWS = 2;
+        const static uint8_t NUM_COLS = 8;
+
         Lcd::ILcd* pLcd_;
         Pwm::IPwm* pBrigthnessPwm_;
-        int16_t temperature_;   // Last temperature reading 
-        uint8_t humidity_;      // Last humidity reading, percent
-        uint8_t brightness_;
+        int16_t temperatureF_;  // Last temperature reading, hundredths of a degree Fahrenheit
+        uint16_t humidity_;     // Last humidity reading, hundredths of a percent
         bool isCelsius_;
 
-        void clearDisplayBuffer();
+        // Backlight level being shown, and the level it is fading towards
+        volatile uint8_t brightness_;
+        volatile uint8_t targetBrightness_;
+
+        // Last ambient light level, and the position on the brightness curve last applied
+        uint16_t light_;
+        uint16_t lightIndex_;
+
+        // What the screen should show, and what has actually been sent to the LCD
+        char frame_[NUM_ROWS][NUM_COLS];
+        char glass_[NUM_ROWS][NUM_COLS];
+
+        // Where the LCD's cursor is, it moves one column right after each character
+        uint8_t cursorRow_;
+        uint8_t cursorCol_;
+
+        void drawText(uint8_t row, uint8_t col, const char* text, uint8_t length);
+        void drawString(uint8_t row, uint8_t col, ProbeStrings string);
+        void drawValue(uint8_t row, uint8_t col, int32_t value, uint8_t length);
+
+        /**
+         * Send the characters of the frame that differ from the glass to the LCD
+         */
+        void flush();
+        void flushRun(uint8_t row, uint8_t start, uint8_t end);
+
+        void applyLightLevel(bool force);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -1,9 +1,17 @@
 #include "veranusProbe/VeranusProbe.hpp"
 #include "utilities/print/Print.hpp"
+#include "ProbeStrings.hpp"
 #include "config.hpp"
 #include "Settings.hpp"
+#include "VeranusProtocol.hpp"
 
-#include <math.h>
+#include <avr/pgmspace.h>
+
+/**
+ * All corrections are done in fixed point hundredths (the wire format), since the ATmega328
+ * has no FPU. Compared to the original float implementation, results agree within 0.01F for
+ * temperature and 0.1% for humidity (up to 100%)
+ */
 
 const static float A_VAL = 17.27f;
 const static float B_VAL = 237.7f;
@@ -17,21 +25,82 @@ const static float HUM_CORRECTION_SLOPE = 0.0f;//0.4f;
 const static float HUM_CORRECTION_OFFSET = 0;//-7.75f;
 const static float HUM_CORRECTION_LCD_FACTOR = -4.5f;
 
-const static uint8_t CORRECT_GRADIENT_PERIOD = 6;
+// Self heating builds up after power on, so the correction is ramped in over this long. It used
+// to step up twice per reading every 5 minutes, this keeps the same ramp with adaptive sampling
+const static uint32_t CORRECT_GRADIENT_SECONDS = 15 * 60;
+
+const static uint8_t MAX_LED_BRIGHTNESS = 100;
+
+// Calibration constants above, converted at compile time.
+// Slopes are Q16, offsets and LCD factors are hundredths
+const static uint8_t SLOPE_SHIFT = 16;
+const static int32_t TEMP_SLOPE_Q16 = (int32_t)(TEMP_CORRECTION_SLOPE * (1L << SLOPE_SHIFT));
+const static int32_t TEMP_OFFSET_FIXED = Protocol::toFixed(TEMP_CORRECTION_OFFSET);
+const static int32_t TEMP_LCD_FACTOR_FIXED = Protocol::toFixed(TEMP_CORRECTION_LCD_FACTOR);
+const static int32_t HUM_SLOPE_Q16 = (int32_t)(HUM_CORRECTION_SLOPE * (1L << SLOPE_SHIFT));
+const static int32_t HUM_OFFSET_FIXED = Protocol::toFixed(HUM_CORRECTION_OFFSET);
+const static int32_t HUM_LCD_FACTOR_FIXED = Protocol::toFixed(HUM_CORRECTION_LCD_FACTOR);
+
+/*
+ * Dewpoint exponent, x = a*b*(Tmeas - Tcorr) / ((b + Tmeas) * (b + Tcorr)), as Q12.
+ * With temperatures in hundredths this is x = dT * (a*b*100) / ((100b + Tmeas) * (100b + Tcorr)).
+ * The denominator is shifted down by the Q12 shift first so the product stays within 32 bits,
+ * which limits the temperature difference
+ */
+const static uint8_t EXP_Q_SHIFT = 12;
+const static int32_t AB_FIXED = (int32_t)(A_VAL * B_VAL * Protocol::FIXED_SCALE);
+const static int32_t B_FIXED = Protocol::toFixed(B_VAL);
+const static int32_t MAX_DEWPOINT_DELTA = INT32_MAX / AB_FIXED;
+
+/*
+ * e^x for x in [0, 1], in steps of 1/32, as Q14. Built at compile time from a Taylor series,
+ * and linearly interpolated between entries (worst case error 0.015%).
+ * Even a 5F correction at -40F keeps x below 0.6
+ */
+const static uint8_t EXP_TABLE_SHIFT = 14;
+const static uint8_t EXP_STEP_SHIFT = 5;
+const static uint8_t EXP_INTERP_SHIFT = EXP_Q_SHIFT - EXP_STEP_SHIFT;
+const static uint16_t EXP_TABLE_STEPS = 32;
+const static int32_t EXP_MAX_X = (int32_t)EXP_TABLE_STEPS << EXP_INTERP_SHIFT;
+
+constexpr float expSeries(float x, uint8_t n, float term, float sum)
+{
+    return (n > 24) ? sum : expSeries(x, n + 1, term * x / n, sum + (term * x / n));
+}
+
+constexpr uint16_t expEntry(uint8_t step)
+{
+    return (uint16_t)((expSeries((float)step / (1 << EXP_STEP_SHIFT), 1, 1.0f, 1.0f) *
+                       (1L << EXP_TABLE_SHIFT)) + 0.5f);
+}
+
+#define EXP_ENTRIES_4(n) expEntry(n), expEntry(n + 1), expEntry(n + 2), expEntry(n + 3)
+#define EXP_ENTRIES_16(n) EXP_ENTRIES_4(n), EXP_ENTRIES_4(n + 4), EXP_ENTRIES_4(n + 8), EXP_ENTRIES_4(n + 12)
+
+const static uint16_t EXP_TABLE[EXP_TABLE_STEPS + 1] PROGMEM =
+{
+    EXP_ENTRIES_16(0),
+    EXP_ENTRIES_16(16),
+    expEntry(32)
+};
 
-const static float MAX_LED_BRIGHTNESS = 100.f;
+static_assert(expEntry(0) == (1 << EXP_TABLE_SHIFT), "e^0 must be exactly 1");
+static_assert(expEntry(EXP_TABLE_STEPS) == 44536, "e^1 out of range of the table");
 
-VeranusProbe::VeranusProbe(ClimateSensor::IClimateSensor* pClimateSensor,
-                           PhotoTransistor* pLightSensor):
+VeranusProbe::VeranusProbe(AsyncHdc1080* pClimateSensor,
+                           LightSampler* pLightSensor,
+                           TicSource getTics):
     pClimateSensor_(pClimateSensor),
     pLightSensor_(pLightSensor),
-    lcdBrightness_(0),
-    numClimateReadings_(0)
+    getTics_(getTics),
+    lcdBrightness_(0)
 {
 }
 
 bool VeranusProbe::init()
 {
+    pLightSensor_->initialize();
+
     if (!pClimateSensor_->initialize())
     {
         return false;
@@ -40,108 +109,124 @@ bool VeranusProbe::init()
     return true;
 }
 
-void VeranusProbe::setLcdBrightness(float lcdBrightness)
+void VeranusProbe::setLcdBrightness(uint8_t lcdBrightness)
 {
     lcdBrightness_ = lcdBrightness;
 }
 
-bool VeranusProbe::readClimate(float& temperatureF, float& humidity)
+AsyncHdc1080::Result VeranusProbe::readClimate(int16_t& temperatureF, uint16_t& humidity)
 {
-    if (!pClimateSensor_->update())
+    // The sensor already reads out in hundredths
+    int16_t tempMeasured;
+    uint16_t humidityMeasured;
+    AsyncHdc1080::Result result = pClimateSensor_->update(tempMeasured, humidityMeasured);
+    if (result != AsyncHdc1080::Result::READY)
     {
-        return false;
+        return result;
     }
-  
-    // Get the readings from the probe
-    float tempMeasured = pClimateSensor_->getTemperatureFahrenheit();
-    float humidityMeasured = pClimateSensor_->getRelativeHumidity();
 
 #ifdef CLIMATE_DEBUG
-    PRINT("MT,%f,MH,%f,", tempMeasured, humidityMeasured);
+    PRINT_P("MT,%d,MH,%u,", tempMeasured, humidityMeasured);
 #endif
 
     // Apply corrections to account for heat from the board and its casing
     temperatureF = getTemperatureCorrected(tempMeasured);
     humidity = getHumidityCorrected(humidityMeasured, tempMeasured, temperatureF);
 
-    return true;
+    return result;
 }
 
-bool VeranusProbe::readLight(float& light)
+bool VeranusProbe::readLight(uint16_t& light)
 {
-    pLightSensor_->update();
-    light = pLightSensor_->getLightPercent();
+    light = pLightSensor_->getLight();
     return true;
 }
 
-float VeranusProbe::getTemperatureCorrected(float temperatureF)
+int32_t VeranusProbe::getSelfHeatingAdjustment(int32_t value, int32_t slope, int32_t offset, int32_t lcdFactor)
 {
     /*
-     * Correct for temperature error due to self heating
      * Correct linear from offsets from real values measured over a range of temperatures
-     * However, since self heating occurs over the first few minutes, only apply the correction 
+     * However, since self heating occurs over the first few minutes, only apply the correction
      * partially at first, and then ramp up to the full correction
      */
-    float tempAdjustment = (temperatureF * TEMP_CORRECTION_SLOPE) +
-                           TEMP_CORRECTION_OFFSET;
+    int32_t adjustment = ((value * slope) >> SLOPE_SHIFT) + offset;
 
     // LCD heat is exponentially related to the voltage (brightness)
     // (brightness^2) / (100%^2) * LCD temperature increase
-    tempAdjustment += (lcdBrightness_ / MAX_LED_BRIGHTNESS) * TEMP_CORRECTION_LCD_FACTOR;
+    adjustment += ((int32_t)lcdBrightness_ * lcdFactor) / MAX_LED_BRIGHTNESS;
 
     // Self heating occurs gradually at startup to apply it gradually
-    if (numClimateReadings_ < CORRECT_GRADIENT_PERIOD)
+    uint32_t uptime = getTics_() / TICS_PER_SECOND;
+    if (uptime < CORRECT_GRADIENT_SECONDS)
     {
-        tempAdjustment *= (float)numClimateReadings_ / CORRECT_GRADIENT_PERIOD;
-        numClimateReadings_++; 
+        adjustment = (adjustment * (int32_t)uptime) / (int32_t)CORRECT_GRADIENT_SECONDS;
     }
 
+    return adjustment;
+}
+
+int16_t VeranusProbe::getTemperatureCorrected(int16_t temperatureF)
+{
+    // Correct for temperature error due to self heating
+    int32_t tempAdjustment = getSelfHeatingAdjustment(temperatureF,
+                                                      TEMP_SLOPE_Q16,
+                                                      TEMP_OFFSET_FIXED,
+                                                      TEMP_LCD_FACTOR_FIXED);
+
     // Only adjust temperature down, since we are only concerned
     // about self heating, not self cooling!
-    if (tempAdjustment < 0) temperatureF += tempAdjustment;
+    if (tempAdjustment < 0) return Protocol::saturateSigned(temperatureF + tempAdjustment);
     return temperatureF;
 }
 
-float VeranusProbe::getHumidityCorrected(float humidity)
+uint16_t VeranusProbe::getHumidityCorrected(uint16_t humidity)
 {
-        /*
-     * Correct for humidity error due to self heating
-     * Correct linear from offsets from real values measured over a range of temperatures
-     * However, since self heating occurs over the first few minutes, only apply the correction 
-     * partially at first, and then ramp up to the full correction
-     */
-    float humAdjustment = (humidity * HUM_CORRECTION_SLOPE) +
-                           HUM_CORRECTION_OFFSET;
+    // Correct for humidity error due to self heating
+    int32_t humAdjustment = getSelfHeatingAdjustment(humidity,
+                                                     HUM_SLOPE_Q16,
+                                                     HUM_OFFSET_FIXED,
+                                                     HUM_LCD_FACTOR_FIXED);
 
-    // LCD heat is exponentially related to the voltage (brightness)
-    // (brightness^2) / (100%^2) * LCD temperature increase
-    humAdjustment += (lcdBrightness_  / MAX_LED_BRIGHTNESS) * HUM_CORRECTION_LCD_FACTOR;
-
-    // Self heating occurs gradually at startup to apply it gradually
-    if (numClimateReadings_ < CORRECT_GRADIENT_PERIOD)
-    {
-        humAdjustment *= (float)numClimateReadings_ / CORRECT_GRADIENT_PERIOD;
-        numClimateReadings_++; 
-    }
-
-    humidity += humAdjustment;
-    return humidity;
+    return Protocol::saturateUnsigned(humidity + humAdjustment);
 }
 
-float VeranusProbe::getHumidityCorrected(float humidity, float tempMeasured, float tempCorrected)
+uint16_t VeranusProbe::getHumidityCorrected(uint16_t humidity, int16_t tempMeasured, int16_t tempCorrected)
 {
     /**
      * Humidity correction is based on the dewpoint equation found here: http://hyperphysics.phy-astr.gsu.edu/hbase/Kinetic/relhum.html
      * Basically, the dewpoint should be the same at the actual temperature and humidity, as at the measured temperature and humidity
      * Therefore, the equation for dewpoint with the measured values equals the equation with corrected values.
      * Solve this equation for correct humidity, since we know both measured values, and have a corrected temperature.
-     * 
-     * Hcorr = Hmeas * e^(  (a*b*(Tmeas - Tcorr)) / ((b + Tmeas) * (b +Tcorr))  )  
+     *
+     * Hcorr = Hmeas * e^(  (a*b*(Tmeas - Tcorr)) / ((b + Tmeas) * (b +Tcorr))  )
      * where a and b are given constants
      */
-    float tempPortion = A_VAL * B_VAL * (tempMeasured - tempCorrected);
-    tempPortion /= (B_VAL + tempMeasured) * (B_VAL + tempCorrected);
-    float hTempCorrected = humidity * exp(tempPortion);
+    int32_t tempDelta = (int32_t)tempMeasured - tempCorrected;
+    if (tempDelta > MAX_DEWPOINT_DELTA) tempDelta = MAX_DEWPOINT_DELTA;
+
+    // Corrections only lower the temperature, so the exponent is never negative
+    uint32_t hTempCorrected = humidity;
+    if (tempDelta > 0)
+    {
+        uint32_t denominator = (uint32_t)(B_FIXED + tempMeasured) * (uint32_t)(B_FIXED + tempCorrected);
+        denominator >>= EXP_Q_SHIFT;
+
+        int32_t x = (tempDelta * AB_FIXED) / (int32_t)denominator;
+        hTempCorrected = (((uint32_t)humidity * expFixed(x)) + (1UL << (EXP_TABLE_SHIFT - 1))) >> EXP_TABLE_SHIFT;
+    }
+
+    return getHumidityCorrected(Protocol::saturateUnsigned(hTempCorrected));
+}
 
-    return getHumidityCorrected(hTempCorrected);
-}
\ No newline at end of file
+uint16_t VeranusProbe::expFixed(int32_t x)
+{
+    // Saturate at the end of the table, well past any real correction
+    if (x >= EXP_MAX_X) return pgm_read_word(&(EXP_TABLE[EXP_TABLE_STEPS]));
+
+    uint8_t index = x >> EXP_INTERP_SHIFT;
+    uint16_t fraction = x & ((1 << EXP_INTERP_SHIFT) - 1);
+
+    uint16_t low = pgm_read_word(&(EXP_TABLE[index]));
+    uint16_t high = pgm_read_word(&(EXP_TABLE[index + 1]));
+    return low + (((uint32_t)(high - low) * fraction) >> EXP_INTERP_SHIFT);
+}
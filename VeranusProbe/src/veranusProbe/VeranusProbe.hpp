@@ -1,31 +1,69 @@
 #ifndef VERANUS_PROBE_HPP
 #define VERANUS_PROBE_HPP
 
-#include "drivers/climateSensor/IClimateSensor.hpp"
-#include "drivers/phototransistor/PhotoTransistor.hpp"
+#include "asyncHdc1080/AsyncHdc1080.hpp"
+#include "lightSampler/LightSampler.hpp"
+
+#include <stdint.h>
+
+/**
+ * Returns the current tic count
+ */
+typedef uint32_t (*TicSource)();
 
 class VeranusProbe
 {
     public:
-        VeranusProbe(ClimateSensor::IClimateSensor* pClimateSensor,
-                     PhotoTransistor* pLightSensor);
+        /**
+         * @param   pClimateSensor  Temperature and humidity sensor
+         * @param   pLightSensor    Light sensor
+         * @param   getTics         Returns the tic count since boot, to ramp in the self heating
+         *                          correction over the first minutes of uptime
+         */
+        VeranusProbe(AsyncHdc1080* pClimateSensor,
+                     LightSampler* pLightSensor,
+                     TicSource getTics);
 
         ~VeranusProbe(){}
 
         bool init();
-        void setLcdBrightness(float lcdBrightness);
-        bool readClimate(float& temperatureF, float& humidity);
-        bool readLight(float& light);
+
+        /**
+         * @param   lcdBrightness   Backlight brightness, 0 to 100 percent
+         */
+        void setLcdBrightness(uint8_t lcdBrightness);
+
+        /**
+         * Move the climate reading on without waiting, and correct it for self heating once done
+         * @param   temperatureF    Corrected temperature, hundredths of a degree Fahrenheit
+         * @param   humidity        Corrected relative humidity, hundredths of a percent
+         * @return  READY once a new reading is out, BUSY while the sensor is still working on it
+         */
+        AsyncHdc1080::Result readClimate(int16_t& temperatureF, uint16_t& humidity);
+
+        /**
+         * Get the light level, which is sampled in the background
+         * @param   light   Light level, hundredths of a percent
+         * @return  True, the reading is always available
+         */
+        bool readLight(uint16_t& light);
 
     private:
-        ClimateSensor::IClimateSensor* pClimateSensor_;
-        PhotoTransistor* pLightSensor_;
-        float lcdBrightness_;
-        uint8_t numClimateReadings_;
-
-        float getTemperatureCorrected(float temperatureF);
-        float getHumidityCorrected(float humidity);
-        float getHumidityCorrected(float humidity, float tempMeasured, float tempCorrected);
+        AsyncHdc1080* pClimateSensor_;
+        LightSampler* pLightSensor_;
+        TicSource getTics_;
+        uint8_t lcdBrightness_;
+
+        int32_t getSelfHeatingAdjustment(int32_t value, int32_t slope, int32_t offset, int32_t lcdFactor);
+        int16_t getTemperatureCorrected(int16_t temperatureF);
+        uint16_t getHumidityCorrected(uint16_t humidity);
+        uint16_t getHumidityCorrected(uint16_t humidity, int16_t tempMeasured, int16_t tempCorrected);
+
+        /**
+         * @param   x   Exponent as Q12, must not be negative
+         * @return  e^x as Q14, saturating at e^1
+         */
+        uint16_t expFixed(int32_t x);
 };
 
 #endif
\ No newline at end of file
@@ -13,6 +13,8 @@ enum VeranusWifiCode : uint8_t
     GET_CONFIG = 0x04,
     TEST = 0x05,
     SEND = 0x06,
+    BINARY_MODE = 0x07,
+    SEND_BATCH = 0x08,
     INVALID
 };
 
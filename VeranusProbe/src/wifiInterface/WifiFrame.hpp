@@ -0,0 +1,60 @@
+#ifndef WIFI_FRAME_HPP
+#define WIFI_FRAME_HPP
+
+#include <stdint.h>
+#include "VeranusProtocol.hpp"
+
+/**
+ * Binary uplink frame, used in place of the "SD id t h l" text command once the
+ * wifi module has accepted a BINARY_MODE request.
+ *
+ * | start | length | version | code | payload ... | crc (LSB, MSB) |
+ *
+ * Length counts the bytes from version through the end of the payload.
+ * The CRC is CRC-16/CCITT (init 0xFFFF) over length through the end of the payload.
+ * All multi-byte fields are little endian.
+ *
+ * The SEND_BATCH payload is a WifiBatchHeader followed by count WifiBatchReadings, oldest first.
+ */
+const static uint8_t WIFI_FRAME_START = 0xA5;
+const static uint8_t WIFI_FRAME_VERSION = 1;
+
+// Readings are sent as fixed point hundredths
+const static int16_t WIFI_FRAME_SCALE = Protocol::FIXED_SCALE;
+
+struct WifiBatchHeader
+{
+    uint16_t probeId;
+    uint8_t count;
+} __attribute__((packed));
+
+struct WifiBatchReading
+{
+    uint32_t age;           // Seconds between the reading and the frame being sent
+    int16_t temperature;    // Hundredths of a degree Fahrenheit
+    uint16_t humidity;      // Hundredths of a percent
+    uint16_t light;         // Hundredths of a percent
+} __attribute__((packed));
+
+// Most readings to put in one frame, keeps the length in a byte and within the module's buffer
+const static uint8_t WIFI_BATCH_MAX_READINGS = 8;
+
+const static uint8_t WIFI_FRAME_HEADER_LEN = 2;     // start, length
+const static uint8_t WIFI_FRAME_PREAMBLE_LEN = 2;   // version, code
+const static uint8_t WIFI_FRAME_CRC_LEN = 2;
+
+static_assert(sizeof(WifiBatchHeader) == 3, "Unexpected padding in wifi batch header");
+static_assert(sizeof(WifiBatchReading) == 10, "Unexpected padding in wifi batch reading");
+static_assert((WIFI_FRAME_PREAMBLE_LEN +
+               sizeof(WifiBatchHeader) +
+               (WIFI_BATCH_MAX_READINGS * sizeof(WifiBatchReading))) <= UINT8_MAX,
+              "Batch frame too long for its length byte");
+
+// Longest frame, from the start byte to the CRC
+const static uint8_t WIFI_FRAME_MAX_LEN = WIFI_FRAME_HEADER_LEN +
+                                          WIFI_FRAME_PREAMBLE_LEN +
+                                          sizeof(WifiBatchHeader) +
+                                          (WIFI_BATCH_MAX_READINGS * sizeof(WifiBatchReading)) +
+                                          WIFI_FRAME_CRC_LEN;
+
+#endif
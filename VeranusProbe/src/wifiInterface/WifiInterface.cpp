@@ -2,10 +2,13 @@
 #include "utilities/strings/Strings.hpp"
 #include "Settings.hpp"
 #include "utilities/print/Print.hpp"
+#include "ProbeStrings.hpp"
 #include "drivers/assert/Assert.hpp"
 #include "config.hpp"
 #include "drivers/timer/Delay.hpp"
 
+#include <util/crc16.h>
+
 using namespace SerialComm;
 using namespace Strings;
 using namespace Timer;
@@ -15,10 +18,10 @@ const static char NEWLINE[] = "\r\n";
 const static uint8_t NEWLINE_LEN = sizeof(NEWLINE) - 1;
 
 const static char DELIM = ' ';
+const static char DECIMAL_POINT = '.';
 
 const static char DATA_STR[] = "SD ";
 const static uint8_t DATA_STR_LEN = sizeof(DATA_STR) - 1;
-const static uint8_t FLOAT_DECIMAL_PLACES = 4;
 
 const static char SET_CONFIG_STR[] = "SC";
 const static uint8_t SET_CONFIG_STR_LEN = sizeof(SET_CONFIG_STR) - 1;
@@ -26,19 +29,41 @@ const static uint8_t SET_CONFIG_STR_LEN = sizeof(SET_CONFIG_STR) - 1;
 const static char GET_CONFIG_STR[] = "GC";
 const static uint8_t GET_CONFIG_STR_LEN = sizeof(GET_CONFIG_STR) - 1;
 
-const static char PASS[] = "PASS";
-const static char FAIL[] = "FAIL";
+const static char BINARY_MODE_STR[] = "BN";
+const static uint8_t BINARY_MODE_STR_LEN = sizeof(BINARY_MODE_STR) - 1;
+
+const static uint16_t CRC_INIT = 0xffff;
+
 const static uint8_t EXPECTED_RESPONSE_LEN = 4;
 
-WifiInterface::WifiInterface(ISerial* pSerial, 
-                             SoftwareTimer* pTimeoutTimer):
+WifiInterface::WifiInterface(ISerial* pSerial,
+                             SoftwareTimer* pTimeoutTimer,
+                             ReadingBuffer* pReadings,
+                             TicSource getTics):
     pSerial_(pSerial),
     pTimeoutTimer_(pTimeoutTimer),
+    pReadings_(pReadings),
+    getTics_(getTics),
+    queueHead_(0),
+    queueCount_(0),
+    sendProbeId_(0),
+    sendQueued_(false),
+    sentThrough_(0),
+    sentCount_(0),
+    sendStartTic_(0),
+    readingsSent_(0),
+    sendTics_(0),
+    configQueued_(false),
+    configReceived_(false),
     bufferIndex_(0),
     state_(WifiState::IDLE),
-    activeTransaction_(VeranusWifiCode::NONE),
-    success_(false)
+    binaryMode_(false)
 {
+    assert(pReadings_ != nullptr);
+    assert(getTics_ != nullptr);
+
+    activeCommand_.code = VeranusWifiCode::NONE;
+    activeCommand_.callback = nullptr;
 }
 
 void WifiInterface::init()
@@ -46,6 +71,9 @@ void WifiInterface::init()
     pSerial_->initialize();
     DELAY(1000);
     pSerial_->write(NEWLINE, NEWLINE_LEN);
+
+    // Ask the wifi module if it can take binary frames, nobody waits on the answer
+    enqueue(VeranusWifiCode::BINARY_MODE, nullptr);
 }
 
 void WifiInterface::update()
@@ -58,62 +86,332 @@ void WifiInterface::update()
         {
             // Check if the response matches the transaction we are waiting for
             uint8_t response = str2int(responseStr);
-            if (getCode(response) == activeTransaction_)
+            if (getCode(response) == activeCommand_.code)
+            {
+                // This code is for this request, check if we got a success response.
+                // Getting the config only succeeds if an SSID came back first
+                bool success = isSuccess(response);
+                if (activeCommand_.code == VeranusWifiCode::GET_CONFIG)
+                {
+                    success = success && configReceived_;
+                }
+                completeCommand(success);
+            }
+            else if ((activeCommand_.code == VeranusWifiCode::GET_CONFIG) &&
+                     !configReceived_)
             {
-                pTimeoutTimer_->disable();
+                // Wasn't a code, so assume ssid
+                strncpy(configBuffer_, responseStr, CONFIG_BUFFER_LEN);
+                configBuffer_[CONFIG_BUFFER_LEN - 1] = '\0';
+                configReceived_ = true;
+            }
+        }
+        // Check if the command has timed out
+        else if (pTimeoutTimer_->hasOneShotPassed())
+        {
+            completeCommand(false);
+        }
+    }
+    else if (queueCount_ > 0)
+    {
+        // Nothing in flight, start on the next queued command
+        startNextCommand();
+    }
+}
+
+bool WifiInterface::send(uint16_t probeId, WifiCallback callback)
+{
+    if (sendQueued_ || pReadings_->isEmpty()) return false;
+
+    sendProbeId_ = probeId;
+    sendQueued_ = enqueue(VeranusWifiCode::SEND, callback);
+    return sendQueued_;
+}
+
+bool WifiInterface::setConfig(const char* ssid, const char* password, WifiCallback callback)
+{
+    uint8_t ssidLen = strlen(ssid);
+    uint8_t passwordLen = strlen(password);
+    if (configQueued_ ||
+        (ssidLen > MAX_SSID_LEN) ||
+        (passwordLen > MAX_PASSWORD_LEN))
+    {
+        return false;
+    }
+
+    // Keep a copy, the caller's strings will be gone by the time the command is sent
+    memcpy(configBuffer_, ssid, ssidLen + 1);
+    memcpy(&(configBuffer_[ssidLen + 1]), password, passwordLen + 1);
+
+    configQueued_ = enqueue(VeranusWifiCode::SET_CONFIG, callback);
+    return configQueued_;
+}
+
+bool WifiInterface::getConfig(WifiCallback callback)
+{
+    if (configQueued_) return false;
+
+    configQueued_ = enqueue(VeranusWifiCode::GET_CONFIG, callback);
+    return configQueued_;
+}
+
+bool WifiInterface::enqueue(VeranusWifiCode code, WifiCallback callback)
+{
+    if (queueCount_ >= QUEUE_LEN) return false;
+
+    uint8_t index = (queueHead_ + queueCount_) % QUEUE_LEN;
+    queue_[index].code = code;
+    queue_[index].callback = callback;
+    queueCount_++;
+
+    return true;
+}
+
+void WifiInterface::startNextCommand()
+{
+    activeCommand_ = queue_[queueHead_];
+    queueHead_ = (queueHead_ + 1) % QUEUE_LEN;
+    queueCount_--;
+
+    // Drop anything left over from the previous command
+    pSerial_->flush();
+    bufferIndex_ = 0;
+
+    switch (activeCommand_.code)
+    {
+        case VeranusWifiCode::SEND:         writeSend();        break;
+        case VeranusWifiCode::SET_CONFIG:   writeSetConfig();   break;
+        case VeranusWifiCode::GET_CONFIG:   writeGetConfig();   break;
+        case VeranusWifiCode::BINARY_MODE:  writeBinaryMode();  break;
+        default:
+        {
+            // Nothing to send for this code
+            completeCommand(false);
+            return;
+        }
+    }
+
+    // Go to sending state and start timeout
+    state_ = WifiState::PENDING;
+    pTimeoutTimer_->enable();
+}
 
-                // This code is for this request, check if we got a success response
-                success_ = isSuccess(response);
-                state_ = WifiState::COMPLETED;
+void WifiInterface::completeCommand(bool success)
+{
+    pTimeoutTimer_->disable();
+    state_ = WifiState::IDLE;
 
-                activeTransaction_ = VeranusWifiCode::NONE;
+    const char* response = nullptr;
+    switch (activeCommand_.code)
+    {
+        case VeranusWifiCode::SEND:
+        case VeranusWifiCode::SEND_BATCH:
+        {
+            sendQueued_ = false;
+            if (success)
+            {
+                // Confirmed, these no longer need to be kept
+                pReadings_->popThrough(sentThrough_);
+                readingsSent_ += sentCount_;
+                sendTics_ += getTics_() - sendStartTic_;
             }
+            break;
         }
-        // Check if connecting has timed out
-        else if (pTimeoutTimer_->hasOneShotPassed())
+
+        case VeranusWifiCode::SET_CONFIG:
         {
-            pTimeoutTimer_->disable();
+            configQueued_ = false;
+            break;
+        }
 
-            success_ = false;
-            activeTransaction_ = VeranusWifiCode::NONE;
-            state_ = WifiState::COMPLETED;
+        case VeranusWifiCode::GET_CONFIG:
+        {
+            configQueued_ = false;
+            if (success) response = configBuffer_;
+            break;
         }
+
+        case VeranusWifiCode::BINARY_MODE:
+        {
+            // Modules that do not know the request fail or time out, leaving the text fallback
+            binaryMode_ = success;
+            if (settings.debug) PRINTLN_P("Binary mode %s", getString(success ? ProbeStrings::PASS : ProbeStrings::FAIL));
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+
+    WifiCallback callback = activeCommand_.callback;
+    activeCommand_.code = VeranusWifiCode::NONE;
+    activeCommand_.callback = nullptr;
+
+    if (callback != nullptr)
+    {
+        callback(success, response);
     }
 }
 
-void WifiInterface::send(uint16_t probeId, float temperature, float humidity, float light)
+void WifiInterface::writeSend()
 {
-    startNewCommand(VeranusWifiCode::SEND);
+    sendStartTic_ = getTics_();
+
+    // Readings may have been added or dropped since the send was queued, so only look now
+    if (binaryMode_)
+    {
+        activeCommand_.code = VeranusWifiCode::SEND_BATCH;
+        writeSendFrame();
+    }
+    else
+    {
+        writeSendText();
+    }
+
+    if (settings.debug) PRINTLN_P("Sending %d...", sentCount_);
+}
+
+void WifiInterface::writeFixed(int32_t value)
+{
+    // Write a hundredths fixed point value as a decimal string
+    if (value < 0)
+    {
+        pSerial_->write("-", sizeof(char));
+        value = -value;
+    }
+
+    int2str(value / WIFI_FRAME_SCALE, valBuffer_, VAL_BUFFER_LEN);
+    pSerial_->write(valBuffer_, strlen(valBuffer_));
+    pSerial_->write(&DECIMAL_POINT, sizeof(char));
+
+    uint8_t hundredths = value % WIFI_FRAME_SCALE;
+    valBuffer_[0] = '0' + (hundredths / 10);
+    valBuffer_[1] = '0' + (hundredths % 10);
+    pSerial_->write(valBuffer_, 2);
+}
+
+void WifiInterface::writeSendText()
+{
+    // Text can only carry one reading, and has no timestamp
+    const StoredReading* pReading = pReadings_->peek(0);
+    sentThrough_ = pReading->timestamp;
+    sentCount_ = 1;
 
     // Write command name
     pSerial_->write(DATA_STR, DATA_STR_LEN);
 
     // Write probe ID
-    int2str(probeId, valBuffer_, VAL_BUFFER_LEN);
+    int2str(sendProbeId_, valBuffer_, VAL_BUFFER_LEN);
     pSerial_->write(valBuffer_, strlen(valBuffer_));
     pSerial_->write(&DELIM, sizeof(char));
 
     // Write temperature
-    float2str(temperature, valBuffer_, VAL_BUFFER_LEN, FLOAT_DECIMAL_PLACES);
-    pSerial_->write(valBuffer_, strlen(valBuffer_));
+    writeFixed(pReading->temperature);
     pSerial_->write(&DELIM, sizeof(char));
 
     // Write humidity
-    float2str(humidity, valBuffer_, VAL_BUFFER_LEN, FLOAT_DECIMAL_PLACES);
-    pSerial_->write(valBuffer_, strlen(valBuffer_));
+    writeFixed(pReading->humidity);
     pSerial_->write(&DELIM, sizeof(char));
 
     // Write light
-    float2str(light, valBuffer_, VAL_BUFFER_LEN, FLOAT_DECIMAL_PLACES);
-    pSerial_->write(valBuffer_, strlen(valBuffer_));
+    writeFixed(pReading->light);
 
     // Send command
     pSerial_->write(NEWLINE, NEWLINE_LEN);
+}
 
-    // Go to sending state and start timeout
-    state_ = WifiState::PENDING;
-    pTimeoutTimer_->enable();
-    if (settings.debug) PRINTLN("Sending...");
+void WifiInterface::writeFrameBytes(const void* pData, uint8_t length, uint16_t& crc)
+{
+    const uint8_t* pBytes = (const uint8_t*)pData;
+    for (uint8_t i=0; i<length; i++)
+    {
+        crc = _crc_ccitt_update(crc, pBytes[i]);
+    }
+
+    pSerial_->write((const char*)pBytes, length);
+}
+
+void WifiInterface::writeSendFrame()
+{
+    WifiBatchHeader header;
+    header.probeId = sendProbeId_;
+    header.count = pReadings_->getCount();
+    if (header.count > WIFI_BATCH_MAX_READINGS)
+    {
+        header.count = WIFI_BATCH_MAX_READINGS;
+    }
+
+    uint8_t preamble[] =
+    {
+        (uint8_t)(WIFI_FRAME_PREAMBLE_LEN + sizeof(WifiBatchHeader) + (header.count * sizeof(WifiBatchReading))),
+        WIFI_FRAME_VERSION,
+        VeranusWifiCode::SEND_BATCH
+    };
+
+    // The CRC covers everything after the start byte
+    uint16_t crc = CRC_INIT;
+    pSerial_->write((const char*)&WIFI_FRAME_START, sizeof(WIFI_FRAME_START));
+    writeFrameBytes(preamble, sizeof(preamble), crc);
+    writeFrameBytes(&header, sizeof(header), crc);
+
+    uint32_t now = getTics_() / TICS_PER_SECOND;
+    for (uint8_t i=0; i<header.count; i++)
+    {
+        const StoredReading* pReading = pReadings_->peek(i);
+
+        WifiBatchReading reading;
+        reading.age = now - pReading->timestamp;
+        reading.temperature = pReading->temperature;
+        reading.humidity = pReading->humidity;
+        reading.light = pReading->light;
+        writeFrameBytes(&reading, sizeof(reading), crc);
+
+        sentThrough_ = pReading->timestamp;
+    }
+    sentCount_ = header.count;
+
+    uint8_t crcBytes[] = {(uint8_t)(crc & 0xff), (uint8_t)(crc >> 8)};
+    pSerial_->write((const char*)crcBytes, sizeof(crcBytes));
+}
+
+void WifiInterface::writeSetConfig()
+{
+    const char* ssid = configBuffer_;
+    uint8_t ssidLen = strlen(ssid);
+    const char* password = &(configBuffer_[ssidLen + 1]);
+
+    // Write set config command
+    pSerial_->write(SET_CONFIG_STR, SET_CONFIG_STR_LEN);
+    pSerial_->write(&DELIM, sizeof(char));
+
+    // Write SSID
+    pSerial_->write(ssid, ssidLen);
+    pSerial_->write(&DELIM, sizeof(char));
+
+    // Write password
+    pSerial_->write(password, strlen(password));
+    pSerial_->write(NEWLINE, NEWLINE_LEN);
+}
+
+void WifiInterface::writeGetConfig()
+{
+    configReceived_ = false;
+
+    // Write get config command
+    pSerial_->write(GET_CONFIG_STR, GET_CONFIG_STR_LEN);
+    pSerial_->write(NEWLINE, NEWLINE_LEN);
+}
+
+void WifiInterface::writeBinaryMode()
+{
+    // Write binary mode request with the frame version we speak
+    pSerial_->write(BINARY_MODE_STR, BINARY_MODE_STR_LEN);
+    pSerial_->write(&DELIM, sizeof(char));
+    int2str(WIFI_FRAME_VERSION, valBuffer_, VAL_BUFFER_LEN);
+    pSerial_->write(valBuffer_, strlen(valBuffer_));
+    pSerial_->write(NEWLINE, NEWLINE_LEN);
 }
 
 bool WifiInterface::checkReponse(char*& response)
@@ -158,107 +456,9 @@ VeranusWifiCode WifiInterface::getCode(uint8_t response)
     return (VeranusWifiCode)(response & ~(SUCCESS_BITMASK));
 }
 
-bool WifiInterface::setConfig(const char* ssid, const char* password)
-{
-    startNewCommand(VeranusWifiCode::SET_CONFIG);
-
-    // Write set config command
-    pSerial_->write(SET_CONFIG_STR, SET_CONFIG_STR_LEN);
-    pSerial_->write(&DELIM, sizeof(char));
-
-    // Write SSID
-    pSerial_->write(ssid, strlen(ssid));
-    pSerial_->write(&DELIM, sizeof(char));
-
-    // Write password
-    pSerial_->write(password, strlen(password));
-    pSerial_->write(NEWLINE, NEWLINE_LEN);
-
-    // Go to sending state and start timeout
-    state_ = WifiState::PENDING;
-    pTimeoutTimer_->enable();
-    
-
-    // Wait until response or timeout
-    while (isBusy())
-    {
-        update();
-    }
-
-    // Get the result of the command, and return to Idle
-    return getSuccess();
-}
-
-bool WifiInterface::getConfig(char* ssid, uint16_t maxLength)
-{
-    startNewCommand(VeranusWifiCode::GET_CONFIG);
-
-    // Write set config command
-    pSerial_->write(GET_CONFIG_STR, GET_CONFIG_STR_LEN);
-    pSerial_->write(NEWLINE, NEWLINE_LEN);
-
-    // Go to sending state and start timeout
-    state_ = WifiState::PENDING;
-    pTimeoutTimer_->enable();
-
-    // First, await a text response
-    char* response;
-    while (!checkReponse(response))
-    {
-        if (pTimeoutTimer_->hasOneShotPassed())
-        {
-            pTimeoutTimer_->disable();
-            return false;
-        }
-    }
-
-    // Received a code, not an SSID
-    if (getCode(str2int(response)) == VeranusWifiCode::GET_CONFIG)
-    {
-        return false;
-    }
-
-    // Wasn't a code, so assume ssid
-    strncpy(ssid, response, maxLength);
-
-    // Await the success/fail message
-    while (isBusy())
-    {
-        update();
-    }
-
-    return getSuccess();
-}
-
-void WifiInterface::startNewCommand(VeranusWifiCode commandCode)
-{
-    // Wait until no other transaction is in progress
-    while (isBusy())
-    {
-        update();
-    }
-
-    pSerial_->flush();
-    bufferIndex_ = 0;
-    activeTransaction_ = commandCode;
-}
-
 bool WifiInterface::isBusy()
 {
-    return (state_ == WifiState::PENDING);
+    return (state_ == WifiState::PENDING) || (queueCount_ > 0);
 }
 
 WifiState WifiInterface::getState(){ return state_; }
-
-bool WifiInterface::getSuccess()
-{
-    bool success = false;
-    if (state_ == WifiState::COMPLETED)
-    {
-        success = success_;
-        success_ = false;
-        state_ = WifiState::IDLE;
-    }
-
-    return success;
-}
\ No newline at end of file
@@ -2,51 +2,129 @@
 #define WIFI_INTERFACE_HPP
 
 #include "VeranusWifiCodes.hpp"
+#include "WifiFrame.hpp"
 #include "drivers/serial/ISerial.hpp"
 #include "drivers/timer/SoftwareTimer.hpp"
+#include "readingBuffer/ReadingBuffer.hpp"
 
 const static uint8_t MAX_SSID_LEN = 32;
+const static uint8_t MAX_PASSWORD_LEN = 63;
 
 enum WifiState : uint8_t
 {
     IDLE,
-    PENDING,
-    COMPLETED
+    PENDING
 };
 
+/**
+ * Called once a queued command has finished
+ * @param   success     True if the wifi module reported success
+ * @param   response    Text returned with the command (the SSID for GET_CONFIG), otherwise nullptr
+ */
+typedef void (*WifiCallback)(bool success, const char* response);
+
+/**
+ * Returns the current tic count
+ */
+typedef uint32_t (*TicSource)();
+
 class WifiInterface
 {
     public:
         WifiInterface(SerialComm::ISerial* pSerial,
-                      Timer::SoftwareTimer* pTimeoutTimer);
+                      Timer::SoftwareTimer* pTimeoutTimer,
+                      ReadingBuffer* pReadings,
+                      TicSource getTics);
 
         void init();
+
+        /**
+         * Drives the command queue, must be called every loop. Never blocks waiting on the wifi module
+         */
         void update();
-        void send(uint16_t probeId, float temperature, float humidity, float light);
-        bool setConfig(const char* ssid, const char* password);
-        bool getConfig(char* ssid, uint16_t maxLength);
+
+        /**
+         * Queue commands for the wifi module. Each returns immediately, and the callback
+         * fires from update() once the module has answered or the command timed out
+         * @return  False if the command could not be queued
+         *
+         * send() uploads the oldest buffered readings, as many as fit in one frame in binary mode,
+         * or a single reading in text mode. Readings are removed from the buffer once the module
+         * confirms them, so a failed send leaves them in place to retry
+         */
+        bool send(uint16_t probeId, WifiCallback callback);
+        bool setConfig(const char* ssid, const char* password, WifiCallback callback);
+        bool getConfig(WifiCallback callback);
 
         WifiState getState();
-        bool getSuccess();
+        bool isBusy();
+        bool isBinaryMode(){ return binaryMode_; }
+
+        /**
+         * Number of readings confirmed by the wifi module, and the tics spent sending them
+         */
+        uint16_t getReadingsSent(){ return readingsSent_; }
+        uint32_t getSendTics(){ return sendTics_; }
 
     private:
+        struct WifiCommand
+        {
+            VeranusWifiCode code;
+            WifiCallback callback;
+        };
+
         SerialComm::ISerial* pSerial_;
         Timer::SoftwareTimer* pTimeoutTimer_;
+        ReadingBuffer* pReadings_;
+        TicSource getTics_;
 
         const static uint8_t VAL_BUFFER_LEN = MAX_SSID_LEN + 2;
         char valBuffer_[VAL_BUFFER_LEN];
 
+        const static uint8_t QUEUE_LEN = 4;
+        WifiCommand queue_[QUEUE_LEN];
+        uint8_t queueHead_;
+        uint8_t queueCount_;
+
+        // Arguments of queued commands. Only one of each kind may be queued at a time
+        uint16_t sendProbeId_;
+        bool sendQueued_;
+
+        // Readings in the frame in flight, and upload statistics
+        uint32_t sentThrough_;
+        uint8_t sentCount_;
+        uint32_t sendStartTic_;
+        uint16_t readingsSent_;
+        uint32_t sendTics_;
+
+        // Holds "ssid\0password\0" for SET_CONFIG, and the returned SSID for GET_CONFIG
+        const static uint8_t CONFIG_BUFFER_LEN = MAX_SSID_LEN + MAX_PASSWORD_LEN + 2;
+        char configBuffer_[CONFIG_BUFFER_LEN];
+        bool configQueued_;
+        bool configReceived_;
+
         uint8_t bufferIndex_;
         WifiState state_;
-        VeranusWifiCode activeTransaction_;
-        bool success_;
+        WifiCommand activeCommand_;
+        bool binaryMode_;
+
+        bool enqueue(VeranusWifiCode code, WifiCallback callback);
+        void startNextCommand();
+        void completeCommand(bool success);
+
+        void writeSend();
+        void writeSendText();
+        void writeFixed(int32_t value);
+        void writeSendFrame();
+        void writeFrameBytes(const void* pData, uint8_t length, uint16_t& crc);
+        void writeSetConfig();
+        void writeGetConfig();
+        void writeBinaryMode();
 
-        void startNewCommand(VeranusWifiCode commandCode);
-        bool isBusy();
         bool checkReponse(char*& response);
 
         bool isSuccess(uint8_t response);
         VeranusWifiCode getCode(uint8_t response);
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -9,6 +9,10 @@
 #include "drivers/assert/Assert.hpp"
 #include "drivers/radio/nrf24l01/Nrf24l01.hpp"
 #include "drivers/spi/atmega328/Atmega328Spi.hpp"
+#include "veranusReceiver/FramedLog.hpp"
+
+#include <avr/interrupt.h>
+#include <util/atomic.h>
 
 using namespace Tic;
 using namespace Timer;
@@ -24,49 +28,89 @@ const static uint16_t TIMEOUT_TIME_SEC = 10;
 const static uint32_t CPU_CLK = 16000000;
 
 // Set up tic handler
-const uint32_t TICS_PER_SECOND = 61u;
 static TicCounter ticHandler(TICS_PER_SECOND);
+static volatile uint32_t ticCount = 0;
 void HandleTicInterrupt()
 {
     ticHandler.incrementTicCount();
+    ticCount++;
 }
 
 TicCounter* pTicCounter = &ticHandler;
 
 // Set up timer that triggers the tic counter to count
 const static TimerPrescaler PRESCALE = PRESCALE_1024;
-const static uint16_t TOP = 255;
+const static uint16_t TOP = COUNTS_PER_TIC - 1;
 static Atmega328Timer tmr(Timer::TIMER_2, CTC, PRESCALE, TOP, &HandleTicInterrupt);
 
-// Set up a software timer that decides how often to run the main loop
-static SoftwareTimer updateTimer(1, &ticHandler);
-static SoftwareTimer timeoutTimer(ticHandler.secondsToTics(TIMEOUT_TIME_SEC), &ticHandler);
+uint32_t getTimerCounts()
+{
+    uint32_t tics;
+    uint8_t count;
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+    {
+        tics = ticCount;
+        count = TCNT2;
+
+        // The timer may have just wrapped, before its interrupt had a chance to count the tic
+        if ((TIFR2 & _BV(OCF2A)) && (count < (COUNTS_PER_TIC / 2))) tics++;
+    }
+
+    return (tics * COUNTS_PER_TIC) + count;
+}
 
-SoftwareTimer* pUpdateTimer = &updateTimer;
+// Set up a software timer for radio timeouts
+static SoftwareTimer timeoutTimer(ticHandler.secondsToTics(TIMEOUT_TIME_SEC), &ticHandler);
 
 // Interrupt control object, must be enabled on start
 static Atmega328Interrupt interruptControl;
 
-// Setup uart for serial debugging
+// Setup uart to the host, see SerialFrame.hpp for what is sent over it. 38400 is within 0.2% of
+// the rate asked for at 16MHz, the host decoder has to be set to match
+#ifndef HOST_BAUD_RATE
+#define HOST_BAUD_RATE BaudRate::BAUD_38400
+#endif
 const static uint8_t RX_BUFF_SIZE = 64;
 const static uint8_t TX_BUFF_SIZE = 255;
 static uint8_t rxBuffer[RX_BUFF_SIZE];
 static uint8_t txBuffer[TX_BUFF_SIZE];
-static Atmega328AsynchUart serialUart(txBuffer, rxBuffer, TX_BUFF_SIZE, RX_BUFF_SIZE, BaudRate::BAUD_9600, CPU_CLK, &interruptControl);
+static Atmega328AsynchUart serialUart(txBuffer, rxBuffer, TX_BUFF_SIZE, RX_BUFF_SIZE, HOST_BAUD_RATE, CPU_CLK, &interruptControl);
 IUart* pUart = &serialUart;
 
+// Printed text goes to the host as LOG frames, a line at a time
+const static uint8_t LOG_LINE_LEN = 64;
+static uint8_t logBuffer[Frame::encodedLength(LOG_LINE_LEN)];
+static FramedLog framedLog(&serialUart, logBuffer, sizeof(logBuffer));
+
 // Set up IO pins
 static Atmega328Dio radioCePin(Port::B, 0, Mode::OUTPUT, Level::L_LOW, false, false);
 static Atmega328Dio radioCsnPin(Port::D, 7, Mode::OUTPUT, Level::L_LOW, false, false);
 
+// Radio IRQ is active low, on INT0
+static Atmega328Dio radioIrqPin(Port::D, 2, Mode::INPUT, Level::L_LOW, false, true);
+
 static Atmega328Spi spiDriver(&radioCsnPin, true);
 static Nrf24l01 radio(&radioCePin, &spiDriver);
 
 static VeranusReceiver veranusReceiver(&radio,
                                        pUart,
-                                       &timeoutTimer);
+                                       &timeoutTimer,
+                                       &getTimerCounts);
 VeranusReceiver* pVeranusReceiver = &veranusReceiver;
 
+ISR(INT0_vect)
+{
+    veranusReceiver.onRadioInterrupt();
+}
+
+static void enableRadioInterrupt()
+{
+    // Interrupt on the falling edge of the radio IRQ
+    EICRA = (EICRA & ~((1 << ISC01) | (1 << ISC00))) | (1 << ISC01);
+    EIFR = (1 << INTF0);
+    EIMSK |= (1 << INT0);
+}
+
 void initializeDevices()
 {
     Delay::Initialize(&ticHandler); // Initialize delay timer
@@ -75,9 +119,9 @@ void initializeDevices()
     interruptControl.enableInterrupts();    // Enabled interrupts
     tmr.initialize();                       // Start tic tmr
     serialUart.initialize();                // Start serial communication
-    PrintHandler::initialize(&serialUart);  // Initialize print handler
-    pUpdateTimer->enable();                 // Start the update timer
+    PrintHandler::initialize(&framedLog);   // Initialize print handler
 
     spiDriver.enable();
     radio.enable();
+    enableRadioInterrupt();
 }
\ No newline at end of file
@@ -10,9 +10,18 @@
 #include <stdint.h>
 
 extern Uart::IUart* pUart;
-extern Timer::SoftwareTimer* pUpdateTimer;
 extern VeranusReceiver* pVeranusReceiver;
 
 void initializeDevices();
 
+// Timer counts in one tic, each count is 64us. Task periods and deadlines are in counts
+const static uint32_t TICS_PER_SECOND = 61u;
+const static uint32_t COUNTS_PER_TIC = 256u;
+const static uint32_t COUNTS_PER_SECOND = COUNTS_PER_TIC * TICS_PER_SECOND;
+
+/**
+ * Time since boot in timer counts, wraps after about 76 hours
+ */
+uint32_t getTimerCounts();
+
 #endif
\ No newline at end of file
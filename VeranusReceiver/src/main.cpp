@@ -3,8 +3,28 @@
 #include "version.hpp"
 #include "config.hpp"
 #include "veranusReceiver/ReceiverCli.hpp"
+#include "TaskScheduler.hpp"
 
-void loop();
+#include <avr/pgmspace.h>
+
+static void updateCli();
+static void updateReceiver();
+
+/**
+ * Everything the receiver does. Periods and deadlines are in timer counts
+ */
+const static char radioName[] PROGMEM = "RADIO";
+const static char cliName[] PROGMEM = "CLI";
+
+const static Scheduler::Task tasks[] PROGMEM =
+{
+    {.name = radioName, .function = updateReceiver, .period = COUNTS_PER_TIC, .priority = 0, .deadline = COUNTS_PER_TIC},
+    {.name = cliName,   .function = updateCli,      .period = COUNTS_PER_TIC, .priority = 1, .deadline = 2 * COUNTS_PER_TIC}
+};
+const static uint8_t numTasks = sizeof(tasks) / sizeof(tasks[0]);
+
+static Scheduler::TaskStats taskStats[numTasks];
+static Scheduler::TaskScheduler scheduler(tasks, taskStats, numTasks, &getTimerCounts);
 
 int main(void)
 {
@@ -16,18 +36,29 @@ int main(void)
   PRINTLN("Running build %d.%d", V_MAJOR, V_MINOR);
 #endif
 
+  scheduler.start();
+
   for (;;) {
 
-    if (pUpdateTimer->hasPeriodPassed())
+    // Service the radio as soon as it raises its IRQ, rather than waiting for its task
+    if (pVeranusReceiver->hasRadioEvent())
     {
-		  loop();
+      pVeranusReceiver->update();
     }
+
+    scheduler.runNext();
 	}
 
   return 0;
 }
 
-void loop()
+static void updateCli()
 {
   pCli->update();
-}
\ No newline at end of file
+}
+
+static void updateReceiver()
+{
+  // Start the next queued probe, or catch a reply or timeout the IRQ did not flag
+  pVeranusReceiver->update();
+}
@@ -0,0 +1,36 @@
+#include "FramedLog.hpp"
+
+FramedLog::FramedLog(Uart::IUart* pUart, uint8_t* buffer, uint8_t length):
+    pUart_(pUart),
+    buffer_(buffer),
+    maxLine_(length - Frame::encodedLength(0)),
+    count_(0)
+{
+}
+
+void FramedLog::write(const uint8_t* data, uint16_t length)
+{
+    for (uint16_t i=0; i<length; i++)
+    {
+        // The frame marks where the line ends, so line endings are not sent
+        if ((data[i] == '\r') || (data[i] == '\n'))
+        {
+            if (count_ > 0) sendLine();
+            continue;
+        }
+
+        buffer_[Frame::IN_PLACE_OFFSET + count_] = data[i];
+        count_++;
+        if (count_ >= maxLine_) sendLine();
+    }
+}
+
+void FramedLog::sendLine()
+{
+    uint8_t frameLength = Frame::encode(Frame::Channel::LOG,
+                                        &buffer_[Frame::IN_PLACE_OFFSET],
+                                        count_,
+                                        buffer_);
+    pUart_->write(buffer_, frameLength);
+    count_ = 0;
+}
@@ -0,0 +1,43 @@
+#ifndef FRAMED_LOG_HPP
+#define FRAMED_LOG_HPP
+
+#include "drivers/uart/IUart.hpp"
+#include "SerialFrame.hpp"
+
+#include <stdint.h>
+
+/**
+ * Sits between the print handler and the UART, and sends printed text as LOG frames so it can
+ * share the link with results. Text is collected a line at a time, and a line longer than the
+ * buffer is split over several frames. Reads go straight through to the UART
+ */
+class FramedLog: public Uart::IUart
+{
+    public:
+        /**
+         * @param   pUart   UART to the host, already initialized
+         * @param   buffer  Space for one line, and the frame it is encoded to in place
+         * @param   length  Length of the buffer, Frame::encodedLength() of the longest line
+         */
+        FramedLog(Uart::IUart* pUart, uint8_t* buffer, uint8_t length);
+        ~FramedLog(){}
+
+        void initialize(){}
+        void write(const uint8_t* data, uint16_t length);
+        uint16_t read(uint8_t* buffer, uint16_t length){ return pUart_->read(buffer, length); }
+        bool isDataAvailable(){ return pUart_->isDataAvailable(); }
+        void flush(){ pUart_->flush(); }
+
+    private:
+        Uart::IUart* pUart_;
+        uint8_t* buffer_;
+        uint8_t maxLine_;
+        uint8_t count_;
+
+        /**
+         * Send what has been collected as one frame
+         */
+        void sendLine();
+};
+
+#endif
@@ -2,29 +2,142 @@
 
 #include "devices.hpp"
 #include "utilities/print/Print.hpp"
-#include "utilities/strings/Strings.hpp"
 
-using namespace Cli;
+using namespace Commands;
 
-static void readProbes(uint16_t argc, ArgV argv);
+static void readProbes(const Args& args);
+static void scanProbes(const Args& args);
+static void subscribe(const Args& args);
+static void unsubscribe(const Args& args);
+static void setPeriod(const Args& args);
+static void addCredits(const Args& args);
+static void help(const Args& args);
 
-static Command commands[] =
+// Longest command line, enough for SUBSCRIBE with every probe listed
+const static uint8_t LINE_LEN = 10 + (4 * MAX_SCAN_PROBES) + 1;
+
+constexpr static Command commands[] PROGMEM =
 {
-    {.name = "READ", .function = &readProbes}
+    {"READ",        &readProbes,  1, MAX_SCAN_PROBES, {CLI_INT("probe", 0, UINT8_MAX)}},
+    {"SCAN",        &scanProbes,  0, MAX_SCAN_PROBES, {CLI_INT("probe", 0, UINT8_MAX)}},
+    {"SUBSCRIBE",   &subscribe,   0, MAX_SCAN_PROBES, {CLI_INT("probe", 0, UINT8_MAX)}},
+    {"UNSUBSCRIBE", &unsubscribe, 0, 0,               {}},
+    {"PERIOD",      &setPeriod,   1, 1,               {CLI_INT("secs", 0, 3600)}},
+    {"CREDIT",      &addCredits,  1, 1,               {CLI_INT("n", 1, MAX_CREDITS)}},
+    {"HELP",        &help,        0, 0,               {}}
 };
+const static uint8_t numCommands = sizeof(commands) / sizeof(commands[0]);
+typedef HashTable<commands, numCommands> CommandHash;
+
+static bool readChar(char& c)
+{
+    return pUart->read((uint8_t*)&c, 1) == 1;
+}
+
+static void onError(Result result)
+{
+    switch (result)
+    {
+        case Result::UNKNOWN:
+            PRINTLN("Unknown command");
+            break;
+        case Result::NUM_ARGS:
+            PRINTLN("Incorrect # of params");
+            break;
+        case Result::BAD_ARG:
+            PRINTLN("Invalid param");
+            break;
+        default:
+            PRINTLN("Line too long");
+            break;
+    }
+}
+
+static char lineBuffer[LINE_LEN];
+static CommandTable cli(commands,
+                        numCommands,
+                        CommandHash::slots,
+                        CommandHash::MASK,
+                        CommandHash::SEED,
+                        lineBuffer,
+                        LINE_LEN,
+                        &readChar,
+                        &onError);
+CommandTable* pCli = &cli;
 
-static CommandInterface cli(pUart, commands, 1);
-CommandInterface* pCli = &cli;
+static void readProbes(const Args& args)
+{
+    // Queue every probe listed, in one pipelined scan
+    uint8_t probeIds[MAX_SCAN_PROBES];
+    for (uint8_t i=0; i<args.count; i++)
+    {
+        probeIds[i] = (uint8_t)args.getInt(i);
+    }
+
+    // Results are sent as each probe answers
+    if (!pVeranusReceiver->scan(probeIds, args.count))
+    {
+#ifdef DEBUG
+        PRINTLN("Scan list full");
+#endif
+    }
+}
+
+static void scanProbes(const Args& args)
+{
+    if (args.count == 0)
+    {
+        // Poll every probe we have heard from before
+        if (!pVeranusReceiver->scanKnown())
+        {
+#ifdef DEBUG
+            PRINTLN("Scan list full");
+#endif
+        }
+    }
+    else
+    {
+        readProbes(args);
+    }
+}
 
-static void readProbes(uint16_t argc, ArgV argv)
+static void subscribe(const Args& args)
 {
-    if (argc < 2)
+    // Every known probe if none are listed
+    uint8_t probeIds[MAX_SCAN_PROBES];
+    for (uint8_t i=0; i<args.count; i++)
     {
-        // Incorrect number of parameters
-        PRINTLN("Incorrect # of params");
-        return;
+        probeIds[i] = (uint8_t)args.getInt(i);
     }
 
-    uint8_t probeId = (uint8_t)Strings::str2int(argv[1]);
-    pVeranusReceiver->getUpdate(probeId);
-}
\ No newline at end of file
+    if (!pVeranusReceiver->subscribe(probeIds, args.count))
+    {
+        PRINTLN("No known probes, list them");
+    }
+}
+
+static void unsubscribe(const Args& args)
+{
+    pVeranusReceiver->unsubscribe();
+}
+
+static void setPeriod(const Args& args)
+{
+    pVeranusReceiver->setRoundPeriod(args.getInt(0) * COUNTS_PER_SECOND);
+}
+
+static void addCredits(const Args& args)
+{
+    // The host hands back a credit for each result it has read
+    pVeranusReceiver->addCredits(args.getInt(0));
+}
+
+static void help(const Args& args)
+{
+    char usage[40];
+    for (uint8_t i=0; i<numCommands; i++)
+    {
+        pCli->getUsage(i, usage, sizeof(usage));
+        PRINTLN(usage);
+    }
+}
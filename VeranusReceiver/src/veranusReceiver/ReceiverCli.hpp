@@ -1,8 +1,8 @@
 #ifndef RECEIVER_CLI_HPP
 #define RECEIVER_CLI_HPP
 
-#include "utilities/cli/CommandInterface.hpp"
+#include "CommandTable.hpp"
 
-extern Cli::CommandInterface* pCli;
+extern Commands::CommandTable* pCli;
 
 #endif
\ No newline at end of file
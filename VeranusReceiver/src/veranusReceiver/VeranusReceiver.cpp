@@ -7,16 +7,30 @@
 static uint32_t successes = 0;
 static uint32_t failures = 0;
 
-const static uint8_t FAILURE_CODE = 0xff;
+// Staleness of a probe that has never been updated
+const static uint16_t NEVER_UPDATED = 0xffff;
 
 VeranusReceiver::VeranusReceiver(Radio::IRadio* pRadio,
                                  Uart::IUart* pUart,
-                                 Timer::SoftwareTimer* pTimeoutTimer):
+                                 Timer::SoftwareTimer* pTimeoutTimer,
+                                 TimeSource getTime):
     pRadio_(pRadio),
     pUart_(pUart),
-    pTimeoutTimer_(pTimeoutTimer)
+    pTimeoutTimer_(pTimeoutTimer),
+    getTime_(getTime),
+    numProbes_(0),
+    pollCount_(0),
+    scanLength_(0),
+    state_(ReceiverState::IDLE),
+    activeProbe_(0),
+    radioEvent_(false),
+    subscribed_(false),
+    subscribeLength_(0),
+    credits_(0),
+    roundPeriod_(0),
+    roundStart_(0)
 {
-
+    pending_.valid = false;
 }
 
 VeranusReceiver::~VeranusReceiver(){}
@@ -37,7 +51,7 @@ bool VeranusReceiver::request(uint8_t probeId)
   return pRadio_->transmit(&probeId, ID_SIZE);
 }
 
-bool VeranusReceiver::receive(uint8_t probeId)
+bool VeranusReceiver::startReceiving(uint8_t probeId)
 {
   pRadio_->setPayloadSize(V_DATA_SIZE);
   if (!pRadio_->startReceiving(probeId))
@@ -48,81 +62,338 @@ bool VeranusReceiver::receive(uint8_t probeId)
     return false;
   }
 
+  // The reply is picked up in update(), once the radio raises its IRQ
+  radioEvent_ = false;
   pTimeoutTimer_->enable();
-  while (!pRadio_->isDataAvailable())
-  {
-    // Check for a timeout so we do not wait forever
-    if (pTimeoutTimer_->hasOneShotPassed())
+  return true;
+}
+
+void VeranusReceiver::update()
+{
+    switch (state_)
     {
-      pTimeoutTimer_->disable();
-      return false;
-    }
-  }
+        case ReceiverState::IDLE:
+        {
+            if (subscribed_ &&
+                (scanLength_ == 0) &&
+                ((getTime_() - roundStart_) >= roundPeriod_))
+            {
+                startRound();
+            }
 
-  VeranusData incomingData;
-  bool success = pRadio_->receive((uint8_t*)&incomingData, V_DATA_SIZE);
+            // A subscriber that is out of credits holds up polling, results are never dropped
+            if ((scanLength_ > 0) &&
+                (!subscribed_ || (credits_ > 0)))
+            {
+                startNextProbe();
+            }
+            else
+            {
+                // Nothing left to overlap with, so send the last result now
+                flushPending();
+            }
+            break;
+        }
 
-  if (success)
-  {
-    transmitOverUart(incomingData);
-  }
+        case ReceiverState::AWAITING_DATA:
+        {
+            // Checking the radio on every pass, not only after an IRQ, covers a missed edge
+            radioEvent_ = false;
+            if (pRadio_->isDataAvailable())
+            {
+                pTimeoutTimer_->disable();
+                // Read straight into the pending result, and only keep it if it is a record we understand
+                uint8_t* pBuffer = (uint8_t*)&(pending_.data);
+                bool success = pRadio_->receive(pBuffer, V_DATA_SIZE) &&
+                               (Protocol::decode(pBuffer, V_DATA_SIZE) != nullptr);
 
 #ifdef DEBUG
-  PRINTLN("Received from %d: T: %dF, H: %d%, L: %d%",
-    incomingData.probeId,
-    (int16_t)incomingData.tempF,
-    (int16_t)incomingData.humidity,
-    (int16_t)incomingData.light);
+                PRINTLN("Received from %d: T: %dF, H: %d%, L: %d%",
+                    pending_.data.probeId,
+                    pending_.data.temperature / Protocol::FIXED_SCALE,
+                    pending_.data.humidity / Protocol::FIXED_SCALE,
+                    pending_.data.light / Protocol::FIXED_SCALE);
 #endif
-  
-  return success;
+
+                completeProbe(success);
+            }
+            // Check for a timeout so we do not wait forever
+            else if (pTimeoutTimer_->hasOneShotPassed())
+            {
+                pTimeoutTimer_->disable();
+                completeProbe(false);
+            }
+            break;
+        }
+
+        default:
+        {
+            break;
+        }
+    }
+}
+
+bool VeranusReceiver::scanKnown()
+{
+    uint8_t probeIds[MAX_SCAN_PROBES];
+    return scan(probeIds, getKnownProbes(probeIds));
+}
+
+bool VeranusReceiver::scan(const uint8_t* probeIds, uint8_t numProbes)
+{
+    return queue(probeIds, numProbes, true);
+}
+
+uint8_t VeranusReceiver::getKnownProbes(uint8_t* probeIds)
+{
+    for (uint8_t i=0; i<numProbes_; i++)
+    {
+        probeIds[i] = probes_[i].probeId;
+    }
+    return numProbes_;
+}
+
+bool VeranusReceiver::queue(const uint8_t* probeIds, uint8_t numProbes, bool requested)
+{
+    bool allQueued = true;
+    for (uint8_t i=0; i<numProbes; i++)
+    {
+        // Skip probes that are already waiting to be polled, but keep them if they are now asked for
+        bool queued = false;
+        for (uint8_t j=0; j<scanLength_; j++)
+        {
+            if (scanList_[j] == probeIds[i])
+            {
+                queued = true;
+                scanRequested_[j] = scanRequested_[j] || requested;
+            }
+        }
+        if (queued) continue;
+
+        if (scanLength_ >= MAX_SCAN_PROBES)
+        {
+            allQueued = false;
+            break;
+        }
+
+        scanList_[scanLength_] = probeIds[i];
+        scanRequested_[scanLength_] = requested;
+        scanLength_++;
+    }
+
+    return allQueued;
+}
+
+bool VeranusReceiver::subscribe(const uint8_t* probeIds, uint8_t numProbes)
+{
+    // Every known probe is none at all until one has been polled
+    if ((numProbes == 0) && (numProbes_ == 0)) return false;
+
+    if (numProbes > MAX_SCAN_PROBES) numProbes = MAX_SCAN_PROBES;
+    for (uint8_t i=0; i<numProbes; i++)
+    {
+        subscribeList_[i] = probeIds[i];
+    }
+    subscribeLength_ = numProbes;
+
+    // Start the first round on the next update
+    credits_ = MAX_CREDITS;
+    roundStart_ = getTime_() - roundPeriod_;
+    subscribed_ = true;
+    return true;
+}
+
+void VeranusReceiver::unsubscribe()
+{
+    subscribed_ = false;
+
+    // Drop what is left of the round, one-shot requests are still owed a result
+    uint8_t kept = 0;
+    for (uint8_t i=0; i<scanLength_; i++)
+    {
+        if (!scanRequested_[i]) continue;
+
+        scanList_[kept] = scanList_[i];
+        scanRequested_[kept] = true;
+        kept++;
+    }
+    scanLength_ = kept;
+}
+
+void VeranusReceiver::addCredits(uint8_t credits)
+{
+    credits_ = ((credits_ + credits) > MAX_CREDITS) ? MAX_CREDITS : (credits_ + credits);
+}
+
+void VeranusReceiver::startRound()
+{
+    roundStart_ = getTime_();
+    if (subscribeLength_ > 0)
+    {
+        queue(subscribeList_, subscribeLength_, false);
+    }
+    else
+    {
+        uint8_t probeIds[MAX_SCAN_PROBES];
+        queue(probeIds, getKnownProbes(probeIds), false);
+    }
+}
+
+uint8_t VeranusReceiver::takeStalestProbe()
+{
+    // Pick the probe that has waited longest for an update, and remove it from the list
+    uint8_t stalest = 0;
+    for (uint8_t i=1; i<scanLength_; i++)
+    {
+        if (getStaleness(scanList_[i]) > getStaleness(scanList_[stalest]))
+        {
+            stalest = i;
+        }
+    }
+
+    uint8_t probeId = scanList_[stalest];
+    scanLength_--;
+    scanList_[stalest] = scanList_[scanLength_];
+    scanRequested_[stalest] = scanRequested_[scanLength_];
+    return probeId;
 }
 
-void VeranusReceiver::getUpdate(uint8_t probeId)
+void VeranusReceiver::startNextProbe()
 {
-    // Request an update from each probe
-    bool success = request(probeId);
+    activeProbe_ = takeStalestProbe();
+    pollCount_++;
+
+    // Every poll ends in a result for the subscriber, good or bad
+    if (subscribed_) credits_--;
+
+    // Request an update from the probe
+    bool success = request(activeProbe_);
 
 #ifdef DEBUG
-    PRINTLN("Request for %d: %s", probeId, (success ? "SUCCESS" : "FAIL"));
+    PRINTLN("Request for %d: %s", activeProbe_, (success ? "SUCCESS" : "FAIL"));
 #endif
 
+    // While this probe gets its reply ready, hand the previous result to the UART
+    flushPending();
+
     if (success)
     {
-        success = receive(probeId);
+        success = startReceiving(activeProbe_);
+    }
+
+    if (success)
+    {
+        state_ = ReceiverState::AWAITING_DATA;
+    }
+    else
+    {
+        completeProbe(false);
+    }
+}
+
+void VeranusReceiver::completeProbe(bool success)
+{
+    state_ = ReceiverState::IDLE;
 
 #ifdef DEBUG
-        PRINTLN("Receive from %d: %s", probeId, (success ? "SUCCESS" : "FAIL"));
+    PRINTLN("Receive from %d: %s", activeProbe_, (success ? "SUCCESS" : "FAIL"));
 #endif
-    }
 
     // Track successful vs failed transactions
     if (success)
     {
+        ProbeRecord* pRecord = trackProbe(activeProbe_);
+        pRecord->updated = true;
+        pRecord->lastUpdate = pollCount_;
         successes++;
     }
     else
     {
-        transmitFailResponse();
         failures++;
     }
 
+    pending_.valid = true;
+    pending_.success = success;
+    pending_.probeId = activeProbe_;
+
 #ifdef DEBUG
     PRINTLN("Successes: %d, failures: %d", (uint16_t)successes, (uint16_t)failures);
 #endif
 }
 
-void VeranusReceiver::transmitOverUart(VeranusData data)
+void VeranusReceiver::flushPending()
+{
+    if (!pending_.valid) return;
+
+    if (pending_.success)
+    {
+        sendFrame(Frame::Channel::DATA, &(pending_.data), sizeof(pending_.data));
+    }
+    else
+    {
+        sendFrame(Frame::Channel::FAILURE, &(pending_.probeId), sizeof(pending_.probeId));
+    }
+
+    pending_.valid = false;
+}
+
+uint16_t VeranusReceiver::getStaleness(uint8_t probeId)
 {
-  VeranusTransmission transmission;
-  transmission.probeId = data.probeId;
-  transmission.light = data.light;
-  transmission.temp = data.tempF;
-  transmission.humid = data.humidity;
-  pUart_->write((uint8_t*)&transmission, sizeof(transmission));
+    ProbeRecord* pRecord = findProbe(probeId);
+    if ((pRecord == nullptr) ||
+        !pRecord->updated)
+    {
+        return NEVER_UPDATED;
+    }
+
+    return pollCount_ - pRecord->lastUpdate;
 }
 
-void VeranusReceiver::transmitFailResponse()
+VeranusReceiver::ProbeRecord* VeranusReceiver::findProbe(uint8_t probeId)
 {
-    pUart_->write((uint8_t*)&FAILURE_CODE, sizeof(FAILURE_CODE));
+    for (uint8_t i=0; i<numProbes_; i++)
+    {
+        if (probes_[i].probeId == probeId) return &(probes_[i]);
+    }
+
+    return nullptr;
+}
+
+VeranusReceiver::ProbeRecord* VeranusReceiver::trackProbe(uint8_t probeId)
+{
+    ProbeRecord* pRecord = findProbe(probeId);
+    if (pRecord != nullptr) return pRecord;
+
+    if (numProbes_ < MAX_SCAN_PROBES)
+    {
+        pRecord = &(probes_[numProbes_]);
+        numProbes_++;
+    }
+    else
+    {
+        // Table is full, replace the probe that has gone longest without an update
+        pRecord = &(probes_[0]);
+        for (uint8_t i=1; i<numProbes_; i++)
+        {
+            if (getStaleness(probes_[i].probeId) > getStaleness(pRecord->probeId))
+            {
+                pRecord = &(probes_[i]);
+            }
+        }
+    }
+
+    pRecord->probeId = probeId;
+    pRecord->updated = false;
+    pRecord->lastUpdate = 0;
+    return pRecord;
+}
+
+void VeranusReceiver::sendFrame(Frame::Channel channel, const void* payload, uint8_t length)
+{
+    // Results are the only frames sent from here, and a reading is the longest of them
+    uint8_t frame[Frame::encodedLength(V_DATA_SIZE)];
+    if (length > V_DATA_SIZE) return;
+
+    uint8_t frameLength = Frame::encode(channel, payload, length, frame);
+    pUart_->write(frame, frameLength);
 }
\ No newline at end of file
@@ -4,50 +4,166 @@
 #include "drivers/radio/IRadio.hpp"
 #include "drivers/uart/IUart.hpp"
 #include "drivers/timer/SoftwareTimer.hpp"
+#include "VeranusProtocol.hpp"
+#include "SerialFrame.hpp"
 
 #include <stdint.h>
 
 const static uint8_t ID_SIZE = sizeof(uint8_t);
 
-struct VeranusData
-{
-    uint8_t probeId;
-    float tempF;
-    float humidity;
-    float light;
-};
-const static uint8_t V_DATA_SIZE = sizeof(VeranusData);
+// Most probes that can be scanned at once, and have their last update tracked
+const static uint8_t MAX_SCAN_PROBES = Frame::MAX_PROBES;
+
+const static uint8_t V_DATA_SIZE = sizeof(Protocol::Reading);
 
-struct VeranusTransmission
+// Results a subscriber can be owed at once, shared with the host in SerialFrame.hpp
+const static uint8_t MAX_CREDITS = Frame::MAX_CREDITS;
+
+/**
+ * Returns a free running time, wrapping at 32 bits
+ */
+typedef uint32_t (*TimeSource)();
+
+enum ReceiverState : uint8_t
 {
-    uint8_t startCode = 0x7f;
-    uint8_t probeId = 0;
-    float light = 0;
-    float temp = 0;
-    float humid = 0;
-    uint8_t endCode = 0xff;
+    IDLE,
+    AWAITING_DATA
 };
 
 class VeranusReceiver
 {
     public:
+        /**
+         * @param   getTime     Time source subscription rounds are timed by
+         */
         VeranusReceiver(Radio::IRadio* pRadio,
                         Uart::IUart* pUart,
-                        Timer::SoftwareTimer* pTimeoutTimer);
+                        Timer::SoftwareTimer* pTimeoutTimer,
+                        TimeSource getTime);
         ~VeranusReceiver();
 
-        void getUpdate(uint8_t probeId);
+        /**
+         * Drives radio transactions, must be called every loop and whenever hasRadioEvent()
+         * is true. Never waits on the radio
+         */
+        void update();
+
+        /**
+         * Called from the radio IRQ interrupt
+         */
+        void onRadioInterrupt(){ radioEvent_ = true; }
+
+        /**
+         * @return  True if the radio has raised its IRQ since the last update
+         */
+        bool hasRadioEvent(){ return radioEvent_; }
+
+        /**
+         * Queue an update from each of the given probes. The ones that have gone longest without
+         * an update are polled first. Each probe's result is written to the UART while the next
+         * probe is being requested, as a DATA frame with its reading or a FAILURE frame with its
+         * ID, see SerialFrame.hpp
+         * @param   probeIds    IDs of the probes to poll
+         * @param   numProbes   Number of probe IDs
+         * @return  False if not all probes could be queued
+         */
+        bool scan(const uint8_t* probeIds, uint8_t numProbes);
+
+        /**
+         * Queue every probe that has been polled before
+         */
+        bool scanKnown();
+
+        /**
+         * Poll the given probes over and over on the receiver's own schedule, and push each
+         * result to the host as it arrives, without waiting to be asked.
+         *
+         * Results are paced by credits: each poll uses one, and none are started while there are
+         * none left. A subscription starts with MAX_CREDITS, and the host hands back credits
+         * with addCredits() as it reads results, so results never pile up in the UART
+         * @param   probeIds    IDs of the probes to poll, none to poll every known probe
+         * @return  False if none are listed and no probe has been polled yet, as there would be
+         *          nothing to poll. Nothing is subscribed
+         */
+        bool subscribe(const uint8_t* probeIds, uint8_t numProbes);
+
+        /**
+         * Stop polling, dropping the rest of the round. Probes queued with scan() are still
+         * polled, and a poll already on the air still reports
+         */
+        void unsubscribe();
+        bool isSubscribed(){ return subscribed_; }
+
+        /**
+         * Allow more results to be pushed, up to MAX_CREDITS owed at once
+         */
+        void addCredits(uint8_t credits);
+
+        /**
+         * Set the time from the start of one subscription round to the next, zero to start each
+         * round as soon as the last is done
+         * @param   period  Time in time source units
+         */
+        void setRoundPeriod(uint32_t period){ roundPeriod_ = period; }
 
     private:
+        struct ProbeRecord
+        {
+            uint8_t probeId;
+            bool updated;           // False until lastUpdate holds a poll count
+            uint16_t lastUpdate;    // Poll count at the last successful update
+        };
+
+        struct PendingResult
+        {
+            bool valid;
+            bool success;
+            uint8_t probeId;
+            Protocol::Reading data;
+        };
+
         Radio::IRadio* pRadio_;
         Uart::IUart* pUart_;
         Timer::SoftwareTimer* pTimeoutTimer_;
+        TimeSource getTime_;
+
+        ProbeRecord probes_[MAX_SCAN_PROBES];
+        uint8_t numProbes_;
+        uint16_t pollCount_;
+
+        // Probes still to poll, and whether each was asked for with scan() rather than only by a round
+        uint8_t scanList_[MAX_SCAN_PROBES];
+        bool scanRequested_[MAX_SCAN_PROBES];
+        uint8_t scanLength_;
+
+        ReceiverState state_;
+        uint8_t activeProbe_;
+        volatile bool radioEvent_;
+        PendingResult pending_;
+
+        bool subscribed_;
+        uint8_t subscribeList_[MAX_SCAN_PROBES];
+        uint8_t subscribeLength_;
+        uint8_t credits_;
+        uint32_t roundPeriod_;
+        uint32_t roundStart_;
+
+        bool queue(const uint8_t* probeIds, uint8_t numProbes, bool requested);
+        uint8_t getKnownProbes(uint8_t* probeIds);
+        void startRound();
+        void startNextProbe();
+        void completeProbe(bool success);
+        uint8_t takeStalestProbe();
 
         bool request(uint8_t probeId);
-        bool receive(uint8_t probeId);
-        void transmitOverUart(VeranusData data);
-        void transmitFailResponse();
+        bool startReceiving(uint8_t probeId);
+        void sendFrame(Frame::Channel channel, const void* payload, uint8_t length);
+        void flushPending();
+
+        ProbeRecord* findProbe(uint8_t probeId);
+        ProbeRecord* trackProbe(uint8_t probeId);
+        uint16_t getStaleness(uint8_t probeId);
 
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,146 @@
+#include "ingestor/Ingestor.hpp"
+
+#include "VeranusProtocol.hpp"
+
+#include <string.h>
+
+Ingestor::Ingestor(RecordLog* pLog):
+    decoder_(frameBuffer_, sizeof(frameBuffer_)),
+    pLog_(pLog),
+    batchLength_(0),
+    echoLogs_(true)
+{
+    memset(&counters_, 0, sizeof(counters_));
+    memset(probeStats_, 0, sizeof(probeStats_));
+}
+
+void Ingestor::onRequest(uint8_t probeId, uint64_t nowUs)
+{
+    probeStats_[probeId].requestTimeUs = nowUs;
+}
+
+uint32_t Ingestor::addBytes(const uint8_t* data, size_t length, uint64_t nowUs, uint64_t wallMs)
+{
+    uint32_t numResults = 0;
+    for (size_t i=0; i<length; i++)
+    {
+        if (decoder_.addByte(data[i]) && handleFrame(nowUs, wallMs)) numResults++;
+    }
+
+    counters_.bytes += length;
+    counters_.decodeErrors = decoder_.getErrors();
+    return numResults;
+}
+
+bool Ingestor::handleFrame(uint64_t nowUs, uint64_t wallMs)
+{
+    counters_.frames++;
+
+    const uint8_t* payload = decoder_.getPayload();
+    uint8_t length = decoder_.getPayloadLength();
+    switch (decoder_.getChannel())
+    {
+        case Frame::Channel::DATA:
+        {
+            const Protocol::Reading* pReading = Protocol::decode(payload, length);
+            if (pReading == nullptr)
+            {
+                counters_.unknownFrames++;
+                return false;
+            }
+
+            Record& record = batch_[batchLength_++];
+            record.timeMs = wallMs;
+            record.probeId = pReading->probeId;
+            record.temperature = pReading->temperature;
+            record.humidity = pReading->humidity;
+            record.light = pReading->light;
+
+            counters_.readings++;
+            if (record.probeId < NUM_PROBE_IDS) probeStats_[record.probeId].readings++;
+            recordLatency(record.probeId, nowUs);
+
+            if (batchLength_ >= MAX_BATCH) flush();
+            return true;
+        }
+
+        case Frame::Channel::FAILURE:
+        {
+            if (length < 1)
+            {
+                counters_.unknownFrames++;
+                return false;
+            }
+
+            counters_.failures++;
+            probeStats_[payload[0]].failures++;
+            recordLatency(payload[0], nowUs);
+            return true;
+        }
+
+        case Frame::Channel::LOG:
+            counters_.logs++;
+            if (echoLogs_) fprintf(stderr, "receiver: %.*s\n", length, (const char*)payload);
+            return false;
+
+        default:
+            counters_.unknownFrames++;
+            return false;
+    }
+}
+
+void Ingestor::recordLatency(uint16_t probeId, uint64_t nowUs)
+{
+    if (probeId >= NUM_PROBE_IDS) return;
+
+    // Only a result that was asked for is timed, a subscription sends them unprompted
+    ProbeStats& stats = probeStats_[probeId];
+    if ((stats.requestTimeUs == 0) || (nowUs < stats.requestTimeUs)) return;
+
+    uint64_t latencyUs = nowUs - stats.requestTimeUs;
+    stats.requestTimeUs = 0;
+    stats.latencyCount++;
+    stats.latencyTotalUs += latencyUs;
+    if (latencyUs > stats.latencyMaxUs) stats.latencyMaxUs = latencyUs;
+}
+
+bool Ingestor::flush()
+{
+    if (batchLength_ == 0) return true;
+
+    bool success = pLog_->write(batch_, batchLength_);
+    if (!success) counters_.writeErrors++;
+    batchLength_ = 0;
+    return success;
+}
+
+void Ingestor::printStats(FILE* pOut, double seconds, const Counters& previous)
+{
+    fprintf(pOut,
+            "%.1f frames/s, %.1f readings/s, %llu readings, %llu failures, %llu decode errors, "
+            "%llu unknown, %llu write errors\n",
+            (counters_.frames - previous.frames) / seconds,
+            (counters_.readings - previous.readings) / seconds,
+            (unsigned long long)counters_.readings,
+            (unsigned long long)counters_.failures,
+            (unsigned long long)counters_.decodeErrors,
+            (unsigned long long)counters_.unknownFrames,
+            (unsigned long long)counters_.writeErrors);
+
+    for (uint16_t i=0; i<NUM_PROBE_IDS; i++)
+    {
+        const ProbeStats& stats = probeStats_[i];
+        if ((stats.readings == 0) && (stats.failures == 0)) continue;
+
+        fprintf(pOut, "  probe %u: %llu readings, %llu failures", i,
+                (unsigned long long)stats.readings,
+                (unsigned long long)stats.failures);
+        if (stats.latencyCount > 0)
+        {
+            fprintf(pOut, ", latency mean %.1f ms max %.1f ms",
+                    (stats.latencyTotalUs / (double)stats.latencyCount) / 1000.0,
+                    stats.latencyMaxUs / 1000.0);
+        }
+        fprintf(pOut, "\n");
+    }
+}
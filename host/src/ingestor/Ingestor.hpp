@@ -0,0 +1,106 @@
+#ifndef INGESTOR_HPP
+#define INGESTOR_HPP
+
+#include "SerialFrame.hpp"
+#include "recordLog/RecordLog.hpp"
+
+#include <stdio.h>
+
+/**
+ * Turns the receiver's framed stream into records, see shared/SerialFrame/SerialFrame.hpp.
+ *
+ * Bytes are decoded as they arrive into one fixed frame buffer, and readings are collected in a
+ * fixed batch that goes to the record log when it fills or when flush() is called, so nothing is
+ * allocated once it is running.
+ */
+class Ingestor
+{
+    public:
+        const static uint16_t MAX_BATCH = 256;
+        const static uint16_t NUM_PROBE_IDS = 256;
+
+        struct Counters
+        {
+            uint64_t bytes;
+            uint64_t frames;
+            uint64_t readings;
+            uint64_t failures;
+            uint64_t logs;
+            uint64_t decodeErrors;     // Frames dropped by the decoder
+            uint64_t unknownFrames;    // Good frames of another version or channel
+            uint64_t writeErrors;
+        };
+
+        struct ProbeStats
+        {
+            uint64_t readings;
+            uint64_t failures;
+            uint64_t latencyCount;
+            uint64_t latencyTotalUs;
+            uint64_t latencyMaxUs;
+            uint64_t requestTimeUs;    // When it was last asked for, 0 if no request is waiting
+        };
+
+        /**
+         * @param   pLog    Where batches go
+         */
+        Ingestor(RecordLog* pLog);
+        ~Ingestor(){}
+
+        /**
+         * Note that a probe has been asked for, its result is timed from here
+         * @param   nowUs   Monotonic time
+         */
+        void onRequest(uint8_t probeId, uint64_t nowUs);
+
+        /**
+         * Decode bytes read from the port. The times are taken once per read, as the frames in it
+         * arrived together
+         * @param   nowUs   Monotonic time, for latency
+         * @param   wallMs  Wall clock time, for the records
+         * @return  Number of results (readings and failures) in the bytes
+         */
+        uint32_t addBytes(const uint8_t* data, size_t length, uint64_t nowUs, uint64_t wallMs);
+
+        /**
+         * Write out the readings batched so far
+         * @return  False if the write failed, the batch is dropped either way
+         */
+        bool flush();
+
+        /**
+         * @param   echo    True to print LOG frames to stderr as they arrive
+         */
+        void setEchoLogs(bool echo){ echoLogs_ = echo; }
+
+        const Counters& getCounters(){ return counters_; }
+        const ProbeStats& getProbeStats(uint8_t probeId){ return probeStats_[probeId]; }
+
+        /**
+         * Print the counters, and latency for each probe heard from
+         * @param   seconds     Time since the previous counters, for rates
+         * @param   previous    The counters printed last time
+         */
+        void printStats(FILE* pOut, double seconds, const Counters& previous);
+
+    private:
+        uint8_t frameBuffer_[Frame::encodedLength(Frame::MAX_PAYLOAD_LEN)];
+        Frame::Decoder decoder_;
+        RecordLog* pLog_;
+
+        Record batch_[MAX_BATCH];
+        uint16_t batchLength_;
+
+        Counters counters_;
+        ProbeStats probeStats_[NUM_PROBE_IDS];
+        bool echoLogs_;
+
+        /**
+         * Handle a good frame from the decoder
+         * @return  True if it was a result
+         */
+        bool handleFrame(uint64_t nowUs, uint64_t wallMs);
+        void recordLatency(uint16_t probeId, uint64_t nowUs);
+};
+
+#endif
@@ -0,0 +1,459 @@
+/**
+ * Host ingestion daemon for the receiver's framed serial link, see shared/SerialFrame/SerialFrame.hpp.
+ *
+ * Build from this directory:
+ *      cmake -S . -B build && cmake --build build
+ *
+ * Run against the receiver, or a pty standing in for it:
+ *      ./veranus_ingest --port /dev/ttyUSB0 [--baud 38400] [--out readings.csv] [--poll-ms 5000]
+ *                       [--probes 1,2,3] [--subscribe] [--stats-s 10]
+ * Sends READ for the probes listed every poll period, or SCAN for every probe the receiver knows
+ * if none are. With --subscribe the receiver is asked to send results itself each period, rounded
+ * to whole seconds, and is handed back a CREDIT for each result read. Readings are appended to the output file in batches,
+ * and failures, decode errors and per-probe latency from each READ are printed to stderr every
+ * stats period. Ctrl-C writes out the last batch and stops.
+ *
+ * Replay benchmark:
+ *      ./veranus_ingest --replay <capture|synthetic> [--frames 1000000] [--repeat 1] [--out file]
+ * Runs a capture of the link, or generated frames with about 1% corrupted, through the same path
+ * as the port, a read's worth at a time, and reports the sustained frames per second. Records are
+ * only written if an output file is given.
+ */
+
+#include "SerialFrame.hpp"
+#include "VeranusProtocol.hpp"
+#include "ingestor/Ingestor.hpp"
+#include "recordLog/RecordLog.hpp"
+#include "serialPort/SerialPort.hpp"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <random>
+#include <vector>
+
+const static uint32_t DEFAULT_BAUD = 38400;
+const static uint32_t DEFAULT_POLL_MS = 5000;
+const static uint32_t DEFAULT_STATS_S = 10;
+const static uint32_t FLUSH_MS = 1000;
+const static size_t READ_LEN = 4096;
+
+// Credits go back a few at a time rather than a command per result
+const static uint8_t CREDIT_BATCH = 4;
+
+struct Options
+{
+    const char* port;
+    uint32_t baud;
+    const char* out;
+    uint32_t pollMs;
+    uint8_t probeIds[Frame::MAX_PROBES];
+    uint8_t numProbes;
+    bool subscribe;
+    uint32_t statsS;
+    const char* replay;
+    uint32_t frames;
+    uint32_t repeat;
+};
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void onSignal(int)
+{
+    stopRequested = 1;
+}
+
+static uint64_t monotonicUs()
+{
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((uint64_t)now.tv_sec * 1000000) + (now.tv_nsec / 1000);
+}
+
+static uint64_t wallMs()
+{
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return ((uint64_t)now.tv_sec * 1000) + (now.tv_nsec / 1000000);
+}
+
+/**
+ * Build a command followed by the probe IDs, space separated
+ */
+static void formatProbeCommand(char* line, size_t length, const char* command, const Options& options)
+{
+    size_t used = snprintf(line, length, "%s", command);
+    for (uint8_t i=0; i<options.numProbes; i++)
+    {
+        used += snprintf(&line[used], length - used, " %u", options.probeIds[i]);
+    }
+    snprintf(&line[used], length - used, "\n");
+}
+
+/**
+ * Ask for the next round of results
+ */
+static bool sendPoll(SerialPort& port, Ingestor& ingestor, const Options& options, uint64_t nowUs)
+{
+    char line[80];
+    if (options.numProbes > 0)
+    {
+        formatProbeCommand(line, sizeof(line), "READ", options);
+        for (uint8_t i=0; i<options.numProbes; i++)
+        {
+            ingestor.onRequest(options.probeIds[i], nowUs);
+        }
+    }
+    else
+    {
+        // The receiver picks the probes, so time the ones it has answered for before
+        snprintf(line, sizeof(line), "SCAN\n");
+        for (uint16_t i=0; i<Ingestor::NUM_PROBE_IDS; i++)
+        {
+            const Ingestor::ProbeStats& stats = ingestor.getProbeStats(i);
+            if ((stats.readings + stats.failures) > 0) ingestor.onRequest(i, nowUs);
+        }
+    }
+
+    return port.writeLine(line);
+}
+
+static bool sendSubscribe(SerialPort& port, const Options& options)
+{
+    char line[80];
+    snprintf(line, sizeof(line), "PERIOD %u\n", (options.pollMs + 500) / 1000);
+    if (!port.writeLine(line)) return false;
+
+    // Starts the receiver with a full set of credits, so also recovers any lost with a frame
+    formatProbeCommand(line, sizeof(line), "SUBSCRIBE", options);
+    return port.writeLine(line);
+}
+
+static bool sendCredits(SerialPort& port, uint32_t& pendingCredits)
+{
+    while (pendingCredits > 0)
+    {
+        uint8_t credits = (pendingCredits > Frame::MAX_CREDITS) ? Frame::MAX_CREDITS : pendingCredits;
+        char line[16];
+        snprintf(line, sizeof(line), "CREDIT %u\n", credits);
+        if (!port.writeLine(line)) return false;
+        pendingCredits -= credits;
+    }
+
+    return true;
+}
+
+static int runDaemon(const Options& options)
+{
+    SerialPort port;
+    RecordLog log;
+    if (!port.open(options.port, options.baud) || !log.open(options.out)) return 1;
+
+    static Ingestor ingestor(&log);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    const uint64_t pollUs = (uint64_t)options.pollMs * 1000;
+    const uint64_t flushUs = (uint64_t)FLUSH_MS * 1000;
+    const uint64_t statsUs = (uint64_t)options.statsS * 1000000;
+
+    // A subscription that has gone quiet for this long has run out of credits, or been reset
+    const uint64_t resubscribeUs = (3 * pollUs) + 10000000;
+
+    uint64_t startUs = monotonicUs();
+    uint64_t nextPollUs = startUs;
+    uint64_t nextFlushUs = startUs + flushUs;
+    uint64_t nextStatsUs = startUs + statsUs;
+    uint64_t lastStatsUs = startUs;
+    uint64_t lastResultUs = startUs;
+    uint32_t pendingCredits = 0;
+    Ingestor::Counters lastCounters = ingestor.getCounters();
+
+    bool success = true;
+    if (options.subscribe) success = sendSubscribe(port, options);
+
+    uint8_t input[READ_LEN];
+    while (success && !stopRequested)
+    {
+        uint64_t nowUs = monotonicUs();
+        if (!options.subscribe && (nowUs >= nextPollUs))
+        {
+            success = sendPoll(port, ingestor, options, nowUs);
+
+            // Skip rounds missed rather than sending them all at once
+            nextPollUs += pollUs;
+            if (nextPollUs <= nowUs) nextPollUs = nowUs + pollUs;
+        }
+
+        uint64_t wakeUs = (nextFlushUs < nextStatsUs) ? nextFlushUs : nextStatsUs;
+        if (!options.subscribe && (nextPollUs < wakeUs)) wakeUs = nextPollUs;
+        int timeoutMs = (wakeUs > nowUs) ? (int)(((wakeUs - nowUs) + 999) / 1000) : 0;
+
+        pollfd pfd = {port.getFd(), POLLIN, 0};
+        int ready = poll(&pfd, 1, timeoutMs);
+        if ((ready < 0) && (errno != EINTR))
+        {
+            perror("poll");
+            break;
+        }
+
+        if ((ready > 0) && (pfd.revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            int numRead;
+            while ((numRead = port.read(input, sizeof(input))) > 0)
+            {
+                nowUs = monotonicUs();
+                uint32_t numResults = ingestor.addBytes(input, numRead, nowUs, wallMs());
+                if (numResults > 0) lastResultUs = nowUs;
+                if (options.subscribe) pendingCredits += numResults;
+            }
+
+            if (numRead < 0)
+            {
+                fprintf(stderr, "Port closed\n");
+                break;
+            }
+
+            if (options.subscribe && (pendingCredits >= CREDIT_BATCH))
+            {
+                success = sendCredits(port, pendingCredits);
+            }
+        }
+
+        nowUs = monotonicUs();
+        if (nowUs >= nextFlushUs)
+        {
+            ingestor.flush();
+            nextFlushUs = nowUs + flushUs;
+
+            if (options.subscribe)
+            {
+                // Odd credits left over from a round go back here
+                if (success) success = sendCredits(port, pendingCredits);
+
+                if (success && ((nowUs - lastResultUs) >= resubscribeUs))
+                {
+                    success = sendSubscribe(port, options);
+                    lastResultUs = nowUs;
+                }
+            }
+        }
+
+        if (nowUs >= nextStatsUs)
+        {
+            ingestor.printStats(stderr, (nowUs - lastStatsUs) / 1e6, lastCounters);
+            lastCounters = ingestor.getCounters();
+            lastStatsUs = nowUs;
+            nextStatsUs = nowUs + statsUs;
+        }
+    }
+
+    if (options.subscribe) port.writeLine("UNSUBSCRIBE\n");
+
+    ingestor.flush();
+    uint64_t endUs = monotonicUs();
+    ingestor.printStats(stderr, (endUs - startUs) / 1e6, Ingestor::Counters());
+    return success ? 0 : 1;
+}
+
+/**
+ * Frames as a subscription to 16 probes would send them, with some failures and log lines
+ */
+static void generateFrames(std::vector<uint8_t>& stream, uint32_t numFrames)
+{
+    std::mt19937 random(1);
+    uint8_t encoded[Frame::encodedLength(Frame::MAX_PAYLOAD_LEN)];
+    for (uint32_t i=0; i<numFrames; i++)
+    {
+        uint8_t length;
+        uint32_t kind = random() % 20;
+        if (kind < 18)
+        {
+            uint8_t reading[sizeof(Protocol::Reading)];
+            Protocol::encode(reading, 1 + (i % Frame::MAX_PROBES), random(), random(), random());
+            length = Frame::encode(Frame::Channel::DATA, reading, sizeof(reading), encoded);
+        }
+        else if (kind < 19)
+        {
+            uint8_t probeId = 1 + (i % Frame::MAX_PROBES);
+            length = Frame::encode(Frame::Channel::FAILURE, &probeId, 1, encoded);
+        }
+        else
+        {
+            char line[40];
+            int lineLength = snprintf(line, sizeof(line), "Successes: %u, failures: %u",
+                                      (unsigned)(random() % 65536), (unsigned)(random() % 65536));
+            length = Frame::encode(Frame::Channel::LOG, line, lineLength, encoded);
+        }
+
+        if ((random() % 100) == 0) encoded[random() % (length - 1)] ^= 1 + (random() % 255);
+        stream.insert(stream.end(), encoded, encoded + length);
+    }
+}
+
+static bool loadCapture(std::vector<uint8_t>& stream, const char* path)
+{
+    FILE* pFile = fopen(path, "rb");
+    if (pFile == nullptr)
+    {
+        perror(path);
+        return false;
+    }
+
+    uint8_t input[READ_LEN];
+    size_t numRead;
+    while ((numRead = fread(input, 1, sizeof(input), pFile)) > 0)
+    {
+        stream.insert(stream.end(), input, input + numRead);
+    }
+    fclose(pFile);
+    return true;
+}
+
+static int runReplay(const Options& options)
+{
+    std::vector<uint8_t> stream;
+    if (strcmp(options.replay, "synthetic") == 0)
+    {
+        generateFrames(stream, options.frames);
+    }
+    else if (!loadCapture(stream, options.replay))
+    {
+        return 1;
+    }
+
+    RecordLog log;
+    if ((options.out != nullptr) && !log.open(options.out)) return 1;
+
+    static Ingestor ingestor(&log);
+    ingestor.setEchoLogs(false);
+
+    uint64_t startUs = monotonicUs();
+    for (uint32_t pass=0; pass<options.repeat; pass++)
+    {
+        for (size_t position=0; position<stream.size(); position+=READ_LEN)
+        {
+            size_t length = ((stream.size() - position) < READ_LEN) ? (stream.size() - position) : READ_LEN;
+            ingestor.addBytes(&stream[position], length, monotonicUs(), wallMs());
+        }
+    }
+    ingestor.flush();
+    double seconds = (monotonicUs() - startUs) / 1e6;
+
+    const Ingestor::Counters& counters = ingestor.getCounters();
+    double bytesPerSecond = counters.bytes / seconds;
+    double linkBytesPerSecond = DEFAULT_BAUD / 10.0;
+    printf("%llu bytes, %llu frames, %llu readings, %llu failures, %llu logs, %llu decode errors\n",
+           (unsigned long long)counters.bytes,
+           (unsigned long long)counters.frames,
+           (unsigned long long)counters.readings,
+           (unsigned long long)counters.failures,
+           (unsigned long long)counters.logs,
+           (unsigned long long)counters.decodeErrors);
+    printf("%.3f s, %.0f frames/s, %.1f MB/s, %.0fx a %u baud link, %llu bytes of records\n",
+           seconds,
+           counters.frames / seconds,
+           bytesPerSecond / 1e6,
+           bytesPerSecond / linkBytesPerSecond,
+           DEFAULT_BAUD,
+           (unsigned long long)log.getBytesWritten());
+    return (counters.writeErrors == 0) ? 0 : 1;
+}
+
+static bool parseProbes(Options& options, const char* list)
+{
+    options.numProbes = 0;
+    while (*list != '\0')
+    {
+        char* pEnd;
+        unsigned long probeId = strtoul(list, &pEnd, 10);
+        if ((pEnd == list) || (probeId > UINT8_MAX) || (options.numProbes >= Frame::MAX_PROBES)) return false;
+
+        options.probeIds[options.numProbes++] = probeId;
+        list = (*pEnd == ',') ? pEnd + 1 : pEnd;
+        if ((*pEnd != ',') && (*pEnd != '\0')) return false;
+    }
+
+    return true;
+}
+
+static void printUsage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s --port <device> [--baud %u] [--out readings.csv] [--poll-ms %u]\n"
+            "          [--probes id,id,...] [--subscribe] [--stats-s %u]\n"
+            "       %s --replay <capture|synthetic> [--frames N] [--repeat N] [--out file]\n",
+            name, DEFAULT_BAUD, DEFAULT_POLL_MS, DEFAULT_STATS_S, name);
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    memset(&options, 0, sizeof(options));
+    options.baud = DEFAULT_BAUD;
+    options.pollMs = DEFAULT_POLL_MS;
+    options.statsS = DEFAULT_STATS_S;
+    options.frames = 1000000;
+    options.repeat = 1;
+
+    for (int i=1; i<argc; i++)
+    {
+        const char* option = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : nullptr;
+        bool hasValue = true;
+
+        if (strcmp(option, "--subscribe") == 0)
+        {
+            options.subscribe = true;
+            hasValue = false;
+        }
+        else if (value == nullptr)
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+        else if (strcmp(option, "--port") == 0) options.port = value;
+        else if (strcmp(option, "--baud") == 0) options.baud = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--out") == 0) options.out = value;
+        else if (strcmp(option, "--poll-ms") == 0) options.pollMs = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--stats-s") == 0) options.statsS = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--replay") == 0) options.replay = value;
+        else if (strcmp(option, "--frames") == 0) options.frames = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--repeat") == 0) options.repeat = strtoul(value, nullptr, 10);
+        else if (strcmp(option, "--probes") == 0)
+        {
+            if (!parseProbes(options, value))
+            {
+                fprintf(stderr, "Expected up to %u probe IDs of 0-255, comma separated\n", Frame::MAX_PROBES);
+                return 1;
+            }
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        if (hasValue) i++;
+    }
+
+    if (options.replay != nullptr) return runReplay(options);
+
+    if ((options.port == nullptr) || (options.pollMs == 0) || (options.statsS == 0))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (options.out == nullptr) options.out = "readings.csv";
+
+    return runDaemon(options);
+}
@@ -0,0 +1,101 @@
+#include "recordLog/RecordLog.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/**
+ * Write a fixed point hundredths value as a decimal, which printf would do with floats
+ */
+static char* formatHundredths(char* out, int32_t value)
+{
+    if (value < 0)
+    {
+        *out++ = '-';
+        value = -value;
+    }
+    return out + sprintf(out, "%d.%02d", value / 100, value % 100);
+}
+
+RecordLog::RecordLog():
+    fd_(-1),
+    bytesWritten_(0)
+{
+}
+
+RecordLog::~RecordLog()
+{
+    close();
+}
+
+bool RecordLog::open(const char* path)
+{
+    close();
+
+    fd_ = ::open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    return true;
+}
+
+void RecordLog::close()
+{
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool RecordLog::write(const Record* records, size_t count)
+{
+    size_t length = 0;
+    for (size_t i=0; i<count; i++)
+    {
+        // A batch bigger than the buffer goes out in pieces
+        if ((length + MAX_LINE_LEN) > BUFFER_LEN)
+        {
+            if (!writeAll(buffer_, length)) return false;
+            length = 0;
+        }
+
+        const Record& record = records[i];
+        char* pLine = &buffer_[length];
+        char* pEnd = pLine + sprintf(pLine, "%llu,%u,", (unsigned long long)record.timeMs, record.probeId);
+        pEnd = formatHundredths(pEnd, record.temperature);
+        *pEnd++ = ',';
+        pEnd = formatHundredths(pEnd, record.humidity);
+        *pEnd++ = ',';
+        pEnd = formatHundredths(pEnd, record.light);
+        *pEnd++ = '\n';
+        length += pEnd - pLine;
+    }
+
+    return writeAll(buffer_, length);
+}
+
+bool RecordLog::writeAll(const char* data, size_t length)
+{
+    if (fd_ < 0) return true;
+
+    while (length > 0)
+    {
+        ssize_t result = ::write(fd_, data, length);
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Record log write failed: %s\n", strerror(errno));
+            return false;
+        }
+
+        data += result;
+        length -= result;
+        bytesWritten_ += result;
+    }
+
+    return true;
+}
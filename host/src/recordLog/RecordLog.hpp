@@ -0,0 +1,58 @@
+#ifndef RECORD_LOG_HPP
+#define RECORD_LOG_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * A reading from a probe, as received
+ */
+struct Record
+{
+    uint64_t timeMs;        // Host wall clock, milliseconds since the epoch
+    uint16_t probeId;
+    int16_t temperature;    // Hundredths of a degree Fahrenheit
+    uint16_t humidity;      // Hundredths of a percent
+    uint16_t light;         // Hundredths of a percent
+};
+
+/**
+ * Append only file of readings, one CSV line each:
+ *      timeMs,probeId,temperatureF,humidity,light
+ *
+ * Records are written a batch at a time with a single write(), so a reader never sees half a
+ * batch unless the disk fills, and the daemon only makes a system call per batch
+ */
+class RecordLog
+{
+    public:
+        RecordLog();
+        ~RecordLog();
+
+        /**
+         * @param   path    File to append to, created if it does not exist
+         * @return  False if it could not be opened, the reason is printed
+         */
+        bool open(const char* path);
+        void close();
+
+        /**
+         * @return  False if the write failed
+         */
+        bool write(const Record* records, size_t count);
+
+        uint64_t getBytesWritten(){ return bytesWritten_; }
+
+    private:
+        // Longest line, "18446744073709551615,65535,-327.68,655.35,655.35\n"
+        const static size_t MAX_LINE_LEN = 64;
+        const static size_t BUFFER_LEN = 16384;
+
+        int fd_;
+        char buffer_[BUFFER_LEN];
+        uint64_t bytesWritten_;
+
+        bool writeAll(const char* data, size_t length);
+};
+
+#endif
@@ -0,0 +1,120 @@
+#include "serialPort/SerialPort.hpp"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static bool toSpeed(uint32_t baud, speed_t& speed)
+{
+    switch (baud)
+    {
+        case 9600:      speed = B9600;      return true;
+        case 19200:     speed = B19200;     return true;
+        case 38400:     speed = B38400;     return true;
+        case 57600:     speed = B57600;     return true;
+        case 115200:    speed = B115200;    return true;
+        case 230400:    speed = B230400;    return true;
+        default:        return false;
+    }
+}
+
+SerialPort::SerialPort():
+    fd_(-1)
+{
+}
+
+SerialPort::~SerialPort()
+{
+    close();
+}
+
+bool SerialPort::open(const char* path, uint32_t baud)
+{
+    close();
+
+    fd_ = ::open(path, O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "Cannot open %s: %s\n", path, strerror(errno));
+        return false;
+    }
+
+    if (!isatty(fd_)) return true;
+
+    speed_t speed;
+    termios tty;
+    if (!toSpeed(baud, speed))
+    {
+        fprintf(stderr, "Unsupported baud rate %u\n", baud);
+        close();
+        return false;
+    }
+    if (tcgetattr(fd_, &tty) != 0)
+    {
+        fprintf(stderr, "Cannot read settings of %s: %s\n", path, strerror(errno));
+        close();
+        return false;
+    }
+
+    // 8N1, no flow control, and nothing done to the bytes either way
+    cfmakeraw(&tty);
+    tty.c_cflag |= CLOCAL | CREAD;
+    tty.c_cflag &= ~(CSTOPB | CRTSCTS);
+    cfsetispeed(&tty, speed);
+    cfsetospeed(&tty, speed);
+    if (tcsetattr(fd_, TCSANOW, &tty) != 0)
+    {
+        fprintf(stderr, "Cannot set up %s: %s\n", path, strerror(errno));
+        close();
+        return false;
+    }
+
+    tcflush(fd_, TCIOFLUSH);
+    return true;
+}
+
+void SerialPort::close()
+{
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+int SerialPort::read(uint8_t* buffer, size_t length)
+{
+    ssize_t numRead = ::read(fd_, buffer, length);
+    if (numRead > 0) return numRead;
+
+    // Zero is the other end of a pty going away
+    if ((numRead < 0) && ((errno == EAGAIN) || (errno == EINTR))) return 0;
+    return -1;
+}
+
+bool SerialPort::writeLine(const char* line)
+{
+    size_t length = strlen(line);
+    size_t written = 0;
+    while (written < length)
+    {
+        ssize_t result = ::write(fd_, line + written, length - written);
+        if (result > 0)
+        {
+            written += result;
+        }
+        else if ((result < 0) && ((errno == EAGAIN) || (errno == EINTR)))
+        {
+            // Lines are short, this only waits when the port's buffer is full
+            pollfd pfd = {fd_, POLLOUT, 0};
+            poll(&pfd, 1, 100);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
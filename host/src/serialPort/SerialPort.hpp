@@ -0,0 +1,43 @@
+#ifndef SERIAL_PORT_HPP
+#define SERIAL_PORT_HPP
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The receiver's serial port, or a pty standing in for it. Opened non-blocking and raw, so the
+ * daemon can wait on it with poll() alongside its timers
+ */
+class SerialPort
+{
+    public:
+        SerialPort();
+        ~SerialPort();
+
+        /**
+         * @param   path    Device to open
+         * @param   baud    Line speed, only set if the device is a terminal
+         * @return  False if it could not be opened or set up, the reason is printed
+         */
+        bool open(const char* path, uint32_t baud);
+        void close();
+
+        /**
+         * Read whatever has arrived, without waiting
+         * @return  Bytes read, 0 if there was nothing, -1 if the port has gone
+         */
+        int read(uint8_t* buffer, size_t length);
+
+        /**
+         * Write a command line, waiting for the port to take all of it
+         * @return  False if the port has gone
+         */
+        bool writeLine(const char* line);
+
+        int getFd(){ return fd_; }
+
+    private:
+        int fd_;
+};
+
+#endif
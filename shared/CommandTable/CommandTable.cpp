@@ -0,0 +1,299 @@
+#include "CommandTable.hpp"
+
+#include <string.h>
+
+#ifndef __AVR__
+// Flash is ordinary memory off the AVR, for building on the host
+#define memcpy_P memcpy
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#endif
+
+using namespace Commands;
+
+const static uint8_t NO_COMMAND = UINT8_MAX;
+
+/**
+ * Split the next word off the line, ending it in place
+ * @param   cursor  Where to look from, moved past the word
+ * @return  The word, or nullptr if the line has no more
+ */
+static char* nextWord(char*& cursor)
+{
+    while (*cursor == ' ') cursor++;
+    if (*cursor == '\0') return nullptr;
+
+    char* word = cursor;
+    while ((*cursor != ' ') && (*cursor != '\0')) cursor++;
+    if (*cursor == ' ') *cursor++ = '\0';
+    return word;
+}
+
+/**
+ * Check a command's name against a line's name and sub command
+ */
+static bool isNamed(const char* commandName, const char* name, const char* sub)
+{
+    uint8_t length = strlen(name);
+    if (strncmp(commandName, name, length) != 0) return false;
+    if (sub == nullptr) return commandName[length] == '\0';
+
+    return (commandName[length] == ' ') && (strcmp(&commandName[length + 1], sub) == 0);
+}
+
+/**
+ * Parse a whole word as a decimal integer, which may be negative
+ * @return  False if it is not a number, or too long to be one that fits
+ */
+static bool parseInt(const char* word, int32_t& value)
+{
+    const static uint8_t MAX_DIGITS = 9;
+
+    bool negative = (*word == '-');
+    if (negative) word++;
+
+    uint8_t numDigits = 0;
+    int32_t result = 0;
+    for (; *word != '\0'; word++)
+    {
+        if ((*word < '0') || (*word > '9') || (numDigits >= MAX_DIGITS)) return false;
+        result = (result * 10) + (*word - '0');
+        numDigits++;
+    }
+
+    if (numDigits == 0) return false;
+    value = negative ? -result : result;
+    return true;
+}
+
+/**
+ * Add text to a buffer, keeping it terminated
+ * @return  False if it did not all fit
+ */
+static bool append(char* buffer, uint8_t length, uint8_t& index, const char* text)
+{
+    for (; *text != '\0'; text++)
+    {
+        if ((index + 1) >= length)
+        {
+            buffer[index] = '\0';
+            return false;
+        }
+        buffer[index++] = *text;
+    }
+    buffer[index] = '\0';
+    return true;
+}
+
+static bool appendInt(char* buffer, uint8_t length, uint8_t& index, int32_t value)
+{
+    // Digits come out backwards, so they are built up from the end
+    char digits[12];
+    uint8_t i = sizeof(digits) - 1;
+    digits[i] = '\0';
+
+    uint32_t magnitude = (value < 0) ? -(uint32_t)value : value;
+    do
+    {
+        digits[--i] = '0' + (magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude > 0);
+    if (value < 0) digits[--i] = '-';
+
+    return append(buffer, length, index, &digits[i]);
+}
+
+/**
+ * Get the spec for an argument, the last one declared covers any past it
+ */
+static const ArgSpec& getSpec(const Command& command, uint8_t index)
+{
+    if (index >= MAX_ARG_SPECS) index = MAX_ARG_SPECS - 1;
+    while ((index > 0) && (command.args[index].type == ArgType::NONE)) index--;
+    return command.args[index];
+}
+
+CommandTable::CommandTable(const Command* commands,
+                           uint8_t numCommands,
+                           const uint8_t* slots,
+                           uint8_t mask,
+                           uint16_t seed,
+                           char* lineBuffer,
+                           uint8_t lineLength,
+                           ReadChar readChar,
+                           OnError onError):
+    commands_(commands),
+    numCommands_(numCommands),
+    slots_(slots),
+    mask_(mask),
+    seed_(seed),
+    lineBuffer_(lineBuffer),
+    lineLength_(lineLength),
+    lineIndex_(0),
+    overflowed_(false),
+    enabled_(false),
+    readChar_(readChar),
+    onError_(onError)
+{
+}
+
+void CommandTable::enable()
+{
+    char c;
+    while (readChar_(c));
+
+    lineIndex_ = 0;
+    overflowed_ = false;
+    enabled_ = true;
+}
+
+void CommandTable::update()
+{
+    if (!enabled_) return;
+
+    char c;
+    while (readChar_(c))
+    {
+        if ((c == '\r') || (c == '\n'))
+        {
+            Result result = Result::NONE;
+            if (overflowed_)
+            {
+                result = Result::TOO_LONG;
+            }
+            else if (lineIndex_ > 0)
+            {
+                lineBuffer_[lineIndex_] = '\0';
+                result = execute(lineBuffer_);
+            }
+
+            if ((result != Result::NONE) && (result != Result::OK) && (onError_ != nullptr))
+            {
+                onError_(result);
+            }
+
+            lineIndex_ = 0;
+            overflowed_ = false;
+        }
+        else if ((lineIndex_ + 1) < lineLength_)
+        {
+            lineBuffer_[lineIndex_++] = c;
+        }
+        else
+        {
+            // Nothing more is kept, the rest of the line is dropped when it ends
+            overflowed_ = true;
+        }
+    }
+}
+
+Result CommandTable::execute(char* line)
+{
+    char* cursor = line;
+    const char* name = nextWord(cursor);
+    if (name == nullptr) return Result::NONE;
+
+    Command command;
+    uint16_t hash = hashString(name, HASH_START);
+
+    // A sub command is tried first, falling back to the second word being an argument
+    char* argStart = cursor;
+    const char* sub = nextWord(cursor);
+    if ((sub == nullptr) ||
+        !find(hashString(sub, hashChar(hash, ' ')), name, sub, command))
+    {
+        if (sub != nullptr)
+        {
+            // Put the line back together for the arguments, unless the word ended it
+            char* end = argStart + strlen(argStart);
+            if (end != cursor) *end = ' ';
+            cursor = argStart;
+        }
+        if (!find(hash, name, nullptr, command)) return Result::UNKNOWN;
+    }
+
+    Args args;
+    Result result = parseArgs(command, cursor, args);
+    if (result != Result::OK) return result;
+
+    command.handler(args);
+    return Result::OK;
+}
+
+bool CommandTable::getUsage(uint8_t index, char* buffer, uint8_t length)
+{
+    Command command;
+    memcpy_P(&command, &commands_[index], sizeof(Command));
+
+    uint8_t bufferIndex = 0;
+    if (!append(buffer, length, bufferIndex, command.name)) return false;
+
+    for (uint8_t i=0; i<command.maxArgs; i++)
+    {
+        if ((i >= MAX_ARG_SPECS) || (command.args[i].type == ArgType::NONE))
+        {
+            // The rest repeat the last declared argument
+            return append(buffer, length, bufferIndex, " ...");
+        }
+
+        const ArgSpec& spec = command.args[i];
+        bool optional = (i >= command.minArgs);
+        if (!append(buffer, length, bufferIndex, optional ? " [" : " <") ||
+            !append(buffer, length, bufferIndex, spec.name))
+        {
+            return false;
+        }
+
+        if ((spec.type == ArgType::INT) &&
+            (!append(buffer, length, bufferIndex, " ") ||
+             !appendInt(buffer, length, bufferIndex, spec.min) ||
+             !append(buffer, length, bufferIndex, "-") ||
+             !appendInt(buffer, length, bufferIndex, spec.max)))
+        {
+            return false;
+        }
+
+        if (!append(buffer, length, bufferIndex, optional ? "]" : ">")) return false;
+    }
+
+    return true;
+}
+
+bool CommandTable::find(uint16_t hash, const char* name, const char* sub, Command& command)
+{
+    uint8_t index = pgm_read_byte(&slots_[hashSlot(hash, seed_, mask_)]);
+    if (index == NO_COMMAND) return false;
+
+    // The slot only says which command it could be, the name is what decides
+    memcpy_P(&command, &commands_[index], sizeof(Command));
+    return isNamed(command.name, name, sub);
+}
+
+Result CommandTable::parseArgs(const Command& command, char* line, Args& args)
+{
+    args.count = 0;
+    const char* word;
+    while ((word = nextWord(line)) != nullptr)
+    {
+        if ((args.count >= command.maxArgs) || (args.count >= MAX_ARGS)) return Result::NUM_ARGS;
+
+        const ArgSpec& spec = getSpec(command, args.count);
+        if (spec.type == ArgType::INT)
+        {
+            int32_t value;
+            if (!parseInt(word, value) ||
+                (value < spec.min) ||
+                (value > spec.max))
+            {
+                return Result::BAD_ARG;
+            }
+            args.args[args.count].value = value;
+        }
+        else
+        {
+            args.args[args.count].word = word;
+        }
+        args.count++;
+    }
+
+    return (args.count < command.minArgs) ? Result::NUM_ARGS : Result::OK;
+}
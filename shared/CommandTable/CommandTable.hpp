@@ -0,0 +1,269 @@
+#ifndef COMMAND_TABLE_HPP
+#define COMMAND_TABLE_HPP
+
+#include <stdint.h>
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+#define PROGMEM
+#endif
+
+/**
+ * Serial command line with its commands in a table in flash, shared by the probe and the receiver.
+ *
+ * Each command is a name, optionally followed by a sub command word ("WIFI SET"), and declares
+ * its arguments: words, or integers with a range. Lines are looked up with a perfect hash built
+ * at compile time, the arguments are checked against the declaration, and the handler only runs
+ * with arguments that are already parsed and in range. Usage text is generated from the table.
+ *
+ * To build a table:
+ *      constexpr static Commands::Command commands[] PROGMEM = { ... };
+ *      typedef Commands::HashTable<commands, sizeof(commands) / sizeof(commands[0])> CommandHash;
+ * then pass the commands, CommandHash::slots, CommandHash::MASK and CommandHash::SEED to a
+ * CommandTable.
+ */
+namespace Commands
+{
+    const static uint8_t NAME_LEN = 12;         // Name and sub command, with a space between
+    const static uint8_t ARG_NAME_LEN = 6;
+    const static uint8_t MAX_ARG_SPECS = 2;     // Arguments past these repeat the last one
+    const static uint8_t MAX_ARGS = 16;
+
+    enum class ArgType: uint8_t
+    {
+        NONE = 0,
+        INT,
+        WORD
+    };
+
+    struct ArgSpec
+    {
+        char name[ARG_NAME_LEN];
+        ArgType type;
+        int32_t min;
+        int32_t max;
+    };
+
+    /**
+     * Arguments of a command, as declared. Integers are parsed and in range
+     */
+    struct Args
+    {
+        uint8_t count;
+        union
+        {
+            int32_t value;
+            const char* word;
+        } args[MAX_ARGS];
+
+        int32_t getInt(uint8_t index) const { return args[index].value; }
+        const char* getWord(uint8_t index) const { return args[index].word; }
+    };
+
+    typedef void (*Handler)(const Args& args);
+
+    struct Command
+    {
+        char name[NAME_LEN];
+        Handler handler;
+        uint8_t minArgs;
+        uint8_t maxArgs;
+        ArgSpec args[MAX_ARG_SPECS];
+    };
+
+    #define CLI_INT(name, min, max)     {name, Commands::ArgType::INT, min, max}
+    #define CLI_WORD(name)              {name, Commands::ArgType::WORD, 0, 0}
+
+    enum class Result: uint8_t
+    {
+        NONE = 0,       // No complete line yet
+        OK,
+        UNKNOWN,        // No command by that name
+        NUM_ARGS,       // Too few or too many arguments
+        BAD_ARG,        // An integer that did not parse or was out of range
+        TOO_LONG        // The line did not fit in the buffer, and was dropped
+    };
+
+    /**
+     * Get the next received character
+     * @return  False if there is none
+     */
+    typedef bool (*ReadChar)(char& c);
+
+    /**
+     * Report a line that could not be run
+     */
+    typedef void (*OnError)(Result result);
+
+    /*
+     * Hashing, the same at compile time and run time. Sub commands continue the hash of the
+     * name through the space, so a line needs no copying to be looked up. The seed only goes
+     * into the final mix, the search for one tries each with the names already hashed
+     */
+    const static uint16_t HASH_START = 5381;
+    const static uint16_t NO_SEED = 0xffff;
+    const static uint16_t MAX_SEED = 1024;
+
+    constexpr uint16_t hashChar(uint16_t hash, char c)
+    {
+        return (uint16_t)((hash * 33u) ^ (uint8_t)c);
+    }
+
+    constexpr uint16_t hashString(const char* s, uint16_t hash)
+    {
+        return (*s == '\0') ? hash : hashString(s + 1, hashChar(hash, *s));
+    }
+
+    constexpr uint8_t hashSlot(uint16_t hash, uint16_t seed, uint8_t mask)
+    {
+        return (uint8_t)(((uint16_t)((hash ^ seed) * 40503u)) >> 8) & mask;
+    }
+
+    constexpr uint8_t commandSlot(const Command* c, uint8_t i, uint16_t seed, uint8_t mask)
+    {
+        return hashSlot(hashString(c[i].name, HASH_START), seed, mask);
+    }
+
+    // At least four times as many slots as commands, so a seed is quick to find
+    constexpr uint8_t tableSize(uint8_t n, uint16_t size = 4)
+    {
+        return (size >= (4 * n)) ? size : tableSize(n, size * 2);
+    }
+
+    constexpr bool noneMatch(const Command* c, uint8_t n, uint16_t seed, uint8_t mask, uint8_t i, uint8_t j)
+    {
+        return (j >= n) ||
+               ((commandSlot(c, i, seed, mask) != commandSlot(c, j, seed, mask)) &&
+                noneMatch(c, n, seed, mask, i, j + 1));
+    }
+
+    constexpr bool isPerfect(const Command* c, uint8_t n, uint16_t seed, uint8_t mask, uint8_t i = 0)
+    {
+        return ((i + 1) >= n) ||
+               (noneMatch(c, n, seed, mask, i, i + 1) && isPerfect(c, n, seed, mask, i + 1));
+    }
+
+    // Searches seeds in halves, so the compiler's recursion depth stays small
+    constexpr uint16_t findSeed(const Command* c, uint8_t n, uint8_t mask, uint16_t low, uint16_t high);
+
+    constexpr uint16_t firstSeed(uint16_t found, const Command* c, uint8_t n, uint8_t mask, uint16_t low, uint16_t high)
+    {
+        return (found != NO_SEED) ? found : findSeed(c, n, mask, low, high);
+    }
+
+    constexpr uint16_t findSeed(const Command* c, uint8_t n, uint8_t mask, uint16_t low, uint16_t high)
+    {
+        return ((high - low) == 1) ?
+               (isPerfect(c, n, low, mask) ? low : NO_SEED) :
+               firstSeed(findSeed(c, n, mask, low, (low + high) / 2), c, n, mask, (low + high) / 2, high);
+    }
+
+    constexpr uint8_t commandInSlot(const Command* c, uint8_t n, uint16_t seed, uint8_t mask, uint8_t slot, uint8_t i = 0)
+    {
+        return (i >= n) ? UINT8_MAX :
+               (commandSlot(c, i, seed, mask) == slot) ? i :
+               commandInSlot(c, n, seed, mask, slot, i + 1);
+    }
+
+    template <uint8_t... I> struct Indices {};
+    template <uint8_t N, uint8_t... I> struct MakeIndices: MakeIndices<N - 1, N - 1, I...> {};
+    template <uint8_t... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
+
+    /**
+     * Perfect hash of a command table, with a slot per hash holding the command's index
+     */
+    template <const Command* C, uint8_t N, typename = typename MakeIndices<tableSize(N)>::type>
+    struct HashTable;
+
+    template <const Command* C, uint8_t N, uint8_t... K>
+    struct HashTable<C, N, Indices<K...>>
+    {
+        constexpr static uint8_t MASK = sizeof...(K) - 1;
+        constexpr static uint16_t SEED = findSeed(C, N, MASK, 0, MAX_SEED);
+        static_assert(SEED != NO_SEED, "No perfect hash for the command table, check for duplicate names");
+
+        const static uint8_t slots[sizeof...(K)];
+    };
+
+    template <const Command* C, uint8_t N, uint8_t... K>
+    const uint8_t HashTable<C, N, Indices<K...>>::slots[sizeof...(K)] PROGMEM =
+    {
+        commandInSlot(C, N, SEED, MASK, K)...
+    };
+
+    class CommandTable
+    {
+        public:
+            /**
+             * @param   commands    Table of commands, in flash
+             * @param   numCommands Number of commands in the table
+             * @param   slots       Hash slots for the table, from HashTable
+             * @param   mask        HashTable::MASK
+             * @param   seed        HashTable::SEED
+             * @param   lineBuffer  Space for the line being received
+             * @param   lineLength  Longest line, including the terminator
+             * @param   readChar    Where characters come from
+             * @param   onError     Called with the reason a line could not be run
+             */
+            CommandTable(const Command* commands,
+                         uint8_t numCommands,
+                         const uint8_t* slots,
+                         uint8_t mask,
+                         uint16_t seed,
+                         char* lineBuffer,
+                         uint8_t lineLength,
+                         ReadChar readChar,
+                         OnError onError);
+
+            /**
+             * Start taking input, anything received before is dropped
+             */
+            void enable();
+
+            /**
+             * Read everything received, and run each line once it is complete
+             */
+            void update();
+
+            /**
+             * Run a line, which is split up in place
+             */
+            Result execute(char* line);
+
+            /**
+             * Write out how to use a command, such as "LIGHT I <min 0-100> <max 0-100>"
+             * @param   index   Position of the command in the table
+             * @return  False if it did not fit in the buffer, the text is cut short
+             */
+            bool getUsage(uint8_t index, char* buffer, uint8_t length);
+
+            uint8_t getNumCommands(){ return numCommands_; }
+
+        private:
+            const Command* commands_;
+            uint8_t numCommands_;
+            const uint8_t* slots_;
+            uint8_t mask_;
+            uint16_t seed_;
+
+            char* lineBuffer_;
+            uint8_t lineLength_;
+            uint8_t lineIndex_;
+            bool overflowed_;
+            bool enabled_;
+
+            ReadChar readChar_;
+            OnError onError_;
+
+            /**
+             * Find a command by its hash, and copy it out of flash
+             * @return  False if no command has that name
+             */
+            bool find(uint16_t hash, const char* name, const char* sub, Command& command);
+
+            Result parseArgs(const Command& command, char* line, Args& args);
+    };
+}
+
+#endif
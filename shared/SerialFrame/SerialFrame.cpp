@@ -0,0 +1,132 @@
+#include "SerialFrame.hpp"
+
+#ifdef __AVR__
+#include <util/crc16.h>
+#endif
+
+using namespace Frame;
+
+uint16_t Frame::crcUpdate(uint16_t crc, uint8_t data)
+{
+#ifdef __AVR__
+    return _crc_ccitt_update(crc, data);
+#else
+    // The C equivalent avr-libc gives for its assembly
+    data ^= (uint8_t)(crc & 0xff);
+    data ^= data << 4;
+    return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+#endif
+}
+
+uint8_t Frame::encode(Channel channel, const void* payload, uint8_t length, uint8_t* buffer)
+{
+    if (length > MAX_PAYLOAD_LEN) return 0;
+
+    const uint8_t* pBytes = (const uint8_t*)payload;
+    uint16_t crc = crcUpdate(CRC_INIT, (uint8_t)channel);
+    for (uint8_t i=0; i<length; i++)
+    {
+        crc = crcUpdate(crc, pBytes[i]);
+    }
+
+    // Each code byte says how far it is to the next zero, which is where the next code goes.
+    // Frames are short enough that a run never reaches the 254 byte limit
+    uint8_t codeIndex = 0;
+    uint8_t index = 1;
+    uint8_t rawLength = length + OVERHEAD_LEN;
+    for (uint8_t i=0; i<rawLength; i++)
+    {
+        uint8_t byte = (i == 0) ? (uint8_t)channel :
+                       (i <= length) ? pBytes[i - 1] :
+                       (i == (length + 1)) ? (uint8_t)(crc & 0xff) :
+                       (uint8_t)(crc >> 8);
+
+        if (byte == 0)
+        {
+            buffer[codeIndex] = index - codeIndex;
+            codeIndex = index++;
+        }
+        else
+        {
+            buffer[index++] = byte;
+        }
+    }
+    buffer[codeIndex] = index - codeIndex;
+    buffer[index++] = DELIMITER;
+
+    return index;
+}
+
+Decoder::Decoder(uint8_t* buffer, uint16_t length):
+    buffer_(buffer),
+    length_(length),
+    count_(0),
+    payloadLength_(0),
+    overflowed_(false),
+    errors_(0),
+    frames_(0)
+{
+}
+
+bool Decoder::addByte(uint8_t byte)
+{
+    if (byte != DELIMITER)
+    {
+        if (count_ < length_)
+        {
+            buffer_[count_++] = byte;
+        }
+        else
+        {
+            overflowed_ = true;
+        }
+        return false;
+    }
+
+    bool good = !overflowed_ && (count_ > 0) && finishFrame();
+    if (good)
+    {
+        frames_++;
+    }
+    else if (overflowed_ || (count_ > 0))
+    {
+        // Back to back delimiters are only idle line, not an error
+        errors_++;
+    }
+
+    count_ = 0;
+    overflowed_ = false;
+    return good;
+}
+
+bool Decoder::finishFrame()
+{
+    // Decode in place, the output never gets ahead of the input
+    uint16_t in = 0;
+    uint16_t out = 0;
+    while (in < count_)
+    {
+        uint8_t code = buffer_[in++];
+        if ((code == 0) || ((in + code - 1) > count_)) return false;
+
+        for (uint8_t i=1; i<code; i++)
+        {
+            buffer_[out++] = buffer_[in++];
+        }
+
+        // A full block of 254 has no zero after it, nor does the end of the frame
+        if ((code != 0xff) && (in < count_)) buffer_[out++] = 0;
+    }
+
+    if ((out < OVERHEAD_LEN) || ((out - OVERHEAD_LEN) > MAX_PAYLOAD_LEN)) return false;
+
+    uint16_t crc = CRC_INIT;
+    for (uint16_t i=0; i<(out - 2); i++)
+    {
+        crc = crcUpdate(crc, buffer_[i]);
+    }
+    if ((buffer_[out - 2] != (crc & 0xff)) || (buffer_[out - 1] != (crc >> 8))) return false;
+
+    payloadLength_ = out - OVERHEAD_LEN;
+    return true;
+}
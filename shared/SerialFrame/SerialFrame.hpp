@@ -0,0 +1,115 @@
+#ifndef SERIAL_FRAME_HPP
+#define SERIAL_FRAME_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Framing for the receiver's link to the host, shared with the host tools.
+ *
+ * Each frame is a channel byte, the payload, and a CRC, COBS encoded so the only zero byte on
+ * the wire is the one that ends the frame:
+ *
+ * | COBS( channel | payload ... | crc (LSB, MSB) ) | 0x00 |
+ *
+ * The CRC is CRC-16/MCRF4XX (avr-libc's _crc_ccitt_update from 0xFFFF) over the channel and
+ * payload. A reader that joins mid-stream, or loses bytes, drops what it has at the
+ * next zero and is back in step from the frame after it.
+ *
+ * Payloads by channel:
+ *  - DATA: a Protocol::Reading
+ *  - FAILURE: the ID of the probe that did not answer, one byte
+ *  - LOG: text, without a line ending
+ */
+namespace Frame
+{
+    enum class Channel: uint8_t
+    {
+        DATA = 1,
+        FAILURE = 2,
+        LOG = 3
+    };
+
+    // Most probe IDs one READ, SCAN or SUBSCRIBE command to the receiver can name
+    const static uint8_t MAX_PROBES = 16;
+
+    // Results a subscriber can be owed at once, so the most one CREDIT command can hand back.
+    // Twelve data frames fill 168 of the receiver's 255 byte UART TX buffer, which leaves room
+    // for log frames, so pushing never waits on the UART
+    const static uint8_t MAX_CREDITS = 12;
+
+    const static uint16_t CRC_INIT = 0xffff;
+    const static uint8_t DELIMITER = 0x00;
+
+    // Longest payload, which keeps a frame to one COBS block and its length in a byte
+    const static uint8_t MAX_PAYLOAD_LEN = 250;
+
+    // Channel and CRC around the payload
+    const static uint8_t OVERHEAD_LEN = 3;
+
+    /**
+     * Longest encoded frame for a payload, including the COBS code byte and the delimiter
+     */
+    constexpr uint8_t encodedLength(uint8_t payloadLength)
+    {
+        return payloadLength + OVERHEAD_LEN + 2;
+    }
+
+    uint16_t crcUpdate(uint16_t crc, uint8_t data);
+
+    // Where a payload goes to be encoded in place, the output never overtakes it
+    const static uint8_t IN_PLACE_OFFSET = 2;
+
+    /**
+     * Build a frame ready to send
+     * @param   payload May be at buffer + IN_PLACE_OFFSET
+     * @param   buffer  At least encodedLength(length) bytes
+     * @return  Length of the frame, including the delimiter, or 0 if the payload is too long
+     */
+    uint8_t encode(Channel channel, const void* payload, uint8_t length, uint8_t* buffer);
+
+    /**
+     * Collects frames from a byte stream
+     */
+    class Decoder
+    {
+        public:
+            /**
+             * @param   buffer  Space for the longest frame expected, encodedLength(MAX_PAYLOAD_LEN)
+             *                  takes any frame
+             */
+            Decoder(uint8_t* buffer, uint16_t length);
+            ~Decoder(){}
+
+            /**
+             * Add a received byte
+             * @return  True if it completed a good frame, which stays readable until the next byte
+             */
+            bool addByte(uint8_t byte);
+
+            Channel getChannel(){ return (Channel)buffer_[0]; }
+            const uint8_t* getPayload(){ return &buffer_[1]; }
+            uint8_t getPayloadLength(){ return payloadLength_; }
+
+            // Frames dropped for a bad CRC or COBS code, or for being too long or too short
+            uint32_t getErrors(){ return errors_; }
+            uint32_t getFrames(){ return frames_; }
+
+        private:
+            uint8_t* buffer_;
+            uint16_t length_;
+            uint16_t count_;
+            uint8_t payloadLength_;
+            bool overflowed_;
+
+            uint32_t errors_;
+            uint32_t frames_;
+
+            /**
+             * Decode the collected bytes in place and check them
+             */
+            bool finishFrame();
+    };
+}
+
+#endif
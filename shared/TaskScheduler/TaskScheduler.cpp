@@ -0,0 +1,148 @@
+#include "TaskScheduler.hpp"
+
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#else
+// Flash is ordinary memory off the AVR, for building on the host
+#include <string.h>
+#define memcpy_P memcpy
+#define pgm_read_byte(address) (*(const uint8_t*)(address))
+#endif
+
+using namespace Scheduler;
+
+const static uint8_t NO_TASK = 0xff;
+
+// Saturate stats rather than wrap
+static uint16_t clamp16(uint32_t value)
+{
+    return (value > UINT16_MAX) ? UINT16_MAX : value;
+}
+
+TaskScheduler::TaskScheduler(const Task* tasks,
+                             TaskStats* stats,
+                             uint8_t numTasks,
+                             TimeSource getTime):
+    tasks_(tasks),
+    stats_(stats),
+    numTasks_(numTasks),
+    getTime_(getTime)
+{
+}
+
+void TaskScheduler::start()
+{
+    clearStats();
+
+    uint32_t now = getTime_();
+    for (uint8_t i=0; i<numTasks_; i++)
+    {
+        Task task = getTask(i);
+        stats_[i].period = task.period;
+        stats_[i].nextRun = now + task.period;
+    }
+}
+
+void TaskScheduler::clearStats()
+{
+    for (uint8_t i=0; i<numTasks_; i++)
+    {
+        stats_[i].runs = 0;
+        stats_[i].totalRuntime = 0;
+        stats_[i].maxRuntime = 0;
+        stats_[i].maxLateness = 0;
+        stats_[i].overruns = 0;
+    }
+}
+
+bool TaskScheduler::runNext()
+{
+    uint32_t now = getTime_();
+
+    // Pick the highest priority task that is due, and the one that has waited longest among equals
+    uint8_t next = NO_TASK;
+    for (uint8_t i=0; i<numTasks_; i++)
+    {
+        if (!isDue(stats_[i].nextRun, now)) continue;
+
+        if ((next == NO_TASK) ||
+            (getPriority(i) < getPriority(next)) ||
+            ((getPriority(i) == getPriority(next)) &&
+             ((int32_t)(stats_[i].nextRun - stats_[next].nextRun) < 0)))
+        {
+            next = i;
+        }
+    }
+
+    if (next == NO_TASK) return false;
+
+    Task task = getTask(next);
+    TaskStats& stats = stats_[next];
+
+    uint32_t due = stats.nextRun;
+    uint32_t start = getTime_();
+    task.function();
+    uint32_t end = getTime_();
+
+    // Track how long the task took, and how late it was
+    uint32_t runtime = end - start;
+    uint32_t lateness = start - due;
+    if (stats.runs == UINT16_MAX)
+    {
+        stats.runs >>= 1;
+        stats.totalRuntime >>= 1;
+    }
+    stats.runs++;
+    stats.totalRuntime += runtime;
+    if (runtime > stats.maxRuntime) stats.maxRuntime = clamp16(runtime);
+    if (lateness > stats.maxLateness) stats.maxLateness = clamp16(lateness);
+    if (((end - due) > task.deadline) && (stats.overruns < UINT16_MAX)) stats.overruns++;
+
+    // Keep to the original phase, but if a whole period was missed skip ahead
+    // rather than running back to back to catch up
+    stats.nextRun = due + stats.period;
+    if (isDue(stats.nextRun, end))
+    {
+        stats.nextRun = end + stats.period;
+    }
+
+    return true;
+}
+
+void TaskScheduler::setPeriod(uint8_t index, uint32_t period)
+{
+    if (index >= numTasks_) return;
+
+    TaskStats& stats = stats_[index];
+    stats.nextRun = stats.nextRun - stats.period + period;
+    stats.period = period;
+}
+
+uint8_t TaskScheduler::findTask(TaskFunction function)
+{
+    uint8_t i = 0;
+    while ((i < numTasks_) && (getTask(i).function != function)) i++;
+    return i;
+}
+
+Task TaskScheduler::getTask(uint8_t index)
+{
+    Task task;
+    memcpy_P(&task, &tasks_[index], sizeof(Task));
+    return task;
+}
+
+uint8_t TaskScheduler::getPriority(uint8_t index)
+{
+    return pgm_read_byte(&(tasks_[index].priority));
+}
+
+uint32_t TaskScheduler::getNextRun()
+{
+    uint32_t next = stats_[0].nextRun;
+    for (uint8_t i=1; i<numTasks_; i++)
+    {
+        if ((int32_t)(stats_[i].nextRun - next) < 0) next = stats_[i].nextRun;
+    }
+    return next;
+}
@@ -0,0 +1,119 @@
+#ifndef TASK_SCHEDULER_HPP
+#define TASK_SCHEDULER_HPP
+
+#include <stdint.h>
+
+/**
+ * Cooperative scheduler for a fixed table of tasks, shared by the probe and the receiver.
+ *
+ * Each call to runNext() runs the single most urgent task that is due, so work that can wait
+ * only ever delays latency critical work by one task's runtime. Times are in whatever units
+ * the time source counts in, and are allowed to wrap.
+ *
+ * The task table, and the names it points to, are kept in flash:
+ *      const static char radioName[] PROGMEM = "RADIO";
+ *      const static Scheduler::Task tasks[] PROGMEM = { {.name = radioName, ...}, ... };
+ */
+namespace Scheduler
+{
+    typedef void (*TaskFunction)();
+
+    /**
+     * Returns a free running time, wrapping at 32 bits
+     */
+    typedef uint32_t (*TimeSource)();
+
+    struct Task
+    {
+        const char* name;       // In flash
+        TaskFunction function;
+        uint32_t period;        // Time between runs to start with, must not be 0
+        uint8_t priority;       // When more than one task is due, the lowest runs first
+        uint32_t deadline;      // Time after becoming due that a run must have finished by
+    };
+
+    /**
+     * Runtimes and lateness saturate at 16 bits, over 4 seconds at 64us a count. When runs would
+     * wrap, it is halved along with totalRuntime, so the mean still holds
+     */
+    struct TaskStats
+    {
+        uint32_t period;        // Time between runs now, see setPeriod()
+        uint32_t nextRun;
+        uint32_t totalRuntime;
+        uint16_t runs;
+        uint16_t maxRuntime;
+        uint16_t maxLateness;   // Longest a run waited after becoming due
+        uint16_t overruns;      // Runs that finished after their deadline
+    };
+
+    class TaskScheduler
+    {
+        public:
+            /**
+             * @param   tasks       Table of tasks to run, in flash
+             * @param   stats       One per task, for the scheduler to keep its state in
+             * @param   numTasks    Number of tasks in the table
+             * @param   getTime     Source of the time periods and deadlines are measured in
+             */
+            TaskScheduler(const Task* tasks,
+                          TaskStats* stats,
+                          uint8_t numTasks,
+                          TimeSource getTime);
+
+            /**
+             * Clear the stats, and schedule the first run of each task one period from now
+             */
+            void start();
+
+            /**
+             * Run the most urgent task that is due
+             * @return  False if nothing was due
+             */
+            bool runNext();
+
+            /**
+             * Change how often a task runs. The next run moves to one new period after the last
+             * one was due, so a shorter period can make it due straight away. A task may call this
+             * on itself to set when it next runs
+             * @param   index   Position of the task in the table, see findTask(). Out of range
+             *                  is ignored
+             * @param   period  New time between runs, must not be 0
+             */
+            void setPeriod(uint8_t index, uint32_t period);
+
+            /**
+             * Find a task by its function, so callers do not depend on the order of the table
+             * @return  Position of the task in the table, getNumTasks() if it is not there
+             */
+            uint8_t findTask(TaskFunction function);
+
+            /**
+             * Get when the next task comes due, so the caller can sleep until then
+             * @return  Earliest next run of any task, which may already have passed
+             */
+            uint32_t getNextRun();
+
+            void clearStats();
+
+            uint8_t getNumTasks(){ return numTasks_; }
+            const TaskStats& getStats(uint8_t index){ return stats_[index]; }
+
+            /**
+             * Get a task from the table
+             * @return  Copy of the task out of flash, its name is still in flash
+             */
+            Task getTask(uint8_t index);
+
+        private:
+            const Task* tasks_;
+            TaskStats* stats_;
+            uint8_t numTasks_;
+            TimeSource getTime_;
+
+            static bool isDue(uint32_t time, uint32_t now){ return (int32_t)(now - time) >= 0; }
+            uint8_t getPriority(uint8_t index);
+    };
+}
+
+#endif
@@ -0,0 +1,29 @@
+#include "VeranusProtocol.hpp"
+
+/**
+ * Exhaustive compile time checks of the fixed point conversions. These live here rather than
+ * in the header since they take a few seconds to evaluate, and only need to run once per build
+ */
+namespace Protocol
+{
+    // Compile time check that every fixed point value survives a trip through float.
+    // Ranges are split in half on each call to keep the recursion shallow
+    constexpr bool temperatureRoundTrips(int32_t low, int32_t high)
+    {
+        return (low == high) ?
+                    (toFixedTemperature(fromFixedTemperature((int16_t)low)) == low) :
+                    (temperatureRoundTrips(low, low + ((high - low) / 2)) &&
+                     temperatureRoundTrips(low + ((high - low) / 2) + 1, high));
+    }
+
+    constexpr bool percentRoundTrips(int32_t low, int32_t high)
+    {
+        return (low == high) ?
+                    (toFixedPercent(fromFixedPercent((uint16_t)low)) == low) :
+                    (percentRoundTrips(low, low + ((high - low) / 2)) &&
+                     percentRoundTrips(low + ((high - low) / 2) + 1, high));
+    }
+
+    static_assert(temperatureRoundTrips(INT16_MIN, INT16_MAX), "Temperature does not round trip");
+    static_assert(percentRoundTrips(0, UINT16_MAX), "Percent does not round trip");
+}
@@ -0,0 +1,121 @@
+#ifndef VERANUS_PROTOCOL_HPP
+#define VERANUS_PROTOCOL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * Wire format shared by the probe and receiver firmwares.
+ *
+ * Readings travel as 16 bit fixed point hundredths, which is finer than the sensors resolve:
+ *  - Temperature: signed hundredths of a degree Fahrenheit (-327.68F to 327.67F)
+ *  - Humidity, light: unsigned hundredths of a percent (0% to 655.35%)
+ *
+ * Records are packed and little endian, which is also the in-memory layout on the ATmega328,
+ * so they are read and written in place in radio and serial buffers.
+ */
+namespace Protocol
+{
+    const static uint8_t VERSION = 1;
+    const static int16_t FIXED_SCALE = 100;
+
+    struct Reading
+    {
+        uint8_t version;
+        uint16_t probeId;
+        int16_t temperature;
+        uint16_t humidity;
+        uint16_t light;
+    } __attribute__((packed));
+
+    static_assert(sizeof(Reading) == 9, "Reading layout changed, bump VERSION");
+    static_assert(offsetof(Reading, version) == 0, "Version must lead the record");
+    static_assert(offsetof(Reading, probeId) == 1, "Reading layout changed, bump VERSION");
+    static_assert(offsetof(Reading, temperature) == 3, "Reading layout changed, bump VERSION");
+    static_assert(offsetof(Reading, humidity) == 5, "Reading layout changed, bump VERSION");
+    static_assert(offsetof(Reading, light) == 7, "Reading layout changed, bump VERSION");
+
+    // Round to the nearest hundredth, saturating at the ends of the field
+    constexpr int32_t toFixed(float value)
+    {
+        return (int32_t)((value * FIXED_SCALE) + ((value < 0) ? -0.5f : 0.5f));
+    }
+
+    constexpr int16_t saturateSigned(int32_t fixed)
+    {
+        return (fixed < INT16_MIN) ? INT16_MIN :
+               (fixed > INT16_MAX) ? INT16_MAX :
+               (int16_t)fixed;
+    }
+
+    constexpr uint16_t saturateUnsigned(int32_t fixed)
+    {
+        return (fixed < 0) ? 0 :
+               (fixed > UINT16_MAX) ? UINT16_MAX :
+               (uint16_t)fixed;
+    }
+
+    constexpr int16_t toFixedTemperature(float temperatureF)
+    {
+        return saturateSigned(toFixed(temperatureF));
+    }
+
+    constexpr uint16_t toFixedPercent(float percent)
+    {
+        return saturateUnsigned(toFixed(percent));
+    }
+
+    constexpr float fromFixedTemperature(int16_t temperature)
+    {
+        return (float)temperature / FIXED_SCALE;
+    }
+
+    constexpr float fromFixedPercent(uint16_t percent)
+    {
+        return (float)percent / FIXED_SCALE;
+    }
+
+    /**
+     * Fill in a reading directly in an outgoing buffer
+     * @param   buffer  Buffer of at least sizeof(Reading) bytes
+     * @return  The record in the buffer
+     */
+    static inline Reading* encode(uint8_t* buffer,
+                                  uint16_t probeId,
+                                  int16_t temperature,
+                                  uint16_t humidity,
+                                  uint16_t light)
+    {
+        Reading* pReading = (Reading*)buffer;
+        pReading->version = VERSION;
+        pReading->probeId = probeId;
+        pReading->temperature = temperature;
+        pReading->humidity = humidity;
+        pReading->light = light;
+        return pReading;
+    }
+
+    /**
+     * View a received buffer as a reading
+     * @param   buffer  Received bytes
+     * @param   length  Number of bytes received
+     * @return  The record in the buffer, or nullptr if it is too short or another version
+     */
+    static inline const Reading* decode(const uint8_t* buffer, uint16_t length)
+    {
+        if ((length < sizeof(Reading)) ||
+            (buffer[0] != VERSION))
+        {
+            return nullptr;
+        }
+
+        return (const Reading*)buffer;
+    }
+
+    static_assert(toFixedTemperature(-400.0f) == INT16_MIN, "Temperature does not saturate low");
+    static_assert(toFixedTemperature(400.0f) == INT16_MAX, "Temperature does not saturate high");
+    static_assert(toFixedPercent(-1.0f) == 0, "Percent does not saturate low");
+    static_assert(toFixedPercent(700.0f) == UINT16_MAX, "Percent does not saturate high");
+}
+
+#endif
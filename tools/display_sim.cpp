@@ -0,0 +1,351 @@
+/**
+ * Simulated 8x2 character LCD and backlight PWM for the probe's VeranusDisplay, counting what
+ * each update sends over the bus, checking that the screen always shows the reading, and that the
+ * backlight follows its curve without flapping on a noisy light level.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusProbe/src -I shared/VeranusProtocol -I tools/stubs \
+ *          tools/display_sim.cpp VeranusProbe/src/veranusDisplay/VeranusDisplay.cpp \
+ *          VeranusProbe/src/ProbeStrings.cpp VeranusProbe/src/Settings.cpp -o display_sim
+ *      ./display_sim [updates]
+ *
+ * The LCD keeps its own copy of the screen, and moves its cursor one column right after each
+ * character as the HD44780 does. Each cursor move or initialize is a command, and each character
+ * a write of its own, which is what the bus time goes on.
+ *
+ * Reports the commands and characters for setup, for the same reading again, for a one degree
+ * change, and on average over a random walk of readings in each unit. Against that, rewriting
+ * both value fields every update costs 2 cursor moves and 7 characters. After every update, the
+ * screen has to match the reading rounded to whole degrees and percent, drawn separately here.
+ *
+ * The backlight is then run from 10% to 100% in both light modes. Every light level from 0 to
+ * 100% is applied and faded to, and the brightness reached has to be within a percent and a half
+ * of a gamma 2.25 curve worked out in float, and move only one way. Reports the worst difference,
+ * and the brightness at half light against a straight line. Noisy light, up to a percent either
+ * side of a level, is applied at levels across the scale, and the PWM writes counted against
+ * applying every sample as before the hysteresis. A small step onto either end of the scale has
+ * to reach the end of the range, and a fade has to move the PWM a percent a tic.
+ */
+
+#include "veranusDisplay/VeranusDisplay.hpp"
+#include "Settings.hpp"
+#include "config.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint8_t NUM_ROWS = 2;
+static const uint8_t NUM_COLS = 8;
+static const uint32_t FIELD_REWRITE_COST = 2 + 4 + 3;
+
+// Backlight range and curve, light levels in hundredths
+static const uint8_t MIN_BRIGHTNESS = 10;
+static const uint8_t MAX_BRIGHTNESS = 100;
+static const double GAMMA = 2.25;
+static const int32_t SCALE_MIN = MIN_LIGHT_SCALE * 100;
+static const int32_t SCALE_MAX = MAX_LIGHT_SCALE * 100;
+static const uint32_t NOISE = 100;
+static const uint32_t NOISY_SAMPLES = 1000;
+
+// The curve is stored in 256 steps, then scaled to the range and rounded to a whole percent
+static const double MAX_CURVE_ERROR = 1.5;
+
+class SimLcd: public Lcd::ILcd
+{
+    public:
+        void initialize()
+        {
+            commands++;
+            memset(screen, ' ', sizeof(screen));
+            row = 0;
+            col = 0;
+        }
+
+        void display(const char* text, uint8_t length)
+        {
+            for (uint8_t i=0; i<length; i++)
+            {
+                if ((row < NUM_ROWS) && (col < NUM_COLS)) screen[row][col] = text[i];
+                else offScreen++;
+                col++;
+                characters++;
+            }
+        }
+
+        void setCursor(uint8_t newRow, uint8_t newCol)
+        {
+            commands++;
+            row = newRow;
+            col = newCol;
+        }
+
+        uint32_t getWrites(){ return commands + characters; }
+
+        char screen[NUM_ROWS][NUM_COLS];
+        uint8_t row = 0;
+        uint8_t col = 0;
+        uint32_t commands = 0;
+        uint32_t characters = 0;
+        uint32_t offScreen = 0;
+};
+
+class SimPwm: public Pwm::IPwm
+{
+    public:
+        void setDutyCycle(uint8_t newDutyCycle)
+        {
+            uint8_t step = (newDutyCycle > dutyCycle) ? (newDutyCycle - dutyCycle) : (dutyCycle - newDutyCycle);
+            if (step > maxStep) maxStep = step;
+            dutyCycle = newDutyCycle;
+            writes++;
+        }
+
+        void enable(){ enabled = true; }
+
+        uint8_t dutyCycle = 0;
+        uint8_t maxStep = 0;
+        uint32_t writes = 0;
+        bool enabled = false;
+};
+
+/**
+ * Run tics until the fade is done
+ * @return  Number of tics the fade took
+ */
+static uint32_t settle(VeranusDisplay& display, SimPwm& pwm)
+{
+    uint32_t tics = 0;
+    uint32_t writes = pwm.writes;
+    for (uint32_t i=0; i<256; i++)
+    {
+        display.onTic();
+        if (pwm.writes != writes) tics = i + 1;
+        writes = pwm.writes;
+    }
+    return tics;
+}
+
+/**
+ * Brightness the backlight should settle on for a light level, worked out in float
+ */
+static double curveBrightness(int32_t light, bool decrease)
+{
+    double x = (double)(light - SCALE_MIN) / (SCALE_MAX - SCALE_MIN);
+    if (x < 0) x = 0;
+    if (x > 1) x = 1;
+    if (decrease) x = 1 - x;
+    return MIN_BRIGHTNESS + ((MAX_BRIGHTNESS - MIN_BRIGHTNESS) * pow(x, GAMMA));
+}
+
+/**
+ * Sweep every light level, checking the brightness reached against the curve
+ * @return  True if it followed the curve, one way only
+ */
+static bool checkCurve(VeranusDisplay& display, SimPwm& pwm, bool decrease)
+{
+    double worst = 0;
+    int32_t worstLight = 0;
+    bool oneWay = true;
+    uint8_t last = decrease ? MAX_BRIGHTNESS : MIN_BRIGHTNESS;
+    uint8_t half = 0;
+
+    for (int32_t light=0; light<=10000; light+=5)
+    {
+        display.setLightLevel(light);
+        display.refreshBrightness();
+        settle(display, pwm);
+
+        double error = fabs(pwm.dutyCycle - curveBrightness(light, decrease));
+        if (error > worst)
+        {
+            worst = error;
+            worstLight = light;
+        }
+        if (decrease ? (pwm.dutyCycle > last) : (pwm.dutyCycle < last)) oneWay = false;
+        last = pwm.dutyCycle;
+        if (light == ((SCALE_MIN + SCALE_MAX) / 2)) half = pwm.dutyCycle;
+    }
+
+    printf("%-12s %8.2f %9.2f %8s %7u %9.0f\n",
+           decrease ? "decrease" : "increase",
+           worst,
+           worstLight / 100.0,
+           oneWay ? "yes" : "no",
+           half,
+           (MIN_BRIGHTNESS + MAX_BRIGHTNESS) / 2.0);
+    return (worst <= MAX_CURVE_ERROR) && oneWay;
+}
+
+static bool checkBacklight()
+{
+    SimLcd lcd;
+    SimPwm pwm;
+    VeranusDisplay display(&lcd, &pwm);
+    bool pass = true;
+
+    settings.lightMode = LightMode::STATIC;
+    settings.staticLight = 50;
+    settings.minLight = MIN_BRIGHTNESS;
+    settings.maxLight = MAX_BRIGHTNESS;
+    display.setup();
+    pass = pass && pwm.enabled && (pwm.dutyCycle == settings.staticLight);
+
+    // A static backlight ignores the light
+    uint32_t writes = pwm.writes;
+    display.setLightLevel(SCALE_MAX);
+    settle(display, pwm);
+    pass = pass && (pwm.writes == writes);
+
+    printf("\n%-12s %8s %9s %8s %7s %9s\n", "curve", "worst", "atLight", "oneWay", "atHalf", "straight");
+    settings.lightMode = LightMode::INCREASE;
+    pass = checkCurve(display, pwm, false) && pass;
+    settings.lightMode = LightMode::DECREASE;
+    pass = checkCurve(display, pwm, true) && pass;
+
+    // A light level jittering around each level, as the sensor gives it every 15 seconds
+    settings.lightMode = LightMode::INCREASE;
+    uint32_t noisyWrites = 0;
+    uint32_t everySampleWrites = 0;
+    for (uint8_t applyAll=0; applyAll<2; applyAll++)
+    {
+        srand(2);
+        for (int32_t level=SCALE_MIN + 500; level<SCALE_MAX; level+=500)
+        {
+            display.setLightLevel(level);
+            display.refreshBrightness();
+            settle(display, pwm);
+
+            writes = pwm.writes;
+            for (uint32_t i=0; i<NOISY_SAMPLES; i++)
+            {
+                display.setLightLevel(level - NOISE + (rand() % ((2 * NOISE) + 1)));
+                if (applyAll) display.refreshBrightness();
+                settle(display, pwm);
+            }
+            (applyAll ? everySampleWrites : noisyWrites) += pwm.writes - writes;
+        }
+    }
+    printf("\n%-12s %8s %12s\n", "noisy", "pwmWrites", "everySample");
+    printf("%-12s %8u %12u\n", "+-1%", noisyWrites, everySampleWrites);
+    pass = pass && (noisyWrites == 0) && (everySampleWrites > 0);
+
+    // Within the hysteresis of either end, it still has to get there
+    display.setLightLevel(SCALE_MAX - 100);
+    display.refreshBrightness();
+    settle(display, pwm);
+    display.setLightLevel(SCALE_MAX);
+    settle(display, pwm);
+    uint8_t top = pwm.dutyCycle;
+    display.setLightLevel(SCALE_MIN + 100);
+    display.refreshBrightness();
+    settle(display, pwm);
+    display.setLightLevel(SCALE_MIN);
+    settle(display, pwm);
+    uint8_t bottom = pwm.dutyCycle;
+
+    // Fades go a percent a tic
+    pwm.maxStep = 0;
+    display.setLightLevel(SCALE_MAX);
+    uint32_t fadeTics = settle(display, pwm);
+
+    printf("\n%-12s %8s %8s %9s %8s\n", "ends", "top", "bottom", "fadeTics", "maxStep");
+    printf("%-12s %8u %8u %9u %8u\n", "", top, bottom, fadeTics, pwm.maxStep);
+    pass = pass && (top == MAX_BRIGHTNESS) && (bottom == MIN_BRIGHTNESS) &&
+           (fadeTics == (MAX_BRIGHTNESS - MIN_BRIGHTNESS)) && (pwm.maxStep == 1);
+
+    return pass;
+}
+
+/**
+ * Whether the screen shows the reading, as whole values rounded half away from zero. Celsius is
+ * taken to the hundredth first, as the probe reports it, so halves land where they do there
+ */
+static bool showsReading(const SimLcd& lcd, int16_t temperatureF, uint16_t humidity, bool isCelsius)
+{
+    int32_t hundredths = isCelsius ? (((temperatureF - 3200) * 5) / 9) : temperatureF;
+    double temperature = hundredths / 100.0;
+
+    char expected[NUM_ROWS][NUM_COLS + 1];
+    snprintf(expected[0], sizeof(expected[0]), "T:%4ld%c%c", lround(temperature), '\xDF', isCelsius ? 'C' : 'F');
+    snprintf(expected[1], sizeof(expected[1]), "H: %3ld%% ", lround(humidity / 100.0));
+
+    return (memcmp(lcd.screen[0], expected[0], NUM_COLS) == 0) &&
+           (memcmp(lcd.screen[1], expected[1], NUM_COLS) == 0);
+}
+
+static void report(const char* name, uint32_t commands, uint32_t characters, double perUpdate)
+{
+    printf("%-12s %9u %11u %10.2f %10u\n", name, commands, characters, perUpdate, FIELD_REWRITE_COST);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t updates = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 10000;
+    srand(1);
+
+    SimLcd lcd;
+    VeranusDisplay display(&lcd);
+    bool pass = true;
+    uint32_t wrong = 0;
+
+    printf("%-12s %9s %11s %10s %10s\n", "case", "commands", "characters", "perUpdate", "rewrite");
+
+    display.setup();
+    report("setup", lcd.commands, lcd.characters, lcd.getWrites());
+
+    int16_t temperature = 7012;
+    uint16_t humidity = 4530;
+    display.update(temperature, humidity);
+    wrong += !showsReading(lcd, temperature, humidity, false);
+
+    // Nothing changed, nothing to send
+    uint32_t commands = lcd.commands;
+    uint32_t characters = lcd.characters;
+    display.update(temperature, humidity);
+    report("unchanged", lcd.commands - commands, lcd.characters - characters,
+           (lcd.commands - commands) + (lcd.characters - characters));
+    pass = pass && (lcd.commands == commands) && (lcd.characters == characters);
+
+    // One degree warmer, only the last digit changes
+    commands = lcd.commands;
+    characters = lcd.characters;
+    temperature += 100;
+    display.update(temperature, humidity);
+    wrong += !showsReading(lcd, temperature, humidity, false);
+    report("one degree", lcd.commands - commands, lcd.characters - characters,
+           (lcd.commands - commands) + (lcd.characters - characters));
+
+    // Readings drift by up to 0.3 a time, across sign changes and digit counts, in both units
+    for (uint8_t celsius=0; celsius<2; celsius++)
+    {
+        display.setTempUnit(celsius);
+        wrong += !showsReading(lcd, temperature, humidity, celsius);
+
+        commands = lcd.commands;
+        characters = lcd.characters;
+        for (uint32_t i=0; i<updates; i++)
+        {
+            temperature += (rand() % 61) - 30;
+            if (temperature < -2000) temperature = -2000;
+            if (temperature > 12000) temperature = 12000;
+            humidity += (rand() % 41) - 20;
+            if (humidity > 10000) humidity = (humidity > 20000) ? 0 : 10000;
+
+            display.update(temperature, humidity);
+            wrong += !showsReading(lcd, temperature, humidity, celsius);
+        }
+        double perUpdate = (double)((lcd.commands - commands) + (lcd.characters - characters)) / updates;
+        report(celsius ? "walk C" : "walk F", lcd.commands - commands, lcd.characters - characters, perUpdate);
+        pass = pass && (perUpdate < FIELD_REWRITE_COST);
+    }
+
+    printf("\nwrong screens %u, characters off the screen %u\n", wrong, lcd.offScreen);
+    pass = pass && (wrong == 0) && (lcd.offScreen == 0);
+
+    pass = checkBacklight() && pass;
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,279 @@
+/**
+ * Host side decoder for the receiver's framed UART link, see shared/SerialFrame/SerialFrame.hpp.
+ *
+ * Build from the repository root:
+ *      g++ -std=c++11 -O2 -I shared/SerialFrame -I shared/VeranusProtocol tools/frame_decoder.cpp \
+ *          shared/SerialFrame/SerialFrame.cpp -o frame_decoder
+ *
+ * Decode a port or a capture, "-" for stdin:
+ *      ./frame_decoder /dev/ttyUSB0 [baud]
+ * A serial port is put in raw mode at the baud given, 38400 by default to match the receiver.
+ * Prints a line per frame, and the frames and errors seen once the input ends.
+ *
+ * Benchmark:
+ *      ./frame_decoder --bench [frames] [corruptPercent]
+ * Encodes a mix of DATA, FAILURE and LOG frames, flips a byte in the given percentage of them
+ * (1 by default), and decodes the lot. Reports decode throughput against what a UART at the
+ * receiver's baud carries, and checks that every frame that was not touched still comes out. The
+ * only exception is a frame whose delimiter was hit, which runs into the frame after it, so a bad
+ * frame costs at most two. Bad frames that get past the CRC are counted too, and should be about
+ * one in 65536 of those corrupted.
+ */
+
+#include "SerialFrame.hpp"
+#include "VeranusProtocol.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+static const uint32_t DEFAULT_BAUD = 38400;
+
+static void printFrame(Frame::Decoder& decoder)
+{
+    const uint8_t* payload = decoder.getPayload();
+    uint8_t length = decoder.getPayloadLength();
+    switch (decoder.getChannel())
+    {
+        case Frame::Channel::DATA:
+        {
+            const Protocol::Reading* pReading = Protocol::decode(payload, length);
+            if (pReading == nullptr)
+            {
+                printf("DATA unknown version, %u bytes\n", length);
+                break;
+            }
+            printf("DATA %u T %.2fF H %.2f%% L %.2f%%\n",
+                   pReading->probeId,
+                   Protocol::fromFixedTemperature(pReading->temperature),
+                   Protocol::fromFixedPercent(pReading->humidity),
+                   Protocol::fromFixedPercent(pReading->light));
+            break;
+        }
+
+        case Frame::Channel::FAILURE:
+            printf("FAIL %u\n", (length > 0) ? payload[0] : 0);
+            break;
+
+        case Frame::Channel::LOG:
+            printf("LOG %.*s\n", length, (const char*)payload);
+            break;
+
+        default:
+            printf("channel %u, %u bytes\n", (uint8_t)decoder.getChannel(), length);
+            break;
+    }
+    fflush(stdout);
+}
+
+static speed_t toSpeed(uint32_t baud)
+{
+    switch (baud)
+    {
+        case 9600: return B9600;
+        case 19200: return B19200;
+        case 38400: return B38400;
+        case 57600: return B57600;
+        case 115200: return B115200;
+        default: return B0;
+    }
+}
+
+static int decodeStream(const char* path, uint32_t baud)
+{
+    int fd = (strcmp(path, "-") == 0) ? STDIN_FILENO : open(path, O_RDONLY | O_NOCTTY);
+    if (fd < 0)
+    {
+        perror(path);
+        return 1;
+    }
+
+    if (isatty(fd))
+    {
+        termios tty;
+        speed_t speed = toSpeed(baud);
+        if ((speed == B0) || (tcgetattr(fd, &tty) != 0))
+        {
+            fprintf(stderr, "Cannot set %s to %u baud\n", path, baud);
+            return 1;
+        }
+        cfmakeraw(&tty);
+        cfsetispeed(&tty, speed);
+        cfsetospeed(&tty, speed);
+        tcsetattr(fd, TCSANOW, &tty);
+    }
+
+    uint8_t frame[Frame::encodedLength(Frame::MAX_PAYLOAD_LEN)];
+    Frame::Decoder decoder(frame, sizeof(frame));
+
+    uint8_t input[256];
+    ssize_t numRead;
+    while ((numRead = read(fd, input, sizeof(input))) > 0)
+    {
+        for (ssize_t i=0; i<numRead; i++)
+        {
+            if (decoder.addByte(input[i])) printFrame(decoder);
+        }
+    }
+
+    fprintf(stderr, "%u frames, %u errors\n", decoder.getFrames(), decoder.getErrors());
+    return 0;
+}
+
+struct SentFrame
+{
+    Frame::Channel channel;
+    std::vector<uint8_t> payload;
+    size_t end;         // Position of its delimiter in the stream
+    bool corrupted;
+    bool joined;        // The frame before lost its delimiter, so this one went with it
+};
+
+static int benchmark(uint32_t numFrames, double corruptPercent)
+{
+    std::mt19937 random(1);
+    std::vector<SentFrame> sent;
+    std::vector<uint8_t> stream;
+    sent.reserve(numFrames);
+
+    for (uint32_t i=0; i<numFrames; i++)
+    {
+        // Mostly results, as a subscription would send, with some log lines
+        SentFrame sentFrame;
+        uint32_t kind = random() % 10;
+        if (kind < 7)
+        {
+            uint8_t reading[sizeof(Protocol::Reading)];
+            Protocol::encode(reading, random() % 256, random(), random(), random());
+            sentFrame.channel = Frame::Channel::DATA;
+            sentFrame.payload.assign(reading, reading + sizeof(reading));
+        }
+        else if (kind < 8)
+        {
+            sentFrame.channel = Frame::Channel::FAILURE;
+            sentFrame.payload.push_back(random() % 256);
+        }
+        else
+        {
+            sentFrame.channel = Frame::Channel::LOG;
+            char line[64];
+            int length = snprintf(line, sizeof(line), "Successes: %u, failures: %u",
+                                  (unsigned)(random() % 65536), (unsigned)(random() % 65536));
+            sentFrame.payload.assign(line, line + length);
+        }
+
+        uint8_t encoded[Frame::encodedLength(Frame::MAX_PAYLOAD_LEN)];
+        uint8_t length = Frame::encode(sentFrame.channel,
+                                       sentFrame.payload.data(),
+                                       sentFrame.payload.size(),
+                                       encoded);
+
+        // Any byte may be hit, the delimiter included
+        static bool delimiterHit = false;
+        sentFrame.joined = delimiterHit;
+        sentFrame.corrupted = ((random() % 10000) < (corruptPercent * 100));
+        delimiterHit = false;
+        if (sentFrame.corrupted)
+        {
+            uint8_t index = random() % length;
+            encoded[index] ^= 1 + (random() % 255);
+            delimiterHit = (index == (length - 1));
+        }
+
+        stream.insert(stream.end(), encoded, encoded + length);
+        sentFrame.end = stream.size() - 1;
+        sent.push_back(sentFrame);
+    }
+
+    uint8_t frame[Frame::encodedLength(Frame::MAX_PAYLOAD_LEN)];
+
+    // Timed on its own, as a host reading the port would run it
+    Frame::Decoder timedDecoder(frame, sizeof(frame));
+    uint32_t numDecoded = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint8_t byte: stream)
+    {
+        if (timedDecoder.addByte(byte)) numDecoded++;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Then each frame that comes out is checked against the frame that ended at the same byte
+    Frame::Decoder decoder(frame, sizeof(frame));
+    std::vector<bool> received(sent.size(), false);
+    size_t nextSent = 0;
+    uint32_t badAccepted = 0;
+    for (size_t position=0; position<stream.size(); position++)
+    {
+        if (!decoder.addByte(stream[position])) continue;
+
+        while ((nextSent < sent.size()) && (sent[nextSent].end < position)) nextSent++;
+
+        if ((nextSent < sent.size()) &&
+            (sent[nextSent].end == position) &&
+            (sent[nextSent].channel == decoder.getChannel()) &&
+            (sent[nextSent].payload.size() == decoder.getPayloadLength()) &&
+            (memcmp(sent[nextSent].payload.data(), decoder.getPayload(), decoder.getPayloadLength()) == 0))
+        {
+            received[nextSent] = true;
+        }
+        else
+        {
+            badAccepted++;
+        }
+    }
+
+    uint32_t intactLost = 0;
+    for (size_t i=0; i<sent.size(); i++)
+    {
+        if (!received[i] && !sent[i].corrupted && !sent[i].joined) intactLost++;
+    }
+
+    uint32_t corrupted = 0;
+    for (const SentFrame& sentFrame: sent)
+    {
+        if (sentFrame.corrupted) corrupted++;
+    }
+
+    double bytesPerSecond = stream.size() / seconds;
+    double linkBytesPerSecond = DEFAULT_BAUD / 10.0;
+    printf("%u frames, %zu bytes, %u corrupted\n", numFrames, stream.size(), corrupted);
+    printf("Decoded %u, intact frames lost %u, bad frames accepted %u, errors counted %u\n",
+           numDecoded, intactLost, badAccepted, decoder.getErrors());
+    printf("Decode: %.1f MB/s, %.0f frames/s, %.0fx a %u baud link\n",
+           bytesPerSecond / 1e6,
+           numFrames / seconds,
+           bytesPerSecond / linkBytesPerSecond,
+           DEFAULT_BAUD);
+
+    // A bad frame gets past the CRC one time in 65536, allow a few times that
+    bool pass = (intactLost == 0) && (badAccepted <= (1 + (corrupted / 16384)));
+    printf("%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
+
+int main(int argc, char** argv)
+{
+    if ((argc >= 2) && (strcmp(argv[1], "--bench") == 0))
+    {
+        uint32_t numFrames = (argc > 2) ? strtoul(argv[2], nullptr, 10) : 1000000;
+        double corruptPercent = (argc > 3) ? atof(argv[3]) : 1.0;
+        return benchmark(numFrames, corruptPercent);
+    }
+
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <port|capture|-> [baud]\n       %s --bench [frames] [corruptPercent]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    uint32_t baud = (argc > 2) ? strtoul(argv[2], nullptr, 10) : DEFAULT_BAUD;
+    return decodeStream(argv[1], baud);
+}
@@ -0,0 +1,434 @@
+/**
+ * Simulated EEPROM and serial port for the probe's HistoryLog, decoding its dumps to check that
+ * the history holds the readings it was given.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusProbe/src -I tools/stubs tools/history_sim.cpp \
+ *          VeranusProbe/src/historyLog/HistoryLog.cpp -o history_sim
+ *      ./history_sim [days]
+ *
+ * The EEPROM in tools/stubs/avr/eeprom.h counts the writes to each byte, and is only ready for
+ * the next write a tic after the last. The log sits where config.hpp puts it, and update() is
+ * called once a tic as the EEPROM task does. Dumps are decoded from the format documented in
+ * HistoryLog.hpp, not from the log's own code.
+ *
+ * Readings come every 5 minutes for the given number of days (10 by default), wandering a
+ * little each time, with light switching between day and night, a reading missed now and then
+ * and a jump in humidity each day. Reports how many days of samples a dump holds, the samples
+ * added and dropped, how far decoded values and times are from the readings they stand for,
+ * and the most writes to any EEPROM byte. Then the probe is reset, once cleanly and then with
+ * the power cut after every number of bytes written over the oldest page, the last of them a
+ * three byte change. Each time a fresh log has to carry on after the newest page with every
+ * decoded sample still matching a reading, and how many cuts kept the last change is reported.
+ */
+
+#include "historyLog/HistoryLog.hpp"
+#include "config.hpp"
+
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+static const uint32_t READING_SECONDS = 5 * 60;
+static const uint8_t HEADER_SIZE = 13;
+static const uint8_t MAGIC_LEN = 4;
+static const uint8_t DUMP_HEADER_SIZE = MAGIC_LEN + 2 + 4;
+
+// Half the storage resolution, in hundredths
+static const int32_t MAX_TEMP_ERROR = 5;
+static const int32_t MAX_HUM_ERROR = 25;
+static const int32_t MAX_LIGHT_ERROR = 50;
+
+/**
+ * Receiving end of the probe's UART
+ */
+class CaptureSerial: public SerialComm::ISerial
+{
+    public:
+        void initialize(){}
+        void write(const char* data, uint16_t length){ written.insert(written.end(), data, data + length); }
+        uint16_t read(char* data, uint16_t length){ return 0; }
+        bool isDataAvailable(){ return false; }
+        void flush(){}
+
+        std::vector<uint8_t> written;
+};
+
+struct Reading
+{
+    uint32_t uptime;
+    int16_t temperatureF;
+    uint16_t humidity;
+    uint16_t light;
+};
+
+struct Sample
+{
+    uint32_t uptime;
+    int16_t temperature;    // Tenths
+    uint8_t humidity;       // Half percents
+    uint8_t light;          // Percent
+};
+
+struct Decoded
+{
+    bool valid;
+    uint32_t uptime;
+    uint8_t pages;
+    uint16_t lastSequence;
+    std::vector<std::vector<Sample>> boots;
+};
+
+static uint32_t readLe(const uint8_t* pBytes, uint8_t length)
+{
+    uint32_t value = 0;
+    for (uint8_t i=0; i<length; i++) value |= (uint32_t)pBytes[i] << (8 * i);
+    return value;
+}
+
+/**
+ * Decode a dump, splitting the samples by boot where a page does not start after the last
+ */
+static Decoded decode(const std::vector<uint8_t>& dump)
+{
+    Decoded result = {};
+    if ((dump.size() < DUMP_HEADER_SIZE) || (memcmp(dump.data(), "HIST", MAGIC_LEN) != 0)) return result;
+
+    uint8_t numPages = dump[MAGIC_LEN];
+    uint8_t pageSize = dump[MAGIC_LEN + 1];
+    result.uptime = readLe(&dump[MAGIC_LEN + 2], 4);
+    if (dump.size() != (DUMP_HEADER_SIZE + ((size_t)numPages * pageSize))) return result;
+    result.valid = true;
+
+    uint32_t lastUptime = 0;
+    bool first = true;
+    for (uint8_t page=0; page<numPages; page++)
+    {
+        const uint8_t* pPage = &dump[DUMP_HEADER_SIZE + (page * pageSize)];
+        uint8_t crc = 0;
+        for (uint8_t i=0; i<(HEADER_SIZE - 1); i++) crc = _crc8_ccitt_update(crc, pPage[i]);
+        uint16_t sequence = readLe(pPage, 2);
+        if ((sequence == 0xffff) || (crc != pPage[HEADER_SIZE - 1])) continue;
+
+        // Oldest first, so sequence numbers only go up
+        if (!first && ((int16_t)(sequence - result.lastSequence) <= 0)) result.valid = false;
+        result.lastSequence = sequence;
+        result.pages++;
+
+        Sample sample;
+        sample.uptime = readLe(&pPage[2], 4);
+        uint16_t interval = readLe(&pPage[6], 2);
+        sample.temperature = (int16_t)readLe(&pPage[8], 2);
+        sample.humidity = pPage[10];
+        sample.light = pPage[11];
+
+        if (first || (sample.uptime <= lastUptime)) result.boots.push_back(std::vector<Sample>());
+        first = false;
+        result.boots.back().push_back(sample);
+
+        for (uint8_t i=HEADER_SIZE; i<pageSize; )
+        {
+            uint8_t entry = pPage[i++];
+            if (entry == 0xff) break;
+
+            if ((entry & 0xc0) == 0xc0)
+            {
+                sample.uptime += (entry & 0x3f) * interval;
+                continue;
+            }
+            if (entry & 0x80)
+            {
+                if ((i + 2) > pageSize)
+                {
+                    result.valid = false;
+                    break;
+                }
+                sample.temperature += (int8_t)(entry << 2) >> 2;
+                sample.humidity += (int8_t)pPage[i++];
+                sample.light += (int8_t)pPage[i++];
+            }
+            else
+            {
+                sample.temperature += ((entry >> 4) & 0x07) - 4;
+                sample.humidity += ((entry >> 2) & 0x03) - 2;
+                sample.light += (entry & 0x03) - 2;
+            }
+            sample.uptime += interval;
+            result.boots.back().push_back(sample);
+        }
+        lastUptime = sample.uptime;
+    }
+
+    return result;
+}
+
+struct Check
+{
+    uint32_t samples;
+    uint32_t unmatched;
+    int32_t worstTemp;
+    int32_t worstHum;
+    int32_t worstLight;
+    uint32_t worstTime;
+    uint32_t oldest;
+};
+
+/**
+ * Find a reading of the boot that a sample stands for. A sample may be moved onto the interval
+ * grid, so any reading up to half an interval either side of it, at the storage resolution
+ * @return  Reading, or nullptr if there is none
+ */
+static const Reading* findReading(const std::vector<Reading>& boot, const Sample& sample)
+{
+    for (const Reading& reading : boot)
+    {
+        uint32_t offset = (reading.uptime > sample.uptime) ? (reading.uptime - sample.uptime) : (sample.uptime - reading.uptime);
+        if ((offset <= (HISTORY_INTERVAL_SECONDS / 2)) &&
+            (abs((sample.temperature * 10) - reading.temperatureF) <= MAX_TEMP_ERROR) &&
+            (abs((sample.humidity * 50) - reading.humidity) <= MAX_HUM_ERROR) &&
+            (abs((sample.light * 100) - reading.light) <= MAX_LIGHT_ERROR))
+        {
+            return &reading;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Match every decoded sample to a reading it stands for. Boots are matched in order, a boot
+ * whose pages were all lost is skipped over
+ */
+static Check check(const Decoded& decoded, const std::vector<std::vector<Reading>>& readings)
+{
+    Check result = {};
+    size_t next = 0;
+    for (const std::vector<Sample>& samples : decoded.boots)
+    {
+        while ((next < readings.size()) && (findReading(readings[next], samples.front()) == nullptr)) next++;
+
+        for (const Sample& sample : samples)
+        {
+            result.samples++;
+            const Reading* pReading = (next < readings.size()) ? findReading(readings[next], sample) : nullptr;
+            if (pReading == nullptr)
+            {
+                result.unmatched++;
+                continue;
+            }
+
+            int32_t temp = abs((sample.temperature * 10) - pReading->temperatureF);
+            int32_t hum = abs((sample.humidity * 50) - pReading->humidity);
+            int32_t light = abs((sample.light * 100) - pReading->light);
+            int32_t time = abs((int32_t)(sample.uptime - pReading->uptime));
+            if (temp > result.worstTemp) result.worstTemp = temp;
+            if (hum > result.worstHum) result.worstHum = hum;
+            if (light > result.worstLight) result.worstLight = light;
+            if ((uint32_t)time > result.worstTime) result.worstTime = time;
+        }
+        next++;
+    }
+    if (!decoded.boots.empty() && !decoded.boots.front().empty()) result.oldest = decoded.boots.front().front().uptime;
+    return result;
+}
+
+/**
+ * A probe running for a while from power on, taking a reading every 5 minutes
+ */
+class Probe
+{
+    public:
+        Probe(): serial(), log(&serial, HISTORY_ADDRESS, HISTORY_BYTES, HISTORY_INTERVAL_SECONDS), uptime(0), tics(0)
+        {
+            log.initialize();
+        }
+
+        void tic()
+        {
+            tics++;
+            hostEeprom().busy = false;
+            log.update();
+        }
+
+        /**
+         * Take a reading unless the sensor fails, then run to the next one
+         * @return  True if a reading was added
+         */
+        bool read(Reading& reading, bool failed)
+        {
+            uptime += READING_SECONDS;
+            reading.uptime = uptime;
+            if (!failed) log.add(reading.uptime, reading.temperatureF, reading.humidity, reading.light);
+
+            for (uint32_t i=0; i<(READING_SECONDS * TICS_PER_SECOND); i++) tic();
+            return !failed;
+        }
+
+        Decoded dump()
+        {
+            serial.written.clear();
+            if (!log.dump(uptime)) return Decoded();
+
+            size_t length = DUMP_HEADER_SIZE + HISTORY_BYTES;
+            for (uint32_t i=0; (i<(100 * TICS_PER_SECOND)) && (serial.written.size() < length); i++) tic();
+            return decode(serial.written);
+        }
+
+        CaptureSerial serial;
+        HistoryLog log;
+        uint32_t uptime;
+        uint32_t tics;
+};
+
+/**
+ * Readings wander a little, the light follows the day, and humidity jumps once a day
+ */
+static Reading nextReading(const Reading& last, uint32_t uptime)
+{
+    Reading reading = last;
+    reading.temperatureF += (rand() % 41) - 20;
+    int32_t humidity = reading.humidity + (rand() % 61) - 30;
+    if ((uptime % 86400) == 43200) humidity += 3000;
+    if (humidity < 0) humidity = 0;
+    if (humidity > 10000) humidity = 5000;
+    reading.humidity = humidity;
+
+    uint32_t hour = (uptime / 3600) % 24;
+    reading.light = ((hour >= 7) && (hour < 19)) ? (6000 + (rand() % 400)) : (200 + (rand() % 50));
+    return reading;
+}
+
+static uint32_t getMaxWrites()
+{
+    uint32_t max = 0;
+    for (uint16_t i=0; i<HISTORY_BYTES; i++)
+    {
+        if (hostEeprom().writes[HISTORY_ADDRESS + i] > max) max = hostEeprom().writes[HISTORY_ADDRESS + i];
+    }
+    return max;
+}
+
+static void report(const char* name, const Decoded& decoded, const Check& result, uint32_t added, uint32_t dropped)
+{
+    // Days held only add up within a boot
+    char days[8] = "-";
+    if (decoded.boots.size() == 1) snprintf(days, sizeof(days), "%.2f", (decoded.uptime - result.oldest) / 86400.0);
+
+    printf("%-8s %6u %6s %8u %8u %8u %10u %5d %4d %6d %6u\n",
+           name,
+           decoded.pages,
+           days,
+           added,
+           dropped,
+           result.samples,
+           result.unmatched,
+           result.worstTemp,
+           result.worstHum,
+           result.worstLight,
+           result.worstTime);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t days = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 10;
+    uint32_t numReadings = (days * 86400) / READING_SECONDS;
+    srand(1);
+    bool pass = true;
+
+    printf("%-8s %6s %6s %8s %8s %8s %10s %5s %4s %6s %6s\n",
+           "case", "pages", "days", "added", "dropped", "decoded", "unmatched", "temp", "hum", "light", "time");
+
+    // One long run, every reading is kept while it is among the newest
+    hostEeprom().erase();
+    std::vector<std::vector<Reading>> readings(1);
+    Reading reading = {0, 7200, 4500, 3000};
+    Probe* pProbe = new Probe();
+    for (uint32_t i=0; i<numReadings; i++)
+    {
+        reading = nextReading(reading, pProbe->uptime + READING_SECONDS);
+        if (pProbe->read(reading, (i % 97) == 50)) readings.back().push_back(reading);
+    }
+    Decoded decoded = pProbe->dump();
+    Check result = check(decoded, readings);
+    uint32_t dropped = pProbe->log.getDropped();
+    report("run", decoded, result, pProbe->log.getSamples(), dropped);
+    pass = pass && decoded.valid && (result.unmatched == 0) && (dropped == 0) && (result.samples > 0);
+
+    // The newest samples have to be in the dump, up to the last one added
+    bool newest = !decoded.boots.empty() && !decoded.boots.back().empty() &&
+                  ((readings.back().back().uptime - decoded.boots.back().back().uptime) < HISTORY_INTERVAL_SECONDS);
+    pass = pass && newest;
+    uint32_t runWrites = getMaxWrites();
+
+    // A reset starts a new page after the newest, keeping the rest
+    delete pProbe;
+    pProbe = new Probe();
+    readings.push_back(std::vector<Reading>());
+    for (uint32_t i=0; i<24; i++)
+    {
+        reading = nextReading(reading, pProbe->uptime + READING_SECONDS);
+        if (pProbe->read(reading, false)) readings.back().push_back(reading);
+    }
+    uint16_t sequence = decoded.lastSequence;
+    decoded = pProbe->dump();
+    result = check(decoded, readings);
+    report("reset", decoded, result, pProbe->log.getSamples(), pProbe->log.getDropped());
+    pass = pass && decoded.valid && (result.unmatched == 0) && (decoded.boots.size() == 2) &&
+           ((int16_t)(decoded.lastSequence - sequence) > 0);
+
+    // Power cut part way through starting or filling a page, each time over the full oldest
+    // page. Whatever was written has to decode to readings that were taken, and the next boot
+    // carries on after it. The last reading before the cut is a long change
+    delete pProbe;
+    pProbe = nullptr;
+    HostEeprom before = hostEeprom();
+    std::vector<std::vector<Reading>> readingsBefore = readings;
+    uint32_t failures = 0;
+    uint32_t cuts = 0;
+    uint32_t kept = 0;
+    for (int32_t limit=0; limit<=(HistoryLog::PAGE_SIZE + 4); limit++)
+    {
+        memcpy(hostEeprom().data, before.data, sizeof(before.data));
+        readings = readingsBefore;
+
+        pProbe = new Probe();
+        readings.push_back(std::vector<Reading>());
+        hostEeprom().writeLimit = limit;
+        for (uint32_t i=0; i<3; i++)
+        {
+            reading = nextReading(reading, pProbe->uptime + READING_SECONDS);
+            if (i == 2) reading.humidity += (reading.humidity > 5000) ? -2000 : 2000;
+            if (pProbe->read(reading, false)) readings.back().push_back(reading);
+        }
+        hostEeprom().writeLimit = -1;
+
+        delete pProbe;
+        pProbe = new Probe();
+        readings.push_back(std::vector<Reading>());
+        reading = nextReading(reading, pProbe->uptime + READING_SECONDS);
+        if (pProbe->read(reading, false)) readings.back().push_back(reading);
+
+        decoded = pProbe->dump();
+        result = check(decoded, readings);
+        if (!decoded.valid || (result.unmatched > 0)) failures++;
+        cuts++;
+
+        // Whether the long change made it before the cut
+        const std::vector<Reading>& torn = readings[readings.size() - 2];
+        for (const std::vector<Sample>& samples : decoded.boots)
+        {
+            for (const Sample& sample : samples) kept += (findReading(torn, sample) == &torn.back());
+        }
+        delete pProbe;
+    }
+    printf("\n%u power cuts, %u kept the last change, %u with samples that were not taken\n", cuts, kept, failures);
+    pass = pass && (failures == 0) && (kept > 0) && (kept < cuts);
+
+    printf("most writes to a byte %u over the long run\n", runWrites);
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+/**
+ * Simulated EEPROM for the probe's SettingsJournal, measuring the wear it spreads and checking
+ * that the settings survive a reset at any point of a save.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusProbe/src -I tools/stubs tools/journal_sim.cpp \
+ *          VeranusProbe/src/settingsJournal/SettingsJournal.cpp -o journal_sim
+ *      ./journal_sim [saves]
+ *
+ * The EEPROM in tools/stubs/avr/eeprom.h counts the writes to each byte, and is only ready for
+ * the next write a tic after the last. The journal sits where config.hpp puts it, and update()
+ * is called once a tic as the EEPROM task does.
+ *
+ * Runs a burst of changes inside the quiet time, then single setting saves, and reports the
+ * records and bytes written and the most writes to any byte, against saving the settings in
+ * place as EepromManager did. Then cuts the power after every number of bytes of a save, runs
+ * the sequence number through its wrap, and reads journals written in the 16 byte slots of
+ * revision 2 from every slot, again cut off at every byte. After each, a fresh journal has to
+ * load the last complete save.
+ */
+
+#include "settingsJournal/SettingsJournal.hpp"
+#include "config.hpp"
+
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static const uint32_t QUIET_TICS = SETTINGS_QUIET_SECONDS * TICS_PER_SECOND;
+
+static uint32_t tics = 0;
+static uint32_t getTics(){ return tics; }
+
+static void run(SettingsJournal& journal, uint32_t numTics)
+{
+    for (uint32_t i=0; i<numTics; i++)
+    {
+        tics++;
+        hostEeprom().busy = false;
+        journal.update();
+    }
+}
+
+/**
+ * Run until a save has started and finished, or would have if the power stayed on
+ */
+static void runSave(SettingsJournal& journal)
+{
+    run(journal, QUIET_TICS + 1);
+    run(journal, SettingsJournal::SLOT_SIZE);
+}
+
+static Settings makeSettings(uint16_t id)
+{
+    Settings settings;
+    memset(&settings, 0, sizeof(Settings));
+    settings.id = id;
+    settings.revision = EEPROM_REV;
+    settings.staticLight = 100;
+    settings.maxLight = 100;
+    settings.slowSampleSeconds = CLIMATE_UPDATE_TIME_SECONDS;
+    return settings;
+}
+
+/**
+ * Load the journal from EEPROM, as after a reset
+ * @return  True if it loaded the settings given
+ */
+static bool reload(const Settings& expected)
+{
+    Settings loaded;
+    memset(&loaded, 0, sizeof(Settings));
+    SettingsJournal journal(&loaded, SETTINGS_JOURNAL_ADDRESS, SETTINGS_JOURNAL_BYTES, QUIET_TICS, &getTics);
+    return journal.initialize() && (memcmp(&loaded, &expected, sizeof(Settings)) == 0);
+}
+
+static uint32_t getMaxWrites()
+{
+    uint32_t max = 0;
+    for (uint16_t i=0; i<SETTINGS_JOURNAL_BYTES; i++)
+    {
+        if (hostEeprom().writes[SETTINGS_JOURNAL_ADDRESS + i] > max) max = hostEeprom().writes[SETTINGS_JOURNAL_ADDRESS + i];
+    }
+    return max;
+}
+
+static void report(const char* name, uint32_t records, uint32_t bytes, uint32_t maxWrites, uint32_t failures)
+{
+    printf("%-10s %8u %8u %10u %9u\n", name, records, bytes, maxWrites, failures);
+}
+
+/**
+ * Write a record the way the revision 2 journal did, in 16 byte slots
+ */
+static void writeLegacy(uint8_t slot, uint16_t sequence, const Settings& settings)
+{
+    uint8_t record[2 + SettingsJournal::LEGACY_SETTINGS_SIZE + 2];
+    memcpy(record, &sequence, 2);
+    memcpy(&record[2], &settings, SettingsJournal::LEGACY_SETTINGS_SIZE);
+
+    uint16_t crc = 0xffff;
+    for (uint8_t i=0; i<(sizeof(record) - 2); i++) crc = _crc_ccitt_update(crc, record[i]);
+    memcpy(&record[sizeof(record) - 2], &crc, 2);
+
+    uint16_t address = SETTINGS_JOURNAL_ADDRESS + (slot * SettingsJournal::LEGACY_SLOT_SIZE);
+    memcpy(&hostEeprom().data[address], record, sizeof(record));
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t numSaves = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 1000;
+    bool pass = true;
+
+    printf("%-10s %8s %8s %10s %9s\n", "case", "records", "bytes", "maxWrites", "failures");
+
+    // A burst of changes inside the quiet time is one record
+    hostEeprom().erase();
+    Settings settings = makeSettings(7);
+    SettingsJournal journal(&settings, SETTINGS_JOURNAL_ADDRESS, SETTINGS_JOURNAL_BYTES, QUIET_TICS, &getTics);
+    journal.initialize();
+    runSave(journal);
+    uint32_t startRecords = journal.getRecordsSaved();
+    uint32_t startBytes = journal.getBytesWritten();
+    settings.staticLight = 50;
+    run(journal, QUIET_TICS / 2);
+    settings.minLight = 20;
+    run(journal, QUIET_TICS / 2);
+    settings.tempDeadband = 10;
+    runSave(journal);
+    uint32_t failures = reload(settings) ? 0 : 1;
+    report("burst",
+           journal.getRecordsSaved() - startRecords,
+           journal.getBytesWritten() - startBytes,
+           getMaxWrites(),
+           failures);
+    pass = pass && (failures == 0) && ((journal.getRecordsSaved() - startRecords) == 1);
+
+    // One setting changed a save at a time, wear spreads over every slot
+    startRecords = journal.getRecordsSaved();
+    startBytes = journal.getBytesWritten();
+    failures = 0;
+    for (uint32_t i=0; i<numSaves; i++)
+    {
+        settings.id = i;
+        runSave(journal);
+    }
+    failures += reload(settings) ? 0 : 1;
+    uint32_t journalMax = getMaxWrites();
+    report("saves",
+           journal.getRecordsSaved() - startRecords,
+           journal.getBytesWritten() - startBytes,
+           journalMax,
+           failures);
+
+    // In place, only the bytes of the ID that change are written, but always to the same cell
+    uint32_t inPlaceBytes = 0;
+    for (uint32_t i=1; i<numSaves; i++)
+    {
+        inPlaceBytes += ((i & 0xff) != ((i - 1) & 0xff)) + ((i >> 8) != ((i - 1) >> 8));
+    }
+    report("in place", numSaves, inPlaceBytes, numSaves - 1, 0);
+    pass = pass && (failures == 0) && (journalMax < numSaves);
+
+    // Power cut after each number of bytes of a save, the last complete save has to load
+    failures = 0;
+    for (int32_t limit=0; limit<=SettingsJournal::SLOT_SIZE; limit++)
+    {
+        Settings before = settings;
+        settings.id ^= 0x5a5a;
+        settings.heartbeatMinutes++;
+        uint32_t bytes = journal.getBytesWritten();
+        hostEeprom().writeLimit = limit;
+        runSave(journal);
+        bool complete = (journal.getBytesWritten() - bytes) <= (uint32_t)limit;
+        hostEeprom().writeLimit = -1;
+
+        if (!reload(complete ? settings : before)) failures++;
+
+        // Start again from what a reset would have left
+        journal.initialize();
+    }
+    report("torn", SettingsJournal::SLOT_SIZE + 1, 0, 0, failures);
+    pass = pass && (failures == 0);
+
+    // Sequence numbers wrap, and the newest record has to be found either side of it
+    failures = 0;
+    uint32_t wraps = 0;
+    uint16_t lastSequence = journal.getSequence();
+    for (uint32_t i=0; i<70000; i++)
+    {
+        settings.id = i;
+        runSave(journal);
+        if (journal.getSequence() < lastSequence) wraps++;
+        lastSequence = journal.getSequence();
+
+        if ((lastSequence > 0xfff0) || (lastSequence < 0x10))
+        {
+            if (!reload(settings)) failures++;
+        }
+    }
+    report("wrap", wraps, 0, 0, failures);
+    pass = pass && (failures == 0) && (wraps > 0);
+
+    // A revision 2 journal is moved to the current slots, keeping the settings until it is
+    failures = 0;
+    uint32_t migrations = 0;
+    const uint8_t numLegacySlots = SETTINGS_JOURNAL_BYTES / SettingsJournal::LEGACY_SLOT_SIZE;
+    for (uint8_t newest=0; newest<numLegacySlots; newest++)
+    {
+        for (int32_t limit=0; limit<=SettingsJournal::SLOT_SIZE; limit++)
+        {
+            hostEeprom().erase();
+            Settings legacy = makeSettings(1000 + newest);
+            legacy.revision = 2;
+            for (uint8_t slot=0; slot<numLegacySlots; slot++)
+            {
+                // Older records with other IDs, the newest in the slot given
+                Settings older = legacy;
+                older.id = slot;
+                uint16_t sequence = 100 + ((slot + numLegacySlots - newest - 1) % numLegacySlots);
+                writeLegacy(slot, sequence, (slot == newest) ? legacy : older);
+            }
+
+            Settings loaded;
+            memset(&loaded, 0, sizeof(Settings));
+            SettingsJournal migrated(&loaded, SETTINGS_JOURNAL_ADDRESS, SETTINGS_JOURNAL_BYTES, QUIET_TICS, &getTics);
+            if (!migrated.initialize() || (loaded.id != legacy.id) || (loaded.revision != 2))
+            {
+                failures++;
+                continue;
+            }
+
+            // As devices.cpp does for revision 2
+            loaded.revision = EEPROM_REV;
+            loaded.slowSampleSeconds = CLIMATE_UPDATE_TIME_SECONDS;
+            hostEeprom().writeLimit = limit;
+            runSave(migrated);
+            bool complete = migrated.getBytesWritten() <= (uint32_t)limit;
+            hostEeprom().writeLimit = -1;
+
+            Settings reloaded;
+            memset(&reloaded, 0, sizeof(Settings));
+            SettingsJournal after(&reloaded, SETTINGS_JOURNAL_ADDRESS, SETTINGS_JOURNAL_BYTES, QUIET_TICS, &getTics);
+            bool found = after.initialize();
+            if (!found || (reloaded.id != legacy.id) || (complete && (reloaded.revision != EEPROM_REV)))
+            {
+                failures++;
+            }
+            migrations += complete;
+        }
+    }
+    report("legacy", migrations, 0, 0, failures);
+    pass = pass && (failures == 0);
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
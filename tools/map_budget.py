@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+"""
+Memory budget check for the AVR firmwares, built from the GNU ld map file.
+
+Attributes .text, .data and .bss to modules, checks them against a budget file, and prints
+the change from the previous build. Exits with 1 if any budget is exceeded.
+
+Link time optimization merges every object into ltrans objects, so as well as by object path,
+bytes are attributed by the symbol that owns them. A symbol owns the bytes up to the next
+symbol in its input section, so statics the map does not list count towards the symbol before
+them, and anything before the first symbol counts towards the object.
+
+Budget file (JSON):
+    {
+        "total": {"flash": 30720, "ram": 1536},
+        "modules": [
+            {"name": "WifiInterface", "match": ["WifiInterface", "wifiInterface/"], "flash": 4096, "ram": 320},
+            ...
+        ]
+    }
+Flash is .text plus .data (its initial values are stored in flash), ram is .data plus .bss.
+A module owns a symbol or object path if any of its match strings is a substring of it, checked
+in order. Anything unmatched is reported as "other". Budgets are optional.
+
+With --compare, a second map file from another build (such as the last commit) is read the same
+way, and each section of a module that changed is printed before and after. That is how a change
+that moves strings or tables out of RAM is measured, without having to keep a saved usage file.
+
+Usage:
+    map_budget.py firmware.map --budget memory_budget.json [--previous last.json] [--save last.json]
+                  [--detail MODULE] [--compare other.map]
+"""
+
+import argparse
+import json
+import os
+import re
+import sys
+
+SECTIONS = ("text", "data", "bss")
+OTHER = "other"
+
+# Input sections whose contents have no symbols, attributed by section name instead of object
+UNNAMED_SECTIONS = (".rodata.str", ".text.startup")
+
+OUTPUT_SECTION = re.compile(r"^\.(\w+)\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)")
+INPUT_SECTION = re.compile(r"^ (\.\S+)(?:\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(.*))?$")
+INPUT_SECTION_CONT = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+0x([0-9a-fA-F]+)\s+(\S.*)$")
+SYMBOL = re.compile(r"^\s+0x([0-9a-fA-F]+)\s+([A-Za-z_.$][\w.$]*)\s*$")
+
+
+class Chunk:
+    """
+    One input section placed in an output section
+    """
+    def __init__(self, section, name, address, size, obj):
+        self.section = section
+        self.name = name
+        self.address = address
+        self.size = size
+        self.obj = obj.replace("\\", "/")
+        self.symbols = []
+
+
+def parse_map(path):
+    """
+    Returns the input section chunks of .text, .data and .bss, with the symbols in each
+    """
+    chunks = []
+    section = None
+    chunk = None
+    pending_name = None
+
+    with open(path, errors="replace") as f:
+        in_memory_map = False
+        for line in f:
+            line = line.rstrip("\n")
+
+            if not in_memory_map:
+                in_memory_map = line.startswith("Linker script and memory map")
+                continue
+
+            match = OUTPUT_SECTION.match(line)
+            if match:
+                section = match.group(1) if match.group(1) in SECTIONS else None
+                chunk = None
+                pending_name = None
+                continue
+            if line.startswith(".") and not line.startswith(" "):
+                # Output section we do not track, possibly with its address on the next line
+                section = None
+                chunk = None
+                continue
+
+            if section is None:
+                continue
+
+            # Input section, its address and object may be on the following line for long names
+            match = INPUT_SECTION.match(line)
+            if match and not line.startswith("  "):
+                chunk = None
+                if match.group(2) is None:
+                    pending_name = match.group(1)
+                    continue
+                pending_name = None
+                chunk = add_chunk(chunks, section, match.group(1), match.group(2), match.group(3), match.group(4))
+                continue
+
+            if pending_name is not None:
+                match = INPUT_SECTION_CONT.match(line)
+                name = pending_name
+                pending_name = None
+                if match:
+                    chunk = add_chunk(chunks, section, name, match.group(1), match.group(2), match.group(3))
+                continue
+
+            match = SYMBOL.match(line)
+            if match and chunk is not None:
+                address = int(match.group(1), 16)
+                if chunk.address <= address < chunk.address + chunk.size:
+                    chunk.symbols.append((address, match.group(2)))
+
+    return chunks
+
+
+def add_chunk(chunks, section, name, address, size, obj):
+    size = int(size, 16)
+    if size == 0:
+        return None
+    chunk = Chunk(section, name, int(address, 16), size, obj.strip())
+    chunks.append(chunk)
+    return chunk
+
+
+def attribute(chunks):
+    """
+    Returns a list of (section, owner, object, size), owner being a symbol, or the input
+    section name for string literals and constructors (which have no symbols), or else the object path
+    """
+    pieces = []
+    for chunk in chunks:
+        symbols = sorted(set(chunk.symbols))
+        end = chunk.address + chunk.size
+
+        # Bytes before the first symbol belong to the object
+        first = symbols[0][0] if symbols else end
+        if first > chunk.address:
+            owner = chunk.name if chunk.name.startswith(UNNAMED_SECTIONS) else chunk.obj
+            pieces.append((chunk.section, owner, chunk.obj, first - chunk.address))
+
+        for i, (address, name) in enumerate(symbols):
+            # Aliases at the same address share their bytes with the first of them
+            following = [a for a, _ in symbols[i + 1:] if a > address]
+            size = (following[0] if following else end) - address
+            if i > 0 and symbols[i - 1][0] == address:
+                size = 0
+            pieces.append((chunk.section, name, chunk.obj, size))
+
+    return pieces
+
+
+def module_of(owner, obj, modules):
+    for module in modules:
+        if any((pattern in owner) or (pattern in obj) for pattern in module.get("match", [])):
+            return module["name"]
+    return OTHER
+
+
+def classify(pieces, modules):
+    """
+    Returns {module: {section: bytes}}
+    """
+    usage = {}
+    for section, owner, obj, size in pieces:
+        sizes = usage.setdefault(module_of(owner, obj, modules), dict.fromkeys(SECTIONS, 0))
+        sizes[section] += size
+    return usage
+
+
+def print_detail(pieces, modules, name, count):
+    """
+    Prints the largest pieces attributed to a module, for writing match rules
+    """
+    owned = [p for p in pieces if p[3] > 0 and module_of(p[1], p[2], modules) == name]
+    print("\nLargest in %s:" % name)
+    for section, owner, obj, size in sorted(owned, key=lambda p: -p[3])[:count]:
+        print("%6d  %-4s  %s" % (size, section, owner if owner != obj else os.path.basename(obj)))
+
+
+def flash(sizes):
+    return sizes["text"] + sizes["data"]
+
+
+def ram(sizes):
+    return sizes["data"] + sizes["bss"]
+
+
+def totals(usage):
+    total = dict.fromkeys(SECTIONS, 0)
+    for sizes in usage.values():
+        for section in SECTIONS:
+            total[section] += sizes[section]
+    return total
+
+
+def signed(value):
+    return "+%d" % value if value > 0 else ("%d" % value if value < 0 else "")
+
+
+def report(usage, budget, previous):
+    """
+    Prints the usage table and returns the list of exceeded budgets
+    """
+    budgets = {module["name"]: module for module in budget.get("modules", [])}
+    total = totals(usage)
+
+    failures = []
+    rows = sorted(usage.items(), key=lambda item: -(flash(item[1]) + ram(item[1])))
+    rows.append(("TOTAL", total))
+
+    print("%-20s %7s %6s %6s %13s %13s" % ("module", "text", "data", "bss", "flash", "ram"))
+    for name, sizes in rows:
+        limits = budget.get("total", {}) if name == "TOTAL" else budgets.get(name, {})
+        before = previous.get(name) if previous else None
+
+        cells = []
+        for label, value in (("flash", flash(sizes)), ("ram", ram(sizes))):
+            limit = limits.get(label)
+            if limit is not None and value > limit:
+                failures.append("%s %s %d > %d" % (name, label, value, limit))
+            delta = signed(value - (flash(before) if label == "flash" else ram(before))) if before else ""
+            cells.append("%6d%-7s" % (value, (" " + delta) if delta else ""))
+
+        print("%-20s %7d %6d %6d %s %s" % (name, sizes["text"], sizes["data"], sizes["bss"], cells[0], cells[1]))
+
+    # Modules that disappeared since the previous build
+    if previous:
+        for name in sorted(set(previous) - set(usage) - {"TOTAL"}):
+            print("%-20s removed (was %d flash, %d ram)" % (name, flash(previous[name]), ram(previous[name])))
+
+    return failures
+
+
+def print_compare(usage, before, path):
+    """
+    Prints each section that changed since another build, by module and in total
+    """
+    empty = dict.fromkeys(SECTIONS, 0)
+    rows = [(name, usage.get(name, empty), before.get(name, empty)) for name in sorted(set(usage) | set(before))]
+    rows.append(("TOTAL", totals(usage), totals(before)))
+
+    print("\nChanged since %s:" % path)
+    print("%-20s %-5s %7s %7s %7s" % ("module", "", "before", "after", "change"))
+    for name, new, old in rows:
+        for section in SECTIONS:
+            if new[section] != old[section] or name == "TOTAL":
+                print("%-20s %-5s %7d %7d %7s" % (name, section, old[section], new[section],
+                                                 signed(new[section] - old[section]) or "0"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.strip().splitlines()[0])
+    parser.add_argument("map", help="linker map file")
+    parser.add_argument("--budget", help="budget file, JSON")
+    parser.add_argument("--previous", help="usage saved from the previous build, to diff against")
+    parser.add_argument("--save", help="where to save this build's usage")
+    parser.add_argument("--detail", metavar="MODULE", help="list the largest symbols attributed to a module")
+    parser.add_argument("--compare", metavar="MAP", help="map file of another build, to list each section before and after")
+    args = parser.parse_args()
+
+    budget = {}
+    if args.budget:
+        with open(args.budget) as f:
+            budget = json.load(f)
+
+    previous = None
+    if args.previous and os.path.exists(args.previous):
+        with open(args.previous) as f:
+            previous = json.load(f)
+
+    pieces = attribute(parse_map(args.map))
+    usage = classify(pieces, budget.get("modules", []))
+    failures = report(usage, budget, previous)
+    if args.detail:
+        print_detail(pieces, budget.get("modules", []), args.detail, 25)
+    if args.compare:
+        before = classify(attribute(parse_map(args.compare)), budget.get("modules", []))
+        print_compare(usage, before, args.compare)
+
+    if args.save:
+        with open(args.save, "w") as f:
+            json.dump(dict(usage, TOTAL=totals(usage)), f, indent=1, sort_keys=True)
+
+    for failure in failures:
+        print("Memory budget exceeded: " + failure, file=sys.stderr)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
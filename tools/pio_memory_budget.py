@@ -0,0 +1,47 @@
+"""
+PlatformIO post build script, checks the firmware against memory_budget.json in the project.
+Add to an env with:
+    extra_scripts = post:../tools/pio_memory_budget.py
+
+Only reports by default, as the budgets have not yet been taken from a real build. Once they
+have, fail the build on an overrun with this in the env, or MEMORY_BUDGET_ENFORCE=1 set:
+    custom_memory_budget_enforce = yes
+"""
+
+import os
+import subprocess
+
+Import("env")
+
+MAP_FILE = os.path.join("$BUILD_DIR", "${PROGNAME}.map")
+LAST_USAGE_FILE = os.path.join("$BUILD_DIR", "memory_usage.json")
+
+env.Append(LINKFLAGS=["-Wl,-Map," + MAP_FILE])
+
+
+def is_enforced(env):
+    value = os.environ.get("MEMORY_BUDGET_ENFORCE") or env.GetProjectOption("custom_memory_budget_enforce", "no")
+    return str(value).strip().lower() in ("1", "yes", "true")
+
+
+def check_memory_budget(source, target, env):
+    tool = os.path.join(os.path.dirname(env.subst("$PROJECT_DIR")), "tools", "map_budget.py")
+    budget = os.path.join(env.subst("$PROJECT_DIR"), "memory_budget.json")
+    last = env.subst(LAST_USAGE_FILE)
+
+    command = [env.subst("$PYTHONEXE"), tool, env.subst(MAP_FILE), "--previous", last, "--save", last + ".new"]
+    if os.path.exists(budget):
+        command += ["--budget", budget]
+
+    result = subprocess.call(command)
+
+    # Only diff against builds that passed, so an overrun is reported until it is fixed
+    if result == 0:
+        os.replace(last + ".new", last)
+    elif is_enforced(env):
+        env.Exit(1)
+    else:
+        print("Memory budget exceeded, not enforced until the budgets are calibrated")
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", check_memory_budget)
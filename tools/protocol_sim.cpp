@@ -0,0 +1,187 @@
+/**
+ * Round trip of the VeranusProtocol Reading record through a byte buffer, as the probe and
+ * receiver pass it over the radio and serial links.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I shared/VeranusProtocol tools/protocol_sim.cpp -o protocol_sim
+ *      ./protocol_sim
+ *
+ * Encodes every combination of the minimum, maximum and byte boundary values of each field into
+ * a buffer at an odd offset, with guard bytes either side. The bytes have to be the little endian
+ * layout of VeranusProtocol.hpp, the guards untouched, and decode has to give back every field.
+ * Then decode has to refuse every other version, and every length short of a whole record.
+ * Last, a few readings go through the fixed point conversions and back.
+ */
+
+#include "VeranusProtocol.hpp"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace Protocol;
+
+const static uint8_t GUARD = 0xa5;
+
+const static uint16_t UNSIGNED_VALUES[] = {0, 1, 0x00ff, 0x0100, 0x7fff, 0x8000, 0xfffe, UINT16_MAX};
+const static int16_t SIGNED_VALUES[] = {INT16_MIN, INT16_MIN + 1, -256, -1, 0, 1, 0x00ff, 0x0100, INT16_MAX - 1, INT16_MAX};
+
+const static uint8_t NUM_UNSIGNED = sizeof(UNSIGNED_VALUES) / sizeof(UNSIGNED_VALUES[0]);
+const static uint8_t NUM_SIGNED = sizeof(SIGNED_VALUES) / sizeof(SIGNED_VALUES[0]);
+
+static uint16_t readLittleEndian(const uint8_t* bytes)
+{
+    return (uint16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+// Encodes one reading and checks its bytes and its decode, returns true if all is right
+static bool roundTrip(uint16_t probeId, int16_t temperature, uint16_t humidity, uint16_t light)
+{
+    // Odd offset, so the packed record is misaligned as it can be in a frame
+    uint8_t buffer[sizeof(Reading) + 3];
+    memset(buffer, GUARD, sizeof(buffer));
+    uint8_t* record = buffer + 1;
+
+    Reading* pEncoded = encode(record, probeId, temperature, humidity, light);
+    if ((uint8_t*)pEncoded != record) return false;
+    if ((buffer[0] != GUARD) ||
+        (buffer[sizeof(Reading) + 1] != GUARD) ||
+        (buffer[sizeof(Reading) + 2] != GUARD))
+    {
+        return false;
+    }
+
+    if ((record[0] != VERSION) ||
+        (readLittleEndian(&record[1]) != probeId) ||
+        (readLittleEndian(&record[3]) != (uint16_t)temperature) ||
+        (readLittleEndian(&record[5]) != humidity) ||
+        (readLittleEndian(&record[7]) != light))
+    {
+        return false;
+    }
+
+    // Exactly one record, and one with bytes after it
+    for (uint16_t length=sizeof(Reading); length<=sizeof(Reading) + 1; length++)
+    {
+        const Reading* pDecoded = decode(record, length);
+        if ((pDecoded == nullptr) ||
+            (pDecoded->version != VERSION) ||
+            (pDecoded->probeId != probeId) ||
+            (pDecoded->temperature != temperature) ||
+            (pDecoded->humidity != humidity) ||
+            (pDecoded->light != light))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static void report(const char* name, uint32_t checked, uint32_t failures)
+{
+    printf("%-12s %8u %8u\n", name, checked, failures);
+}
+
+int main()
+{
+    bool pass = true;
+
+    printf("%-12s %8s %8s\n", "check", "cases", "failures");
+
+    // Every combination of the edge values
+    uint32_t checked = 0;
+    uint32_t failures = 0;
+    for (uint8_t p=0; p<NUM_UNSIGNED; p++)
+    {
+        for (uint8_t t=0; t<NUM_SIGNED; t++)
+        {
+            for (uint8_t h=0; h<NUM_UNSIGNED; h++)
+            {
+                for (uint8_t l=0; l<NUM_UNSIGNED; l++)
+                {
+                    checked++;
+                    if (!roundTrip(UNSIGNED_VALUES[p], SIGNED_VALUES[t], UNSIGNED_VALUES[h], UNSIGNED_VALUES[l]))
+                    {
+                        failures++;
+                    }
+                }
+            }
+        }
+    }
+    report("round trip", checked, failures);
+    pass = pass && (failures == 0);
+
+    // Any other version is refused
+    uint8_t record[sizeof(Reading)];
+    checked = 0;
+    failures = 0;
+    for (uint16_t version=0; version<=UINT8_MAX; version++)
+    {
+        if (version == VERSION) continue;
+        encode(record, 1, 7250, 4500, 10000);
+        record[0] = version;
+        checked++;
+        if (decode(record, sizeof(record)) != nullptr) failures++;
+    }
+    report("version", checked, failures);
+    pass = pass && (failures == 0);
+
+    // Any length short of a whole record is refused, even with the right version
+    checked = 0;
+    failures = 0;
+    encode(record, 1, 7250, 4500, 10000);
+    for (uint16_t length=0; length<sizeof(Reading); length++)
+    {
+        checked++;
+        if (decode(record, length) != nullptr) failures++;
+    }
+    report("short", checked, failures);
+    pass = pass && (failures == 0);
+
+    // Readings the sensors give, through the fixed point conversions
+    struct Conversion
+    {
+        float temperatureF;
+        float humidity;
+        int16_t fixedTemperature;
+        uint16_t fixedHumidity;
+    };
+    const static Conversion CONVERSIONS[] =
+    {
+        {72.5f, 45.0f, 7250, 4500},
+        {-40.0f, 0.0f, -4000, 0},
+        {0.004f, 100.0f, 0, 10000},
+        {-0.006f, 99.995f, -1, 10000},
+        {327.67f, 655.35f, INT16_MAX, UINT16_MAX},
+        {-327.68f, 0.01f, INT16_MIN, 1},
+        {1000.0f, 1000.0f, INT16_MAX, UINT16_MAX},
+        {-1000.0f, -5.0f, INT16_MIN, 0},
+    };
+    checked = 0;
+    failures = 0;
+    for (uint8_t i=0; i<sizeof(CONVERSIONS) / sizeof(CONVERSIONS[0]); i++)
+    {
+        const Conversion& conversion = CONVERSIONS[i];
+        encode(record, 1, toFixedTemperature(conversion.temperatureF), toFixedPercent(conversion.humidity), 0);
+        const Reading* pDecoded = decode(record, sizeof(record));
+        checked++;
+        if ((pDecoded == nullptr) ||
+            (pDecoded->temperature != conversion.fixedTemperature) ||
+            (pDecoded->humidity != conversion.fixedHumidity) ||
+            (toFixedTemperature(fromFixedTemperature(pDecoded->temperature)) != conversion.fixedTemperature) ||
+            (toFixedPercent(fromFixedPercent(pDecoded->humidity)) != conversion.fixedHumidity))
+        {
+            printf("  %.3fF %.3f%% gave %d %u\n",
+                   conversion.temperatureF,
+                   conversion.humidity,
+                   (pDecoded != nullptr) ? pDecoded->temperature : 0,
+                   (pDecoded != nullptr) ? pDecoded->humidity : 0);
+            failures++;
+        }
+    }
+    report("conversion", checked, failures);
+    pass = pass && (failures == 0);
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
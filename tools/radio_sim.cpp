@@ -0,0 +1,402 @@
+/**
+ * Simulated radio and probes for the receiver, measuring how long a scan of several probes takes,
+ * and how long the CLI takes to answer while the radio waits on a probe.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusReceiver/src -I shared/VeranusProtocol -I shared/SerialFrame \
+ *          -I shared/TaskScheduler -I shared/CommandTable -I tools/stubs tools/radio_sim.cpp \
+ *          VeranusReceiver/src/veranusReceiver/VeranusReceiver.cpp \
+ *          VeranusReceiver/src/veranusReceiver/ReceiverCli.cpp shared/SerialFrame/SerialFrame.cpp \
+ *          shared/TaskScheduler/TaskScheduler.cpp shared/CommandTable/CommandTable.cpp -o radio_sim
+ *      ./radio_sim [sweeps]
+ *
+ * The receiver runs its real main loop: the RADIO and CLI tasks of main.cpp from the shared
+ * scheduler, and an update straight away whenever the radio raises its IRQ. The radio model takes 1ms to send
+ * each request. A probe that is there answers 2-12ms later and raises the IRQ, one that is not
+ * never answers, so the receiver waits out its 10s timeout. Simulated time moves 4us for every
+ * time source call. Results are decoded from the UART as the host would see them.
+ *
+ * For 1 to 16 probes, reports how long a sweep takes, from the request reaching the receiver to
+ * the last result reaching the host: as one scan of every probe, and one probe at a time with
+ * the host waiting for each result before asking for the next. Then the same with one of the
+ * probes missing.
+ *
+ * Then READs a missing probe, and while the receiver waits out the timeout the host sends a
+ * command line every 20-200ms, at the host baud rate. Reports how long after the end of each
+ * line the CLI read it, which has to be within the CLI task's deadline, and the longest any task
+ * was held up past when it was due.
+ *
+ * Last, checks that a receiver that has polled no probe yet refuses to subscribe to every known
+ * probe, and that unsubscribing in the middle of a round still answers the READs queued with it.
+ */
+
+#include "devices.hpp"
+#include "veranusReceiver/ReceiverCli.hpp"
+#include "TaskScheduler.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+static const uint32_t COUNT_US = 64;
+static const uint32_t TIC_US = COUNTS_PER_TIC * COUNT_US;
+static const uint32_t CPU_US_PER_TIME_CALL = 4;
+static const uint32_t TIMEOUT_SECONDS = 10;
+
+// 38400 baud, ten bits a byte
+static const uint32_t HOST_BYTE_US = 260;
+static const uint32_t MIN_COMMAND_GAP_US = 20000;
+static const uint32_t MAX_COMMAND_GAP_US = 200000;
+
+static const uint32_t TRANSMIT_US = 1000;
+static const uint32_t MIN_REPLY_US = 2000;
+static const uint32_t MAX_REPLY_US = 12000;
+static const uint32_t NEVER = UINT32_MAX;
+
+static uint64_t now = 0;
+static uint64_t nextTic = TIC_US;
+static Tic::TicCounter ticCounter(TICS_PER_SECOND);
+static VeranusReceiver* pReceiver = nullptr;
+
+/**
+ * Move the clock on, running the tic interrupt on the way
+ */
+static void advanceTo(uint64_t time)
+{
+    now = time;
+    while (nextTic <= now)
+    {
+        ticCounter.incrementTicCount();
+        nextTic += TIC_US;
+    }
+}
+
+uint32_t getTimerCounts()
+{
+    advanceTo(now + CPU_US_PER_TIME_CALL);
+    return now / COUNT_US;
+}
+
+/**
+ * nRF24L01 and the probes at the other end of it
+ */
+class SimRadio: public Radio::IRadio
+{
+    public:
+        void setPayloadSize(uint8_t){}
+
+        bool startTransmitting(uint8_t){ return true; }
+        bool transmit(uint8_t* data, uint8_t)
+        {
+            advanceTo(now + TRANSMIT_US);
+            requested_ = data[0];
+            return true;
+        }
+
+        bool startReceiving(uint8_t)
+        {
+            replyAt_ = NEVER;
+            if ((requested_ != missingProbe) && (requested_ < 64))
+            {
+                replyAt_ = now + MIN_REPLY_US + (rand() % (MAX_REPLY_US - MIN_REPLY_US));
+            }
+            return true;
+        }
+
+        bool isDataAvailable(){ return (replyAt_ != NEVER) && (now >= replyAt_); }
+        bool receive(uint8_t* data, uint8_t length)
+        {
+            if ((length < sizeof(Protocol::Reading)) || !isDataAvailable()) return false;
+
+            Protocol::encode(data, requested_, 7012, 4550, 1234);
+            replyAt_ = NEVER;
+            return true;
+        }
+
+        /**
+         * Raise the IRQ once the reply is in
+         */
+        uint64_t getIrqTime(){ return irqRaised_ ? NEVER : replyAt_; }
+        void checkIrq()
+        {
+            if ((replyAt_ != NEVER) && (now >= replyAt_) && !irqRaised_)
+            {
+                irqRaised_ = true;
+                pReceiver->onRadioInterrupt();
+            }
+            if (replyAt_ == NEVER) irqRaised_ = false;
+        }
+
+        uint8_t missingProbe = 0xff;
+
+    private:
+        uint8_t requested_ = 0;
+        uint64_t replyAt_ = NEVER;
+        bool irqRaised_ = false;
+};
+
+/**
+ * Host end of the UART, collects the results and sends command lines
+ */
+class HostUart: public Uart::IUart
+{
+    public:
+        HostUart(): decoder_(frame_, sizeof(frame_)){}
+
+        void initialize(){}
+        void flush(){}
+
+        /**
+         * Send a line, a byte at a time from now at the baud rate
+         */
+        void sendLine(const char* line)
+        {
+            uint64_t arrival = (rx_.empty() || (rx_.back().arrival < now)) ? now : rx_.back().arrival;
+            for (const char* c=line; *c!='\0'; c++)
+            {
+                arrival += HOST_BYTE_US;
+                rx_.push_back({*c, arrival});
+            }
+        }
+
+        bool isDataAvailable(){ return !rx_.empty() && (rx_.front().arrival <= now); }
+        uint16_t read(uint8_t* data, uint16_t length)
+        {
+            uint16_t i = 0;
+            while ((i < length) && isDataAvailable())
+            {
+                data[i++] = rx_.front().c;
+                if (rx_.front().c == '\n')
+                {
+                    uint64_t latency = now - rx_.front().arrival;
+                    lines++;
+                    if (latency > worstLineLatency) worstLineLatency = latency;
+                }
+                rx_.pop_front();
+            }
+            return i;
+        }
+
+        void write(const uint8_t* data, uint16_t length)
+        {
+            for (uint16_t i=0; i<length; i++)
+            {
+                if (!decoder_.addByte(data[i])) continue;
+
+                results++;
+                if (decoder_.getChannel() == Frame::Channel::FAILURE) failures++;
+                lastResultAt = now;
+            }
+        }
+
+        uint32_t results = 0;
+        uint32_t failures = 0;
+        uint64_t lastResultAt = 0;
+
+        uint32_t lines = 0;
+        uint64_t worstLineLatency = 0;
+
+    private:
+        struct RxByte
+        {
+            char c;
+            uint64_t arrival;
+        };
+        std::deque<RxByte> rx_;
+
+        uint8_t frame_[Frame::encodedLength(Frame::MAX_PAYLOAD_LEN)];
+        Frame::Decoder decoder_;
+};
+
+static SimRadio radio;
+static HostUart uart;
+static Timer::SoftwareTimer timeoutTimer(TIMEOUT_SECONDS * TICS_PER_SECOND, &ticCounter);
+static VeranusReceiver receiver(&radio, &uart, &timeoutTimer, &getTimerCounts);
+
+// What ReceiverCli.cpp takes from devices.cpp
+Uart::IUart* pUart = &uart;
+VeranusReceiver* pVeranusReceiver = &receiver;
+
+static void updateCli()
+{
+    pCli->update();
+}
+
+static void updateReceiver()
+{
+    receiver.update();
+}
+
+// As in main.cpp
+static const Scheduler::Task tasks[] =
+{
+    {"RADIO", updateReceiver, COUNTS_PER_TIC, 0, COUNTS_PER_TIC},
+    {"CLI",   updateCli,      COUNTS_PER_TIC, 1, 2 * COUNTS_PER_TIC}
+};
+static const uint8_t numTasks = sizeof(tasks) / sizeof(tasks[0]);
+static Scheduler::TaskStats taskStats[numTasks];
+static Scheduler::TaskScheduler scheduler(tasks, taskStats, numTasks, &getTimerCounts);
+
+/**
+ * Run the receiver's main loop until the host has the given number of results, or until the time
+ * given, sending a command line now and then if asked to
+ */
+static void runUntilResults(uint32_t results, bool sendCommands = false, uint64_t until = UINT64_MAX)
+{
+    static const char* const lines[] = {"CREDIT 1\n", "PERIOD 5\n", "HELP\n", "UNSUBSCRIBE\n"};
+    uint64_t nextLineAt = now;
+    uint8_t nextLine = 0;
+
+    while ((uart.results < results) && (now < until))
+    {
+        if (sendCommands && (now >= nextLineAt))
+        {
+            uart.sendLine(lines[nextLine]);
+            nextLine = (nextLine + 1) % (sizeof(lines) / sizeof(lines[0]));
+            nextLineAt = now + MIN_COMMAND_GAP_US + (rand() % (MAX_COMMAND_GAP_US - MIN_COMMAND_GAP_US));
+        }
+
+        radio.checkIrq();
+        if (receiver.hasRadioEvent())
+        {
+            receiver.update();
+            continue;
+        }
+        if (scheduler.runNext()) continue;
+
+        // Idle until the next task or the radio IRQ
+        uint64_t wake = (uint64_t)taskStats[0].nextRun * COUNT_US;
+        for (uint8_t i=1; i<numTasks; i++)
+        {
+            uint64_t due = (uint64_t)taskStats[i].nextRun * COUNT_US;
+            if (due < wake) wake = due;
+        }
+        if (radio.getIrqTime() < wake) wake = radio.getIrqTime();
+        if (sendCommands && (nextLineAt < wake)) wake = nextLineAt;
+        if (wake > now) advanceTo(wake);
+    }
+}
+
+struct Sweep
+{
+    double scanMs;
+    double serialMs;
+    uint32_t failures;
+};
+
+static Sweep sweep(uint8_t numProbes)
+{
+    std::vector<uint8_t> probeIds;
+    for (uint8_t i=0; i<numProbes; i++) probeIds.push_back(i + 1);
+
+    Sweep result = {};
+
+    // One scan of every probe
+    uint32_t failures = uart.failures;
+    uint64_t start = now;
+    receiver.scan(probeIds.data(), numProbes);
+    runUntilResults(uart.results + numProbes);
+    result.scanMs = (uart.lastResultAt - start) / 1000.0;
+
+    // A probe at a time, the host waiting for each result
+    start = now;
+    for (uint8_t probeId: probeIds)
+    {
+        receiver.scan(&probeId, 1);
+        runUntilResults(uart.results + 1);
+    }
+    result.serialMs = (uart.lastResultAt - start) / 1000.0;
+    result.failures = uart.failures - failures;
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t sweeps = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 20;
+    pReceiver = &receiver;
+    pCli->enable();
+    scheduler.start();
+
+    printf("%-7s %6s %12s %12s %8s %8s\n", "missing", "probes", "scanMs", "serialMs", "speedup", "failed");
+
+    bool pass = true;
+    for (uint8_t missing=0; missing<2; missing++)
+    {
+        for (uint8_t numProbes=1; numProbes<=MAX_SCAN_PROBES; numProbes++)
+        {
+            // The last probe is the one missing, if any
+            radio.missingProbe = missing ? numProbes : 0xff;
+
+            Sweep total = {};
+            for (uint32_t i=0; i<sweeps; i++)
+            {
+                Sweep one = sweep(numProbes);
+                total.scanMs += one.scanMs;
+                total.serialMs += one.serialMs;
+                total.failures += one.failures;
+            }
+
+            printf("%-7s %6u %12.1f %12.1f %8.2f %8u\n",
+                   missing ? "one" : "none",
+                   numProbes,
+                   total.scanMs / sweeps,
+                   total.serialMs / sweeps,
+                   total.serialMs / total.scanMs,
+                   total.failures);
+
+            // A missing probe fails in both runs of a sweep, and nothing else does
+            pass = pass && (total.failures == (missing ? (2 * sweeps) : 0));
+        }
+    }
+
+    // The CLI keeps answering while a READ waits out a missing probe
+    for (uint8_t i=0; i<numTasks; i++) taskStats[i].maxLateness = 0;
+    uint8_t missingProbe = radio.missingProbe;
+    uint64_t start = now;
+    receiver.scan(&missingProbe, 1);
+    runUntilResults(uart.results + 1, true);
+    double waitMs = (uart.lastResultAt - start) / 1000.0;
+
+    printf("\n%-8s %8s %14s %16s %16s\n", "waitMs", "lines", "worstLineMs", "radioLateMs", "cliLateMs");
+    printf("%-8.1f %8u %14.2f %16.2f %16.2f\n",
+           waitMs,
+           uart.lines,
+           uart.worstLineLatency / 1000.0,
+           (taskStats[0].maxLateness * COUNT_US) / 1000.0,
+           (taskStats[1].maxLateness * COUNT_US) / 1000.0);
+
+    uint64_t cliDeadlineUs = tasks[1].deadline * COUNT_US;
+    pass = pass && (waitMs >= (TIMEOUT_SECONDS * 1000)) && (uart.lines > 0) &&
+           (uart.worstLineLatency <= cliDeadlineUs) && (taskStats[1].overruns == 0);
+
+    // SUBSCRIBE with no list polls the known probes, of which a receiver just booted has none
+    VeranusReceiver fresh(&radio, &uart, &timeoutTimer, &getTimerCounts);
+    bool emptyRefused = !fresh.subscribe(nullptr, 0) && !fresh.isSubscribed();
+
+    // UNSUBSCRIBE drops the rest of the round, but not READs queued alongside it, even of a
+    // probe the round was also going to poll
+    static const uint8_t subscribed[] = {1, 2, 3, 4, 5, 6};
+    static const uint8_t reads[] = {4, 20};
+    radio.missingProbe = 0xff;
+    receiver.setRoundPeriod(0);
+    receiver.subscribe(subscribed, sizeof(subscribed));
+    receiver.update();
+    receiver.scan(reads, sizeof(reads));
+    receiver.unsubscribe();
+
+    uint32_t results = uart.results;
+    runUntilResults(UINT32_MAX, false, now + (2 * 1000000));
+    uint32_t afterUnsubscribe = uart.results - results;
+
+    printf("\n%-12s %18s\n", "emptyRefused", "afterUnsubscribe");
+    printf("%-12s %18u\n", emptyRefused ? "yes" : "no", afterUnsubscribe);
+
+    // The probe already on the air, then both READs
+    pass = pass && emptyRefused && (afterUnsubscribe == (1 + sizeof(reads)));
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
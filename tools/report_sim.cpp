@@ -0,0 +1,221 @@
+/**
+ * Trace driven simulation of the probe's climate reporting, comparing adaptive sampling and
+ * send on change (ReportPolicy) against the old fixed schedule of a reading every 5 minutes
+ * with every third reading uploaded.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusProbe/src tools/report_sim.cpp \
+ *          VeranusProbe/src/reportPolicy/ReportPolicy.cpp -o report_sim
+ *      ./report_sim trace.csv [tempDeadband humidityDeadband heartbeatMinutes fastSeconds slowSeconds]
+ *
+ * The trace has a line per point, "seconds,temperatureF,humidity", and is interpolated between
+ * points. Use "-" instead of a file for a built in week long trace of a stable site with a few
+ * excursions. Reports the readings taken, messages sent, and how far the last value sent was
+ * from the real climate at worst.
+ */
+
+#include "reportPolicy/ReportPolicy.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+struct TracePoint
+{
+    double seconds;
+    double temperature;
+    double humidity;
+};
+
+struct Result
+{
+    unsigned readings;
+    unsigned messages;
+    double worstTemperature;
+    double worstHumidity;
+};
+
+static const uint32_t OLD_PERIOD = 5 * 60;
+static const unsigned OLD_READINGS_PER_UPLOAD = 3;
+
+static std::vector<TracePoint> makeSyntheticTrace()
+{
+    // A week at a minute resolution, a gentle daily cycle with sensor noise, and an excursion
+    // (a door left open, heating failing) on some days
+    std::vector<TracePoint> trace;
+    srand(1);
+    for (uint32_t minute=0; minute<(7 * 24 * 60); minute++)
+    {
+        double day = minute / (24.0 * 60.0);
+        double temperature = 72.0 + (1.5 * sin(2 * M_PI * day));
+        double humidity = 50.0 - (3.0 * sin(2 * M_PI * day));
+
+        double dayMinute = fmod(minute, 24.0 * 60.0);
+        int dayIndex = minute / (24 * 60);
+        if (((dayIndex % 3) == 1) && (dayMinute >= 600) && (dayMinute < 780))
+        {
+            // Drops 10F over 30 minutes, then recovers over the next 2.5 hours
+            double t = dayMinute - 600;
+            double drop = (t < 30) ? (t / 30.0) : (1.0 - ((t - 30) / 150.0));
+            temperature -= 10.0 * drop;
+            humidity += 12.0 * drop;
+        }
+
+        temperature += ((rand() % 11) - 5) * 0.01;
+        humidity += ((rand() % 21) - 10) * 0.01;
+        trace.push_back({minute * 60.0, temperature, humidity});
+    }
+
+    return trace;
+}
+
+static bool loadTrace(const char* path, std::vector<TracePoint>& trace)
+{
+    FILE* pFile = fopen(path, "r");
+    if (pFile == nullptr) return false;
+
+    TracePoint point;
+    while (fscanf(pFile, "%lf,%lf,%lf", &point.seconds, &point.temperature, &point.humidity) == 3)
+    {
+        trace.push_back(point);
+    }
+
+    fclose(pFile);
+    return trace.size() > 1;
+}
+
+// The climate at a time, interpolated between trace points
+static TracePoint sample(const std::vector<TracePoint>& trace, double seconds, size_t& index)
+{
+    while (((index + 2) < trace.size()) && (trace[index + 1].seconds <= seconds)) index++;
+
+    const TracePoint& a = trace[index];
+    const TracePoint& b = trace[index + 1];
+    double fraction = (seconds - a.seconds) / (b.seconds - a.seconds);
+    if (fraction < 0) fraction = 0;
+    if (fraction > 1) fraction = 1;
+
+    return {seconds,
+            a.temperature + ((b.temperature - a.temperature) * fraction),
+            a.humidity + ((b.humidity - a.humidity) * fraction)};
+}
+
+/**
+ * Run through the trace, a reading every period, sending the readings chosen. The error is how
+ * far the last value sent is from the trace, checked at every trace point
+ */
+template <typename Reading>
+static Result simulate(const std::vector<TracePoint>& trace, Reading onReading)
+{
+    Result result = {0, 0, 0, 0};
+    double end = trace.back().seconds;
+    double next = trace.front().seconds;
+    TracePoint sent = trace.front();
+    bool hasSent = false;
+    size_t sampleIndex = 0;
+
+    for (const TracePoint& point : trace)
+    {
+        while (next <= point.seconds)
+        {
+            TracePoint reading = sample(trace, next, sampleIndex);
+            int16_t temperature = (int16_t)lround(reading.temperature * 100);
+            uint16_t humidity = (uint16_t)lround(reading.humidity * 100);
+
+            uint32_t period;
+            bool send = onReading((uint32_t)next, temperature, humidity, period);
+            result.readings++;
+            if (send)
+            {
+                result.messages++;
+                sent = reading;
+                hasSent = true;
+            }
+            next += period;
+        }
+
+        if (hasSent && (point.seconds <= end))
+        {
+            result.worstTemperature = fmax(result.worstTemperature, fabs(point.temperature - sent.temperature));
+            result.worstHumidity = fmax(result.worstHumidity, fabs(point.humidity - sent.humidity));
+        }
+    }
+
+    return result;
+}
+
+static void printResult(const char* name, const Result& result, double days)
+{
+    printf("%-10s %8u %8u %10.1f %10.2f %10.2f\n",
+           name,
+           result.readings,
+           result.messages,
+           result.messages / days,
+           result.worstTemperature,
+           result.worstHumidity);
+}
+
+int main(int argc, char** argv)
+{
+    if ((argc != 2) && (argc != 7))
+    {
+        fprintf(stderr, "Usage: %s trace.csv|- [tempDeadband humidityDeadband heartbeatMinutes fastSeconds slowSeconds]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<TracePoint> trace;
+    if (argv[1][0] == '-')
+    {
+        trace = makeSyntheticTrace();
+    }
+    else if (!loadTrace(argv[1], trace))
+    {
+        fprintf(stderr, "Could not read a trace from %s\n", argv[1]);
+        return 1;
+    }
+
+    // Defaults match a freshly configured probe
+    Settings settings = {};
+    settings.tempDeadband = 5;
+    settings.humidityDeadband = 20;
+    settings.heartbeatMinutes = 60;
+    settings.fastSampleSeconds = 60;
+    settings.slowSampleSeconds = 5 * 60;
+    if (argc == 7)
+    {
+        settings.tempDeadband = atoi(argv[2]);
+        settings.humidityDeadband = atoi(argv[3]);
+        settings.heartbeatMinutes = atoi(argv[4]);
+        settings.fastSampleSeconds = atoi(argv[5]);
+        settings.slowSampleSeconds = atoi(argv[6]);
+    }
+
+    unsigned oldCount = 0;
+    Result old = simulate(trace, [&](uint32_t, int16_t, uint16_t, uint32_t& period)
+    {
+        period = OLD_PERIOD;
+        return (++oldCount % OLD_READINGS_PER_UPLOAD) == 1;
+    });
+
+    ReportPolicy policy(&settings);
+    Result adaptive = simulate(trace, [&](uint32_t uptime, int16_t temperature, uint16_t humidity, uint32_t& period)
+    {
+        bool send = policy.onReading(uptime, temperature, humidity);
+        period = policy.getSamplePeriod();
+        return send;
+    });
+
+    double days = (trace.back().seconds - trace.front().seconds) / (24 * 60 * 60);
+    printf("%.1f days, deadband %.1fF %.1f%%, heartbeat %u min, sampling %u-%u s\n",
+           days,
+           settings.tempDeadband / 10.0,
+           settings.humidityDeadband / 10.0,
+           settings.heartbeatMinutes,
+           settings.fastSampleSeconds,
+           settings.slowSampleSeconds);
+    printf("%-10s %8s %8s %10s %10s %10s\n", "", "readings", "messages", "per day", "worst F", "worst %");
+    printResult("fixed", old, days);
+    printResult("adaptive", adaptive, days);
+    return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef SELFHEAT_SIM_ASYNC_HDC1080_HPP
+#define SELFHEAT_SIM_ASYNC_HDC1080_HPP
+
+#include <stdint.h>
+
+/**
+ * Stands in for the HDC1080 driver, handing out whatever reading the tool set last
+ */
+class AsyncHdc1080
+{
+    public:
+        enum class Result: uint8_t
+        {
+            BUSY = 0,
+            READY,
+            FAILED
+        };
+
+        bool initialize(){ return true; }
+
+        Result update(int16_t& temperatureF, uint16_t& humidity)
+        {
+            temperatureF = temperature;
+            humidity = relativeHumidity;
+            return Result::READY;
+        }
+
+        int16_t temperature = 0;
+        uint16_t relativeHumidity = 0;
+};
+
+#endif
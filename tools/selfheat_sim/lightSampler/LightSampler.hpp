@@ -0,0 +1,16 @@
+#ifndef SELFHEAT_SIM_LIGHT_SAMPLER_HPP
+#define SELFHEAT_SIM_LIGHT_SAMPLER_HPP
+
+#include <stdint.h>
+
+/**
+ * Stands in for the light sampler, which the corrections do not use
+ */
+class LightSampler
+{
+    public:
+        void initialize(){}
+        uint16_t getLight(){ return 0; }
+};
+
+#endif
@@ -0,0 +1,175 @@
+/**
+ * Compares the probe's fixed point self heating corrections against the float formulas they
+ * replaced, over every reading the probe can take.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I tools/selfheat_sim -I VeranusProbe/src -I shared/VeranusProtocol \
+ *          -I tools/stubs tools/selfheat_sim/selfheat_sim.cpp \
+ *          VeranusProbe/src/veranusProbe/VeranusProbe.cpp VeranusProbe/src/ProbeStrings.cpp \
+ *          -o selfheat_sim
+ *      ./selfheat_sim [tempStep]
+ *
+ * The HDC1080 driver in tools/selfheat_sim/asyncHdc1080 hands VeranusProbe whatever reading is
+ * set, so readClimate() runs the real corrections. The float formulas are those of revision 2,
+ * with the same calibration constants, except that the correction ramps in over the first 15
+ * minutes of uptime rather than over the first 6 readings, as the fixed point one now does.
+ *
+ * Every measured temperature from -20F to 120F in steps of tempStep hundredths, and every
+ * humidity from 0% to 100% in steps of 0.37%, is corrected at backlight brightnesses of 0% to
+ * 100% and at uptimes through and past the ramp. Reports the worst difference from the float
+ * result for temperature and humidity, in hundredths, and where it was. This measures accuracy
+ * only, the cycles and flash saved need an avr-gcc build.
+ */
+
+#include "veranusProbe/VeranusProbe.hpp"
+#include "config.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+// Calibration of VeranusProbe.cpp, as the float formulas used it
+const static float A_VAL = 17.27f;
+const static float B_VAL = 237.7f;
+const static float TEMP_CORRECTION_SLOPE = 0.0f;
+const static float TEMP_CORRECTION_OFFSET = -3.0f;
+const static float TEMP_CORRECTION_LCD_FACTOR = -2.0f;
+const static float HUM_CORRECTION_SLOPE = 0.0f;
+const static float HUM_CORRECTION_OFFSET = 0;
+const static float HUM_CORRECTION_LCD_FACTOR = -4.5f;
+const static uint32_t CORRECT_GRADIENT_SECONDS = 15 * 60;
+const static float MAX_LED_BRIGHTNESS = 100.f;
+
+// Worst differences the comment in VeranusProbe.cpp claims, in hundredths
+const static float MAX_TEMP_ERROR = 1.0f;
+const static float MAX_HUM_ERROR = 10.0f;
+
+const static uint8_t brightnesses[] = {0, 1, 25, 50, 73, 100};
+const static uint32_t uptimes[] = {0, 1, 60, 449, 450, 899, 900, 86400};
+
+static uint32_t tics = 0;
+static uint32_t getTics(){ return tics; }
+
+static float getAdjustment(float value, float slope, float offset, float lcdFactor, uint8_t brightness, uint32_t uptime)
+{
+    float adjustment = (value * slope) + offset;
+    adjustment += (brightness / MAX_LED_BRIGHTNESS) * lcdFactor;
+    if (uptime < CORRECT_GRADIENT_SECONDS)
+    {
+        adjustment *= (float)uptime / CORRECT_GRADIENT_SECONDS;
+    }
+    return adjustment;
+}
+
+/**
+ * Revision 2 corrections, in float
+ */
+static void correctFloat(float tempMeasured, float humidityMeasured, uint8_t brightness, uint32_t uptime,
+                         float& temperatureF, float& humidity)
+{
+    temperatureF = tempMeasured;
+    float tempAdjustment = getAdjustment(tempMeasured,
+                                         TEMP_CORRECTION_SLOPE,
+                                         TEMP_CORRECTION_OFFSET,
+                                         TEMP_CORRECTION_LCD_FACTOR,
+                                         brightness,
+                                         uptime);
+    if (tempAdjustment < 0) temperatureF += tempAdjustment;
+
+    float tempPortion = A_VAL * B_VAL * (tempMeasured - temperatureF);
+    tempPortion /= (B_VAL + tempMeasured) * (B_VAL + temperatureF);
+    humidity = humidityMeasured * exp(tempPortion);
+    humidity += getAdjustment(humidity,
+                              HUM_CORRECTION_SLOPE,
+                              HUM_CORRECTION_OFFSET,
+                              HUM_CORRECTION_LCD_FACTOR,
+                              brightness,
+                              uptime);
+
+    // The wire format has no negative humidity
+    if (humidity < 0) humidity = 0;
+}
+
+struct Worst
+{
+    float error;
+    int16_t tempMeasured;
+    uint16_t humidityMeasured;
+    uint8_t brightness;
+    uint32_t uptime;
+};
+
+static void check(Worst& worst, float error, int16_t tempMeasured, uint16_t humidityMeasured,
+                  uint8_t brightness, uint32_t uptime)
+{
+    if (error <= worst.error) return;
+    worst = {error, tempMeasured, humidityMeasured, brightness, uptime};
+}
+
+static void report(const char* name, const Worst& worst, float limit)
+{
+    printf("%-12s %6.2f %6.2f %8.2f %11.2f %6u %9u\n",
+           name,
+           worst.error,
+           limit,
+           worst.tempMeasured / 100.f,
+           worst.humidityMeasured / 100.f,
+           worst.brightness,
+           worst.uptime);
+}
+
+int main(int argc, char** argv)
+{
+    int16_t tempStep = (argc > 1) ? strtol(argv[1], nullptr, 10) : 7;
+
+    AsyncHdc1080 climateSensor;
+    LightSampler lightSensor;
+    VeranusProbe probe(&climateSensor, &lightSensor, &getTics);
+    probe.init();
+
+    Worst worstTemp = {};
+    Worst worstHum = {};
+    uint32_t readings = 0;
+
+    for (uint8_t b=0; b<sizeof(brightnesses); b++)
+    {
+        probe.setLcdBrightness(brightnesses[b]);
+        for (uint8_t u=0; u<(sizeof(uptimes) / sizeof(uptimes[0])); u++)
+        {
+            tics = uptimes[u] * TICS_PER_SECOND;
+            for (int16_t t=-2000; t<=12000; t+=tempStep)
+            {
+                for (uint16_t h=0; h<=10000; h+=37)
+                {
+                    climateSensor.temperature = t;
+                    climateSensor.relativeHumidity = h;
+
+                    int16_t temperatureF;
+                    uint16_t humidity;
+                    probe.readClimate(temperatureF, humidity);
+
+                    float floatTemperature, floatHumidity;
+                    correctFloat(t / 100.f, h / 100.f, brightnesses[b], uptimes[u], floatTemperature, floatHumidity);
+
+                    check(worstTemp, fabs(temperatureF - (floatTemperature * 100)), t, h, brightnesses[b], uptimes[u]);
+
+                    // Past 100% the humidity is already wrong, so only the range the claim covers
+                    if (floatHumidity <= 100)
+                    {
+                        check(worstHum, fabs(humidity - (floatHumidity * 100)), t, h, brightnesses[b], uptimes[u]);
+                    }
+                    readings++;
+                }
+            }
+        }
+    }
+
+    printf("%u readings corrected\n\n", readings);
+    printf("%-12s %6s %6s %8s %11s %6s %9s\n", "value", "worst", "limit", "atTempF", "atHumidity", "atLcd", "atUptime");
+    report("temperature", worstTemp, MAX_TEMP_ERROR);
+    report("humidity", worstHum, MAX_HUM_ERROR);
+
+    bool pass = (worstTemp.error <= MAX_TEMP_ERROR) && (worstHum.error <= MAX_HUM_ERROR);
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
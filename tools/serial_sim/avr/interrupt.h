@@ -0,0 +1,7 @@
+#ifndef SERIAL_SIM_AVR_INTERRUPT_H
+#define SERIAL_SIM_AVR_INTERRUPT_H
+
+// Interrupts are called by the simulated timer, between calls from the main loop
+#define ISR(vector) void vector()
+
+#endif
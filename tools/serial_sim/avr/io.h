@@ -0,0 +1,57 @@
+#ifndef SERIAL_SIM_AVR_IO_H
+#define SERIAL_SIM_AVR_IO_H
+
+/**
+ * Just the Timer 0, port D and analog comparator registers, for serial_sim.cpp. Writes to the
+ * flag register and the forced compare bit are handed to the simulated timer
+ */
+
+#include <stdint.h>
+
+class Register
+{
+    public:
+        Register& operator=(uint8_t newValue);
+        Register& operator|=(int bits){ return *this = value | bits; }
+        Register& operator&=(int bits){ return *this = value & bits; }
+        operator uint8_t() const { return value; }
+
+        uint8_t value;
+};
+
+extern Register PORTD;
+extern Register DDRD;
+extern Register PIND;
+extern Register TCCR0A;
+extern Register TCCR0B;
+extern Register TCNT0;
+extern Register OCR0A;
+extern Register OCR0B;
+extern Register TIMSK0;
+extern Register TIFR0;
+extern Register ACSR;
+extern Register ADCSRB;
+
+#define PORTD6  6
+#define DDD6    6
+#define DDD7    7
+#define PIND7   7
+
+#define COM0A1  7
+#define COM0A0  6
+#define FOC0A   7
+#define CS01    1
+
+#define OCIE0B  2
+#define OCIE0A  1
+#define OCF0B   2
+#define OCF0A   1
+
+#define ACBG    6
+#define ACI     4
+#define ACIE    3
+#define ACIS1   1
+#define ACIS0   0
+#define ACME    6
+
+#endif
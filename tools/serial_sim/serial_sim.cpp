@@ -0,0 +1,266 @@
+/**
+ * Simulated Timer 0 and analog comparator for the probe's TimerSerial, with TX wired to RX, checking
+ * that every byte round trips and that interrupt latency does not move the TX edges.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -DF_CPU=16000000UL -I tools/serial_sim -I VeranusProbe/src \
+ *          -I tools/stubs tools/serial_sim/serial_sim.cpp \
+ *          VeranusProbe/src/timerSerial/TimerSerial.cpp -o serial_sim
+ *      ./serial_sim [maxLatencyUs]
+ *
+ * The registers in tools/serial_sim/avr/io.h drive a model of Timer 0 counting at F_CPU / 8,
+ * a count at a time. Compare A sets or clears the TX pin in hardware on a match, as set in
+ * TCCR0A, and the RX pin follows the TX pin. A falling RX edge trips the analog comparator.
+ * Each interrupt runs a random 0 to maxLatencyUs (20us by default) after its flag is raised, as
+ * if the tic interrupt or the hardware UART had the CPU.
+ *
+ * Every byte value is written in blocks of 64, each once the last has been received, so the
+ * port starts from idle as well as sending back to back. This is done at the wifi baud rate and
+ * at twice and four times it. Reports the bytes received, the RX errors, and how far the TX
+ * edges land from a whole number of bits after the one before, in timer counts of 0.5us.
+ * RX samples the pin when the compare B interrupt runs, so latency comes out of the half bit
+ * the sample has either side of it, which is what runs out first at the faster rates.
+ *
+ * This is a model of the port only. The jitter of the old bit-banged port against this one was
+ * not measured, that needs simavr and avr-gcc, which this tool does not replace.
+ */
+
+#include "timerSerial/TimerSerial.hpp"
+#include "config.hpp"
+
+#include <avr/io.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+static const uint32_t TIMER_CLOCK = F_CPU / 8;
+static const uint32_t COUNTS_PER_US = TIMER_CLOCK / 1000000;
+static const uint16_t BLOCK_LEN = 64;
+static const uint8_t TX_BUFFER_LEN = 96;
+static const uint8_t RX_BUFFER_LEN = 64;
+
+// Edges are set in whole counts, from a bit time kept as Q8, so may be up to a count off plus
+// the rounding of the bit time over a frame
+static const double MAX_EDGE_ERROR = 1.0 + (10 * 0.5 / 256);
+
+void TIMER0_COMPA_vect();
+void TIMER0_COMPB_vect();
+void ANALOG_COMP_vect();
+
+Register PORTD;
+Register DDRD;
+Register PIND;
+Register TCCR0A;
+Register TCCR0B;
+Register TCNT0;
+Register OCR0A;
+Register OCR0B;
+Register TIMSK0;
+Register TIFR0;
+Register ACSR;
+Register ADCSRB;
+
+static uint64_t now = 0;
+static uint32_t maxLatency = 20 * COUNTS_PER_US;
+static bool txLevel = true;
+
+/**
+ * An interrupt flag, and when the CPU gets round to its vector once it is raised
+ */
+struct Flag
+{
+    bool raised;
+    uint64_t due;
+
+    void raise()
+    {
+        if (raised) return;
+        raised = true;
+        due = now + (rand() % (maxLatency + 1));
+    }
+};
+
+static Flag compareA;
+static Flag compareB;
+static Flag comparator;
+
+// TX level changes
+static std::vector<uint64_t> edges;
+
+static void setTxLevel(bool high)
+{
+    if (high != txLevel) edges.push_back(now);
+    txLevel = high;
+}
+
+/**
+ * What compare A does to the TX pin on a match, or when forced
+ */
+static void compareOutput()
+{
+    if (!(TCCR0A.value & (1 << COM0A1))) return;
+    setTxLevel(TCCR0A.value & (1 << COM0A0));
+}
+
+Register& Register::operator=(uint8_t newValue)
+{
+    if (this == &TIFR0)
+    {
+        // Flags are cleared by writing a one to them
+        if (newValue & (1 << OCF0A)) compareA.raised = false;
+        if (newValue & (1 << OCF0B)) compareB.raised = false;
+        return *this;
+    }
+    if ((this == &TCCR0B) && (newValue & (1 << FOC0A)))
+    {
+        compareOutput();
+        newValue &= ~(1 << FOC0A);
+    }
+    if (this == &ACSR)
+    {
+        if (newValue & (1 << ACI)) comparator.raised = false;
+        newValue &= ~(1 << ACI);
+    }
+    value = newValue;
+    return *this;
+}
+
+/**
+ * Move the timer on a count, and run whatever interrupts are due
+ */
+static void tick()
+{
+    now++;
+    TCNT0.value = now & 0xff;
+
+    if (TCNT0.value == OCR0A.value)
+    {
+        compareOutput();
+        compareA.raise();
+    }
+    if (TCNT0.value == OCR0B.value) compareB.raise();
+
+    // RX is wired to TX. The start bit pulls AIN1 below the bandgap
+    bool rxLevel = txLevel;
+    if (!rxLevel && (PIND.value & (1 << PIND7))) comparator.raise();
+    PIND.value = rxLevel ? (1 << PIND7) : 0;
+
+    // The CPU clears each flag as it runs the vector
+    if (compareA.raised && (TIMSK0.value & (1 << OCIE0A)) && (now >= compareA.due))
+    {
+        compareA.raised = false;
+        TIMER0_COMPA_vect();
+    }
+    if (compareB.raised && (TIMSK0.value & (1 << OCIE0B)) && (now >= compareB.due))
+    {
+        compareB.raised = false;
+        TIMER0_COMPB_vect();
+    }
+    if (comparator.raised && (ACSR.value & (1 << ACIE)) && (now >= comparator.due))
+    {
+        comparator.raised = false;
+        ANALOG_COMP_vect();
+    }
+}
+
+struct Run
+{
+    uint32_t sent;
+    uint32_t received;
+    uint32_t wrong;
+    uint16_t rxErrors;
+    double worstEdgeError;
+};
+
+static Run run(uint32_t baudRate)
+{
+    uint8_t txBuffer[TX_BUFFER_LEN];
+    uint8_t rxBuffer[RX_BUFFER_LEN];
+    TimerSerial serial(baudRate, txBuffer, TX_BUFFER_LEN, rxBuffer, RX_BUFFER_LEN);
+    serial.initialize();
+
+    edges.clear();
+    compareA.raised = false;
+    compareB.raised = false;
+    comparator.raised = false;
+
+    Run result = {};
+    double bitCounts = (double)TIMER_CLOCK / baudRate;
+    uint64_t blockCounts = (uint64_t)(bitCounts * 10 * BLOCK_LEN);
+
+    for (uint16_t block=0; block<(256 / BLOCK_LEN); block++)
+    {
+        char data[BLOCK_LEN];
+        for (uint16_t i=0; i<BLOCK_LEN; i++) data[i] = (block * BLOCK_LEN) + i;
+        serial.write(data, BLOCK_LEN);
+        result.sent += BLOCK_LEN;
+
+        // Read as the WIFI task would, a block is given twice the time it takes to send
+        uint64_t end = now + (2 * blockCounts);
+        while ((now < end) && (result.received < result.sent))
+        {
+            tick();
+
+            char c;
+            while (serial.read(&c, 1) == 1)
+            {
+                if ((uint8_t)c != (result.received & 0xff)) result.wrong++;
+                result.received++;
+            }
+        }
+
+        // Writing more would wait forever on a port that has stopped sending
+        if (result.received < result.sent) break;
+
+        // Idle a while before the next block
+        for (uint32_t i=0; i<(20 * bitCounts); i++) tick();
+    }
+    result.rxErrors = serial.getRxErrors();
+
+    // Within a frame, or back to back frames, edges are a whole number of bits apart
+    for (size_t i=1; i<edges.size(); i++)
+    {
+        double bits = (edges[i] - edges[i - 1]) / bitCounts;
+        if (bits > 10.5) continue;
+
+        double error = fabs(bits - round(bits)) * bitCounts;
+        if (error > result.worstEdgeError) result.worstEdgeError = error;
+    }
+
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t maxLatencyUs = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 20;
+    maxLatency = maxLatencyUs * COUNTS_PER_US;
+
+    printf("Interrupt latency up to %uus\n\n", maxLatencyUs);
+    printf("%-6s %6s %9s %6s %9s %14s\n", "baud", "sent", "received", "wrong", "rxErrors", "worstEdgeCounts");
+
+    bool pass = true;
+    for (uint32_t multiple=1; multiple<=4; multiple*=2)
+    {
+        uint32_t baudRate = WIFI_BAUD_RATE * multiple;
+        Run result = run(baudRate);
+        printf("%-6u %6u %9u %6u %9u %14.2f\n",
+               baudRate,
+               result.sent,
+               result.received,
+               result.wrong,
+               result.rxErrors,
+               result.worstEdgeError);
+
+        // Only the baud rate the probe uses has to work, faster ones show the margin
+        if (baudRate == WIFI_BAUD_RATE)
+        {
+            pass = (result.received == result.sent) && (result.wrong == 0) &&
+                   (result.rxErrors == 0) && (result.worstEdgeError <= MAX_EDGE_ERROR);
+        }
+    }
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
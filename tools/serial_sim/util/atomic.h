@@ -0,0 +1,8 @@
+#ifndef SERIAL_SIM_UTIL_ATOMIC_H
+#define SERIAL_SIM_UTIL_ATOMIC_H
+
+// Interrupts only run between calls from the main loop, so blocks are atomic already
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (bool atomicOnce = true; atomicOnce; atomicOnce = false)
+
+#endif
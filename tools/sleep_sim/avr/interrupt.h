@@ -0,0 +1,12 @@
+#ifndef SLEEP_SIM_AVR_INTERRUPT_H
+#define SLEEP_SIM_AVR_INTERRUPT_H
+
+// The global interrupt flag of the simulated CPU. Like the AVR, sei() lets the instruction after
+// it run before any interrupt is taken
+void cli();
+void sei();
+
+#define ISR(vector) void vector()
+#define EMPTY_INTERRUPT(vector) void vector(){}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef SLEEP_SIM_AVR_IO_H
+#define SLEEP_SIM_AVR_IO_H
+
+/**
+ * Just the Timer 2 registers, for sleep_sim.cpp. Each access is an instruction of the simulated
+ * CPU, which moves the clock on and takes any interrupt that is due
+ */
+
+#include <stdint.h>
+
+class TimerRegister
+{
+    public:
+        TimerRegister(): value(0){}
+
+        TimerRegister& operator=(uint8_t newValue);
+        TimerRegister& operator|=(uint8_t bits){ return *this = (*this | bits); }
+        TimerRegister& operator&=(uint8_t bits){ return *this = (*this & bits); }
+        operator uint8_t();
+
+        uint8_t value;
+};
+
+extern TimerRegister TCNT2;
+extern TimerRegister OCR2B;
+extern TimerRegister TIFR2;
+extern TimerRegister TIMSK2;
+
+#define OCF2B   2
+#define OCF2A   1
+#define OCIE2B  2
+#define OCIE2A  1
+
+#define _BV(bit) (1 << (bit))
+
+#endif
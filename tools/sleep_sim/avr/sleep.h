@@ -0,0 +1,18 @@
+#ifndef SLEEP_SIM_AVR_SLEEP_H
+#define SLEEP_SIM_AVR_SLEEP_H
+
+#include <stdint.h>
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_ADC  1
+
+// Sleeps the simulated CPU until the next interrupt, when sleep is enabled
+extern uint8_t sleepMode;
+extern bool sleepEnabled;
+void sleep_cpu();
+
+#define set_sleep_mode(mode) (sleepMode = (mode))
+#define sleep_enable() (sleepEnabled = true)
+#define sleep_disable() (sleepEnabled = false)
+
+#endif
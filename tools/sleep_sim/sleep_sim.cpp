@@ -0,0 +1,352 @@
+/**
+ * Simulated Timer 2 and CPU for the probe's TicClock, checking that sleeping between tics never
+ * sleeps through a tic or holds up a task past its deadline.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I tools/sleep_sim -I VeranusProbe/src -I shared/TaskScheduler \
+ *          tools/sleep_sim/sleep_sim.cpp VeranusProbe/src/ticClock/TicClock.cpp \
+ *          shared/TaskScheduler/TaskScheduler.cpp -o sleep_sim
+ *      ./sleep_sim [minutes]
+ *
+ * The registers in tools/sleep_sim/avr/io.h and the interrupt flag in avr/interrupt.h drive a
+ * model of the CPU, where every register access and every cli() or sei() is an instruction
+ * taking 1us. Interrupts that are due are taken between instructions while the flag is set,
+ * except straight after sei(), as on the AVR. Timer 2 sets its compare A flag every tic and its
+ * compare B flag when the count reaches OCR2B. sleep_cpu() moves the clock on to the next
+ * interrupt, or counts a hang if interrupts are off. Task bodies take a random time, a
+ * microsecond at a time, so interrupts land anywhere in the loop, including between the loop
+ * checking the tic count and going to sleep.
+ *
+ * The main loop is the one in main.cpp, with its task table, run on the real TaskScheduler.
+ * It is run with the tasks starting at 8 points through a tic, with the UART quiet and with a
+ * UART interrupt every 0-8ms, which also wakes the loop. Reports the worst lateness of any task
+ * as a share of its deadline, the overruns, how often the loop went to sleep with a tic not yet
+ * counted or a task due, and the sleep residency TicClock reports against the time the model
+ * spent asleep.
+ */
+
+#include "ticClock/TicClock.hpp"
+#include "config.hpp"
+#include "TaskScheduler.hpp"
+
+#include <avr/io.h>
+#include <avr/sleep.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+static const uint32_t COUNT_US = 64;
+static const uint32_t TIC_US = COUNTS_PER_TIC * COUNT_US;
+static const uint64_t NEVER = UINT64_MAX;
+
+static uint64_t now = 0;
+
+// CPU
+static bool interruptFlag = false;
+static bool seiShadow = false;
+uint8_t sleepMode = SLEEP_MODE_IDLE;
+bool sleepEnabled = false;
+
+// Interrupt sources, the UART is quiet when its gap is 0
+TimerRegister TCNT2;
+TimerRegister OCR2B;
+TimerRegister TIFR2;
+TimerRegister TIMSK2;
+static uint64_t nextCompareAt = TIC_US;
+static bool comparePending = false;
+static bool compareBPending = false;
+static uint32_t maxUartGapUs = 0;
+static uint64_t nextUartAt = NEVER;
+static bool uartPending = false;
+
+// What happened
+static uint64_t ticsHappened = 0;
+static uint64_t ticsTaken = 0;
+static uint64_t sleepUs = 0;
+static uint32_t sleeps = 0;
+static uint32_t hangs = 0;
+static uint32_t sleptWithTicPending = 0;
+static uint32_t sleptWithTaskDue = 0;
+
+static bool isTaskDue();
+
+/**
+ * When the count next reaches OCR2B, after the given time
+ */
+static uint64_t getCompareBAt(uint64_t after)
+{
+    uint64_t at = (after - (after % TIC_US)) + (OCR2B.value * COUNT_US);
+    return (at <= after) ? (at + TIC_US) : at;
+}
+
+static void advance(uint64_t us)
+{
+    if (getCompareBAt(now) <= (now + us)) compareBPending = true;
+
+    now += us;
+    while (now >= nextCompareAt)
+    {
+        comparePending = true;
+        ticsHappened++;
+        nextCompareAt += TIC_US;
+    }
+    if (now >= nextUartAt) uartPending = true;
+}
+
+static void scheduleUart()
+{
+    nextUartAt = (maxUartGapUs > 0) ? (now + 1 + (rand() % maxUartGapUs)) : NEVER;
+}
+
+static void takeInterrupts()
+{
+    if (!interruptFlag || seiShadow) return;
+
+    // In vector order, each costs a few instructions either side
+    if (comparePending)
+    {
+        comparePending = false;
+        now += 3;
+        ticsTaken++;
+        TicClock::onTic();
+    }
+    if (compareBPending && (TIMSK2.value & _BV(OCIE2B)))
+    {
+        compareBPending = false;
+        now += 3;
+    }
+    if (uartPending)
+    {
+        uartPending = false;
+        now += 3;
+        scheduleUart();
+    }
+}
+
+/**
+ * Run one instruction
+ */
+static void step()
+{
+    takeInterrupts();
+    seiShadow = false;
+    advance(1);
+}
+
+TimerRegister& TimerRegister::operator=(uint8_t newValue)
+{
+    step();
+    if (this == &TIFR2)
+    {
+        // Flags are cleared by writing a one to them
+        if (newValue & _BV(OCF2A)) comparePending = false;
+        if (newValue & _BV(OCF2B)) compareBPending = false;
+    }
+    else
+    {
+        value = newValue;
+    }
+    return *this;
+}
+
+TimerRegister::operator uint8_t()
+{
+    step();
+    if (this == &TCNT2) return (now / COUNT_US) % COUNTS_PER_TIC;
+    if (this == &TIFR2) return (comparePending ? _BV(OCF2A) : 0) | (compareBPending ? _BV(OCF2B) : 0);
+    return value;
+}
+
+void cli()
+{
+    step();
+    interruptFlag = false;
+}
+
+void sei()
+{
+    step();
+    interruptFlag = true;
+    seiShadow = true;
+}
+
+bool getInterruptFlag(){ return interruptFlag; }
+void setInterruptFlag(bool enabled)
+{
+    step();
+    interruptFlag = enabled;
+}
+
+void sleep_cpu()
+{
+    // The instruction after sei() is this one, pending interrupts wake us straight away
+    seiShadow = false;
+    if (!sleepEnabled) return;
+
+    if (!interruptFlag)
+    {
+        // Nothing can wake us, only the watchdog would. Carry on from the next tic
+        hangs++;
+        advance(nextCompareAt - now);
+        interruptFlag = true;
+        takeInterrupts();
+        return;
+    }
+
+    bool compareBWakes = TIMSK2.value & _BV(OCIE2B);
+    if (!comparePending && !uartPending && !(compareBPending && compareBWakes))
+    {
+        sleeps++;
+        if (ticsTaken != ticsHappened) sleptWithTicPending++;
+        if (isTaskDue()) sleptWithTaskDue++;
+
+        uint64_t wake = (nextCompareAt < nextUartAt) ? nextCompareAt : nextUartAt;
+        if (compareBWakes && (getCompareBAt(now) < wake)) wake = getCompareBAt(now);
+        sleepUs += wake - now;
+        advance(wake - now);
+    }
+    takeInterrupts();
+}
+
+/**
+ * Tasks of main.cpp, doing nothing for a while
+ */
+static void work(uint32_t minUs, uint32_t maxUs)
+{
+    uint32_t us = minUs + (rand() % (maxUs - minUs + 1));
+    for (uint32_t i=0; i<us; i++) step();
+}
+
+static void updateCli(){ work(20, 300); }
+static void updateWifiTask(){ work(20, 600); }
+static void updateClimateSensor(){ work(200, 2000); }
+static void updateLightSensor(){ work(100, 400); }
+
+// Now and then an eeprom byte is written, which waits out the last write
+static void updateEeprom(){ (rand() % 8) ? work(10, 100) : work(3400, 3600); }
+static void feedWatchdog(){ work(5, 20); }
+
+static const Scheduler::Task tasks[] =
+{
+    {"CLI",     updateCli,           COUNTS_PER_TIC,                                   0, COUNTS_PER_TIC},
+    {"WIFI",    updateWifiTask,      COUNTS_PER_TIC,                                   0, COUNTS_PER_TIC},
+    {"CLIMATE", updateClimateSensor, CLIMATE_UPDATE_TIME_SECONDS * COUNTS_PER_SECOND,  1, COUNTS_PER_SECOND},
+    {"LIGHT",   updateLightSensor,   LIGHT_UPDATE_TIME_SECONDS * COUNTS_PER_SECOND,    1, COUNTS_PER_SECOND},
+    {"EEPROM",  updateEeprom,        COUNTS_PER_TIC,                                   2, 5 * COUNTS_PER_SECOND},
+    {"WDT",     feedWatchdog,        COUNTS_PER_SECOND / 4,                            3, COUNTS_PER_SECOND}
+};
+static const uint8_t numTasks = sizeof(tasks) / sizeof(tasks[0]);
+static Scheduler::TaskStats taskStats[numTasks];
+static Scheduler::TaskScheduler scheduler(tasks, taskStats, numTasks, &TicClock::getTimerCounts);
+
+static bool isTaskDue()
+{
+    uint32_t counts = now / COUNT_US;
+    for (uint8_t i=0; i<numTasks; i++)
+    {
+        if ((int32_t)(counts - taskStats[i].nextRun) >= 0) return true;
+    }
+    return false;
+}
+
+struct Run
+{
+    double worstLateness;   // Fraction of the deadline
+    uint32_t overruns;
+    uint32_t sleeps;
+    uint32_t hangs;
+    uint32_t ticPending;
+    uint32_t taskDue;
+    uint8_t residency;
+    double asleep;
+};
+
+/**
+ * Run the main loop of main.cpp for a while, with the tasks starting the given time into a tic
+ */
+static Run run(uint32_t startUs, uint32_t uartGapUs, uint64_t runUs)
+{
+    maxUartGapUs = uartGapUs;
+    scheduleUart();
+    interruptFlag = true;
+
+    // Start on the next tic, then however far into it
+    while (!comparePending) step();
+    for (uint32_t i=0; i<startUs; i++) step();
+    scheduler.start();
+
+    uint32_t windowTics = 0;
+    TicClock::takeSleepResidency(windowTics);
+    uint64_t startSleepUs = sleepUs;
+    uint32_t startSleeps = sleeps;
+    uint32_t startHangs = hangs;
+    uint32_t startTicPending = sleptWithTicPending;
+    uint32_t startTaskDue = sleptWithTaskDue;
+    uint64_t start = now;
+
+    while (now < (start + runUs))
+    {
+        uint32_t tic = TicClock::getTicCount();
+        if (!scheduler.runNext())
+        {
+            TicClock::sleepUntilInterrupt(tic, scheduler.getNextRun(), SLEEP_MODE_IDLE);
+        }
+    }
+
+    Run result = {};
+    for (uint8_t i=0; i<numTasks; i++)
+    {
+        double lateness = (double)taskStats[i].maxLateness / tasks[i].deadline;
+        if (lateness > result.worstLateness) result.worstLateness = lateness;
+        result.overruns += taskStats[i].overruns;
+    }
+    result.sleeps = sleeps - startSleeps;
+    result.hangs = hangs - startHangs;
+    result.ticPending = sleptWithTicPending - startTicPending;
+    result.taskDue = sleptWithTaskDue - startTaskDue;
+    result.residency = TicClock::takeSleepResidency(windowTics);
+    result.asleep = (100.0 * (sleepUs - startSleepUs)) / (now - start);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t minutes = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2;
+    uint64_t runUs = (uint64_t)minutes * 60 * 1000000;
+
+    printf("%-6s %8s %10s %9s %8s %6s %11s %8s %10s %8s\n",
+           "uart", "startUs", "worstLate", "overruns", "sleeps", "hangs", "ticPending", "taskDue", "residency", "asleep");
+
+    bool pass = true;
+    for (uint8_t busy=0; busy<2; busy++)
+    {
+        for (uint32_t startUs=0; startUs<TIC_US; startUs+=(TIC_US / 8))
+        {
+            Run result = run(startUs + (rand() % 100), busy ? 8000 : 0, runUs);
+            printf("%-6s %8u %9.0f%% %9u %8u %6u %11u %8u %9u%% %7.1f%%\n",
+                   busy ? "busy" : "quiet",
+                   startUs,
+                   100 * result.worstLateness,
+                   result.overruns,
+                   result.sleeps,
+                   result.hangs,
+                   result.ticPending,
+                   result.taskDue,
+                   result.residency,
+                   result.asleep);
+
+            // Residency is counted in whole tics, so is only close
+            pass = pass && (result.overruns == 0) && (result.hangs == 0) &&
+                   (result.ticPending == 0) && (result.taskDue == 0) &&
+                   (fabs(result.residency - result.asleep) <= 1.5);
+        }
+    }
+    // Every tic is counted, but for one that may have only just happened
+    pass = pass && ((ticsHappened - TicClock::getTicCount()) <= 1);
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,21 @@
+#ifndef SLEEP_SIM_UTIL_ATOMIC_H
+#define SLEEP_SIM_UTIL_ATOMIC_H
+
+#include <avr/interrupt.h>
+
+// Restores the interrupt flag at the end of the block, interrupts that came due run then
+bool getInterruptFlag();
+void setInterruptFlag(bool enabled);
+
+struct AtomicGuard
+{
+    AtomicGuard(): once(true), enabled(getInterruptFlag()) { cli(); }
+    ~AtomicGuard(){ setInterruptFlag(enabled); }
+    bool once;
+    bool enabled;
+};
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (AtomicGuard atomicGuard; atomicGuard.once; atomicGuard.once = false)
+
+#endif
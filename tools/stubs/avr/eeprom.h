@@ -0,0 +1,61 @@
+#ifndef STUBS_AVR_EEPROM_H
+#define STUBS_AVR_EEPROM_H
+
+/**
+ * The ATmega328's 1KB of EEPROM, counting the writes to each byte. A write keeps the EEPROM busy
+ * until the tool clears busy, as the 3.3ms write time has passed. Once writeLimit reaches 0
+ * writes are dropped, as if the probe had reset part way through a save
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define E2END 1023
+
+struct HostEeprom
+{
+    uint8_t data[E2END + 1];
+    uint32_t writes[E2END + 1];
+    bool busy;
+    int32_t writeLimit;     // Negative for no limit
+
+    void erase()
+    {
+        memset(data, 0xff, sizeof(data));
+        memset(writes, 0, sizeof(writes));
+        busy = false;
+        writeLimit = -1;
+    }
+};
+
+inline HostEeprom& hostEeprom()
+{
+    static HostEeprom eeprom = []{ HostEeprom e; e.erase(); return e; }();
+    return eeprom;
+}
+
+inline bool eeprom_is_ready(){ return !hostEeprom().busy; }
+
+inline uint8_t eeprom_read_byte(const uint8_t* address)
+{
+    return hostEeprom().data[(uintptr_t)address];
+}
+
+inline void eeprom_read_block(void* dest, const void* address, size_t length)
+{
+    memcpy(dest, &hostEeprom().data[(uintptr_t)address], length);
+}
+
+inline void eeprom_write_byte(uint8_t* address, uint8_t value)
+{
+    HostEeprom& eeprom = hostEeprom();
+    if (eeprom.writeLimit == 0) return;
+    if (eeprom.writeLimit > 0) eeprom.writeLimit--;
+
+    eeprom.data[(uintptr_t)address] = value;
+    eeprom.writes[(uintptr_t)address]++;
+    eeprom.busy = true;
+}
+
+#endif
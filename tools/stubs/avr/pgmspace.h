@@ -0,0 +1,26 @@
+#ifndef STUB_AVR_PGMSPACE_H
+#define STUB_AVR_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+// One address space on the host
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+#define strcpy_P strcpy
+#define strcmp_P strcmp
+#define strlen_P strlen
+#define strncpy_P strncpy
+#define memcpy_P memcpy
+#define strlcpy_P(dest, src, length) (strncpy(dest, src, length), (dest)[(length) - 1] = '\0', strlen(src))
+
+// Reads give back the type pointed to, so that pointer tables read with pgm_read_word still work
+// with the host's wider pointers
+template<typename T> inline T pgmRead(const T* p){ return *p; }
+#define pgm_read_byte(p) pgmRead(p)
+#define pgm_read_word(p) pgmRead(p)
+#define pgm_read_dword(p) pgmRead(p)
+#define pgm_read_ptr(p) pgmRead(p)
+
+#endif
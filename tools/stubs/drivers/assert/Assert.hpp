@@ -0,0 +1,6 @@
+#ifndef STUB_ASSERT_HPP
+#define STUB_ASSERT_HPP
+
+#include <cassert>
+
+#endif
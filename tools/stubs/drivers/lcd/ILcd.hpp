@@ -0,0 +1,18 @@
+#ifndef STUB_ILCD_HPP
+#define STUB_ILCD_HPP
+
+#include <stdint.h>
+
+namespace Lcd
+{
+    class ILcd
+    {
+        public:
+            virtual ~ILcd(){}
+            virtual void initialize() = 0;
+            virtual void display(const char* text, uint8_t length) = 0;
+            virtual void setCursor(uint8_t row, uint8_t col) = 0;
+    };
+}
+
+#endif
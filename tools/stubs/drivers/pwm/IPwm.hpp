@@ -0,0 +1,17 @@
+#ifndef STUB_IPWM_HPP
+#define STUB_IPWM_HPP
+
+#include <stdint.h>
+
+namespace Pwm
+{
+    class IPwm
+    {
+        public:
+            virtual ~IPwm(){}
+            virtual void setDutyCycle(uint8_t dutyCycle) = 0;
+            virtual void enable() = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef STUB_IRADIO_HPP
+#define STUB_IRADIO_HPP
+
+#include <stdint.h>
+
+namespace Radio
+{
+    class IRadio
+    {
+        public:
+            virtual ~IRadio(){}
+            virtual void setPayloadSize(uint8_t size) = 0;
+            virtual bool startTransmitting(uint8_t address) = 0;
+            virtual bool transmit(uint8_t* data, uint8_t length) = 0;
+            virtual bool startReceiving(uint8_t address) = 0;
+            virtual bool isDataAvailable() = 0;
+            virtual bool receive(uint8_t* data, uint8_t length) = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef STUB_ISERIAL_HPP
+#define STUB_ISERIAL_HPP
+
+#include <stdint.h>
+
+namespace SerialComm
+{
+    class ISerial
+    {
+        public:
+            virtual ~ISerial(){}
+            virtual void initialize() = 0;
+            virtual void write(const char* data, uint16_t length) = 0;
+            virtual uint16_t read(char* data, uint16_t length) = 0;
+            virtual bool isDataAvailable() = 0;
+            virtual void flush() = 0;
+    };
+}
+
+#endif
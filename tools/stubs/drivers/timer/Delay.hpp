@@ -0,0 +1,6 @@
+#ifndef STUB_DELAY_HPP
+#define STUB_DELAY_HPP
+
+#define DELAY(ms)
+
+#endif
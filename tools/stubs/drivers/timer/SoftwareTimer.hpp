@@ -0,0 +1,47 @@
+#ifndef STUB_SOFTWARE_TIMER_HPP
+#define STUB_SOFTWARE_TIMER_HPP
+
+#include <stdint.h>
+#include "drivers/timer/TicCounter.hpp"
+#include "drivers/watchdog/Watchdog.hpp"
+
+namespace Timer
+{
+    /**
+     * Period counted in tics of the given counter
+     */
+    class SoftwareTimer
+    {
+        public:
+            SoftwareTimer(uint32_t period, Tic::TicCounter* pCounter, Watchdog::IWatchdog* = nullptr):
+                period_(period), pCounter_(pCounter), start_(0), enabled_(false){}
+
+            void enable(){ enabled_ = true; start_ = pCounter_->getTicCount(); }
+            void disable(){ enabled_ = false; }
+            void reset(){ start_ = pCounter_->getTicCount(); }
+            bool isEnabled(){ return enabled_; }
+            void setPeriod(uint32_t period){ period_ = period; }
+
+            bool hasPeriodPassed()
+            {
+                if (!enabled_ || ((pCounter_->getTicCount() - start_) < period_)) return false;
+                start_ += period_;
+                return true;
+            }
+
+            bool hasOneShotPassed()
+            {
+                if (!enabled_ || ((pCounter_->getTicCount() - start_) < period_)) return false;
+                enabled_ = false;
+                return true;
+            }
+
+        private:
+            uint32_t period_;
+            Tic::TicCounter* pCounter_;
+            uint32_t start_;
+            bool enabled_;
+    };
+}
+
+#endif
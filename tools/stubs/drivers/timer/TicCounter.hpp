@@ -0,0 +1,26 @@
+#ifndef STUB_TIC_COUNTER_HPP
+#define STUB_TIC_COUNTER_HPP
+
+#include <stdint.h>
+
+namespace Tic
+{
+    /**
+     * Counts tics as the tic interrupt would, the tool calls incrementTicCount()
+     */
+    class TicCounter
+    {
+        public:
+            TicCounter(uint32_t ticsPerSecond): ticsPerSecond_(ticsPerSecond), tics_(0){}
+
+            void incrementTicCount(){ tics_++; }
+            uint32_t secondsToTics(uint32_t seconds){ return seconds * ticsPerSecond_; }
+            uint32_t getTicCount(){ return tics_; }
+
+        private:
+            uint32_t ticsPerSecond_;
+            uint32_t tics_;
+    };
+}
+
+#endif
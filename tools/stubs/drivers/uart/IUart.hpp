@@ -0,0 +1,20 @@
+#ifndef STUB_IUART_HPP
+#define STUB_IUART_HPP
+
+#include <stdint.h>
+
+namespace Uart
+{
+    class IUart
+    {
+        public:
+            virtual ~IUart(){}
+            virtual void initialize() = 0;
+            virtual void write(const uint8_t* data, uint16_t length) = 0;
+            virtual uint16_t read(uint8_t* data, uint16_t length) = 0;
+            virtual bool isDataAvailable() = 0;
+            virtual void flush() = 0;
+    };
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef STUB_WATCHDOG_HPP
+#define STUB_WATCHDOG_HPP
+
+namespace Watchdog
+{
+    enum ResetCause
+    {
+        POWER_ON,
+        WATCHDOG,
+        BROWN_OUT
+    };
+
+    class IWatchdog
+    {
+        public:
+            virtual ~IWatchdog(){}
+            virtual void reset() = 0;
+    };
+}
+
+#endif
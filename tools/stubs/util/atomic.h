@@ -0,0 +1,8 @@
+#ifndef STUBS_UTIL_ATOMIC_H
+#define STUBS_UTIL_ATOMIC_H
+
+// Nothing interrupts the tools that use this, so the block only has to run once
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (bool atomicOnce = true; atomicOnce; atomicOnce = false)
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef STUB_UTIL_CRC16_H
+#define STUB_UTIL_CRC16_H
+
+#include <stdint.h>
+
+// The C versions given in the avr-libc documentation
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+    data ^= crc & 0xff;
+    data ^= data << 4;
+    return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data)
+{
+    data ^= crc;
+    for (uint8_t i=0; i<8; i++)
+    {
+        data = (data & 0x80) ? ((data << 1) ^ 0x07) : (data << 1);
+    }
+    return data;
+}
+
+#endif
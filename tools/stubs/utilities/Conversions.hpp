@@ -0,0 +1,7 @@
+#ifndef STUB_CONVERSIONS_HPP
+#define STUB_CONVERSIONS_HPP
+
+inline float degreesCToF(float celsius){ return (celsius * 9.0f / 5.0f) + 32.0f; }
+inline float degreesFToC(float fahrenheit){ return (fahrenheit - 32.0f) * 5.0f / 9.0f; }
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef STUB_PRINT_HPP
+#define STUB_PRINT_HPP
+
+#include <stdio.h>
+
+// Firmware output is only noise in a tool's report, define PRINT_TO_STDERR to see it
+#ifdef PRINT_TO_STDERR
+#define PRINT(format, ...) fprintf(stderr, format, ##__VA_ARGS__)
+#define PRINTLN(format, ...) (fprintf(stderr, format, ##__VA_ARGS__), fprintf(stderr, "\n"))
+#else
+#define PRINT(format, ...) do { if (0) fprintf(stderr, format, ##__VA_ARGS__); } while (0)
+#define PRINTLN(format, ...) do { if (0) fprintf(stderr, format, ##__VA_ARGS__); } while (0)
+#endif
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef STUB_STRINGS_HPP
+#define STUB_STRINGS_HPP
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace Strings
+{
+    inline int32_t str2int(const char* str){ return strtol(str, nullptr, 10); }
+    inline bool strcompare(const char* a, const char* b){ return strcmp(a, b) == 0; }
+    // Length is the most characters written, the buffer holds one more for the terminator
+    inline void int2str(int32_t value, char* buffer, uint16_t length){ snprintf(buffer, length + 1, "%d", value); }
+    inline void copy(char* dest, const char* src, uint16_t length){ strncpy(dest, src, length); dest[length - 1] = '\0'; }
+}
+
+#endif
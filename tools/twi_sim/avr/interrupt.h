@@ -0,0 +1,7 @@
+#ifndef TWI_SIM_AVR_INTERRUPT_H
+#define TWI_SIM_AVR_INTERRUPT_H
+
+// Interrupts are called by the simulated bus, between calls from the main loop
+#define ISR(vector) void vector()
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef TWI_SIM_AVR_IO_H
+#define TWI_SIM_AVR_IO_H
+
+/**
+ * Just the TWI registers, for twi_sim.cpp. Writes to TWCR are handed to the simulated bus
+ */
+
+#include <stdint.h>
+
+class ControlRegister
+{
+    public:
+        ControlRegister& operator=(uint8_t value);
+        operator uint8_t();
+
+        uint8_t value;
+        unsigned reads;
+};
+
+extern ControlRegister TWCR;
+extern uint8_t TWSR;
+extern uint8_t TWBR;
+extern uint8_t TWDR;
+
+#define TWINT   7
+#define TWEA    6
+#define TWSTA   5
+#define TWSTO   4
+#define TWWC    3
+#define TWEN    2
+#define TWIE    0
+
+#endif
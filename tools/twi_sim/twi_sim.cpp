@@ -0,0 +1,369 @@
+/**
+ * Simulated I2C bus for the probe's TWI queue and HDC1080 driver, checking that reading the
+ * climate never holds up the main loop, whatever the bus does.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -DF_CPU=16000000UL -I tools/twi_sim -I VeranusProbe/src \
+ *          tools/twi_sim/twi_sim.cpp VeranusProbe/src/twiQueue/TwiQueue.cpp \
+ *          VeranusProbe/src/asyncHdc1080/AsyncHdc1080.cpp -o twi_sim
+ *      ./twi_sim [bitRate]
+ *
+ * The TWI registers in tools/twi_sim/avr/io.h drive a model of the bus and an HDC1080, which
+ * takes 9 bit times per byte and fires the TWI interrupt when each step is done. The main loop
+ * calls the driver once a tic like the climate task does, through a healthy stretch, a stretch
+ * with the sensor unplugged (every address is not acknowledged), and a stretch with the bus
+ * stuck (SCL held low, nothing ever completes). Simulated time moves 4us for every time source
+ * call, so a driver that waited on the bus would show up as a long call, or never return.
+ *
+ * Reports how long each call to the driver took at worst, in simulated time and TWCR reads,
+ * how many readings were right, and how long readings and failures took to come out.
+ */
+
+#include "twiQueue/TwiQueue.hpp"
+#include "asyncHdc1080/AsyncHdc1080.hpp"
+
+#include <avr/io.h>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Twi;
+
+void TWI_vect();
+
+static const uint32_t TIC_US = 16384;
+static const uint32_t COUNT_US = 64;
+static const uint32_t COUNTS_PER_TIC = TIC_US / COUNT_US;
+static const uint32_t CPU_US_PER_TIME_CALL = 4;
+static const uint32_t SAMPLE_PERIOD_US = 60u * 1000000u;
+
+// HDC1080 at 14 bits, temperature then humidity
+static const uint32_t CONVERSION_US = 6350 + 6500;
+
+static uint64_t now = 0;
+int atomicDepth = 0;
+
+ControlRegister TWCR = {0, 0};
+uint8_t TWSR = 0;
+uint8_t TWBR = 0;
+uint8_t TWDR = 0;
+
+/**
+ * Bus and sensor model
+ */
+enum class Fault
+{
+    NONE,
+    UNPLUGGED,
+    STUCK
+};
+
+enum class Phase
+{
+    IDLE,
+    ADDRESS,    // Start sent, the address byte goes next
+    TRANSMIT,
+    RECEIVE
+};
+
+static Fault fault = Fault::NONE;
+static Phase phase = Phase::IDLE;
+
+static bool eventPending = false;
+static uint64_t eventAt = 0;
+static uint8_t eventStatus = 0;
+
+// Sensor state
+static uint8_t pointer = 0;
+static uint8_t bytesWritten = 0;
+static uint16_t configuration = 0;
+static uint64_t conversionDone = 0;
+static bool converted = false;
+static uint8_t readIndex = 0;
+static uint16_t rawTemperature = 0;
+static uint16_t rawHumidity = 0;
+
+static uint32_t byteUs()
+{
+    uint32_t bitRate = F_CPU / (16 + (2 * (uint32_t)TWBR));
+    return ((9 * 1000000u) + bitRate - 1) / bitRate;
+}
+
+static void schedule(uint8_t status, uint32_t us)
+{
+    eventPending = true;
+    eventAt = now + us;
+    eventStatus = status;
+}
+
+static void sensorStop()
+{
+    // A pointer write to the temperature register on its own starts a conversion
+    if ((phase == Phase::TRANSMIT) && (bytesWritten == 1) && (pointer == 0))
+    {
+        conversionDone = now + CONVERSION_US;
+        converted = true;
+        readIndex = 0;
+    }
+    phase = Phase::IDLE;
+}
+
+static void onControl(uint8_t value)
+{
+    if (!(value & (1 << TWEN)))
+    {
+        // Disabled, lets go of the bus
+        eventPending = false;
+        phase = Phase::IDLE;
+        return;
+    }
+    if (!(value & (1 << TWINT))) return;
+
+    if (fault == Fault::STUCK) return;
+
+    if (value & (1 << TWSTO))
+    {
+        sensorStop();
+        TWCR.value &= ~(1 << TWSTO);
+        if (value & (1 << TWSTA))
+        {
+            schedule(0x08, byteUs() / 4);
+            phase = Phase::ADDRESS;
+        }
+        return;
+    }
+
+    if (value & (1 << TWSTA))
+    {
+        schedule((phase == Phase::IDLE) ? 0x08 : 0x10, byteUs() / 4);
+        if (phase != Phase::IDLE) sensorStop();
+        phase = Phase::ADDRESS;
+        return;
+    }
+
+    switch (phase)
+    {
+        case Phase::ADDRESS:
+        {
+            bool read = TWDR & 1;
+            bool present = ((TWDR >> 1) == 0x40) && (fault != Fault::UNPLUGGED);
+
+            // Reads are not acknowledged until the conversion is done
+            if (read && present && converted && (now < conversionDone)) present = false;
+
+            if (!present)
+            {
+                schedule(read ? 0x48 : 0x20, byteUs());
+                phase = Phase::IDLE;
+                break;
+            }
+
+            phase = read ? Phase::RECEIVE : Phase::TRANSMIT;
+            bytesWritten = 0;
+            schedule(read ? 0x40 : 0x18, byteUs());
+            break;
+        }
+
+        case Phase::TRANSMIT:
+        {
+            if (bytesWritten == 0) pointer = TWDR;
+            else if (pointer == 0x02) configuration = (bytesWritten == 1) ?
+                                                      ((uint16_t)TWDR << 8) :
+                                                      (configuration | TWDR);
+            bytesWritten++;
+            schedule(0x28, byteUs());
+            break;
+        }
+
+        case Phase::RECEIVE:
+        {
+            uint16_t value = (readIndex < 2) ? rawTemperature : rawHumidity;
+            TWDR = (readIndex % 2) ? (value & 0xff) : (value >> 8);
+            readIndex++;
+            schedule((TWCR.value & (1 << TWEA)) ? 0x50 : 0x58, byteUs());
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+ControlRegister& ControlRegister::operator=(uint8_t newValue)
+{
+    // Writing a one clears the interrupt flag
+    value = newValue & ~(1 << TWINT);
+    onControl(newValue);
+    return *this;
+}
+
+ControlRegister::operator uint8_t()
+{
+    reads++;
+    return value;
+}
+
+/**
+ * Run the interrupts due by now, unless they are disabled
+ */
+void runInterrupts()
+{
+    while ((atomicDepth == 0) && eventPending && (eventAt <= now))
+    {
+        eventPending = false;
+        TWSR = eventStatus;
+        TWCR.value |= (1 << TWINT);
+        if (TWCR.value & (1 << TWIE)) TWI_vect();
+    }
+}
+
+static uint32_t getCounts()
+{
+    now += CPU_US_PER_TIME_CALL;
+    runInterrupts();
+    return now / COUNT_US;
+}
+
+/**
+ * Main loop
+ */
+struct Stats
+{
+    unsigned readings;
+    unsigned wrong;
+    unsigned failures;
+    unsigned calls;
+    uint64_t worstCallUs;
+    unsigned worstCallReads;
+    uint64_t worstReadingUs;
+    uint64_t worstFailureUs;
+};
+
+static void setClimate(uint64_t us)
+{
+    double hours = us / 3.6e9;
+    double temperatureC = 22.0 + (3.0 * sin(hours));
+    double humidity = 50.0 + (10.0 * cos(hours));
+    rawTemperature = (uint16_t)(((temperatureC + 40.0) / 165.0) * 65536.0);
+    rawHumidity = (uint16_t)((humidity / 100.0) * 65536.0);
+}
+
+static void run(AsyncHdc1080& sensor, uint64_t untilUs, Stats& stats)
+{
+    static uint64_t nextRun = 0;
+    static uint64_t readingStart = 0;
+    static bool inFlight = false;
+
+    while (now < untilUs)
+    {
+        // Sleep until the next tic, the bus carries on in the meantime
+        uint64_t tic = ((now / TIC_US) + 1) * TIC_US;
+        while (eventPending && (eventAt <= tic))
+        {
+            now = eventAt;
+            runInterrupts();
+        }
+        now = tic;
+        runInterrupts();
+
+        if (now < nextRun) continue;
+        if (!inFlight)
+        {
+            readingStart = now;
+            inFlight = true;
+            setClimate(now);
+        }
+
+        int16_t temperatureF;
+        uint16_t humidity;
+        uint64_t start = now;
+        unsigned reads = TWCR.reads;
+        AsyncHdc1080::Result result = sensor.update(temperatureF, humidity);
+
+        stats.calls++;
+        if ((now - start) > stats.worstCallUs) stats.worstCallUs = now - start;
+        if ((TWCR.reads - reads) > stats.worstCallReads) stats.worstCallReads = TWCR.reads - reads;
+
+        if (result == AsyncHdc1080::Result::BUSY)
+        {
+            nextRun = tic + TIC_US;
+            continue;
+        }
+
+        uint64_t took = now - readingStart;
+        inFlight = false;
+        nextRun = readingStart + SAMPLE_PERIOD_US;
+
+        if (result == AsyncHdc1080::Result::FAILED)
+        {
+            stats.failures++;
+            if (took > stats.worstFailureUs) stats.worstFailureUs = took;
+            continue;
+        }
+
+        stats.readings++;
+        if (took > stats.worstReadingUs) stats.worstReadingUs = took;
+
+        int32_t expectedT = (((int32_t)rawTemperature * 29700) >> 16) - 4000;
+        int32_t expectedH = ((uint32_t)rawHumidity * 10000) >> 16;
+        if ((configuration != 0x1000) || (temperatureF != expectedT) || (humidity != expectedH))
+        {
+            stats.wrong++;
+        }
+    }
+}
+
+static void report(const char* name, const Stats& stats)
+{
+    printf("%-10s %8u %8u %6u %6u %10.0f %6u %10.1f %10.1f\n",
+           name,
+           stats.calls,
+           stats.readings,
+           stats.wrong,
+           stats.failures,
+           (double)stats.worstCallUs,
+           stats.worstCallReads,
+           stats.worstReadingUs / 1000.0,
+           stats.worstFailureUs / 1000.0);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t bitRate = (argc > 1) ? atoi(argv[1]) : 400000;
+
+    TwiQueue twi(bitRate, &getCounts, COUNTS_PER_TIC);
+    AsyncHdc1080 sensor(&twi, &getCounts, 15000 / COUNT_US);
+
+    twi.initialize();
+    uint64_t startUs = now;
+    bool configured = sensor.initialize();
+    printf("%u Hz, configured %s in %.0fus\n\n",
+           bitRate, configured ? "ok" : "FAILED", (double)(now - startUs));
+
+    printf("%-10s %8s %8s %6s %6s %10s %6s %10s %10s\n",
+           "bus", "calls", "readings", "wrong", "failed", "callMaxUs", "reads", "readMaxMs", "failMaxMs");
+
+    const uint64_t HOUR = 3600ull * 1000000ull;
+    Stats healthy = {}, unplugged = {}, stuck = {}, recovered = {};
+
+    run(sensor, now + HOUR, healthy);
+    fault = Fault::UNPLUGGED;
+    run(sensor, now + HOUR, unplugged);
+    fault = Fault::STUCK;
+    run(sensor, now + HOUR, stuck);
+    fault = Fault::NONE;
+    run(sensor, now + HOUR, recovered);
+
+    report("healthy", healthy);
+    report("unplugged", unplugged);
+    report("stuck", stuck);
+    report("recovered", recovered);
+
+    bool pass = configured &&
+                (healthy.readings > 0) && (healthy.wrong == 0) && (healthy.failures == 0) &&
+                (unplugged.readings == 0) && (stuck.readings == 0) &&
+                (recovered.readings > 0) && (recovered.wrong == 0) &&
+                (stuck.worstCallUs < TIC_US);
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
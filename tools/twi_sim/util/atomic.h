@@ -0,0 +1,18 @@
+#ifndef TWI_SIM_UTIL_ATOMIC_H
+#define TWI_SIM_UTIL_ATOMIC_H
+
+// Interrupts that came due inside a block run at the end of it, like on the AVR
+extern int atomicDepth;
+void runInterrupts();
+
+struct AtomicGuard
+{
+    AtomicGuard(): once(true) { atomicDepth++; }
+    ~AtomicGuard(){ atomicDepth--; runInterrupts(); }
+    bool once;
+};
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_BLOCK(type) for (AtomicGuard atomicGuard; atomicGuard.once; atomicGuard.once = false)
+
+#endif
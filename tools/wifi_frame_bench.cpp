@@ -0,0 +1,287 @@
+/**
+ * Benchmark of the probe's wifi uplink, the binary SEND_BATCH frame against the "SD" text
+ * command it replaced, see VeranusProbe/src/wifiInterface/WifiFrame.hpp.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusProbe/src -I shared/VeranusProtocol -I tools/stubs \
+ *          tools/wifi_frame_bench.cpp VeranusProbe/src/wifiInterface/WifiInterface.cpp \
+ *          VeranusProbe/src/readingBuffer/ReadingBuffer.cpp VeranusProbe/src/ProbeStrings.cpp \
+ *          VeranusProbe/src/Settings.cpp -o wifi_frame_bench
+ *      ./wifi_frame_bench [sends]
+ *
+ * Readings go through the real WifiInterface into a fake serial port, which answers each
+ * command as the wifi module would. The frames written are run through a decoder of the frame
+ * format, byte at a time as the module receives them, and checked against the readings sent.
+ *
+ * For each number of readings per send, reports the bytes on the wire per reading, the time the
+ * bytes take at the wifi baud rate, and the host time (and TSC cycles on x86) to encode and to
+ * decode a send. Host time is only a relative measure, the probe runs at 16MHz.
+ */
+
+#include "wifiInterface/WifiInterface.hpp"
+#include "config.hpp"
+#include "Settings.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <util/crc16.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+static uint64_t cycles(){ return __rdtsc(); }
+#else
+static uint64_t cycles(){ return 0; }
+#endif
+
+static uint32_t tics = 0;
+static uint32_t getTics(){ return tics; }
+
+/**
+ * Wifi module end of the serial port. Keeps what the probe wrote, and answers the next
+ * command with the line queued for it
+ */
+class FakeSerial: public SerialComm::ISerial
+{
+    public:
+        void initialize(){}
+        void write(const char* data, uint16_t length){ written.insert(written.end(), data, data + length); }
+        void flush(){}
+
+        bool isDataAvailable(){ return readIndex < response.size(); }
+        uint16_t read(char* data, uint16_t length)
+        {
+            uint16_t i = 0;
+            while ((i < length) && isDataAvailable()) data[i++] = response[readIndex++];
+            return i;
+        }
+
+        void respond(VeranusWifiCode code, bool success)
+        {
+            char line[8];
+            snprintf(line, sizeof(line), "%u\r\n", code | (success ? SUCCESS_BITMASK : 0));
+            response = line;
+            readIndex = 0;
+        }
+
+        std::vector<char> written;
+        std::string response;
+        size_t readIndex = 0;
+};
+
+/**
+ * The module's side of a SEND_BATCH frame, fed a byte at a time
+ */
+class FrameDecoder
+{
+    public:
+        /**
+         * @return  True once a frame with a good CRC is complete
+         */
+        bool addByte(uint8_t byte)
+        {
+            if (index_ == 0)
+            {
+                if (byte == WIFI_FRAME_START) buffer_[index_++] = byte;
+                return false;
+            }
+
+            buffer_[index_++] = byte;
+            uint8_t length = buffer_[1];
+            if (index_ < (WIFI_FRAME_HEADER_LEN + length + WIFI_FRAME_CRC_LEN)) return false;
+
+            uint16_t crc = 0xffff;
+            for (uint16_t i=1; i<(WIFI_FRAME_HEADER_LEN + length); i++)
+            {
+                crc = _crc_ccitt_update(crc, buffer_[i]);
+            }
+            uint16_t sentCrc = buffer_[index_ - 2] | (buffer_[index_ - 1] << 8);
+            index_ = 0;
+            return (crc == sentCrc) && (buffer_[2] == WIFI_FRAME_VERSION) &&
+                   (buffer_[3] == VeranusWifiCode::SEND_BATCH);
+        }
+
+        const WifiBatchHeader* getHeader(){ return (const WifiBatchHeader*)&buffer_[4]; }
+        const WifiBatchReading* getReading(uint8_t index)
+        {
+            return (const WifiBatchReading*)&buffer_[4 + sizeof(WifiBatchHeader) + (index * sizeof(WifiBatchReading))];
+        }
+
+    private:
+        uint8_t buffer_[WIFI_FRAME_MAX_LEN];
+        uint16_t index_ = 0;
+};
+
+static const uint16_t PROBE_ID = 42;
+
+static StoredReading makeReading(uint32_t i)
+{
+    StoredReading reading;
+    reading.timestamp = i;
+    reading.temperature = (int16_t)((i * 7919) % 20000) - 4000;
+    reading.humidity = (i * 104729) % 10001;
+    reading.light = (i * 1299709) % 10001;
+    return reading;
+}
+
+struct Result
+{
+    uint64_t bytes;
+    uint64_t readings;
+    double encodeNs;
+    uint64_t encodeCycles;
+    double decodeNs;
+    uint64_t decodeCycles;
+    uint32_t mismatches;
+};
+
+/**
+ * Upload readings in sends of the given size, in binary mode or as text
+ */
+static Result run(bool binary, uint8_t perSend, uint32_t numSends)
+{
+    Result result = {};
+
+    static Tic::TicCounter ticCounter(TICS_PER_SECOND);
+    static Timer::SoftwareTimer timeoutTimer(ticCounter.secondsToTics(WIFI_TIMEOUT_TIME_SECONDS), &ticCounter);
+    StoredReading storage[WIFI_BATCH_MAX_READINGS];
+    ReadingBuffer readings(storage, WIFI_BATCH_MAX_READINGS);
+    FakeSerial serial;
+    WifiInterface wifi(&serial, &timeoutTimer, &readings, &getTics);
+
+    // Negotiate the mode as the probe does at boot
+    wifi.init();
+    wifi.update();
+    serial.respond(VeranusWifiCode::BINARY_MODE, binary);
+    wifi.update();
+    if (wifi.isBinaryMode() != binary) exit(1);
+
+    std::vector<StoredReading> sent;
+    serial.written.reserve(WIFI_FRAME_MAX_LEN);
+    uint32_t next = 0;
+    for (uint32_t send=0; send<numSends; send++)
+    {
+        sent.clear();
+        for (uint8_t i=0; i<perSend; i++)
+        {
+            StoredReading reading = makeReading(next++);
+            readings.push(reading);
+            sent.push_back(reading);
+        }
+        tics = sent.back().timestamp * TICS_PER_SECOND;
+
+        // Text mode only carries one reading a send, so sends until the buffer is empty
+        while (!readings.isEmpty())
+        {
+            serial.written.clear();
+
+            auto start = std::chrono::steady_clock::now();
+            uint64_t startCycles = cycles();
+            wifi.send(PROBE_ID, nullptr);
+            wifi.update();
+            result.encodeCycles += cycles() - startCycles;
+            result.encodeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            result.bytes += serial.written.size();
+            if (binary)
+            {
+                FrameDecoder decoder;
+                bool decoded = false;
+                start = std::chrono::steady_clock::now();
+                startCycles = cycles();
+                for (char byte: serial.written)
+                {
+                    decoded = decoder.addByte(byte);
+                }
+                result.decodeCycles += cycles() - startCycles;
+                result.decodeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+                const WifiBatchHeader* pHeader = decoder.getHeader();
+                if (!decoded || (pHeader->probeId != PROBE_ID) || (pHeader->count != perSend)) result.mismatches++;
+                for (uint8_t i=0; decoded && (i<pHeader->count) && (i<perSend); i++)
+                {
+                    const WifiBatchReading* pReading = decoder.getReading(i);
+                    if ((pReading->temperature != sent[i].temperature) ||
+                        (pReading->humidity != sent[i].humidity) ||
+                        (pReading->light != sent[i].light) ||
+                        (pReading->age != (sent.back().timestamp - sent[i].timestamp)))
+                    {
+                        result.mismatches++;
+                    }
+                }
+            }
+            else
+            {
+                // The module parses "SD id t h l" with sscanf
+                start = std::chrono::steady_clock::now();
+                startCycles = cycles();
+                serial.written.push_back('\0');
+                unsigned id;
+                float temperature, humidity, light;
+                int fields = sscanf(serial.written.data(), "SD %u %f %f %f", &id, &temperature, &humidity, &light);
+                result.decodeCycles += cycles() - startCycles;
+                result.decodeNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+                serial.written.pop_back();
+
+                const StoredReading& reading = sent[sent.size() - readings.getCount()];
+                if ((fields != 4) || (id != PROBE_ID) ||
+                    (Protocol::toFixedTemperature(temperature) != reading.temperature) ||
+                    (Protocol::toFixedPercent(humidity) != reading.humidity) ||
+                    (Protocol::toFixedPercent(light) != reading.light))
+                {
+                    result.mismatches++;
+                }
+            }
+
+            serial.respond(binary ? VeranusWifiCode::SEND_BATCH : VeranusWifiCode::SEND, true);
+            wifi.update();
+        }
+        result.readings += perSend;
+    }
+
+    return result;
+}
+
+static void report(const char* mode, uint8_t perSend, const Result& result, uint32_t numSends)
+{
+    double bytesPerReading = (double)result.bytes / result.readings;
+    double wireMsPerReading = (bytesPerReading * 10 * 1000.0) / WIFI_BAUD_RATE;
+    printf("%-6s %6u %10.1f %9.2f %10.0f %10.0f %10.0f %10.0f %6u\n",
+           mode,
+           perSend,
+           bytesPerReading,
+           wireMsPerReading,
+           result.encodeNs / numSends,
+           (double)result.encodeCycles / numSends,
+           result.decodeNs / numSends,
+           (double)result.decodeCycles / numSends,
+           result.mismatches);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t numSends = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 100000;
+    settings.debug = false;
+
+    printf("%-6s %6s %10s %9s %10s %10s %10s %10s %6s\n",
+           "mode", "perSend", "bytes/rdg", "wireMs", "encodeNs", "encodeCyc", "decodeNs", "decodeCyc", "bad");
+
+    bool pass = true;
+    Result text = run(false, 1, numSends);
+    report("text", 1, text, numSends);
+    pass = pass && (text.mismatches == 0);
+
+    for (uint8_t perSend=1; perSend<=WIFI_BATCH_MAX_READINGS; perSend++)
+    {
+        Result binary = run(true, perSend, numSends);
+        report("binary", perSend, binary, numSends);
+        pass = pass && (binary.mismatches == 0);
+    }
+
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}
@@ -0,0 +1,303 @@
+/**
+ * Scripted wifi module for the probe's WifiInterface, checking that the command queue never
+ * holds up the main loop, whatever the module does.
+ *
+ * Build and run from the repository root:
+ *      g++ -std=c++11 -O2 -I VeranusProbe/src -I shared/VeranusProtocol -I tools/stubs \
+ *          tools/wifi_latency_sim.cpp VeranusProbe/src/wifiInterface/WifiInterface.cpp \
+ *          VeranusProbe/src/readingBuffer/ReadingBuffer.cpp VeranusProbe/src/ProbeStrings.cpp \
+ *          VeranusProbe/src/Settings.cpp -o wifi_latency_sim
+ *      ./wifi_latency_sim [repeats]
+ *
+ * The fake serial port takes each command the probe writes, and plays back the module's answer
+ * from a script: after a delay, a line at a time, with noise lines, an SSID ahead of a GET_CONFIG
+ * result, failures, and no answer at all so the command times out. Answers arrive at the wifi
+ * baud rate, a tic's worth of bytes at a time, into a receive buffer the size of the real one.
+ * The script is also run with each answer arriving all at once, as if the loop had been held up.
+ *
+ * update() is called once a tic, as the WIFI task does. Reports how long each call took at
+ * worst in host time, and the most bytes it read and wrote, which is the work it does on the
+ * probe. Each command has to finish with the result the script gave, at the tic it was given.
+ */
+
+#include "wifiInterface/WifiInterface.hpp"
+#include "config.hpp"
+#include "Settings.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Receive buffer of the Timer 0 serial port in devices.cpp
+static const uint16_t RX_BUFFER_LEN = 64;
+static const uint16_t BYTES_PER_TIC = (WIFI_BAUD_RATE / 10) / TICS_PER_SECOND;
+static const uint32_t TIMEOUT_TICS = WIFI_TIMEOUT_TIME_SECONDS * TICS_PER_SECOND;
+static const uint32_t NO_ANSWER = UINT32_MAX;
+
+static Tic::TicCounter ticCounter(TICS_PER_SECOND);
+static uint32_t getTics(){ return ticCounter.getTicCount(); }
+
+/**
+ * What the module does with the next command: wait, then send the lines given
+ */
+struct Answer
+{
+    const char* command;    // Start of the command expected
+    uint32_t delayTics;     // NO_ANSWER to stay quiet
+    const char* lines;
+    bool success;           // Result the callback should see
+};
+
+static const Answer script[] =
+{
+    {"BN 1",        2,          "\r\n135\r\n",                  true},
+    {"GC",          5,          "HomeNet\r\n132\r\n",         true},
+    {"\xA5",        10,         "136\r\n",                      true},
+    {"SC",          30,         "noise\r\n131\r\n",             true},
+    {"\xA5",        NO_ANSWER,  "",                             false},
+    {"\xA5",        3,          "7\r\n8\r\n",                   false},
+    {"GC",          4,          "132\r\n",                      false},
+    {"\xA5",        1,          "136\r\n",                      true}
+};
+static const uint8_t SCRIPT_LEN = sizeof(script) / sizeof(script[0]);
+
+class ScriptedModule: public SerialComm::ISerial
+{
+    public:
+        void initialize(){}
+        void flush()
+        {
+            rxCount = 0;
+            rxIndex = 0;
+        }
+
+        void write(const char* data, uint16_t length)
+        {
+            bytesWritten += length;
+            command.append(data, length);
+
+            // Text commands end with a newline, frames are complete at their length
+            bool complete = (command[0] == (char)WIFI_FRAME_START) ?
+                            ((command.size() >= 2) &&
+                             (command.size() >= (size_t)(WIFI_FRAME_HEADER_LEN + (uint8_t)command[1] + WIFI_FRAME_CRC_LEN))) :
+                            (command.find('\n') != std::string::npos);
+            if (!complete) return;
+
+            // init() clears the line before the first command
+            if (command == "\r\n")
+            {
+                command.clear();
+                return;
+            }
+
+            if ((step >= SCRIPT_LEN) || (command.compare(0, strlen(script[step].command), script[step].command) != 0))
+            {
+                printf("Unexpected command %u: %.*s\n", step, (int)command.size(), command.c_str());
+                exit(1);
+            }
+
+            sentAt[step] = getTics();
+            if (script[step].delayTics != NO_ANSWER)
+            {
+                pending = script[step].lines;
+                answerAt = getTics() + script[step].delayTics;
+            }
+            step++;
+            command.clear();
+        }
+
+        bool isDataAvailable(){ return rxIndex < rxCount; }
+        uint16_t read(char* data, uint16_t length)
+        {
+            uint16_t i = 0;
+            while ((i < length) && isDataAvailable()) data[i++] = rx[rxIndex++];
+            bytesRead += i;
+            return i;
+        }
+
+        /**
+         * Receive what has arrived over the last tic
+         */
+        void tic(bool burst)
+        {
+            if (pending.empty() || (getTics() < answerAt)) return;
+
+            // The ring buffer empties as it is read, keep what is left at the front
+            memmove(rx, &rx[rxIndex], rxCount - rxIndex);
+            rxCount -= rxIndex;
+            rxIndex = 0;
+
+            size_t length = burst ? pending.size() : std::min<size_t>(pending.size(), BYTES_PER_TIC);
+            for (size_t i=0; i<length; i++)
+            {
+                if (rxCount < RX_BUFFER_LEN) rx[rxCount++] = pending[i];
+                else overruns++;
+            }
+            pending.erase(0, length);
+        }
+
+        std::string command;
+        std::string pending;
+        uint32_t answerAt = 0;
+        uint8_t step = 0;
+        uint32_t sentAt[SCRIPT_LEN] = {};
+
+        char rx[RX_BUFFER_LEN];
+        uint16_t rxCount = 0;
+        uint16_t rxIndex = 0;
+        uint32_t overruns = 0;
+
+        uint32_t bytesRead = 0;
+        uint32_t bytesWritten = 0;
+};
+
+struct Completion
+{
+    bool done;
+    bool success;
+    uint32_t tic;
+};
+
+static Completion completions[SCRIPT_LEN];
+static uint8_t numCompleted = 0;
+static std::string ssid;
+
+static void onComplete(bool success, const char* response)
+{
+    completions[numCompleted++] = {true, success, getTics()};
+    if (response != nullptr) ssid = response;
+}
+
+struct Stats
+{
+    double worstUpdateNs;
+    double totalUpdateNs;
+    uint32_t updates;
+    uint32_t worstRead;
+    uint32_t worstWritten;
+    uint32_t wrong;
+    uint32_t overruns;
+};
+
+static void runScript(bool burst, Stats& stats)
+{
+    StoredReading storage[16];
+    ReadingBuffer readings(storage, 16);
+    Timer::SoftwareTimer timeoutTimer(TIMEOUT_TICS, &ticCounter);
+    ScriptedModule module;
+    WifiInterface wifi(&module, &timeoutTimer, &readings, &getTics);
+
+    numCompleted = 0;
+    ssid.clear();
+
+    uint8_t queued = 1;
+    wifi.init();
+
+    uint32_t end = getTics() + (SCRIPT_LEN * TIMEOUT_TICS);
+    while ((getTics() < end) && (numCompleted < (SCRIPT_LEN - 1)))
+    {
+        ticCounter.incrementTicCount();
+        module.tic(burst);
+
+        // Queue the next command once the one before has finished, some while others are queued
+        if ((queued < SCRIPT_LEN) && (numCompleted >= queued - 1))
+        {
+            StoredReading reading = {getTics() / TICS_PER_SECOND, 7012, 4550, 1234};
+            readings.push(reading);
+
+            const char* command = script[queued].command;
+            bool accepted = (command[0] == (char)WIFI_FRAME_START) ? wifi.send(42, &onComplete) :
+                            (strcmp(command, "GC") == 0) ? wifi.getConfig(&onComplete) :
+                            wifi.setConfig("HomeNet", "secret", &onComplete);
+            if (!accepted) stats.wrong++;
+
+            // A second send or config command cannot be queued behind the first
+            if ((command[0] == (char)WIFI_FRAME_START) && wifi.send(42, &onComplete)) stats.wrong++;
+            if ((command[0] != (char)WIFI_FRAME_START) && wifi.getConfig(&onComplete)) stats.wrong++;
+
+            queued++;
+        }
+
+        uint32_t read = module.bytesRead;
+        uint32_t written = module.bytesWritten;
+        auto start = std::chrono::steady_clock::now();
+        wifi.update();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        stats.updates++;
+        stats.totalUpdateNs += ns;
+        if (ns > stats.worstUpdateNs) stats.worstUpdateNs = ns;
+        if ((module.bytesRead - read) > stats.worstRead) stats.worstRead = module.bytesRead - read;
+        if ((module.bytesWritten - written) > stats.worstWritten) stats.worstWritten = module.bytesWritten - written;
+    }
+
+    // The binary mode request has no callback, the rest finish in script order. Each is timed
+    // from when the module had all of it, as some wait in the queue first
+    if (!wifi.isBinaryMode() || (ssid != "HomeNet") || (numCompleted != (SCRIPT_LEN - 1))) stats.wrong++;
+    for (uint8_t i=1; i<SCRIPT_LEN; i++)
+    {
+        const Completion& completion = completions[i - 1];
+        // update() takes one line a call, and a trickled answer may end a tic later
+        uint32_t numLines = 0;
+        for (const char* c=script[i].lines; *c!='\0'; c++) numLines += (*c == '\n');
+
+        uint32_t sentAt = module.sentAt[i];
+        uint32_t latest = (script[i].delayTics == NO_ANSWER) ?
+                          (sentAt + TIMEOUT_TICS + 1) :
+                          (sentAt + script[i].delayTics + numLines + (burst ? 0 : 1));
+        if (!completion.done || (completion.success != script[i].success) || (completion.tic > latest))
+        {
+            printf("Command %u: %s at tic %u, expected %s by %u\n",
+                   i, completion.success ? "success" : "failure", completion.tic - sentAt,
+                   script[i].success ? "success" : "failure", latest - sentAt);
+            stats.wrong++;
+        }
+    }
+    stats.overruns += module.overruns;
+}
+
+static void report(const char* name, const Stats& stats)
+{
+    printf("%-8s %8u %12.0f %12.1f %8u %8u %6u %8u\n",
+           name,
+           stats.updates,
+           stats.worstUpdateNs,
+           stats.totalUpdateNs / stats.updates,
+           stats.worstRead,
+           stats.worstWritten,
+           stats.wrong,
+           stats.overruns);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t repeats = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 20;
+    settings.debug = false;
+
+    // The first run warms up caches and allocations, and is not counted
+    Stats trickle = {}, burst = {};
+    runScript(false, trickle);
+    runScript(true, burst);
+    trickle = {};
+    burst = {};
+
+    for (uint32_t i=0; i<repeats; i++)
+    {
+        runScript(false, trickle);
+        runScript(true, burst);
+    }
+
+    printf("%-8s %8s %12s %12s %8s %8s %6s %8s\n",
+           "answers", "updates", "worstNs", "meanNs", "maxRead", "maxWrite", "wrong", "overruns");
+    report("trickle", trickle);
+    report("burst", burst);
+
+    // At most one command line or frame, and one receive buffer, are handled in a call
+    bool pass = (trickle.wrong == 0) && (burst.wrong == 0) &&
+                (trickle.overruns == 0) && (burst.overruns == 0) &&
+                (burst.worstRead <= RX_BUFFER_LEN) && (burst.worstWritten <= WIFI_FRAME_MAX_LEN);
+    printf("\n%s\n", pass ? "PASS" : "FAIL");
+    return pass ? 0 : 1;
+}